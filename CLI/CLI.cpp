@@ -43,8 +43,12 @@
 #include <TRXManager.h>
 #include <PowerManager.h>
 #include <TMSITable.h>
+#include <sqlite3util.h>
 #include <RadioResource.h>
 #include <CallControl.h>
+#include <MobilityManagement.h>
+#include <SMSSpool.h>
+#include <SMSControl.h>
 
 #include <Globals.h>
 
@@ -283,6 +287,24 @@ int tmsis(int argc, char** argv, ostream& os, istream& is)
 }
 
 
+/** Print the latest RRLP position fixes. */
+int locations(int argc, char** argv, ostream& os, istream& is)
+{
+	if (argc>2) return BAD_NUM_ARGS;
+	const char *name = NULL;
+	string IMSIName;
+	if (argc==2) {
+		// Accept the IMSI with or without the "IMSI" prefix of the subscriber name.
+		IMSIName = argv[1];
+		if (IMSIName.compare(0,4,"IMSI")!=0) IMSIName = "IMSI" + IMSIName;
+		name = IMSIName.c_str();
+	}
+	os << "subscriber              latitude    longitude   error  time (UTC)" << endl;
+	gBTS.locations().dump(os,name);
+	return SUCCESS;
+}
+
+
 /** Submit an SMS for delivery to an IMSI. */
 int sendsimple(int argc, char** argv, ostream& os, istream& is)
 {
@@ -386,12 +408,67 @@ int printStats(int argc, char** argv, ostream& os, istream& is)
 	if (argc!=1) return BAD_NUM_ARGS;
 	os << "SDCCH load: " << gBTS.SDCCHActive() << '/' << gBTS.SDCCHTotal() << endl;
 	os << "TCH/F load: " << gBTS.TCHActive() << '/' << gBTS.TCHTotal() << endl;
-	os << "AGCH/PCH load: " << gBTS.AGCHLoad() << ',' << gBTS.PCHLoad() << endl;
+	os << "AGCH/PCH load: " << gBTS.AGCHLoad()+gBTS.accessGrants().load() << ',' << gBTS.PCHLoad() << endl;
+	gBTS.accessGrants().dumpStats(os);
 	// paging table size
 	os << "Paging table size: " << gBTS.pager().pagingEntryListSize() << endl;
 	os << "Transactions: " << gTransactionTable.size() << endl;
 	// 3122 timer current value (the number of seconds an MS should hold off the next RACH)
 	os << "T3122: " << gBTS.T3122() << " ms" << endl;
+	if (gBTS.overload().enabled()) {
+		os << "Overload: ";
+		gBTS.overload().dump(os);
+		os << endl;
+	}
+	os << "Startup: ";
+	gBTS.dumpStartup(os);
+	os << endl;
+	os << "Physical status: ";
+	gPhysStatus.dump(os);
+	os << endl;
+	os << "TMSI table: ";
+	gTMSITable.dumpStats(os);
+	os << endl;
+	os << "sqlite: ";
+	sqlite3_dump_stats(os);
+	os << endl;
+	os << "Subscriber cache: ";
+	gSubscriberRegistry.dumpCacheStats(os);
+	os << endl;
+	os << "LUR pipeline: " << Control::RegistrationCache::policy() << " ";
+	gBTS.registrations().dump(os);
+	os << endl;
+	os << "RRLP server: ";
+	Control::dumpRRLPStats(os);
+	os << endl;
+	os << "RRLP fixes: ";
+	gBTS.locations().dumpStats(os);
+	os << endl;
+	os << "SMS spool: ";
+	gSMSSpool.dump(os);
+	os << endl;
+	os << "MT-SMS: ";
+	Control::dumpMTSMSStats(os);
+	os << endl;
+	gBTS.dumpChannelStats(os);
+	if (gBTS.scheduler().enabled()) gBTS.scheduler().dump(os);
+	if (gBTS.reactor().enabled()) gBTS.reactor().dump(os);
+	os << "Protocol timers: ";
+	gBTS.timers().dump(os);
+	os << endl;
+	if (gConfig.defines("Control.Tasks")) {
+		os << "SDCCH tasks: ";
+		gBTS.tasks().dump(os);
+		os << endl;
+	}
+	unsigned threads;
+	unsigned long voluntary, involuntary;
+	if (GSM::processThreadStats(threads,voluntary,involuntary)) {
+		os << "Threads: " << threads << ", context switches: " << voluntary << " voluntary, "
+			<< involuntary << " involuntary" << endl;
+	}
+	if (gTRX.ARFCN()->decodePool().running()) gTRX.ARFCN()->decodePool().dump(os);
+	ObjectPool::dumpAll(os);
 	return SUCCESS;
 }
 
@@ -571,6 +648,7 @@ int notices(int argc, char **argv, ostream& os, istream& is)
 int page(int argc, char **argv, ostream& os, istream& is)
 {
 	if (argc==1) {
+		gBTS.pager().dumpStats(os);
 		gBTS.pager().dump(os);
 		return SUCCESS;
 	}
@@ -619,15 +697,27 @@ void printChanInfo(unsigned transID, const GSM::LogicalChannel* chan, ostream& o
 		100.0*chan->FER(), (int)round(chan->RSSI()),
 		chan->actualMSPower(), chan->actualMSTiming());
 	os << " " << buffer;
-	const GSM::L3MeasurementResults& meas = chan->SACCH()->measurementResults();
-	if (!meas.MEAS_VALID()) {
+	// The latest measurement report, from memory.
+	GSM::PhysicalStatus::Entry status;
+	if (gPhysStatus.get(chan->SACCH(),status) && !status.mMeasValid) {
 		snprintf(buffer,199,"%5d %5.2f",
-			meas.RXLEV_FULL_SERVING_CELL_dBm(),
-			100.0*meas.RXQUAL_FULL_SERVING_CELL_BER());
+			status.mRXLevFull,
+			100.0*status.mRXQualFullBER);
 		os << " " << buffer;
 	} else {
 		os << " ----- ------";
 	}
+	snprintf(buffer,199,"%6.0f %6u",
+		chan->decodeLatency(), chan->maxDecodeLatency());
+	os << " " << buffer;
+	// Soft combining on the main channel and its SACCH.
+	unsigned tries = chan->combineTries() + chan->SACCH()->combineTries();
+	unsigned hits = chan->combineHits() + chan->SACCH()->combineHits();
+	if (tries) snprintf(buffer,199,"%4u %5.1f", tries, 100.0*hits/tries);
+	else snprintf(buffer,199,"%4u %5s", tries, "-");
+	os << " " << buffer;
+	snprintf(buffer,199,"%4u", chan->T200Expirations() + chan->SACCH()->T200Expirations());
+	os << " " << buffer;
 	os << endl;
 }
 
@@ -637,8 +727,8 @@ int chans(int argc, char **argv, ostream& os, istream& is)
 {
 	if (argc!=1) return BAD_NUM_ARGS;
 
-	os << "CN TN chan      transaction UPFER RSSI TXPWR TXTA DNLEV DNBER" << endl;
-	os << "CN TN type      id          pct    dB   dBm  sym   dBm   pct" << endl;
+	os << "CN TN chan      transaction UPFER RSSI TXPWR TXTA DNLEV DNBER DECLAT DECMAX COMB COMBOK T200" << endl;
+	os << "CN TN type      id          pct    dB   dBm  sym   dBm   pct     us     us   ct    pct   ct" << endl;
 
 	//gPhysStatus.dump(os);
 	//os << endl << "Old data reporting: " << endl;
@@ -743,6 +833,7 @@ Parser::Parser()
 	addCommand("tmsis", tmsis, "[\"clear\"] or [\"dump\" filename] -- print/clear the TMSI table or dump it to a file.");
 	addCommand("sendsms", sendsms, "<IMSI> <src> -- send direct SMS to <IMSI>, addressed from <src>, after prompting.");
 	addCommand("sendsimple", sendsimple, "<IMSI> <src> -- send SMS to <IMSI> via SIP interface, addressed from <src>, after prompting.");
+	addCommand("locations", locations, "[IMSI] -- print the latest RRLP position fix of each subscriber, or of one.");
 	addCommand("sendrrlp", sendrrlp, "<IMSI> <hexstring> -- send RRLP message <hexstring> to <IMSI>.");
 	addCommand("load", printStats, "-- print the current activity loads.");
 	addCommand("cellid", cellID, "[MCC MNC LAC CI] -- get/set location area identity (MCC, MNC, LAC) and cell ID (CI)");
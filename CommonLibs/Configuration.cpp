@@ -46,6 +46,7 @@ static const char* createConfigTable = {
 
 
 ConfigurationTable::ConfigurationTable(const char* filename)
+	:mLastReload(0)
 {
 	// Connect to the database.
 	int rc = sqlite3_open(filename,&mDB);
@@ -55,10 +56,13 @@ ConfigurationTable::ConfigurationTable(const char* filename)
 		mDB = NULL;
 		return;
 	}
+	sqlite3_setup(mDB);
 	// Create the table, if needed.
 	if (!sqlite3_command(mDB,createConfigTable)) {
 		cerr << "Cannot create configuration table:" << sqlite3_errmsg(mDB);
 	}
+	// Warm the cache.
+	preload();
 }
 
 
@@ -287,19 +291,45 @@ bool ConfigurationTable::set(const string& key)
 void ConfigurationTable::checkCacheAge()
 {
 	// mLock is set by caller 
-	static time_t timeOfLastPurge = 0;
 	time_t now = time(NULL);
-	// purge every 3 seconds
-	// purge period cannot be configuration parameter
-	if (now - timeOfLastPurge < 3) return;
-	timeOfLastPurge = now;
-	// this is purge() without the lock
-	ConfigurationMap::iterator mp = mCache.begin();
-	while (mp != mCache.end()) {
-		ConfigurationMap::iterator prev = mp;
-		mp++;
-		mCache.erase(prev);
+	// reload every 3 seconds
+	// reload period cannot be configuration parameter
+	if (now - mLastReload < 3) return;
+	// One scan of the table is cheaper than a query for each key used in the next 3 seconds.
+	reload();
+}
+
+
+unsigned ConfigurationTable::preload()
+{
+	assert(mDB);
+	ScopedLock lock(mLock);
+	return reload();
+}
+
+
+unsigned ConfigurationTable::reload()
+{
+	// mLock is set by caller
+	mLastReload = time(NULL);
+	mCache.clear();
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_statement(mDB,&stmt,"SELECT KEYSTRING,VALUESTRING FROM CONFIG")) return 0;
+	unsigned count = 0;
+	int src = sqlite3_run_query(mDB,stmt);
+	while (src==SQLITE_ROW) {
+		const char* key = (const char*)sqlite3_column_text(stmt,0);
+		const char* value = (const char*)sqlite3_column_text(stmt,1);
+		// A NULL value is an undefined key, as in lookup().
+		if (key) {
+			if (value) mCache[key] = ConfigurationRecord(value);
+			else mCache[key] = ConfigurationRecord(false);
+			count++;
+		}
+		src = sqlite3_run_query(mDB,stmt);
 	}
+	sqlite3_finalize(stmt);
+	return count;
 }
 
 
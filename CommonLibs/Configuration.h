@@ -40,6 +40,7 @@
 
 #include <Threads.h>
 #include <stdint.h>
+#include <time.h>
 
 
 /** A class for configuration file errors. */
@@ -174,8 +175,9 @@ class ConfigurationTable {
 	private:
 
 	sqlite3* mDB;				///< database connection
-	ConfigurationMap mCache;	///< cache of recently access configuration values
+	ConfigurationMap mCache;	///< cache of the whole table, reloaded every 3 seconds
 	mutable Mutex mLock;		///< control for multithreaded access to the cache
+	time_t mLastReload;			///< time of the last reload of the cache
 
 	public:
 
@@ -249,9 +251,16 @@ class ConfigurationTable {
 	/** Define the callback to purge the cache whenever the database changes. */
 	void setUpdateHook(void(*)(void *,int ,char const *,char const *,sqlite3_int64));
 
-	/** purege cache if it exceeds a certain age */
+	/** Reload the cache if it exceeds a certain age. */
 	void checkCacheAge();
 
+	/**
+		Load the whole table into the cache in one scan,
+		rather than one query per key on first use.
+		@return The number of keys loaded.
+	*/
+	unsigned preload();
+
 	/** Delete all records from the cache. */
 	void purge();
 
@@ -265,6 +274,9 @@ class ConfigurationTable {
 	*/
 	const ConfigurationRecord& lookup(const std::string& key);
 
+	/** Replace the cache with the whole table.  Caller holds mLock. */
+	unsigned reload();
+
 };
 
 
@@ -0,0 +1,382 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "Coroutines.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <assert.h>
+
+using namespace std;
+
+
+__thread Task* gCurrentTask = NULL;
+
+/** Protects the parking state of all tasks and the parked lists of all signals. */
+static Mutex gTaskParkLock;
+
+
+/**
+	Run a scope as plain thread code, even inside a task.
+	The task machinery itself uses Mutex and TimerWheel, and must not
+	park in the middle of parking.  These locks are only held briefly.
+*/
+class ThreadScope {
+
+	private:
+
+	Task *mSaved;
+
+	public:
+
+	ThreadScope()
+		:mSaved(gCurrentTask)
+	{ gCurrentTask = NULL; }
+
+	~ThreadScope() { gCurrentTask = mSaved; }
+};
+
+
+
+
+Task::Task(TaskPool *wPool, void (*wFunction)(void*), void *wArg, size_t stackSize)
+	:mPool(wPool),mWorker(0),mFunction(wFunction),mArg(wArg),
+	mReturn(NULL),mDone(false),
+	mParked(false),mParkedOn(NULL),mParkCount(0),mTimerID(0)
+{
+	// Put a guard page under the stack, so that an overflow faults.
+	size_t page = sysconf(_SC_PAGESIZE);
+	stackSize = (stackSize + page - 1) / page * page;
+	mMapSize = stackSize + page;
+	void *map = mmap(NULL,mMapSize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+	assert(map!=MAP_FAILED);
+	mStack = (char*)map;
+	int s = mprotect(mStack,page,PROT_NONE);
+	assert(s==0);
+
+	s = getcontext(&mContext);
+	assert(s==0);
+	mContext.uc_stack.ss_sp = mStack + page;
+	mContext.uc_stack.ss_size = stackSize;
+	mContext.uc_link = NULL;
+	// makecontext only passes ints.
+	uint64_t self = (uintptr_t)this;
+	makecontext(&mContext,(void(*)())start,2,(unsigned)(self>>32),(unsigned)self);
+}
+
+
+Task::~Task()
+{
+	assert(mDone);
+	// A stale wake-up timer may still be on its way.
+	mPool->timers().wait(this);
+	munmap(mStack,mMapSize);
+}
+
+
+void Task::start(unsigned hi, unsigned lo)
+{
+	Task *task = (Task*)(uintptr_t)(((uint64_t)hi<<32) | lo);
+	task->mFunction(task->mArg);
+	task->mDone = true;
+	setcontext(task->mReturn);
+}
+
+
+void Task::run(ucontext_t *worker)
+{
+	mReturn = worker;
+	gCurrentTask = this;
+	swapcontext(worker,&mContext);
+	gCurrentTask = NULL;
+}
+
+
+void Task::park(TaskList *waiting, Mutex *mutex, bool timed, unsigned ms)
+{
+	assert(gCurrentTask==this);
+	unsigned parkCount;
+	{
+		ThreadScope scope;
+		ScopedLock lock(gTaskParkLock);
+		mParked = true;
+		mParkedOn = waiting;
+		parkCount = ++mParkCount;
+		if (waiting) waiting->push_back(this);
+	}
+	if (timed) {
+		ThreadScope scope;
+		mTimerID = mPool->timers().schedule(ms,this,parkCount);
+	}
+	// Nobody can run us until we swap out, since only our own thread runs us.
+	if (mutex) mutex->unlock();
+	swapcontext(&mContext,mReturn);
+
+	// Woken up, back on our own thread.
+	if (mTimerID) {
+		ThreadScope scope;
+		mPool->timers().cancel(mTimerID);
+		mTimerID = 0;
+	}
+	if (mutex) mutex->lock();
+}
+
+
+void Task::wait(const Signal& signal, Mutex& mutex)
+{
+	park(&signal.mParked,&mutex,false,0);
+}
+
+
+void Task::wait(const Signal& signal, Mutex& mutex, unsigned timeout)
+{
+	park(&signal.mParked,&mutex,true,timeout);
+}
+
+
+void Task::lock(Mutex& mutex)
+{
+	while (!mutex.trylock()) {
+		{
+			ThreadScope scope;
+			ScopedLock lock(gTaskParkLock);
+			mParked = true;
+			mParkedOn = &mutex.mWaiters;
+			// A new park count makes any earlier wake-up timer stale.
+			mParkCount++;
+			mutex.mWaiters.push_back(this);
+		}
+		// The holder may have unlocked before it could see us on the list.
+		if (mutex.trylock()) {
+			bool woken;
+			{
+				ThreadScope scope;
+				ScopedLock lock(gTaskParkLock);
+				woken = !mParked;
+				if (mParked) {
+					mParked = false;
+					mutex.mWaiters.remove(this);
+					mParkedOn = NULL;
+				}
+			}
+			// If we were posted anyway, let the worker take the post.
+			if (woken) swapcontext(&mContext,mReturn);
+			return;
+		}
+		// Any unlock after that trylock sees us in the waiter count and wakes us.
+		swapcontext(&mContext,mReturn);
+	}
+}
+
+
+void Task::sleep(unsigned ms)
+{
+	park(NULL,NULL,true,ms);
+}
+
+
+void Task::timeout(unsigned tag)
+{
+	ScopedLock lock(gTaskParkLock);
+	// The tag tells a late timer from an earlier park.
+	if (mParked && tag==mParkCount) wake();
+}
+
+
+void Task::wake()
+{
+	// Caller holds gTaskParkLock.
+	assert(mParked);
+	mParked = false;
+	if (mParkedOn) {
+		mParkedOn->remove(this);
+		mParkedOn = NULL;
+	}
+	mPool->post(this);
+}
+
+
+void Task::wake(TaskList& waiting, bool all)
+{
+	ThreadScope scope;
+	ScopedLock lock(gTaskParkLock);
+	while (!waiting.empty()) {
+		// wake() takes the task off the list.
+		waiting.front()->wake();
+		if (!all) break;
+	}
+}
+
+
+
+void Signal::wakeTasks(bool all) const
+{
+	Task::wake(mParked,all);
+}
+
+
+void Mutex::wakeTasks()
+{
+	Task::wake(mWaiters,false);
+}
+
+
+
+
+void TaskWorker::start(TaskPool *wPool)
+{
+	mPool = wPool;
+	mThread.start((void*(*)(void*))TaskWorkerAdapter,this);
+}
+
+
+void TaskWorker::post(Task *task)
+{
+	ThreadScope scope;
+	ScopedLock lock(mLock);
+	mReady.push_back(task);
+	mReadySignal.signal();
+}
+
+
+void TaskWorker::serviceLoop()
+{
+	while (true) {
+		Task *task;
+		{
+			ScopedLock lock(mLock);
+			while (mReady.size()==0) mReadySignal.wait(mLock);
+			task = mReady.front();
+			mReady.pop_front();
+			mRuns++;
+		}
+		task->run(&mContext);
+		if (task->mDone) mPool->finished(task);
+	}
+}
+
+
+void *TaskWorkerAdapter(TaskWorker *worker)
+{
+	worker->serviceLoop();
+	return NULL;
+}
+
+
+
+
+TaskPool::TaskPool(TimerWheel& wTimers, size_t wStackSize)
+	:mTimers(wTimers),mWorkers(NULL),mNumWorkers(0),mRunning(false),
+	mStackSize(wStackSize),
+	mSpawned(0),mFinished(0)
+{ }
+
+
+void TaskPool::start(unsigned numThreads)
+{
+	assert(numThreads>0);
+	ThreadScope scope;
+	ScopedLock lock(mLock);
+	if (mRunning) return;
+	mNumWorkers = numThreads;
+	mWorkers = new TaskWorker[mNumWorkers];
+	for (unsigned i=0; i<mNumWorkers; i++) mWorkers[i].start(this);
+	mRunning = true;
+	while (mPending.size()) {
+		assign(mPending.front());
+		mPending.pop_front();
+	}
+}
+
+
+void TaskPool::spawn(void (*function)(void*), void *arg)
+{
+	Task *task = new Task(this,function,arg,mStackSize);
+	ThreadScope scope;
+	ScopedLock lock(mLock);
+	mSpawned++;
+	if (mRunning) assign(task);
+	else mPending.push_back(task);
+}
+
+
+void TaskPool::assign(Task *task)
+{
+	// Caller holds mLock.
+	unsigned best = 0;
+	for (unsigned i=1; i<mNumWorkers; i++) {
+		if (mWorkers[i].mTasks < mWorkers[best].mTasks) best = i;
+	}
+	mWorkers[best].mTasks++;
+	task->mWorker = best;
+	post(task);
+}
+
+
+void TaskPool::post(Task *task)
+{
+	assert(task->mWorker<mNumWorkers);
+	mWorkers[task->mWorker].post(task);
+}
+
+
+void TaskPool::finished(Task *task)
+{
+	{
+		ScopedLock lock(mLock);
+		mFinished++;
+		mWorkers[task->mWorker].mTasks--;
+	}
+	delete task;
+}
+
+
+unsigned TaskPool::size() const
+{
+	ScopedLock lock(mLock);
+	return mSpawned - mFinished;
+}
+
+
+void TaskPool::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "tasks " << (mSpawned-mFinished) << " spawned " << mSpawned << " finished " << mFinished;
+	if (!mRunning) {
+		os << " (not started)";
+		return;
+	}
+	os << " threads " << mNumWorkers << " (tasks/runs";
+	for (unsigned i=0; i<mNumWorkers; i++) {
+		ScopedLock wlock(mWorkers[i].mLock);
+		os << " " << mWorkers[i].mTasks << "/" << mWorkers[i].mRuns;
+	}
+	os << ")";
+}
+
+
+// vim: ts=4 sw=4
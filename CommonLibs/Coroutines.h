@@ -0,0 +1,224 @@
+/**@file Stackful coroutine tasks on a small thread pool. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef COROUTINES_H
+#define COROUTINES_H
+
+#include <ucontext.h>
+#include <deque>
+#include <list>
+#include <ostream>
+
+#include "Threads.h"
+#include "TimerWheel.h"
+
+
+class TaskPool;
+
+
+/**
+	A stackful coroutine, run by one thread of a TaskPool.
+
+	Blocking code runs unchanged in a task: a Signal wait (and so any
+	Interthread queue or map read), msleep() and a contended Mutex park
+	the task and let its thread run other tasks.  A task always resumes
+	on the same thread, so a Mutex it holds stays valid across a wait.
+	Anything else that blocks, like a socket read, blocks the whole thread.
+*/
+class Task : public TimerWheelClient {
+
+	private:
+
+	TaskPool *mPool;
+	unsigned mWorker;					///< index of the thread that runs this task
+	void (*mFunction)(void*);
+	void *mArg;
+
+	ucontext_t mContext;
+	ucontext_t *mReturn;				///< the worker context, while running
+	char *mStack;						///< the mapped stack, including a guard page
+	size_t mMapSize;
+	bool mDone;
+
+	/**@name Parking state, protected by the park lock. */
+	//@{
+	bool mParked;						///< waiting for a signal, a lock or a timer
+	TaskList *mParkedOn;				///< the waiting list of the signal or lock, if any
+	unsigned mParkCount;				///< tags the wake-up timer of each park
+	//@}
+	unsigned mTimerID;					///< wake-up timer, touched only by the task
+
+	public:
+
+	/** Create a task for a given function.  The pool assigns it a thread. */
+	Task(TaskPool *wPool, void (*wFunction)(void*), void *wArg, size_t stackSize);
+
+	~Task();
+
+	/** Park until the signal or a spurious wakeup, releasing the mutex meanwhile. */
+	void wait(const Signal& signal, Mutex& mutex);
+
+	/** Park until the signal or the timeout (ms), releasing the mutex meanwhile. */
+	void wait(const Signal& signal, Mutex& mutex, unsigned timeout);
+
+	/** Lock a mutex, parking while another task or thread holds it. */
+	void lock(Mutex& mutex);
+
+	/** Park for a time in ms; 0 means until the next timer tick. */
+	void sleep(unsigned ms);
+
+	/** Timer wheel callback. */
+	void timeout(unsigned tag);
+
+	private:
+
+	/**
+		Park until woken from a waiting list and/or by a timer.
+		@param waiting The waiting list to join, or NULL.
+		@param mutex A mutex to release while parked, or NULL.
+	*/
+	void park(TaskList *waiting, Mutex *mutex, bool timed, unsigned ms);
+
+	/** Post a parked task to its thread.  Caller holds the park lock. */
+	void wake();
+
+	/** Wake one or all of the tasks on a waiting list. */
+	static void wake(TaskList& waiting, bool all);
+
+	/** Run the task until it parks or finishes.  Called from its worker thread. */
+	void run(ucontext_t *worker);
+
+	/** Entry point for makecontext, with the task pointer split into 32-bit halves. */
+	static void start(unsigned hi, unsigned lo);
+
+	friend class TaskPool;
+	friend class TaskWorker;
+	friend class Signal;
+	friend class Mutex;
+};
+
+
+
+/** One thread of a TaskPool. */
+class TaskWorker {
+
+	private:
+
+	TaskPool *mPool;
+	Thread mThread;
+	Mutex mLock;
+	Signal mReadySignal;
+	std::deque<Task*> mReady;
+	ucontext_t mContext;				///< where a task returns to when it parks
+	unsigned long mRuns;				///< task resumptions, protected by mLock
+	unsigned mTasks;					///< tasks assigned to this thread, protected by the pool lock
+
+	public:
+
+	TaskWorker()
+		:mPool(NULL),mRuns(0),mTasks(0)
+	{ }
+
+	void start(TaskPool *wPool);
+
+	/** Queue a task to run. */
+	void post(Task *task);
+
+	void serviceLoop();
+
+	friend class TaskPool;
+	friend void *TaskWorkerAdapter(TaskWorker*);
+};
+
+void *TaskWorkerAdapter(TaskWorker*);
+
+
+
+/**
+	A small pool of threads running coroutine tasks.
+	Each task goes to the least loaded thread when it is spawned and stays there.
+	Tasks can be spawned before the pool is started; they run once it is.
+*/
+class TaskPool {
+
+	private:
+
+	mutable Mutex mLock;
+	TimerWheel &mTimers;				///< for task timeouts and sleeps
+	TaskWorker *mWorkers;
+	unsigned mNumWorkers;
+	bool mRunning;
+	std::deque<Task*> mPending;			///< spawned before start()
+	size_t mStackSize;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mSpawned;
+	unsigned long mFinished;
+	//@}
+
+	public:
+
+	/**
+		Create a pool.
+		@param wTimers A timer wheel, which must be started, for task timeouts.
+		@param wStackSize The stack size for each task.
+	*/
+	TaskPool(TimerWheel& wTimers, size_t wStackSize=65536*4);
+
+	/** Start a number of threads and run any pending tasks. */
+	void start(unsigned numThreads);
+
+	/** Start a task running a function. */
+	void spawn(void (*function)(void*), void *arg);
+
+	/** Number of live tasks. */
+	unsigned size() const;
+
+	TimerWheel& timers() { return mTimers; }
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+
+	private:
+
+	/** Queue a task to run on its thread. */
+	void post(Task *task);
+
+	/** Assign a new task to the least loaded thread and queue it.  Caller holds mLock. */
+	void assign(Task *task);
+
+	/** Clean up after a finished task. */
+	void finished(Task *task);
+
+	friend class Task;
+	friend class TaskWorker;
+};
+
+
+#endif
+// vim: ts=4 sw=4
@@ -0,0 +1,119 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "Coroutines.h"
+#include "Interthread.h"
+#include <iostream>
+
+using namespace std;
+
+
+// Like the OpenBTS threads, the pool is never stopped, so these live forever.
+TimerWheel *gWheel;
+TaskPool *gPool;
+
+InterthreadQueue<unsigned> gPing[8];
+InterthreadQueue<unsigned> gDone;
+
+Mutex gShared;
+unsigned gCounter = 0;
+
+
+/** Bounce a token down a chain of queues. */
+void relay(void *arg)
+{
+	unsigned i = (unsigned)(size_t)arg;
+	while (true) {
+		unsigned *token = gPing[i].read();
+		if (*token==0) {
+			gDone.write(token);
+			return;
+		}
+		(*token)--;
+		gPing[(i+1)%8].write(token);
+	}
+}
+
+
+/** Hold a shared lock across a sleep, so that other tasks on the thread must park for it. */
+void locker(void *arg)
+{
+	for (unsigned i=0; i<5; i++) {
+		ScopedLock lock(gShared);
+		unsigned before = gCounter;
+		msleep(2);
+		gCounter = before+1;
+	}
+	gDone.write(new unsigned(0));
+}
+
+
+/** Check a timed read and a sleep. */
+void timer(void *arg)
+{
+	InterthreadQueue<unsigned> empty;
+	Timeval start;
+	assert(empty.read(100)==NULL);
+	long waited = start.elapsed();
+	cout << "timed read waited " << waited << " ms" << endl;
+	assert(waited>=100);
+	start.now();
+	msleep(50);
+	waited = start.elapsed();
+	cout << "sleep waited " << waited << " ms" << endl;
+	assert(waited>=50);
+	gDone.write(new unsigned(0));
+}
+
+
+int main(int argc, char *argv[])
+{
+	gWheel = new TimerWheel(10);
+	gWheel->start();
+	gPool = new TaskPool(*gWheel);
+
+	// Spawn some tasks before starting, as OpenBTS does.
+	for (unsigned i=0; i<8; i++) gPool->spawn(relay,(void*)(size_t)i);
+	gPool->start(2);
+	for (unsigned i=0; i<4; i++) gPool->spawn(locker,NULL);
+	gPool->spawn(timer,NULL);
+
+	gPing[0].write(new unsigned(10000));
+	for (unsigned i=0; i<6; i++) delete gDone.read();
+	// The relay tasks see the 0 token one at a time, and the first one quits.
+	assert(gCounter==20);
+	for (unsigned i=1; i<8; i++) gPing[i].write(new unsigned(0));
+	for (unsigned i=1; i<8; i++) delete gDone.read();
+
+	// Let the workers delete the finished tasks.
+	msleep(20);
+	gPool->dump(cout);
+	cout << endl;
+	assert(gPool->size()==0);
+}
+
+// vim: ts=4 sw=4
@@ -0,0 +1,456 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "HTTPClient.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <sstream>
+
+using namespace std;
+
+
+
+/** Buffered reading from a socket, up to a deadline. */
+class HTTPReader {
+
+	private:
+
+	int mFD;
+	const Timeval& mDeadline;
+	char mBuffer[4096];
+	size_t mStart;
+	size_t mEnd;
+
+	public:
+
+	bool mTimedOut;
+	bool mClosed;				///< the server closed the connection
+	unsigned long mReceived;	///< bytes read from the socket
+
+	HTTPReader(int wFD, const Timeval& wDeadline)
+		:mFD(wFD),mDeadline(wDeadline),mStart(0),mEnd(0),
+		mTimedOut(false),mClosed(false),mReceived(0)
+	{ }
+
+	/** Refill the buffer, waiting up to the deadline. */
+	bool fill()
+	{
+		mStart = mEnd = 0;
+		while (true) {
+			long remaining = mDeadline.remaining();
+			if (remaining<=0) {
+				mTimedOut = true;
+				return false;
+			}
+			struct pollfd pfd;
+			pfd.fd = mFD;
+			pfd.events = POLLIN;
+			int ready = poll(&pfd,1,remaining);
+			if (ready<0 && errno==EINTR) continue;
+			if (ready<0) return false;
+			if (ready==0) continue;
+			ssize_t count = recv(mFD,mBuffer,sizeof(mBuffer),0);
+			if (count<0 && (errno==EINTR || errno==EAGAIN)) continue;
+			if (count<=0) {
+				mClosed = true;
+				return false;
+			}
+			mEnd = count;
+			mReceived += count;
+			return true;
+		}
+	}
+
+	/** Read a line, without its CRLF. */
+	bool line(string& dest)
+	{
+		dest.clear();
+		while (true) {
+			if (mStart==mEnd && !fill()) return false;
+			char *start = mBuffer+mStart;
+			char *nl = (char*)memchr(start,'\n',mEnd-mStart);
+			if (!nl) {
+				dest.append(start,mEnd-mStart);
+				mStart = mEnd;
+				continue;
+			}
+			dest.append(start,nl-start);
+			mStart = nl+1-mBuffer;
+			if (dest.size() && dest[dest.size()-1]=='\r') dest.resize(dest.size()-1);
+			return true;
+		}
+	}
+
+	/** Read a given number of bytes. */
+	bool bytes(string& dest, size_t count)
+	{
+		while (count) {
+			if (mStart==mEnd && !fill()) return false;
+			size_t take = mEnd-mStart;
+			if (take>count) take = count;
+			dest.append(mBuffer+mStart,take);
+			mStart += take;
+			count -= take;
+		}
+		return true;
+	}
+
+	/** Read until the server closes the connection. */
+	bool rest(string& dest)
+	{
+		dest.append(mBuffer+mStart,mEnd-mStart);
+		mStart = mEnd;
+		while (fill()) {
+			dest.append(mBuffer,mEnd);
+			mStart = mEnd;
+		}
+		return mClosed;
+	}
+
+	/** True if bytes past the response were received, which would confuse the next request. */
+	bool leftover() const { return mStart!=mEnd; }
+};
+
+
+
+
+HTTPClient::HTTPClient(unsigned wPoolSize, unsigned wIdleTimeout)
+	:mPoolSize(wPoolSize),mIdleTimeout(wIdleTimeout),
+	mRequests(0),mConnects(0),mReuses(0),mRetries(0),mTimeouts(0),mFailures(0)
+{ }
+
+
+HTTPClient::~HTTPClient()
+{
+	ScopedLock lock(mLock);
+	for (Pool::iterator p=mIdle.begin(); p!=mIdle.end(); ++p) close(p->second.mFD);
+}
+
+
+bool HTTPClient::parseURL(const string& URL, string& host, unsigned short& port, string& path)
+{
+	static const char scheme[] = "http://";
+	if (strncasecmp(URL.c_str(),scheme,sizeof(scheme)-1)!=0) return false;
+	size_t start = sizeof(scheme)-1;
+	size_t slash = URL.find_first_of("/?",start);
+	string server = URL.substr(start,slash==string::npos ? string::npos : slash-start);
+	if (slash==string::npos) path = "/";
+	else if (URL[slash]=='?') path = "/" + URL.substr(slash);
+	else path = URL.substr(slash);
+	// No user info.
+	if (server.find('@')!=string::npos) return false;
+	size_t colon = server.find(':');
+	port = 80;
+	if (colon!=string::npos) {
+		char *end;
+		unsigned long value = strtoul(server.c_str()+colon+1,&end,10);
+		if (*end || value==0 || value>65535) return false;
+		port = value;
+		server.resize(colon);
+	}
+	host = server;
+	return host.size()>0;
+}
+
+
+int HTTPClient::checkout(const string& server)
+{
+	ScopedLock lock(mLock);
+	// Drop connections idle too long; the server has probably closed them.
+	Pool::iterator p = mIdle.begin();
+	while (p!=mIdle.end()) {
+		Pool::iterator here = p++;
+		if (here->second.mLastUse.elapsed() < (long)mIdleTimeout) continue;
+		close(here->second.mFD);
+		mIdle.erase(here);
+	}
+	p = mIdle.find(server);
+	if (p==mIdle.end()) return -1;
+	int fd = p->second.mFD;
+	mIdle.erase(p);
+	return fd;
+}
+
+
+void HTTPClient::checkin(const string& server, int fd)
+{
+	ScopedLock lock(mLock);
+	if (mIdle.count(server)>=mPoolSize) {
+		close(fd);
+		return;
+	}
+	mIdle.insert(Pool::value_type(server,Connection(fd)));
+}
+
+
+int HTTPClient::connect(const string& host, unsigned short port, const Timeval& deadline)
+{
+	// getaddrinfo, unlike gethostbyname, is safe in concurrent requests.
+	struct addrinfo hints;
+	memset(&hints,0,sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *addresses;
+	ostringstream service;
+	service << port;
+	if (getaddrinfo(host.c_str(),service.str().c_str(),&hints,&addresses)!=0) return -1;
+	int fd = -1;
+	for (struct addrinfo *ap=addresses; ap; ap=ap->ai_next) {
+		fd = socket(ap->ai_family,ap->ai_socktype,ap->ai_protocol);
+		if (fd<0) continue;
+		// Connect without blocking past the deadline.
+		int flags = fcntl(fd,F_GETFL);
+		fcntl(fd,F_SETFL,flags|O_NONBLOCK);
+		int status = ::connect(fd,ap->ai_addr,ap->ai_addrlen);
+		if (status<0 && errno==EINPROGRESS) {
+			struct pollfd pfd;
+			pfd.fd = fd;
+			pfd.events = POLLOUT;
+			long remaining = deadline.remaining();
+			if (remaining>0 && poll(&pfd,1,remaining)==1) {
+				int error = 0;
+				socklen_t len = sizeof(error);
+				getsockopt(fd,SOL_SOCKET,SO_ERROR,&error,&len);
+				status = error ? -1 : 0;
+			}
+		}
+		if (status==0) {
+			// Requests are small and we wait for each answer.
+			int one = 1;
+			setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addresses);
+	return fd;
+}
+
+
+int HTTPClient::transact(int fd, const string& request, string& body, const Timeval& deadline,
+	bool& answered, bool& keepAlive, bool& timedOut)
+{
+	answered = false;
+	keepAlive = false;
+	timedOut = false;
+
+	// Send the request.
+	size_t sent = 0;
+	while (sent<request.size()) {
+		long remaining = deadline.remaining();
+		if (remaining<=0) {
+			timedOut = true;
+			return 0;
+		}
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+		if (poll(&pfd,1,remaining)<=0) continue;
+		ssize_t count = send(fd,request.data()+sent,request.size()-sent,MSG_NOSIGNAL);
+		if (count<0 && (errno==EINTR || errno==EAGAIN)) continue;
+		if (count<=0) return 0;
+		sent += count;
+	}
+
+	// Status line, skipping any 100 Continue.
+	HTTPReader reader(fd,deadline);
+	string line;
+	int status;
+	bool HTTP10;
+	while (true) {
+		if (!reader.line(line)) {
+			answered = reader.mReceived>0;
+			timedOut = reader.mTimedOut;
+			return 0;
+		}
+		answered = true;
+		if (strncmp(line.c_str(),"HTTP/1.",7)!=0 || line.size()<12) return 0;
+		HTTP10 = line[7]=='0';
+		status = atoi(line.c_str()+9);
+		if (status<100) return 0;
+		if (status!=100) break;
+		// Skip the headers of the interim response.
+		while (reader.line(line) && line.size()) {}
+	}
+
+	// Headers.
+	long length = -1;
+	bool chunked = false;
+	keepAlive = !HTTP10;
+	while (true) {
+		if (!reader.line(line)) {
+			timedOut = reader.mTimedOut;
+			return 0;
+		}
+		if (line.size()==0) break;
+		size_t colon = line.find(':');
+		if (colon==string::npos) continue;
+		string name = line.substr(0,colon);
+		size_t vstart = line.find_first_not_of(" \t",colon+1);
+		string value = vstart==string::npos ? "" : line.substr(vstart);
+		if (strcasecmp(name.c_str(),"Content-Length")==0) length = atol(value.c_str());
+		else if (strcasecmp(name.c_str(),"Transfer-Encoding")==0) chunked = strcasecmp(value.c_str(),"identity")!=0;
+		else if (strcasecmp(name.c_str(),"Connection")==0) {
+			if (strcasecmp(value.c_str(),"close")==0) keepAlive = false;
+			if (strcasecmp(value.c_str(),"keep-alive")==0) keepAlive = true;
+		}
+	}
+
+	// Body.
+	body.clear();
+	bool complete;
+	if (status==204 || status==304) complete = true;
+	else if (chunked) {
+		complete = false;
+		while (reader.line(line)) {
+			long size = strtol(line.c_str(),NULL,16);
+			if (size<0) break;
+			if (size==0) {
+				// Trailers, up to an empty line.
+				while (reader.line(line) && line.size()) {}
+				complete = line.size()==0 && !reader.mClosed && !reader.mTimedOut;
+				break;
+			}
+			if (!reader.bytes(body,size)) break;
+			if (!reader.line(line)) break;
+		}
+	}
+	else if (length>=0) complete = reader.bytes(body,length);
+	else {
+		complete = reader.rest(body);
+		keepAlive = false;
+	}
+	timedOut = reader.mTimedOut;
+	if (!complete) {
+		keepAlive = false;
+		return 0;
+	}
+	if (reader.leftover()) keepAlive = false;
+	return status;
+}
+
+
+int HTTPClient::get(const string& URL, string& body, unsigned timeout)
+{
+	Timeval deadline(timeout);
+	body.clear();
+	mLock.lock();
+	mRequests++;
+	mLock.unlock();
+
+	string host, path;
+	unsigned short port;
+	if (!parseURL(URL,host,port,path)) {
+		ScopedLock lock(mLock);
+		mFailures++;
+		return 0;
+	}
+	ostringstream server;
+	server << host << ":" << port;
+	ostringstream request;
+	request << "GET " << path << " HTTP/1.1\r\n"
+		<< "Host: " << host;
+	if (port!=80) request << ":" << port;
+	request << "\r\n"
+		<< "Connection: keep-alive\r\n"
+		<< "\r\n";
+
+	// A pooled connection may have been closed by the server, in which case
+	// we get no answer at all, and try once more with a new connection.
+	int fd = checkout(server.str());
+	bool pooled = fd>=0;
+	while (true) {
+		if (fd<0) {
+			fd = connect(host,port,deadline);
+			if (fd<0) {
+				if (deadline.passed()) {
+					ScopedLock lock(mLock);
+					mTimeouts++;
+				}
+				break;
+			}
+			ScopedLock lock(mLock);
+			mConnects++;
+		} else if (pooled) {
+			ScopedLock lock(mLock);
+			mReuses++;
+		}
+		bool answered, keepAlive, timedOut;
+		int status = transact(fd,request.str(),body,deadline,answered,keepAlive,timedOut);
+		if (status) {
+			if (keepAlive) checkin(server.str(),fd);
+			else close(fd);
+			return status;
+		}
+		close(fd);
+		fd = -1;
+		if (timedOut) {
+			ScopedLock lock(mLock);
+			mTimeouts++;
+			break;
+		}
+		if (!pooled || answered) break;
+		pooled = false;
+		ScopedLock lock(mLock);
+		mRetries++;
+	}
+	body.clear();
+	ScopedLock lock(mLock);
+	mFailures++;
+	return 0;
+}
+
+
+size_t HTTPClient::idle() const
+{
+	ScopedLock lock(mLock);
+	return mIdle.size();
+}
+
+
+void HTTPClient::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "requests " << mRequests << " connects " << mConnects << " reuses " << mReuses
+		<< " retries " << mRetries << " timeouts " << mTimeouts << " failures " << mFailures
+		<< " idle " << mIdle.size();
+}
+
+
+// vim: ts=4 sw=4
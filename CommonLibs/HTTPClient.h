@@ -0,0 +1,147 @@
+/**@file A small HTTP/1.1 client with persistent connections. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#ifndef HTTPCLIENT_H
+#define HTTPCLIENT_H
+
+#include <map>
+#include <string>
+#include <ostream>
+
+#include "Threads.h"
+#include "Timeval.h"
+
+
+/**
+	A minimal HTTP/1.1 client for GET requests to plain http:// URLs.
+
+	Connections are kept open after each request and put in a pool,
+	by server, for the next request to the same server.  Each request
+	takes a connection out of the pool for its duration, so any number of
+	threads can use the client at once; a server gets as many connections
+	as there are requests in progress, and keeps up to the pool size of
+	them open when idle.  A pooled connection that the server has closed
+	is detected on its next use and the request is retried once on a new
+	connection.
+
+	Responses may be delimited by Content-Length, by chunked transfer
+	coding, or by the server closing the connection.
+*/
+class HTTPClient {
+
+	private:
+
+	/** An idle connection. */
+	class Connection {
+		public:
+		int mFD;
+		Timeval mLastUse;
+		Connection(int wFD)
+			:mFD(wFD)
+		{ }
+	};
+
+	typedef std::multimap<std::string,Connection> Pool;
+
+	mutable Mutex mLock;
+	Pool mIdle;						///< idle connections, by "host:port"
+	unsigned mPoolSize;				///< most idle connections per server
+	unsigned mIdleTimeout;			///< ms an idle connection is kept
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mRequests;
+	unsigned long mConnects;		///< new connections
+	unsigned long mReuses;			///< requests sent on a pooled connection
+	unsigned long mRetries;			///< pooled connections found closed
+	unsigned long mTimeouts;
+	unsigned long mFailures;		///< requests with no valid response, including timeouts
+	//@}
+
+	public:
+
+	/**
+		Create a client.
+		@param wPoolSize The number of idle connections kept per server.
+		@param wIdleTimeout How long an idle connection is kept, in ms.
+	*/
+	HTTPClient(unsigned wPoolSize=8, unsigned wIdleTimeout=30000);
+
+	/** Close the idle connections. */
+	~HTTPClient();
+
+	/**
+		Split an http:// URL.
+		@param URL The URL.
+		@param host The host name.
+		@param port The port, 80 if not given.
+		@param path The path and query, "/" if not given.
+		@return false if the URL is not a valid http:// URL.
+	*/
+	static bool parseURL(const std::string& URL, std::string& host, unsigned short& port, std::string& path);
+
+	/**
+		GET a URL.
+		@param URL The http:// URL.
+		@param body The response body.
+		@param timeout The limit for the whole request, in ms.
+		@return The HTTP status code, or 0 if there was no valid response.
+	*/
+	int get(const std::string& URL, std::string& body, unsigned timeout=10000);
+
+	/** Number of idle connections. */
+	size_t idle() const;
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+
+	private:
+
+	/** Take an idle connection to a server out of the pool, or return -1. */
+	int checkout(const std::string& server);
+
+	/** Put a connection back in the pool, or close it if the pool is full. */
+	void checkin(const std::string& server, int fd);
+
+	/** Open a new connection, or return -1. */
+	int connect(const std::string& host, unsigned short port, const Timeval& deadline);
+
+	/**
+		Send a request and read the response on one connection.
+		@param answered Set true once any of the response arrived.
+		@param keepAlive Set true if the connection can be used again.
+		@param timedOut Set true if the deadline passed.
+		@return The status code, or 0 on failure.
+	*/
+	int transact(int fd, const std::string& request, std::string& body, const Timeval& deadline,
+		bool& answered, bool& keepAlive, bool& timedOut);
+};
+
+
+#endif
+// vim: ts=4 sw=4
@@ -0,0 +1,260 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "HTTPClient.h"
+#include "Threads.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+
+/**
+	A loopback HTTP server standing in for a real one.
+	It keeps connections open and answers by path:
+		/len/...		the path, with Content-Length
+		/chunked/...	the path, in three chunks
+		/close/...		the path, ended by closing the connection
+		/slow/...		the path, after half a second
+		/bye/...		the path, then close the connection although it said keep-alive
+*/
+class LoopbackServer {
+
+	private:
+
+	int mListenFD;
+	unsigned short mPort;
+	Thread mThread;
+	Mutex mLock;
+	unsigned mConnections;
+
+	public:
+
+	LoopbackServer()
+		:mConnections(0)
+	{
+		mListenFD = socket(AF_INET,SOCK_STREAM,0);
+		assert(mListenFD>=0);
+		struct sockaddr_in address;
+		memset(&address,0,sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = 0;
+		assert(bind(mListenFD,(struct sockaddr*)&address,sizeof(address))==0);
+		socklen_t len = sizeof(address);
+		getsockname(mListenFD,(struct sockaddr*)&address,&len);
+		mPort = ntohs(address.sin_port);
+		assert(listen(mListenFD,64)==0);
+		mThread.start((void*(*)(void*))acceptLoop,this);
+	}
+
+	unsigned short port() const { return mPort; }
+
+	unsigned connections()
+	{
+		ScopedLock lock(mLock);
+		return mConnections;
+	}
+
+	private:
+
+	struct Session {
+		LoopbackServer *server;
+		int fd;
+	};
+
+	static void* acceptLoop(LoopbackServer *server)
+	{
+		while (true) {
+			int fd = accept(server->mListenFD,NULL,NULL);
+			if (fd<0) continue;
+			server->mLock.lock();
+			server->mConnections++;
+			server->mLock.unlock();
+			Session *session = new Session;
+			session->server = server;
+			session->fd = fd;
+			Thread thread;
+			thread.start((void*(*)(void*))serve,session);
+		}
+		return NULL;
+	}
+
+	static void send(int fd, const string& data)
+	{
+		::send(fd,data.data(),data.size(),MSG_NOSIGNAL);
+	}
+
+	static void* serve(Session *session)
+	{
+		int fd = session->fd;
+		delete session;
+		string pending;
+		while (true) {
+			size_t end = pending.find("\r\n\r\n");
+			if (end==string::npos) {
+				char buf[1024];
+				ssize_t count = recv(fd,buf,sizeof(buf),0);
+				if (count<=0) break;
+				pending.append(buf,count);
+				continue;
+			}
+			string request = pending.substr(0,end);
+			pending.erase(0,end+4);
+			size_t space = request.find(' ',4);
+			string path = request.substr(4,space-4);
+			ostringstream response;
+			if (path.compare(0,9,"/chunked/")==0) {
+				size_t third = path.size()/3;
+				response << "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n" << hex
+					<< third << "\r\n" << path.substr(0,third) << "\r\n"
+					<< third << "\r\n" << path.substr(third,third) << "\r\n"
+					<< path.size()-2*third << ";ext=1\r\n" << path.substr(2*third) << "\r\n"
+					<< "0\r\n\r\n";
+				send(fd,response.str());
+				continue;
+			}
+			if (path.compare(0,7,"/close/")==0) {
+				response << "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\n" << path;
+				send(fd,response.str());
+				break;
+			}
+			if (path.compare(0,6,"/slow/")==0) msleep(500);
+			response << "HTTP/1.1 200 OK\r\nContent-Length: " << path.size() << "\r\n\r\n" << path;
+			send(fd,response.str());
+			if (path.compare(0,5,"/bye/")==0) break;
+		}
+		close(fd);
+		return NULL;
+	}
+};
+
+
+static LoopbackServer *gServer;
+static HTTPClient *gClient;
+static const unsigned numThreads = 8;
+static const unsigned numRequests = 200;
+
+
+/** Check a GET and its body. */
+static void check(const string& path, unsigned timeout=2000)
+{
+	ostringstream URL;
+	URL << "http://127.0.0.1:" << gServer->port() << path;
+	string body;
+	int status = gClient->get(URL.str(),body,timeout);
+	if (status!=200 || body!=path) cout << "GET " << path << ": " << status << " " << body << endl;
+	assert(status==200);
+	assert(body==path);
+}
+
+
+static void* concurrentRequests(void *arg)
+{
+	for (unsigned i=0; i<numRequests; i++) {
+		ostringstream path;
+		path << (i%2 ? "/len/" : "/chunked/") << (size_t)arg << "/" << i;
+		check(path.str());
+	}
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	string host, path;
+	unsigned short port;
+	assert(HTTPClient::parseURL("http://example.com",host,port,path));
+	assert(host=="example.com" && port==80 && path=="/");
+	assert(HTTPClient::parseURL("http://localhost:8080/cgi/rrlp.cgi?query=loc",host,port,path));
+	assert(host=="localhost" && port==8080 && path=="/cgi/rrlp.cgi?query=loc");
+	assert(HTTPClient::parseURL("HTTP://h?x=1",host,port,path));
+	assert(host=="h" && path=="/?x=1");
+	assert(!HTTPClient::parseURL("https://example.com/",host,port,path));
+	assert(!HTTPClient::parseURL("http://h:99999/",host,port,path));
+
+	gServer = new LoopbackServer;
+	gClient = new HTTPClient(numThreads);
+
+	// Sequential requests share one connection.
+	for (unsigned i=0; i<100; i++) {
+		ostringstream path;
+		path << "/len/" << i;
+		check(path.str());
+	}
+	check("/chunked/abcdefghij");
+	assert(gServer->connections()==1);
+
+	// A connection closed by the server is not reused.
+	check("/close/1");
+	check("/len/2");
+	assert(gServer->connections()==2);
+
+	// A pooled connection closed behind our back is retried.
+	check("/bye/1");
+	check("/len/3");
+	assert(gServer->connections()==3);
+
+	// A timeout fails the request and drops the connection.
+	ostringstream slowURL;
+	slowURL << "http://127.0.0.1:" << gServer->port() << "/slow/1";
+	string body;
+	Timeval start;
+	assert(gClient->get(slowURL.str(),body,100)==0);
+	assert(start.elapsed()<400);
+	check("/slow/2");
+	assert(gServer->connections()==4);
+
+	// No server.
+	assert(gClient->get("http://127.0.0.1:1/",body,1000)==0);
+
+	// Concurrent requests, each taking a connection from the pool.
+	Timeval concurrentStart;
+	Thread threads[numThreads];
+	for (unsigned i=0; i<numThreads; i++) threads[i].start(concurrentRequests,(void*)(size_t)i);
+	for (unsigned i=0; i<numThreads; i++) threads[i].join();
+	long elapsed = concurrentStart.elapsed();
+	cout << numThreads*numRequests << " concurrent requests in " << elapsed << " ms on "
+		<< gServer->connections()-4 << " more connections" << endl;
+	assert(gServer->connections()<=4+numThreads);
+	assert(gClient->idle()<=numThreads);
+
+	gClient->dump(cout);
+	cout << endl;
+	cout << "OK" << endl;
+	return 0;
+}
+
+// vim: ts=4 sw=4
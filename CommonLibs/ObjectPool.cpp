@@ -0,0 +1,199 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "ObjectPool.h"
+
+#include <assert.h>
+#include <list>
+
+using namespace std;
+
+
+/** Every pool, for dumpAll(). */
+static list<ObjectPool*> *gPools = NULL;
+static Mutex gPoolsLock;
+
+
+
+ObjectPool::ObjectPool(const char* wName, size_t wBlockSize, unsigned wCacheSize)
+	:mName(wName),mBlockSize(wBlockSize),mCacheSize(wCacheSize),
+	mShared(NULL),mSharedCount(0),
+	mBlocks(0),mRefills(0),mSpills(0),mOversize(0),mThreads(0)
+{
+	assert(mCacheSize>=2);
+	int status = pthread_key_create(&mKey,ObjectPoolThreadExit);
+	assert(status==0);
+	ScopedLock lock(gPoolsLock);
+	if (!gPools) gPools = new list<ObjectPool*>;
+	gPools->push_back(this);
+}
+
+
+ObjectPool::Cache* ObjectPool::cache()
+{
+	Cache* cache = (Cache*)pthread_getspecific(mKey);
+	if (cache) return cache;
+	cache = new Cache;
+	cache->mPool = this;
+	cache->mHead = NULL;
+	cache->mCount = 0;
+	pthread_setspecific(mKey,cache);
+	ScopedLock lock(mLock);
+	mThreads++;
+	return cache;
+}
+
+
+void* ObjectPool::allocate(size_t size)
+{
+	if (size!=mBlockSize) {
+		ScopedLock lock(mLock);
+		mOversize++;
+		return ::operator new(size);
+	}
+	Cache* cache = this->cache();
+	if (!cache->mHead) refill(cache);
+	Block* block = cache->mHead;
+	cache->mHead = block->mNext;
+	cache->mCount--;
+	return block;
+}
+
+
+void ObjectPool::release(void* ptr, size_t size)
+{
+	if (!ptr) return;
+	if (size!=mBlockSize) {
+		::operator delete(ptr);
+		return;
+	}
+	Cache* cache = this->cache();
+	Block* block = (Block*)ptr;
+	block->mNext = cache->mHead;
+	cache->mHead = block;
+	cache->mCount++;
+	if (cache->mCount>mCacheSize) spill(cache);
+}
+
+
+void ObjectPool::refill(Cache* cache)
+{
+	// The lock may switch to another task on this thread,
+	// which can use the cache, so build the batch first and add it after.
+	unsigned batch = mCacheSize/2;
+	Block* head = NULL;
+	Block* tail = NULL;
+	unsigned count = 0;
+	mLock.lock();
+	mRefills++;
+	while (mShared && count<batch) {
+		Block* block = mShared;
+		mShared = block->mNext;
+		mSharedCount--;
+		block->mNext = head;
+		head = block;
+		if (!tail) tail = block;
+		count++;
+	}
+	if (count==0) {
+		// Carve a new batch from one heap chunk, keeping the blocks aligned like malloc.
+		size_t stride = (mBlockSize + sizeof(double) - 1) & ~(sizeof(double) - 1);
+		if (stride<sizeof(Block)) stride = sizeof(Block);
+		char* chunk = (char*)::operator new(stride*batch);
+		for (unsigned i=0; i<batch; i++) {
+			Block* block = (Block*)(chunk + i*stride);
+			block->mNext = head;
+			head = block;
+			if (!tail) tail = block;
+		}
+		count = batch;
+		mBlocks += batch;
+	}
+	mLock.unlock();
+	tail->mNext = cache->mHead;
+	cache->mHead = head;
+	cache->mCount += count;
+}
+
+
+void ObjectPool::spill(Cache* cache)
+{
+	// Detach the batch before taking the lock; see refill().
+	unsigned count = mCacheSize/2;
+	Block* head = cache->mHead;
+	Block* tail = head;
+	for (unsigned i=1; i<count; i++) tail = tail->mNext;
+	cache->mHead = tail->mNext;
+	cache->mCount -= count;
+	ScopedLock lock(mLock);
+	mSpills++;
+	giveBack(head,tail,count);
+}
+
+
+void ObjectPool::giveBack(Block* head, Block* tail, unsigned count)
+{
+	// Caller holds mLock.
+	tail->mNext = mShared;
+	mShared = head;
+	mSharedCount += count;
+}
+
+
+void ObjectPoolThreadExit(void* arg)
+{
+	ObjectPool::Cache* cache = (ObjectPool::Cache*)arg;
+	ObjectPool* pool = cache->mPool;
+	ObjectPool::Block* tail = cache->mHead;
+	while (tail && tail->mNext) tail = tail->mNext;
+	ScopedLock lock(pool->mLock);
+	if (tail) pool->giveBack(cache->mHead,tail,cache->mCount);
+	pool->mThreads--;
+	delete cache;
+}
+
+
+void ObjectPool::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << mName << ": size " << mBlockSize << " blocks " << mBlocks
+		<< " shared " << mSharedCount << " threads " << mThreads
+		<< " refills " << mRefills << " spills " << mSpills << " oversize " << mOversize;
+}
+
+
+void ObjectPool::dumpAll(ostream& os)
+{
+	ScopedLock lock(gPoolsLock);
+	if (!gPools) return;
+	for (list<ObjectPool*>::const_iterator p=gPools->begin(); p!=gPools->end(); ++p) {
+		(*p)->dump(os);
+		os << endl;
+	}
+}
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,139 @@
+/**@file Typed, thread-caching pools for small objects that cross thread boundaries at high rates. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <ostream>
+
+#include "Threads.h"
+
+
+/**
+	A pool of fixed-size blocks for the objects of one class.
+
+	A class uses a pool through its own operator new and operator delete,
+	so that existing new/delete calls are pooled without change.
+	Each thread keeps a small cache of free blocks, so most allocations
+	and releases take no lock at all.  Objects made in one thread and
+	deleted in another, as with the frames in an InterthreadQueue,
+	pass through a shared free list in batches, one lock per batch.
+	A thread's cache goes back to the shared list when the thread exits.
+
+	Blocks are never given back to the heap, so the pool grows to the
+	high-water mark of objects in use plus the thread caches.
+	Requests of another size, as from a larger derived class,
+	go straight to the heap.
+
+	Pools are typically made on first use and never deleted,
+	since objects may still be released during static destruction.
+*/
+class ObjectPool {
+
+	private:
+
+	/** A free block. */
+	struct Block {
+		Block* mNext;
+	};
+
+	/** The free blocks held by one thread. */
+	struct Cache {
+		ObjectPool* mPool;
+		Block* mHead;
+		unsigned mCount;
+	};
+
+	const char* mName;
+	size_t mBlockSize;
+	unsigned mCacheSize;			///< most free blocks kept by a thread
+	pthread_key_t mKey;				///< the Cache of each thread
+
+	mutable Mutex mLock;
+	Block* mShared;					///< free blocks given up by the threads
+	unsigned mSharedCount;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mBlocks;			///< blocks taken from the heap
+	unsigned long mRefills;			///< batches moved to a thread cache
+	unsigned long mSpills;			///< batches moved to the shared list
+	unsigned long mOversize;		///< requests of another size
+	unsigned mThreads;				///< threads with a cache
+	//@}
+
+	public:
+
+	/**
+		Create a pool.
+		@param wName A name for statistics.
+		@param wBlockSize The object size.
+		@param wCacheSize The most free blocks a thread may hold.
+	*/
+	ObjectPool(const char* wName, size_t wBlockSize, unsigned wCacheSize=64);
+
+	/** Get a block of the given size, normally from the thread cache. */
+	void* allocate(size_t size);
+
+	/** Release a block from allocate(), with the same size. */
+	void release(void* block, size_t size);
+
+	size_t blockSize() const { return mBlockSize; }
+
+	const char* name() const { return mName; }
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+
+	/** Dump the statistics of every pool, one line each. */
+	static void dumpAll(std::ostream&);
+
+	private:
+
+	/** The cache of the calling thread, created as needed. */
+	Cache* cache();
+
+	/** Move a batch of blocks from the shared list or the heap into a cache. */
+	void refill(Cache*);
+
+	/** Move half of a full cache to the shared list. */
+	void spill(Cache*);
+
+	/** Give a whole chain of blocks to the shared list. */
+	void giveBack(Block* head, Block* tail, unsigned count);
+
+	friend void ObjectPoolThreadExit(void*);
+};
+
+/** The destructor of the per-thread caches. */
+void ObjectPoolThreadExit(void*);
+
+
+#endif
+// vim: ts=4 sw=4
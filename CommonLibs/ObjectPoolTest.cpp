@@ -0,0 +1,132 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+
+#include "ObjectPool.h"
+#include "Interthread.h"
+#include <iostream>
+#include <assert.h>
+#include <string.h>
+
+using namespace std;
+
+
+/** A pooled object, like the GSM frames. */
+class Frame {
+
+	public:
+
+	unsigned mSerial;
+	char mBits[184];
+
+	Frame(unsigned wSerial)
+		:mSerial(wSerial)
+	{ memset(mBits,wSerial&0x0ff,sizeof(mBits)); }
+
+	bool valid() const
+	{
+		for (unsigned i=0; i<sizeof(mBits); i++) if (mBits[i]!=(char)(mSerial&0x0ff)) return false;
+		return true;
+	}
+
+	static ObjectPool& pool()
+	{
+		static ObjectPool* sPool = new ObjectPool("Frame",sizeof(Frame),16);
+		return *sPool;
+	}
+
+	static void* operator new(size_t size) { return pool().allocate(size); }
+	static void operator delete(void* block, size_t size) { pool().release(block,size); }
+};
+
+
+/** A derived class of another size, which goes to the heap. */
+class BigFrame : public Frame {
+
+	public:
+
+	char mMore[100];
+
+	BigFrame(unsigned wSerial)
+		:Frame(wSerial)
+	{ }
+};
+
+
+static const unsigned numFrames = 100000;
+static const unsigned numThreads = 4;
+
+InterthreadQueue<Frame> gQ;
+
+
+void *producer(void*)
+{
+	for (unsigned i=0; i<numFrames; i++) gQ.write(new Frame(i));
+	return NULL;
+}
+
+
+void *consumer(void*)
+{
+	for (unsigned i=0; i<numFrames; i++) {
+		Frame *frame = gQ.read();
+		assert(frame->valid());
+		delete frame;
+	}
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	// Reuse within one thread stays in the thread cache.
+	Frame *first = new Frame(1);
+	delete first;
+	Frame *second = new Frame(2);
+	assert(first==second);
+	delete second;
+
+	BigFrame *big = new BigFrame(3);
+	assert(big->valid());
+	delete big;
+
+	// Frames made in one thread and deleted in another go through the shared list.
+	Thread producers[numThreads];
+	Thread consumers[numThreads];
+	for (unsigned i=0; i<numThreads; i++) {
+		producers[i].start(producer,NULL);
+		consumers[i].start(consumer,NULL);
+	}
+	for (unsigned i=0; i<numThreads; i++) {
+		producers[i].join();
+		consumers[i].join();
+	}
+	assert(gQ.size()==0);
+	ObjectPool::dumpAll(cout);
+}
+
+// vim: ts=4 sw=4
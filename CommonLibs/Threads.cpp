@@ -29,6 +29,7 @@
 
 #include "Threads.h"
 #include "Timeval.h"
+#include "Coroutines.h"
 
 
 using namespace std;
@@ -73,6 +74,7 @@ void unlockCerr()
 
 
 Mutex::Mutex()
+	:mOwnerTask(NULL),mTaskDepth(0)
 {
 	bool res;
 	res = pthread_mutexattr_init(&mAttribs);
@@ -94,9 +96,57 @@ Mutex::~Mutex()
 
 
 
+bool Mutex::trylock()
+{
+	if (pthread_mutex_trylock(&mMutex)!=0) return false;
+	if (!gCurrentTask) return true;
+	// On this thread, the recursive mutex may really belong to another task.
+	if (mOwnerTask && mOwnerTask!=gCurrentTask) {
+		pthread_mutex_unlock(&mMutex);
+		return false;
+	}
+	mOwnerTask = gCurrentTask;
+	mTaskDepth++;
+	return true;
+}
+
+
+void Mutex::taskLock()
+{
+	// Don't block the thread, since other tasks on it may hold the lock.
+	gCurrentTask->lock(*this);
+}
+
+
+void Mutex::taskUnlock()
+{
+	assert(mOwnerTask==gCurrentTask);
+	if (--mTaskDepth==0) mOwnerTask=NULL;
+	pthread_mutex_unlock(&mMutex);
+}
+
+
+
+void Signal::wait(Mutex& wMutex) const
+{
+	if (gCurrentTask) {
+		gCurrentTask->wait(*this,wMutex);
+		return;
+	}
+	// The wait releases the mutex without unlock().
+	if (!wMutex.mWaiters.empty()) wMutex.wakeTasks();
+	pthread_cond_wait(&mSignal,&wMutex.mMutex);
+}
+
+
 /** Block for the signal up to the cancellation timeout. */
 void Signal::wait(Mutex& wMutex, unsigned timeout) const
 {
+	if (gCurrentTask) {
+		gCurrentTask->wait(*this,wMutex,timeout);
+		return;
+	}
+	if (!wMutex.mWaiters.empty()) wMutex.wakeTasks();
 	Timeval then(timeout);
 	struct timespec waitTime = then.timespec();
 	pthread_cond_timedwait(&mSignal,&wMutex.mMutex,&waitTime);
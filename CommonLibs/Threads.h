@@ -28,6 +28,7 @@
 
 #include <pthread.h>
 #include <iostream>
+#include <list>
 #include <assert.h>
 
 class Mutex;
@@ -64,7 +65,62 @@ void unlockCout();		///< call after writing cout
 /**@defgroup C++ wrappers for pthread mechanisms. */
 //@{
 
-/** A class for recursive mutexes based on pthread_mutex. */
+
+class Task;
+
+/** The coroutine task running on this thread, if any; see Coroutines.h. */
+extern __thread Task* gCurrentTask;
+
+inline Task* currentTask() { return gCurrentTask; }
+
+
+/**
+	The tasks parked on a Mutex or a Signal.
+	The list is changed only under the task park lock, but the count is
+	read with a full barrier and no lock, so that an unlock or a signal
+	with nobody parked stays cheap and still sees a task that just joined.
+*/
+class TaskList {
+
+	private:
+
+	std::list<Task*> mTasks;
+	mutable unsigned mCount;	///< length of mTasks, changed and read atomically
+
+	public:
+
+	TaskList() :mCount(0) { }
+
+	bool empty() const { return __sync_fetch_and_add(&mCount,0)==0; }
+
+	/**@name Changes, for the holder of the task park lock. */
+	//@{
+	Task* front() const { return mTasks.front(); }
+
+	void push_back(Task* task)
+	{
+		mTasks.push_back(task);
+		__sync_fetch_and_add(&mCount,1);
+	}
+
+	void remove(Task* task)
+	{
+		for (std::list<Task*>::iterator p=mTasks.begin(); p!=mTasks.end(); ++p) {
+			if (*p!=task) continue;
+			mTasks.erase(p);
+			__sync_fetch_and_sub(&mCount,1);
+			return;
+		}
+	}
+	//@}
+};
+
+
+/**
+	A class for recursive mutexes based on pthread_mutex.
+	Coroutine tasks that share a thread are kept apart by ownership
+	tracking, and a task waiting for the lock gives up its thread.
+*/
 class Mutex {
 
 	private:
@@ -72,21 +128,51 @@ class Mutex {
 	pthread_mutex_t mMutex;
 	pthread_mutexattr_t mAttribs;
 
+	Task *mOwnerTask;			///< task holding the lock, if a task holds it
+	unsigned mTaskDepth;		///< recursion depth of mOwnerTask
+	TaskList mWaiters;			///< tasks waiting for the lock
+
 	public:
 
 	Mutex();
 
 	~Mutex();
 
-	void lock() { pthread_mutex_lock(&mMutex); }
+	void lock()
+	{
+		if (gCurrentTask) taskLock();
+		else pthread_mutex_lock(&mMutex);
+	}
 
-	void unlock() { pthread_mutex_unlock(&mMutex); }
+	void unlock()
+	{
+		// Only the holder can see a nonzero mTaskDepth here.
+		if (mTaskDepth) taskUnlock();
+		else pthread_mutex_unlock(&mMutex);
+		if (!mWaiters.empty()) wakeTasks();
+	}
+
+	/** Lock if the mutex is free, without blocking.  Return true on success. */
+	bool trylock();
 
 	friend class Signal;
+	friend class Task;
+
+	private:
+
+	/** Lock from a coroutine task. */
+	void taskLock();
+
+	/** Unlock from a coroutine task. */
+	void taskUnlock();
+
+	/** Wake a task waiting for the lock. */
+	void wakeTasks();
 
 };
 
 
+
 class ScopedLock {
 
 	private:
@@ -101,12 +187,16 @@ class ScopedLock {
 
 
 
-/** A C++ interthread signal based on pthread condition variables. */
+/**
+	A C++ interthread signal based on pthread condition variables.
+	A coroutine task waiting on a signal is parked instead of blocking its thread.
+*/
 class Signal {
 
 	private:
 
 	mutable pthread_cond_t mSignal;
+	mutable TaskList mParked;	///< tasks waiting
 
 	public:
 
@@ -124,12 +214,26 @@ class Signal {
 		Block for the signal.
 		Under Linux, spurious returns are possible.
 	*/
-	void wait(Mutex& wMutex) const
-		{ pthread_cond_wait(&mSignal,&wMutex.mMutex); }
+	void wait(Mutex& wMutex) const;
+
+	void signal()
+	{
+		pthread_cond_signal(&mSignal);
+		if (!mParked.empty()) wakeTasks(false);
+	}
 
-	void signal() { pthread_cond_signal(&mSignal); }
+	void broadcast()
+	{
+		pthread_cond_broadcast(&mSignal);
+		if (!mParked.empty()) wakeTasks(true);
+	}
+
+	friend class Task;
+
+	private:
 
-	void broadcast() { pthread_cond_broadcast(&mSignal); }
+	/** Wake one or all of the parked tasks. */
+	void wakeTasks(bool all) const;
 
 };
 
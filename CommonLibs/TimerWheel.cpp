@@ -0,0 +1,228 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "TimerWheel.h"
+
+#include <assert.h>
+
+using namespace std;
+
+
+
+TimerWheel::TimerWheel(unsigned wTickMs)
+	:mTickMs(wTickMs),mNext(0),mNextID(1),
+	mFiringClient(NULL),mRunning(false),
+	mScheduled(0),mCancelled(0),mFired(0),mCascaded(0)
+{
+	assert(mTickMs>0);
+}
+
+
+uint64_t TimerWheel::currentTick() const
+{
+	long elapsed = mStart.elapsed();
+	if (elapsed<0) return 0;
+	return elapsed / mTickMs;
+}
+
+
+void TimerWheel::insert(const Entry& entry)
+{
+	// Caller holds mLock.
+	assert(entry.mDue>=mNext);
+	uint64_t delta = entry.mDue - mNext;
+	unsigned level = 0;
+	while (level<numLevels-1 && delta>=(1ULL<<(slotBits*(level+1)))) level++;
+	unsigned slot = (entry.mDue >> (slotBits*level)) & (numSlots-1);
+	Slot& dest = mSlots[level][slot];
+	dest.push_back(entry);
+	mIndex[entry.mID] = pair<Slot*,Slot::iterator>(&dest,--dest.end());
+}
+
+
+void TimerWheel::cascade(unsigned level, unsigned slot)
+{
+	// Caller holds mLock.
+	Slot entries;
+	entries.swap(mSlots[level][slot]);
+	for (Slot::const_iterator p=entries.begin(); p!=entries.end(); ++p) {
+		insert(*p);
+		mCascaded++;
+	}
+}
+
+
+unsigned TimerWheel::schedule(unsigned ms, TimerWheelClient *client, unsigned tag)
+{
+	assert(client);
+	// Round up, plus one tick, since we may already be part way through the current tick.
+	uint64_t ticks = (ms + mTickMs - 1) / mTickMs + 1;
+	if (ticks>maxTicks) ticks = maxTicks;
+	ScopedLock lock(mLock);
+	uint64_t due = currentTick() + ticks;
+	if (due<mNext) due = mNext;
+	// Clamp again, in case expire() is far behind.
+	if (due-mNext>maxTicks) due = mNext+maxTicks;
+	unsigned id = mNextID++;
+	if (mNextID==0) mNextID=1;
+	insert(Entry(id,due,client,tag));
+	mScheduled++;
+	// The service thread may be sleeping past the new timer.
+	if (mRunning) mWakeSignal.signal();
+	return id;
+}
+
+
+bool TimerWheel::cancel(unsigned id)
+{
+	ScopedLock lock(mLock);
+	Index::iterator p = mIndex.find(id);
+	if (p==mIndex.end()) return false;
+	p->second.first->erase(p->second.second);
+	mIndex.erase(p);
+	mCancelled++;
+	return true;
+}
+
+
+bool TimerWheel::pending(unsigned id) const
+{
+	ScopedLock lock(mLock);
+	return mIndex.find(id)!=mIndex.end();
+}
+
+
+void TimerWheel::wait(const TimerWheelClient *client)
+{
+	ScopedLock lock(mLock);
+	while (mFiringClient==client && !pthread_equal(mFiringThread,pthread_self())) mFiredSignal.wait(mLock);
+}
+
+
+unsigned TimerWheel::expire()
+{
+	ScopedLock lock(mLock);
+	uint64_t now = currentTick();
+	while (mNext<=now) {
+		// When a level wraps, pull down the next slot of the level above.
+		unsigned slot0 = mNext & (numSlots-1);
+		for (unsigned level=1; level<numLevels; level++) {
+			if (((mNext >> (slotBits*(level-1))) & (numSlots-1)) != 0) break;
+			cascade(level, (mNext >> (slotBits*level)) & (numSlots-1));
+		}
+		// Move the due timers to mDue, where they can still be cancelled.
+		Slot& slot = mSlots[0][slot0];
+		for (Slot::iterator p=slot.begin(); p!=slot.end(); ++p) {
+			assert(p->mDue==mNext);
+			mIndex[p->mID].first = &mDue;
+		}
+		mDue.splice(mDue.end(),slot);
+		mNext++;
+	}
+
+	// Call back outside of the lock so that clients can reschedule.
+	// Take them one at a time, since a callback may cancel a later one.
+	unsigned count = 0;
+	while (mDue.size()) {
+		Entry entry = mDue.front();
+		mDue.pop_front();
+		mIndex.erase(entry.mID);
+		mFired++;
+		count++;
+		mFiringClient = entry.mClient;
+		mFiringThread = pthread_self();
+		mLock.unlock();
+		entry.mClient->timeout(entry.mTag);
+		mLock.lock();
+		mFiringClient = NULL;
+		mFiredSignal.broadcast();
+	}
+	return count;
+}
+
+
+unsigned TimerWheel::idleMs() const
+{
+	ScopedLock lock(mLock);
+	uint64_t now = currentTick();
+	if (mNext<=now) return 0;
+	// Look for a due timer in level 0, up to the next cascade.
+	uint64_t tick = mNext;
+	while ((tick & (numSlots-1))!=0 && mSlots[0][tick & (numSlots-1)].size()==0) tick++;
+	// The tick starts at tick*mTickMs after mStart.
+	long wait = (long)(tick*mTickMs) - mStart.elapsed();
+	if (wait<=0) return 0;
+	return wait;
+}
+
+
+size_t TimerWheel::size() const
+{
+	ScopedLock lock(mLock);
+	return mIndex.size();
+}
+
+
+void TimerWheel::start()
+{
+	ScopedLock lock(mLock);
+	if (mRunning) return;
+	mRunning = true;
+	mThread.start((void*(*)(void*))TimerWheelServiceLoopAdapter,this);
+}
+
+
+void TimerWheel::serviceLoop()
+{
+	while (true) {
+		{
+			ScopedLock lock(mLock);
+			if (mIndex.size()==0) mWakeSignal.wait(mLock);
+			else {
+				unsigned idle = idleMs();
+				if (idle>0) mWakeSignal.wait(mLock,idle);
+			}
+		}
+		expire();
+	}
+}
+
+
+void *TimerWheelServiceLoopAdapter(TimerWheel *wheel)
+{
+	wheel->serviceLoop();
+	return NULL;
+}
+
+
+void TimerWheel::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "timers " << mIndex.size() << " scheduled " << mScheduled << " cancelled " << mCancelled
+		<< " fired " << mFired << " cascaded " << mCascaded << " tick " << mTickMs << " ms";
+}
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,209 @@
+/**@file A hierarchical timer wheel for large numbers of protocol timers. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <ostream>
+
+#include "Threads.h"
+#include "Timeval.h"
+
+
+/** Something that can be called back from a TimerWheel. */
+class TimerWheelClient {
+
+	public:
+
+	virtual ~TimerWheelClient() {}
+
+	/**
+		Called when a timer runs out.
+		This is called from the thread that runs TimerWheel::expire(),
+		without the wheel lock held, so it may schedule and cancel timers.
+		@param tag The tag given to TimerWheel::schedule().
+	*/
+	virtual void timeout(unsigned tag) = 0;
+};
+
+
+/**
+	A hierarchical timer wheel, in the style of the Linux kernel timers.
+
+	Time is counted in ticks from the construction of the wheel.
+	Level 0 has one slot per tick; each higher level has one slot
+	per turn of the level below it, and its entries are moved down
+	("cascaded") when the level below wraps around.  Scheduling and
+	cancelling are O(log n) in the number of timers (for the cancel index)
+	and a tick costs only the entries that are due or cascaded,
+	no matter how many timers are running.
+
+	A timer never fires early, and fires at most two ticks late
+	if expire() is called on time.  Either the owner calls expire(),
+	sleeping up to idleMs() in between, or start() runs a thread that does so.
+
+	A client must cancel its timers and call wait() before it is deleted,
+	since a callback may already be on its way.
+*/
+class TimerWheel {
+
+	private:
+
+	static const unsigned slotBits = 6;
+	static const unsigned numSlots = 1<<slotBits;
+	static const unsigned numLevels = 4;
+	/** The longest timer, in ticks; longer timers are clamped. */
+	static const uint64_t maxTicks = (1ULL<<(slotBits*numLevels)) - 1;
+
+	/** One scheduled timer. */
+	class Entry {
+		public:
+		unsigned mID;
+		uint64_t mDue;					///< tick at which to fire
+		TimerWheelClient *mClient;
+		unsigned mTag;
+		Entry(unsigned wID, uint64_t wDue, TimerWheelClient *wClient, unsigned wTag)
+			:mID(wID),mDue(wDue),mClient(wClient),mTag(wTag)
+		{ }
+	};
+
+	typedef std::list<Entry> Slot;
+
+	/** Where an entry is, for cancellation. */
+	typedef std::map<unsigned, std::pair<Slot*,Slot::iterator> > Index;
+
+	mutable Mutex mLock;
+	unsigned mTickMs;					///< tick length in ms
+	Timeval mStart;						///< time of tick 0
+	uint64_t mNext;						///< next tick to process
+	unsigned mNextID;					///< next timer ID, never 0
+	Slot mSlots[numLevels][numSlots];
+	Slot mDue;							///< timers taken off the wheel by expire(), not yet called
+	Index mIndex;						///< every timer in mSlots or mDue
+
+	/**@name Callback tracking. */
+	//@{
+	TimerWheelClient *mFiringClient;	///< client being called back, or NULL
+	pthread_t mFiringThread;			///< thread making the callback
+	Signal mFiredSignal;				///< a callback returned
+	//@}
+
+	/**@name The optional service thread. */
+	//@{
+	Thread mThread;
+	Signal mWakeSignal;					///< a timer was scheduled
+	bool mRunning;
+	//@}
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mScheduled;
+	unsigned long mCancelled;
+	unsigned long mFired;
+	unsigned long mCascaded;			///< entries moved to a lower level
+	//@}
+
+	public:
+
+	/** Create a wheel with a given tick length in ms. */
+	TimerWheel(unsigned wTickMs=10);
+
+	/**
+		Schedule a timer.
+		@param ms The timeout in ms.
+		@param client The object to call back.
+		@param tag A value passed back to the client.
+		@return An ID for cancel(), never 0.
+	*/
+	unsigned schedule(unsigned ms, TimerWheelClient *client, unsigned tag=0);
+
+	/**
+		Cancel a timer.
+		Unknown IDs, including 0 and IDs that already fired, are ignored.
+		@return true if the timer was still pending.
+	*/
+	bool cancel(unsigned id);
+
+	/** Return true if a timer is still pending. */
+	bool pending(unsigned id) const;
+
+	/**
+		Wait for a callback to a client to finish, if one is in progress.
+		Returns at once if called from the callback itself.
+	*/
+	void wait(const TimerWheelClient *client);
+
+	/** Start a thread to call expire() on time. */
+	void start();
+
+	/**
+		Process all ticks up to the current time, calling back the due timers.
+		Only one thread should call this, the service thread if it is started.
+		@return The number of timers fired.
+	*/
+	unsigned expire();
+
+	/**
+		How long the owner can sleep before calling expire() again, in ms.
+		That is the time to the next tick with a due timer or a cascade.
+		Zero means expire() is overdue.
+	*/
+	unsigned idleMs() const;
+
+	/** Number of pending timers. */
+	size_t size() const;
+
+	/** Tick length in ms. */
+	unsigned tickMs() const { return mTickMs; }
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+
+	private:
+
+	/** The current tick, by the system clock. */
+	uint64_t currentTick() const;
+
+	/** Put an entry into its slot.  Caller holds mLock. */
+	void insert(const Entry&);
+
+	/** Move the entries of a slot to lower levels.  Caller holds mLock. */
+	void cascade(unsigned level, unsigned slot);
+
+	/** The service thread loop. */
+	void serviceLoop();
+
+	friend void *TimerWheelServiceLoopAdapter(TimerWheel*);
+};
+
+void *TimerWheelServiceLoopAdapter(TimerWheel*);
+
+
+#endif
+// vim: ts=4 sw=4
@@ -0,0 +1,107 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "TimerWheel.h"
+#include <iostream>
+#include <stdlib.h>
+
+using namespace std;
+
+
+/** Check that a timer fires no earlier than asked, and not much later. */
+class TestClient : public TimerWheelClient {
+
+	public:
+
+	Timeval mStart;
+	unsigned mTimeout;
+	unsigned mFired;
+	long mLate;
+
+	TestClient(unsigned wTimeout)
+		:mTimeout(wTimeout),mFired(0),mLate(0)
+	{ }
+
+	void timeout(unsigned tag)
+	{
+		mFired++;
+		mLate = mStart.elapsed() - (long)mTimeout;
+		if (mLate<0) cout << "timer " << tag << " fired " << -mLate << " ms early" << endl;
+	}
+};
+
+
+int main(int argc, char *argv[])
+{
+	TimerWheel wheel(10);
+
+	// Timers on every level, plus one cancelled.
+	const unsigned timeouts[] = { 0, 15, 100, 650, 1200, 3000 };
+	const unsigned numTimers = sizeof(timeouts)/sizeof(timeouts[0]);
+	TestClient* clients[numTimers];
+	for (unsigned i=0; i<numTimers; i++) {
+		clients[i] = new TestClient(timeouts[i]);
+		wheel.schedule(timeouts[i],clients[i],i);
+	}
+	TestClient cancelled(50);
+	unsigned id = wheel.schedule(50,&cancelled,99);
+	assert(wheel.pending(id));
+	assert(wheel.cancel(id));
+	assert(!wheel.cancel(id));
+
+	unsigned fired = 0;
+	while (wheel.size()) {
+		msleep(wheel.idleMs());
+		fired += wheel.expire();
+	}
+
+	for (unsigned i=0; i<numTimers; i++) {
+		cout << "timeout " << timeouts[i] << " ms fired " << clients[i]->mFired
+			<< " late " << clients[i]->mLate << " ms" << endl;
+		assert(clients[i]->mFired==1);
+		assert(clients[i]->mLate>=0);
+		delete clients[i];
+	}
+	assert(fired==numTimers);
+	assert(cancelled.mFired==0);
+	wheel.dump(cout);
+	cout << endl;
+
+	// A wheel run from its own thread.
+	// Like the OpenBTS threads, it is never stopped, so don't destroy it.
+	TimerWheel *service = new TimerWheel(10);
+	service->start();
+	TestClient threaded(200);
+	service->schedule(200,&threaded,100);
+	msleep(300);
+	service->wait(&threaded);
+	cout << "threaded timeout fired " << threaded.mFired << " late " << threaded.mLate << " ms" << endl;
+	assert(threaded.mFired==1);
+	assert(threaded.mLate>=0);
+}
+
+// vim: ts=4 sw=4
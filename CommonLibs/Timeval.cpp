@@ -26,9 +26,20 @@
 
 
 #include "Timeval.h"
+#include "Coroutines.h"
+
+#include <unistd.h>
 
 using namespace std;
 
+
+void msleep(long v)
+{
+	if (gCurrentTask) gCurrentTask->sleep(v>0 ? v : 0);
+	else usleep(v*1000);
+}
+
+
 void Timeval::future(unsigned offset)
 {
 	now();
@@ -71,8 +82,9 @@ double Timeval::seconds() const
 long Timeval::delta(const Timeval& other) const
 {
 	// 2^31 milliseconds is just over 4 years.
-	long deltaS = other.sec() - sec();
-	long deltaUs = other.usec() - usec();
+	// Widen before subtracting, so a negative difference does not wrap where long is 64 bits.
+	long deltaS = (long)other.sec() - (long)sec();
+	long deltaUs = (long)other.usec() - (long)usec();
 	return 1000*deltaS + deltaUs/1000;
 }
 	
@@ -32,8 +32,11 @@
 
 
 
-/** A wrapper on usleep to sleep for milliseconds. */
-inline void msleep(long v) { usleep(v*1000); }
+/**
+	A wrapper on usleep to sleep for milliseconds.
+	In a coroutine task, only the task sleeps.
+*/
+void msleep(long v);
 
 
 /** A C++ wrapper for struct timeval. */
@@ -83,6 +83,30 @@ template <class T> class Vector {
 	/** Release memory and clear pointers. */
 	void clear() { resize(0); }
 
+	protected:
+
+	/**
+		Change the size, using a block inside the derived object if it is big enough.
+		The block is not owned, so it is never deleted or shifted to another Vector;
+		a Vector built by shifting from this one only aliases it.
+		@param block The inline block.
+		@param capacity Its size in elements.
+		@param newSize The new size.
+	*/
+	void resizeInto(T* block, size_t capacity, size_t newSize)
+	{
+		if (newSize>capacity) {
+			resize(newSize);
+			return;
+		}
+		if (mData!=NULL) delete[] mData;
+		mData = NULL;
+		mStart = block;
+		mEnd = mStart + newSize;
+	}
+
+	public:
+
 
 	/** Copy data from another vector. */
 	void clone(const Vector<T>& other)
@@ -0,0 +1,103 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+	Globals for the benchmarks in this directory.
+
+	The benchmarks pull in most of the stack, so they need the same globals
+	as OpenBTS, but they must never open the databases of a running BTS.
+	The configuration is read from a copy of OpenBTS.db named by the
+	OPENBTS_BENCH_DB environment variable, and the TMSI table, physical
+	status table and subscriber registry are made next to that copy.
+	None of the benchmarks needs a radio.
+
+	usage: OPENBTS_BENCH_DB=/tmp/OpenBTS.db PagingBench ...
+*/
+
+
+#include <string>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Configuration.h>
+
+#include <TRXManager.h>
+#include <GSMConfig.h>
+
+#include "TransactionTable.h"
+#include "SMSSpool.h"
+
+#include <SIPInterface.h>
+#include <Globals.h>
+
+#include <PhysicalStatus.h>
+#include <SubscriberRegistry.h>
+
+using namespace std;
+
+
+/** The configuration database of a running BTS, which a benchmark must not use. */
+static const char* liveConfig = "/etc/OpenBTS/OpenBTS.db";
+
+
+/** Return the configuration database for a benchmark, or exit if there is none. */
+static const char* benchConfig()
+{
+	const char* path = getenv("OPENBTS_BENCH_DB");
+	if (!path || !*path) {
+		fprintf(stderr,"set OPENBTS_BENCH_DB to a copy of %s for the benchmark to use\n",liveConfig);
+		exit(1);
+	}
+	char real[PATH_MAX];
+	if (!strcmp(path,liveConfig) || (realpath(path,real) && !strcmp(real,liveConfig))) {
+		fprintf(stderr,"OPENBTS_BENCH_DB must not be the live configuration %s\n",liveConfig);
+		exit(1);
+	}
+	return path;
+}
+
+
+/** Return the path of a scratch database kept next to the benchmark configuration. */
+static string benchPath(const char* name)
+{
+	return string(getenv("OPENBTS_BENCH_DB")) + "." + name;
+}
+
+
+const char* gDateTime = __DATE__ " " __TIME__;
+ConfigurationTable gConfig(benchConfig());
+// The registry takes its path from the configuration, so point the copy at a scratch file first.
+bool gBenchRegistry = gConfig.set("SubscriberRegistry.db",benchPath("SubscriberRegistry.db"));
+Control::TMSITable gTMSITable(benchPath("TMSITable.db").c_str());
+Control::TransactionTable gTransactionTable;
+GSM::PhysicalStatus gPhysStatus(benchPath("PhysStatus.db").c_str());
+SIP::SIPInterface gSIPInterface;
+GSM::GSMConfig gBTS;
+TransceiverManager gTRX(gConfig.getStr("TRX.IP").c_str(), gConfig.getNum("TRX.Port"));
+SubscriberRegistry gSubscriberRegistry;
+Control::SMSSpool gSMSSpool;
+
+// vim: ts=4 sw=4
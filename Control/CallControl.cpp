@@ -271,8 +271,8 @@ bool callManagementDispatchGSM(TransactionEntry *transaction, GSM::LogicalChanne
 	// "Call Confirmed" is the GSM MTC counterpart to "Call Proceeding"
 	if (dynamic_cast<const GSM::L3CallConfirmed*>(message)) {
 		LOG(INFO) << "GSM Call Confirmed " << *transaction;
-		transaction->resetTimer("303");
-		transaction->setTimer("301");
+		transaction->resetTimer(TransactionEntry::T303);
+		transaction->setTimer(TransactionEntry::T301);
 		transaction->GSMState(GSM::MTCConfirmed);
 		return false;
 	}
@@ -281,8 +281,8 @@ bool callManagementDispatchGSM(TransactionEntry *transaction, GSM::LogicalChanne
 	// GSM 04.08 5.2.2.3.2
 	if (dynamic_cast<const GSM::L3Alerting*>(message)) {
 		LOG(INFO) << "GSM Alerting " << *transaction;
-		transaction->resetTimer("310");
-		transaction->setTimer("301");
+		transaction->resetTimer(TransactionEntry::T310);
+		transaction->setTimer(TransactionEntry::T301);
 		transaction->GSMState(GSM::CallReceived);
 		return false;
 	}
@@ -298,7 +298,7 @@ bool callManagementDispatchGSM(TransactionEntry *transaction, GSM::LogicalChanne
 		LOG(INFO) << "GSM Disconnect " << *transaction;
 		transaction->resetTimers();
 		LCH->send(GSM::L3Release(transaction->L3TI()));
-		transaction->setTimer("308");
+		transaction->setTimer(TransactionEntry::T308);
 		transaction->GSMState(GSM::ReleaseRequest);
 		// FIXME -- Maybe we need to send CANCEL.  See ticket #172.
 		transaction->MODSendBYE();
@@ -510,7 +510,7 @@ bool updateSIPSignalling(TransactionEntry *transaction, GSM::LogicalChannel *LCH
 		if (!GSMClearedOrClearing) {
 			// Initiate clearing in the GSM side.
 			LCH->send(GSM::L3Disconnect(transaction->L3TI()));
-			transaction->setTimer("305");
+			transaction->setTimer(TransactionEntry::T305);
 			transaction->GSMState(GSM::DisconnectIndication);
 		} else {
 			// GSM already cleared?
@@ -862,7 +862,7 @@ void Control::MOCController(TransactionEntry *transaction, GSM::TCHFACCHLogicalC
 	// Let the phone know the call is connected.
 	LOG(INFO) << "sending Connect to handset";
 	TCH->send(GSM::L3Connect(L3TI));
-	transaction->setTimer("313");
+	transaction->setTimer(TransactionEntry::T313);
 	transaction->GSMState(GSM::ConnectIndication);
 
 	// The call is open.
@@ -915,7 +915,7 @@ void Control::MTCStarter(TransactionEntry *transaction, GSM::LogicalChannel *LCH
 	// GSM 04.08 5.2.2.1
 	LOG(INFO) << "sending GSM Setup to call " << transaction->calling();
 	LCH->send(GSM::L3Setup(L3TI,GSM::L3CallingPartyBCDNumber(transaction->calling())));
-	transaction->setTimer("303");
+	transaction->setTimer(TransactionEntry::T303);
 	transaction->GSMState(GSM::CallPresent);
 
 	// Wait for Call Confirmed message.
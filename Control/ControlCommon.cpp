@@ -54,7 +54,8 @@ using namespace Control;
 // This will mean moving all of the parsing into the control layer.
 // FIXME -- This needs an adjustable timeout.
 
-L3Message* Control::getMessage(LogicalChannel *LCH, unsigned SAPI)
+/** Get a message, into a buffer if one is given. */
+static L3Message* getMessageInto(LogicalChannel *LCH, L3MessageBuffer* buffer, unsigned SAPI)
 {
 	unsigned timeout_ms = LCH->N200() * T200ms;
 	L3Frame *rcv = LCH->recv(timeout_ms,SAPI);
@@ -69,7 +70,7 @@ L3Message* Control::getMessage(LogicalChannel *LCH, unsigned SAPI)
 		delete rcv;
 		throw UnexpectedPrimitive();
 	}
-	L3Message *msg = parseL3(*rcv);
+	L3Message *msg = parseL3(*rcv,buffer);
 	delete rcv;
 	if (msg==NULL) {
 		LOG(NOTICE) << "unparsed message";
@@ -79,6 +80,18 @@ L3Message* Control::getMessage(LogicalChannel *LCH, unsigned SAPI)
 }
 
 
+L3Message* Control::getMessage(LogicalChannel *LCH, unsigned SAPI)
+{
+	return getMessageInto(LCH,NULL,SAPI);
+}
+
+
+L3Message* Control::getMessage(LogicalChannel *LCH, L3MessageBuffer& buffer, unsigned SAPI)
+{
+	return getMessageInto(LCH,&buffer,SAPI);
+}
+
+
 
 
 
@@ -109,6 +109,13 @@ const unsigned T313ms=3000;		///< send CONNECT --> recv CONNECT ACK
 // FIXME -- This needs an adjustable timeout.
 GSM::L3Message* getMessage(GSM::LogicalChannel* LCH, unsigned SAPI=0);
 
+/**
+	Get a message from a LogicalChannel into a message buffer.
+	The buffer owns the message, so the caller must not delete it.
+	Throws the same exceptions as the other getMessage.
+*/
+GSM::L3Message* getMessage(GSM::LogicalChannel* LCH, GSM::L3MessageBuffer& buffer, unsigned SAPI=0);
+
 
 //@}
 
@@ -119,6 +126,13 @@ void FACCHDispatcher(GSM::TCHFACCHLogicalChannel *TCHFACCH);
 void SDCCHDispatcher(GSM::SDCCHLogicalChannel *SDCCH);
 void DCCHDispatcher(GSM::LogicalChannel *DCCH);
 void PDCHDispatcher(GSM::LogicalChannel *PDCH);
+
+/**
+	Start a DCCHDispatcher for an SDCCH, as a coroutine task
+	if Control.Tasks is defined, otherwise on its own thread.
+	TCH dispatchers always get threads, since the RTP reads in a call block.
+*/
+void startSDCCHDispatcher(GSM::LogicalChannel *SDCCH);
 //@}
 
 /**@name Socket for GPRS RLC/MAC. */
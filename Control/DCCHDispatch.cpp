@@ -128,16 +128,19 @@ void DCCHDispatchMessage(const L3Message* msg, LogicalChannel* DCCH)
 /** Example of a closed-loop, persistent-thread control function for the DCCH. */
 void Control::DCCHDispatcher(LogicalChannel *DCCH)
 {
+	// The first message of each transaction is parsed into this buffer,
+	// and lives until the transaction is dispatched.
+	L3MessageBuffer messageBuffer;
 	while (1) {
 		try {
 			// Wait for a transaction to start.
 			LOG(DEBUG) << "waiting for " << *DCCH << " ESTABLISH";
 			DCCH->waitForPrimitive(ESTABLISH);
 			// Pull the first message and dispatch a new transaction.
-			const L3Message *message = getMessage(DCCH);
+			const L3Message *message = getMessage(DCCH,messageBuffer);
 			LOG(DEBUG) << *DCCH << " received " << *message;
 			DCCHDispatchMessage(message,DCCH);
-			delete message;
+			messageBuffer.clear();
 		}
 
 		// Catch the various error cases.
@@ -191,6 +194,17 @@ void Control::DCCHDispatcher(LogicalChannel *DCCH)
 }
 
 
+void Control::startSDCCHDispatcher(LogicalChannel *SDCCH)
+{
+	if (gConfig.defines("Control.Tasks")) {
+		gBTS.tasks().spawn((void(*)(void*))DCCHDispatcher,SDCCH);
+		return;
+	}
+	Thread* thread = new Thread;
+	thread->start((void*(*)(void*))DCCHDispatcher,SDCCH);
+}
+
+
 /** Example of a closed-loop, persistent-thread control function for the PDCH. */
 void Control::PDCHDispatcher(LogicalChannel *PDCH)
 {
@@ -223,7 +237,8 @@ void Control::GPRSReader(LogicalChannel *PDCH)
 		int count = RLCMACSocket.read(buf, 3000);
 		if (count>0)
 		{
-			RLCMACFrame *frame = new RLCMACFrame(23*8);
+			// The block size selects the coding scheme in L1; CS-1 is 23 octets.
+			RLCMACFrame *frame = new RLCMACFrame((count>23 ? count : 23)*8);
 			frame->unpack((unsigned char*)buf);
 			COUT("Recieve from RLCMAC and send to MS on PDCH: " << *frame);
 			if (frame->payloadType() != 0x03)//RLCMACReserved)
@@ -234,12 +249,10 @@ void Control::GPRSReader(LogicalChannel *PDCH)
 			else
 			{
 				COUT(" GPRS downlink assignment CCCH");
-				// Get an AGCH to send on.
-				CCCHLogicalChannel *AGCH = gBTS.getAGCH();
-				// Someone had better have created a least one AGCH.
-				assert(AGCH);
+				// The AGCH scheduler sends the assignment.
+				AccessGrantScheduler& AGCH = gBTS.accessGrants();
 				// Check AGCH load now.
-				if (AGCH->load()>gConfig.getNum("GSM.CCCH.AGCH.QMax"))
+				if (AGCH.load()>(unsigned)gConfig.getNum("GSM.CCCH.AGCH.QMax"))
 				{
 					COUT(" GPRS AGCH congestion");
 					return;
@@ -264,7 +277,7 @@ void Control::GPRSReader(LogicalChannel *PDCH)
 					(unsigned char*)buf
 				);
 				COUT("sending " << assign);
-				AGCH->send(assign);
+				AGCH.grant(assign,when,NormalPriority);
 				delete frame;
 			}
 		}
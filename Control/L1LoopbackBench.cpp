@@ -0,0 +1,448 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+	End-to-end L1 loopback benchmark.
+
+	Synthetic L2 frames and speech frames are pushed through the real
+	SDCCH and TCH/FACCH encoders, GMSK-modulated with modulateBurst,
+	passed through an AWGN channel with optional two-ray multipath and
+	timing offset, detected and demodulated with analyzeTrafficBurst and
+	demodulateBurst, and decoded by the matching L1 decoders.
+
+	The benchmark reports block error rate against SNR and the number of
+	blocks processed per CPU-second, split into encoder, decoder and modem time.
+
+	usage: L1LoopbackBench [sdcch|tch] [blocks] [minSNR] [maxSNR] [stepSNR] [delay] [echo]
+		delay	timing offset in symbols, may be fractional
+		echo	relative amplitude of a one-symbol echo, 0 for none
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <ctime>
+
+#include <Configuration.h>
+
+#include <sigProcLib.h>
+
+#include <TRXManager.h>
+#include <GSML1FEC.h>
+#include <GSMConfig.h>
+#include <GSMTDMA.h>
+
+#include <ControlCommon.h>
+#include <TransactionTable.h>
+#include <SMSSpool.h>
+
+#include <SIPInterface.h>
+#include <Globals.h>
+
+#include <Logger.h>
+#include <PhysicalStatus.h>
+#include <SubscriberRegistry.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+
+
+extern TransceiverManager gTRX;
+
+
+/** CPU time accumulator for one stage of the loopback. */
+class StageTimer {
+
+	private:
+
+	clock_t mStart;
+	clock_t mTotal;
+
+	public:
+
+	StageTimer():mStart(0),mTotal(0) {}
+
+	void start() { mStart = clock(); }
+	void stop() { mTotal += clock() - mStart; }
+	void reset() { mTotal = 0; }
+
+	/** Accumulated time in seconds. */
+	double seconds() const { return ((double)mTotal) / CLOCKS_PER_SEC; }
+};
+
+
+
+/**
+	The radio channel.
+	Modulates each downlink burst, applies the channel model, demodulates it
+	and hands it to the uplink decoder, re-stamped with the uplink TDMA position.
+*/
+class LoopbackChannel {
+
+	private:
+
+	static const int mSamplesPerSymbol = 1;
+
+	signalVector *mPulse;			///< GMSK pulse shape
+	unsigned mTSC;
+	float mNoiseVariance;			///< per-component noise variance
+	float mDelay;					///< timing offset, symbols
+	signalVector *mEcho;			///< multipath taps, or NULL
+
+	L1Decoder *mDecoder;
+	unsigned mBurstCount;			///< bursts sent since the decoder was attached
+
+	public:
+
+	/**@name Statistics. */
+	//@{
+	unsigned mBursts;				///< total bursts through the channel
+	unsigned mMissed;				///< bursts that failed midamble detection
+	StageTimer mModemTime;			///< modulate, channel, detect, demodulate
+	StageTimer mDecodeTime;			///< L1 decoder
+	//@}
+
+	LoopbackChannel(unsigned wTSC, float wDelay, float wEcho)
+		:mTSC(wTSC),mNoiseVariance(0.0F),mDelay(wDelay),mEcho(NULL),
+		mDecoder(NULL),mBurstCount(0),
+		mBursts(0),mMissed(0)
+	{
+		sigProcLibSetup(mSamplesPerSymbol);
+		mPulse = generateGSMPulse(2,mSamplesPerSymbol);
+		generateMidamble(*mPulse,mSamplesPerSymbol,mTSC);
+		if (wEcho>0.0F) {
+			mEcho = new signalVector(2);
+			(*mEcho)[0] = complex(1.0F);
+			(*mEcho)[1] = complex(wEcho);
+		}
+	}
+
+	~LoopbackChannel()
+	{
+		delete mPulse;
+		if (mEcho) delete mEcho;
+		sigProcLibDestroy();
+	}
+
+	void decoder(L1Decoder *wDecoder) { mDecoder=wDecoder; mBurstCount=0; }
+
+	/** Set the SNR in dB, relative to unit signal power. */
+	void SNR(float dB)
+	{
+		// gaussianNoise puts the variance on each component.
+		mNoiseVariance = 0.5F * pow(10.0F,-dB/10.0F);
+	}
+
+	void clearStats()
+	{
+		mBursts = 0;
+		mMissed = 0;
+		mModemTime.reset();
+		mDecodeTime.reset();
+	}
+
+	void write(const TxBurst& txBurst)
+	{
+		mModemTime.start();
+
+		// Transmit side, as in Transceiver::addRadioVector.
+		signalVector *rx = modulateBurst(txBurst,*mPulse,8,mSamplesPerSymbol);
+
+		// The channel.
+		if (mEcho) {
+			signalVector *echoed = convolve(rx,mEcho,NULL,NO_DELAY);
+			delete rx;
+			rx = echoed;
+		}
+		if (mDelay!=0.0F) delayVector(*rx,mDelay*mSamplesPerSymbol);
+		signalVector *noise = gaussianNoise(rx->size(),mNoiseVariance);
+		addVector(*rx,*noise);
+		delete noise;
+
+		// Receive side, as in Transceiver::pullRadioVector without the DFE.
+		complex amplitude;
+		float TOA = 0.0F;
+		bool detected = analyzeTrafficBurst(*rx,mTSC,3.0,mSamplesPerSymbol,&amplitude,&TOA,8);
+		float soft[gSlotLen];
+		if (detected) {
+			SoftVector *bits = demodulateBurst(*rx,*mPulse,mSamplesPerSymbol,amplitude,TOA);
+			// Same 8-bit quantization as the transceiver socket interface.
+			for (unsigned i=0; i<gSlotLen; i++) soft[i] = round((*bits)[i]*255.0F) / 256.0F;
+			delete bits;
+		} else {
+			// A missed burst reaches the decoder as an erasure.
+			mMissed++;
+			for (unsigned i=0; i<gSlotLen; i++) soft[i] = 0.5F;
+		}
+		delete rx;
+		mBursts++;
+
+		// Re-stamp with the uplink position of the same burst.
+		const TDMAMapping& mapping = mDecoder->mapping();
+		unsigned FN = mapping.frameMapping(mBurstCount) + (mBurstCount/mapping.numFrames())*mapping.repeatLength();
+		mBurstCount++;
+		mModemTime.stop();
+
+		mDecodeTime.start();
+		mDecoder->writeLowSide(RxBurst(soft,Time(FN,txBurst.time().TN()),TOA,0));
+		mDecodeTime.stop();
+	}
+};
+
+
+
+/** SDCCH encoder that sends its bursts into the loopback channel. */
+class LoopbackSDCCHEncoder : public SDCCHL1Encoder {
+
+	private:
+
+	LoopbackChannel &mChannel;
+
+	public:
+
+	LoopbackSDCCHEncoder(unsigned wTN, const TDMAMapping& wMapping, LoopbackChannel& wChannel)
+		:SDCCHL1Encoder(wTN,wMapping,NULL),
+		mChannel(wChannel)
+	{ }
+
+	void sendBlock(const L2Frame& frame)
+	{
+		// Keep the BTS clock on the encoder so that it never waits.
+		gBTS.clock().set(mNextWriteTime);
+		writeHighSide(frame);
+	}
+
+	protected:
+
+	void sendBurst(const TxBurst& burst) { mChannel.write(burst); }
+};
+
+
+/** SDCCH decoder that checks its frames instead of sending them to L2. */
+class LoopbackSDCCHDecoder : public SDCCHL1Decoder {
+
+	public:
+
+	BitVector mExpected;		///< last frame sent
+	unsigned mGood;				///< frames that passed parity and matched
+
+	LoopbackSDCCHDecoder(unsigned wTN, const TDMAMapping& wMapping)
+		:SDCCHL1Decoder(wTN,wMapping,NULL),
+		mExpected(184),mGood(0)
+	{ }
+
+	protected:
+
+	void handleGoodFrame()
+	{
+		for (unsigned i=0; i<mExpected.size(); i++) {
+			if (mD.bit(i)!=mExpected.bit(i)) return;
+		}
+		mGood++;
+	}
+};
+
+
+
+/** TCH/FACCH encoder that sends its bursts into the loopback channel. */
+class LoopbackTCHEncoder : public TCHFACCHL1Encoder {
+
+	private:
+
+	LoopbackChannel &mChannel;
+
+	public:
+
+	LoopbackTCHEncoder(unsigned wTN, const TDMAMapping& wMapping, LoopbackChannel& wChannel)
+		:TCHFACCHL1Encoder(wTN,wMapping,NULL),
+		mChannel(wChannel)
+	{ }
+
+	void sendBlock(const unsigned char *frame)
+	{
+		sendTCH(frame);
+		gBTS.clock().set(mNextWriteTime);
+		dispatch();
+	}
+
+	protected:
+
+	/** Do not start the dispatch thread; the benchmark drives dispatch(). */
+	void start() { L1Encoder::start(); }
+
+	void sendBurst(const TxBurst& burst) { mChannel.write(burst); }
+};
+
+
+/** TCH/FACCH decoder with no L2 above it. */
+class LoopbackTCHDecoder : public TCHFACCHL1Decoder {
+
+	public:
+
+	LoopbackTCHDecoder(unsigned wTN, const TDMAMapping& wMapping)
+		:TCHFACCHL1Decoder(wTN,wMapping,NULL)
+	{ }
+
+	protected:
+
+	/** FACCH is not exercised here. */
+	void handleGoodFrame() { }
+};
+
+
+
+/** Results for one SNR point. */
+struct LoopbackResult {
+	unsigned blocks;
+	unsigned errors;
+	double totalSeconds;
+	double modemSeconds;
+	double decodeSeconds;
+};
+
+
+void runSDCCH(LoopbackChannel& channel, unsigned blocks, LoopbackResult& result)
+{
+	const MappingPair& pair = gSDCCH_8_0Pair;
+	LoopbackSDCCHEncoder encoder(1,pair.downlink(),channel);
+	LoopbackSDCCHDecoder decoder(1,pair.uplink());
+	encoder.downstream(gTRX.ARFCN());
+	channel.decoder(&decoder);
+	encoder.open();
+	decoder.open();
+
+	StageTimer total;
+	total.start();
+	for (unsigned b=0; b<blocks; b++) {
+		for (unsigned i=0; i<decoder.mExpected.size(); i++) decoder.mExpected[i] = random() & 0x01;
+		encoder.sendBlock(L2Frame(decoder.mExpected,DATA));
+	}
+	total.stop();
+
+	result.blocks = blocks;
+	result.errors = blocks - decoder.mGood;
+	result.totalSeconds = total.seconds();
+}
+
+
+void runTCH(LoopbackChannel& channel, unsigned blocks, LoopbackResult& result)
+{
+	const MappingPair& pair = gFACCH_TCHFPair;
+	LoopbackTCHEncoder encoder(2,pair.downlink(),channel);
+	LoopbackTCHDecoder decoder(2,pair.uplink());
+	encoder.downstream(gTRX.ARFCN());
+	channel.decoder(&decoder);
+	encoder.open();
+	decoder.open();
+
+	// Diagonal interleaving delays each speech frame by one block,
+	// so the first output is discarded and each later one is checked
+	// against the frame sent one block earlier.
+	unsigned char sent[33];
+	unsigned char prev[33];
+	memset(sent,0,33);
+	unsigned errors = 0;
+	StageTimer total;
+	total.start();
+	for (unsigned b=0; b<=blocks; b++) {
+		memcpy(prev,sent,33);
+		// GSM 06.10 frames carry a 0xd signature in the first nibble.
+		sent[0] = 0xd0 | (random() & 0x0f);
+		for (unsigned i=1; i<33; i++) sent[i] = random() & 0xff;
+		encoder.sendBlock(sent);
+		while (unsigned char *frame = decoder.recvTCH()) {
+			if ((b>0) && (memcmp(frame,prev,33)!=0)) errors++;
+			delete[] frame;
+		}
+	}
+	total.stop();
+
+	result.blocks = blocks;
+	result.errors = errors;
+	result.totalSeconds = total.seconds();
+}
+
+
+
+int main(int argc, char **argv)
+{
+	gLogInit("L1LoopbackBench","WARNING");
+
+	string chanType = "sdcch";
+	unsigned blocks = 1000;
+	float minSNR = 0.0F;
+	float maxSNR = 12.0F;
+	float stepSNR = 2.0F;
+	float delay = 0.0F;
+	float echo = 0.0F;
+	if (argc>1) chanType = argv[1];
+	if (argc>2) blocks = atoi(argv[2]);
+	if (argc>3) minSNR = atof(argv[3]);
+	if (argc>4) maxSNR = atof(argv[4]);
+	if (argc>5) stepSNR = atof(argv[5]);
+	if (argc>6) delay = atof(argv[6]);
+	if (argc>7) echo = atof(argv[7]);
+	bool TCH = (chanType=="tch");
+	if ((!TCH && chanType!="sdcch") || (blocks==0) || (stepSNR<=0.0F)) {
+		cerr << "usage: " << argv[0] << " [sdcch|tch] [blocks] [minSNR] [maxSNR] [stepSNR] [delay] [echo]" << endl;
+		return 1;
+	}
+
+	srandom(1);
+	LoopbackChannel channel(gBTS.BCC(),delay,echo);
+
+	cout << (TCH ? "TCH/FS" : "SDCCH") << ", " << blocks << " blocks per point"
+		<< ", delay " << delay << " symbols, echo " << echo << endl;
+	cout << "  SNR    BLER  missed  blocks/s/core  enc%  dec%  modem%" << endl;
+
+	for (float SNR=minSNR; SNR<=maxSNR+0.001F; SNR+=stepSNR) {
+		channel.SNR(SNR);
+		channel.clearStats();
+		LoopbackResult result;
+		if (TCH) runTCH(channel,blocks,result);
+		else runSDCCH(channel,blocks,result);
+		result.modemSeconds = channel.mModemTime.seconds();
+		result.decodeSeconds = channel.mDecodeTime.seconds();
+
+		double total = result.totalSeconds;
+		double rate = (total>0.0) ? result.blocks/total : 0.0;
+		double modemPct = (total>0.0) ? 100.0*result.modemSeconds/total : 0.0;
+		double decodePct = (total>0.0) ? 100.0*result.decodeSeconds/total : 0.0;
+		double encodePct = (total>0.0) ? 100.0 - modemPct - decodePct : 0.0;
+		cout << setw(5) << fixed << setprecision(1) << SNR
+			<< "  " << setw(6) << setprecision(4) << ((float)result.errors)/result.blocks
+			<< "  " << setw(6) << channel.mMissed
+			<< "  " << setw(13) << setprecision(0) << rate
+			<< "  " << setw(4) << encodePct
+			<< "  " << setw(4) << decodePct
+			<< "  " << setw(6) << modemPct
+			<< endl;
+	}
+
+	return 0;
+}
+
+// vim: ts=4 sw=4
@@ -0,0 +1,152 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+	L3 parsing throughput benchmark.
+
+	Each message type is parsed from the same uplink frame many times,
+	first onto the heap and deleted, as parseL3 callers used to do,
+	then into a reused L3MessageBuffer, as the SACCH and DCCH dispatchers do.
+	Measurement reports are also decoded straight from the frame,
+	as the SACCH does, without making a message.
+
+	The benchmark reports parses per second for each type and path.
+
+	usage: L3ParseBench [iterations]
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+
+#include <Configuration.h>
+
+#include <TRXManager.h>
+#include <GSMConfig.h>
+#include <GSML3RRMessages.h>
+
+#include "ControlCommon.h"
+#include "TransactionTable.h"
+#include "SMSSpool.h"
+
+#include <SIPInterface.h>
+#include <Globals.h>
+
+#include <Logger.h>
+#include <PhysicalStatus.h>
+#include <SubscriberRegistry.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+
+
+/** A sample uplink message. */
+struct Sample {
+	const char* name;
+	const char* hex;
+};
+
+static const Sample samples[] = {
+	{ "MeasurementReport", "06152a2a00" "00000000000000000000000000" },
+	{ "MeasurementReport/3", "06152a2a00e5" "1234567890abcdef1234abcd" },
+	{ "PagingResponse", "062707" "03575819" "05f412345678" },
+	{ "LocationUpdatingRequest", "050870" "00f1100001" "33" "080910101032547698" },
+	{ "CMServiceRequest", "052471" "03575819" "05f412345678" },
+	{ "IdentityResponse", "0519" "080910101032547698" },
+	{ "Setup", "0305" "0401a0" "5e068121436587f9" },
+	{ "Disconnect", "0325" "02e090" },
+	{ "ConnectAcknowledge", "030f" },
+	{ "CP-DATA", "0901" "050001000000" },
+	{ "CP-ACK", "0904" },
+};
+static const unsigned numSamples = sizeof(samples)/sizeof(samples[0]);
+
+
+/** Return parses per second for a number of iterations, or 0 if parsing fails. */
+static double parseHeap(const L3Frame& frame, unsigned iterations)
+{
+	Timeval start;
+	for (unsigned i=0; i<iterations; i++) {
+		L3Message *msg = parseL3(frame);
+		if (!msg) return 0;
+		delete msg;
+	}
+	return iterations * 1000.0 / (start.elapsed()+1);
+}
+
+
+static double parseBuffer(const L3Frame& frame, unsigned iterations, L3MessageBuffer& buffer)
+{
+	Timeval start;
+	for (unsigned i=0; i<iterations; i++) {
+		if (!parseL3(frame,&buffer)) return 0;
+	}
+	return iterations * 1000.0 / (start.elapsed()+1);
+}
+
+
+static double parseDirect(const L3Frame& frame, unsigned iterations)
+{
+	L3MeasurementResults results;
+	Timeval start;
+	for (unsigned i=0; i<iterations; i++) {
+		if (!L3MeasurementReport::parseResults(frame,results)) return 0;
+	}
+	return iterations * 1000.0 / (start.elapsed()+1);
+}
+
+
+int main(int argc, char *argv[])
+{
+	unsigned iterations = argc>1 ? atoi(argv[1]) : 100000;
+
+	cout << iterations << " parses per test" << endl;
+	cout << setw(24) << "message" << setw(8) << "bytes" << setw(12) << "heap/s"
+		<< setw(12) << "buffer/s" << setw(12) << "direct/s" << endl;
+	L3MessageBuffer buffer;
+	for (unsigned i=0; i<numSamples; i++) {
+		L3Frame frame(samples[i].hex);
+		L3Message *msg = parseL3(frame,&buffer);
+		if (!msg) {
+			cout << setw(24) << samples[i].name << "  unparsable: " << frame << endl;
+			continue;
+		}
+		cout << setw(24) << samples[i].name << setw(8) << frame.size()/8
+			<< fixed << setprecision(0)
+			<< setw(12) << parseHeap(frame,iterations)
+			<< setw(12) << parseBuffer(frame,iterations,buffer);
+		if (dynamic_cast<L3MeasurementReport*>(msg)) cout << setw(12) << parseDirect(frame,iterations);
+		else cout << setw(12) << "-";
+		if (buffer.onHeap()) cout << "  (too big for the buffer)";
+		cout << endl;
+		buffer.clear();
+	}
+	return 0;
+}
+
+// vim: ts=4 sw=4
@@ -0,0 +1,210 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+	Location updating pipeline benchmark.
+
+	A number of SDCCH threads each serve one location updating request
+	after another, as LocationUpdatingController() would, from a population
+	of subscribers that come back periodically.  Each request holds its
+	SDCCH for a fixed radio signalling time plus the time to get the
+	registration answer from a RegistrationCache, with each of the
+	Control.LUR.Pipeline policies.
+
+	The SIP registrar is an in-process stand-in that answers after a
+	fixed round trip time, since the SIP stack cannot run here.  It refuses
+	a fixed fraction of the subscribers, so that the cached answers can be
+	checked against it.
+
+	The benchmark reports completed LURs per second, the mean and worst
+	SDCCH holding time, the registrations the stand-in got, and the answers
+	that disagreed with it, for each policy.
+
+	usage: LURBench [seconds] [RTT] [SDCCHs] [subscribers]
+		RTT			registrar round trip time, ms
+		SDCCHs		number of SDCCH threads
+		subscribers	size of the subscriber population
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <Configuration.h>
+
+#include <TRXManager.h>
+#include <GSMConfig.h>
+
+#include "ControlCommon.h"
+#include "TransactionTable.h"
+#include "SMSSpool.h"
+#include "RegistrationCache.h"
+
+#include <SIPInterface.h>
+#include <Globals.h>
+
+#include <Logger.h>
+#include <PhysicalStatus.h>
+#include <SubscriberRegistry.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+using namespace Control;
+
+
+/** SDCCH time of a LUR apart from the registration, ms. */
+static const unsigned radioTime = 50;
+/** One subscriber in this many is refused by the registrar. */
+static const unsigned refusedEvery = 20;
+
+
+/** Whether the stand-in accepts a subscriber. */
+static bool accepted(const char* IMSI)
+{
+	return strtoul(IMSI+5,NULL,10) % refusedEvery != 0;
+}
+
+
+/** A registrar that answers after a fixed delay. */
+class StandInRegistrar : public Registrar {
+
+	private:
+
+	unsigned mRTT;
+	mutable Mutex mLock;
+	unsigned long mRequests;
+
+	public:
+
+	StandInRegistrar(unsigned wRTT)
+		:mRTT(wRTT),mRequests(0)
+	{ }
+
+	bool registerIMSI(const char* IMSI)
+	{
+		mLock.lock();
+		mRequests++;
+		mLock.unlock();
+		msleep(mRTT);
+		return accepted(IMSI);
+	}
+
+	unsigned long requests() const
+	{
+		ScopedLock lock(mLock);
+		return mRequests;
+	}
+};
+
+
+/** The state of one run, shared by the SDCCH threads. */
+struct Run {
+	RegistrationCache *cache;
+	LURPolicy policy;
+	unsigned subscribers;
+	Timeval end;
+	Mutex lock;
+	unsigned long completed;
+	unsigned long wrong;			///< answers that disagree with the registrar
+	double totalHold;				///< ms
+	long maxHold;					///< ms
+};
+
+
+/** One SDCCH, serving LURs until the end of the run. */
+static void* SDCCHLoop(Run* run)
+{
+	unsigned seed = (unsigned)(size_t)pthread_self();
+	while (!run->end.passed()) {
+		char IMSI[16];
+		sprintf(IMSI,"00101%010u",rand_r(&seed) % run->subscribers);
+		Timeval start;
+		msleep(radioTime);
+		bool success = run->cache->registerIMSI(IMSI,run->policy);
+		long hold = start.elapsed();
+		ScopedLock lock(run->lock);
+		run->completed++;
+		if (success!=accepted(IMSI)) run->wrong++;
+		run->totalHold += hold;
+		if (hold>run->maxHold) run->maxHold = hold;
+	}
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc>1 ? atof(argv[1]) : 30;
+	unsigned RTT = argc>2 ? atoi(argv[2]) : 500;
+	unsigned SDCCHs = argc>3 ? atoi(argv[3]) : 8;
+	unsigned subscribers = argc>4 ? atoi(argv[4]) : 2000;
+
+	cout << SDCCHs << " SDCCHs, registrar RTT " << RTT << " ms, " << subscribers
+		<< " subscribers, " << seconds << " s per run" << endl;
+	cout << setw(12) << "policy" << setw(10) << "LUR/s" << setw(10) << "meanHold"
+		<< setw(10) << "maxHold" << setw(10) << "SIP" << setw(8) << "wrong" << endl;
+
+	for (unsigned policy=LURSynchronous; policy<=LUROptimistic; policy++) {
+		// The refresh threads never exit, so each run gets its own cache, never deleted.
+		StandInRegistrar *registrar = new StandInRegistrar(RTT);
+		Run run;
+		run.cache = new RegistrationCache(registrar);
+		run.cache->start(4);
+		run.policy = (LURPolicy)policy;
+		run.subscribers = subscribers;
+		run.completed = 0;
+		run.wrong = 0;
+		run.totalHold = 0;
+		run.maxHold = 0;
+		run.end.future((long)(seconds*1000));
+		vector<Thread*> threads;
+		for (unsigned i=0; i<SDCCHs; i++) {
+			Thread *thread = new Thread;
+			thread->start((void*(*)(void*))SDCCHLoop,&run);
+			threads.push_back(thread);
+		}
+		for (unsigned i=0; i<SDCCHs; i++) {
+			threads[i]->join();
+			delete threads[i];
+		}
+		cout << setw(12) << run.policy
+			<< setw(10) << fixed << setprecision(1) << run.completed/seconds
+			<< setw(10) << (run.completed ? run.totalHold/run.completed : 0.0)
+			<< setw(10) << run.maxHold
+			<< setw(10) << registrar->requests()
+			<< setw(8) << run.wrong << endl;
+		cout << "    ";
+		run.cache->dump(cout);
+		cout << endl;
+	}
+	return 0;
+}
+
+// vim: ts=4 sw=4
@@ -0,0 +1,232 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "LocationTable.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <iomanip>
+#include <vector>
+
+#include <Configuration.h>
+#include <Logger.h>
+#include <SubscriberRegistry.h>
+#include <sqlite3util.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace Control;
+
+extern ConfigurationTable gConfig;
+extern SubscriberRegistry gSubscriberRegistry;
+
+
+
+LocationTable::LocationTable()
+	:mRunning(false),
+	mFixes(0),mWritten(0),mBatches(0),mFailures(0),mDropped(0),mMaxQueue(0),mLastFlushTime(0)
+{ }
+
+
+void LocationTable::start()
+{
+	ScopedLock lock(mLock);
+	if (mRunning) return;
+	mRunning = true;
+	load();
+	mWriterThread.start((void*(*)(void*))LocationTableWriterLoopAdapter,this);
+}
+
+
+void LocationTable::load()
+{
+	// Caller holds mLock.
+	sqlite3 *DB = gSubscriberRegistry.db();
+	if (!DB) return;
+	sqlite3_stmt *stmt = sqlite3_cached_statement(DB,
+		"SELECT name, latitude, longitude, error, time FROM RRLP "
+		"WHERE id IN (SELECT MAX(id) FROM RRLP GROUP BY name)");
+	if (!stmt) {
+		LOG(ALERT) << "cannot read the RRLP table: " << sqlite3_errmsg(DB);
+		return;
+	}
+	while (sqlite3_run_query(DB,stmt)==SQLITE_ROW) {
+		const char *name = (const char*)sqlite3_column_text(stmt,0);
+		const char *time = (const char*)sqlite3_column_text(stmt,4);
+		if (!name) continue;
+		Fix& fix = mLatest[name];
+		fix.mName = name;
+		fix.mLatitude = sqlite3_column_double(stmt,1);
+		fix.mLongitude = sqlite3_column_double(stmt,2);
+		fix.mError = sqlite3_column_double(stmt,3);
+		fix.mTime = time ? time : "";
+	}
+	sqlite3_release_statement(DB,stmt);
+	LOG(INFO) << "loaded the latest fixes of " << mLatest.size() << " subscribers";
+}
+
+
+void LocationTable::add(const string& name, double latitude, double longitude, double error)
+{
+	Fix fix;
+	fix.mName = name;
+	fix.mLatitude = latitude;
+	fix.mLongitude = longitude;
+	fix.mError = error;
+	time_t now = time(NULL);
+	struct tm fields;
+	gmtime_r(&now,&fields);
+	char buf[32];
+	strftime(buf,sizeof(buf),"%Y-%m-%d %H:%M:%S",&fields);
+	fix.mTime = buf;
+
+	ScopedLock lock(mLock);
+	mFixes++;
+	mLatest[name] = fix;
+	if (mQueue.size()>=maxQueue) {
+		mQueue.pop_front();
+		if (mDropped++ % 1000 == 0) LOG(ALERT) << "RRLP fix queue full, dropping the oldest fixes";
+	}
+	mQueue.push_back(fix);
+	if (mQueue.size()>mMaxQueue) mMaxQueue = mQueue.size();
+}
+
+
+bool LocationTable::latest(const string& name, Fix& fix) const
+{
+	ScopedLock lock(mLock);
+	FixMap::const_iterator p = mLatest.find(name);
+	if (p==mLatest.end()) return false;
+	fix = p->second;
+	return true;
+}
+
+
+size_t LocationTable::backlog() const
+{
+	ScopedLock lock(mLock);
+	return mQueue.size();
+}
+
+
+void LocationTable::flush()
+{
+	ScopedLock flushLock(mFlushLock);
+	while (true) {
+		// Take a batch under the lock and write it without it.
+		vector< vector<string> > rows;
+		mLock.lock();
+		unsigned long dropped = mDropped;
+		size_t count = mQueue.size();
+		if (count>maxBatch) count = maxBatch;
+		for (size_t i=0; i<count; i++) {
+			const Fix& fix = mQueue[i];
+			vector<string> row(5);
+			row[0] = fix.mName;
+			char buf[32];
+			sprintf(buf,"%.7f",fix.mLatitude);
+			row[1] = buf;
+			sprintf(buf,"%.7f",fix.mLongitude);
+			row[2] = buf;
+			sprintf(buf,"%.1f",fix.mError);
+			row[3] = buf;
+			row[4] = fix.mTime;
+			rows.push_back(row);
+		}
+		mLock.unlock();
+		if (count==0) return;
+
+		Timeval start;
+		SubscriberRegistry::Status status = gSubscriberRegistry.sqlBatch(
+			"INSERT INTO RRLP (name, latitude, longitude, error, time) VALUES (?,?,?,?,?)",rows);
+		long elapsed = start.elapsed();
+		LOG(DEBUG) << "wrote " << count << " RRLP fixes in " << elapsed << " ms";
+
+		ScopedLock lock(mLock);
+		mLastFlushTime = elapsed;
+		if (status!=SubscriberRegistry::SUCCESS) {
+			// Leave the batch queued for the next flush.
+			mFailures++;
+			return;
+		}
+		// Meanwhile, add() only appends, and drops from the front if the queue is full,
+		// which may have taken some of this batch already.
+		size_t gone = mDropped - dropped;
+		if (gone<count) mQueue.erase(mQueue.begin(),mQueue.begin()+(count-gone));
+		mWritten += gone<count ? count-gone : 0;
+		mBatches++;
+	}
+}
+
+
+void LocationTable::writerLoop()
+{
+	while (true) {
+		unsigned interval = 1000;
+		if (gConfig.defines("Control.Reporting.LocationFlush")) interval = gConfig.getNum("Control.Reporting.LocationFlush");
+		msleep(interval);
+		flush();
+	}
+}
+
+
+void *Control::LocationTableWriterLoopAdapter(LocationTable *table)
+{
+	table->writerLoop();
+	return NULL;
+}
+
+
+void LocationTable::dump(ostream& os, const char* name) const
+{
+	ScopedLock lock(mLock);
+	ios::fmtflags flags = os.flags();
+	streamsize precision = os.precision();
+	for (FixMap::const_iterator p=mLatest.begin(); p!=mLatest.end(); ++p) {
+		if (name && p->first!=name) continue;
+		const Fix& fix = p->second;
+		os << setw(20) << left << fix.mName << right << fixed << setprecision(6)
+			<< setw(12) << fix.mLatitude << setw(13) << fix.mLongitude
+			<< setprecision(0) << setw(8) << fix.mError << "  " << fix.mTime << endl;
+	}
+	os.flags(flags);
+	os.precision(precision);
+}
+
+
+void LocationTable::dumpStats(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "fixes " << mFixes << " subscribers " << mLatest.size() << " written " << mWritten
+		<< " batches " << mBatches << " failures " << mFailures << " dropped " << mDropped
+		<< " queue " << mQueue.size() << " max " << mMaxQueue << " last batch " << mLastFlushTime << " ms";
+}
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,144 @@
+/**@file Write-behind storage of RRLP position fixes. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#ifndef LOCATIONTABLE_H
+#define LOCATIONTABLE_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <ostream>
+
+#include <Threads.h>
+#include <Timeval.h>
+
+
+namespace Control {
+
+
+/**
+	The RRLP position fixes, for the RRLP table of the subscriber registry.
+
+	The RRLP server is polled on channel threads, so a fix is only queued
+	here, and a writer thread inserts the queue every
+	Control.Reporting.LocationFlush ms, one transaction per batch.
+	The latest fix of each subscriber is also kept in memory, so it can
+	be looked up without a query.  If the database stays unwritable,
+	the queue is bounded and the oldest fixes are dropped first.
+*/
+class LocationTable {
+
+	public:
+
+	/** One position fix. */
+	class Fix {
+		public:
+		std::string mName;			///< subscriber, "IMSI" + digits, as in sip_buddies
+		double mLatitude;			///< degrees
+		double mLongitude;			///< degrees
+		double mError;				///< meters
+		std::string mTime;			///< UTC "YYYY-MM-DD HH:MM:SS", as sqlite datetime()
+	};
+
+	private:
+
+	/** Most fixes in one transaction. */
+	static const unsigned maxBatch = 500;
+	/** Most fixes waiting to be written. */
+	static const unsigned maxQueue = 10000;
+
+	typedef std::map<std::string,Fix> FixMap;
+
+	mutable Mutex mLock;
+	FixMap mLatest;					///< latest fix, by subscriber name
+	std::deque<Fix> mQueue;			///< fixes not yet written
+	Mutex mFlushLock;				///< serializes flushes
+	Thread mWriterThread;
+	bool mRunning;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mFixes;
+	unsigned long mWritten;
+	unsigned long mBatches;
+	unsigned long mFailures;		///< batches that failed, to be retried
+	unsigned long mDropped;			///< fixes lost to a full queue
+	size_t mMaxQueue;
+	long mLastFlushTime;			///< ms for the last batch
+	//@}
+
+	public:
+
+	LocationTable();
+
+	/** Load the latest fix of each subscriber from the database and start the writer. */
+	void start();
+
+	/**
+		Record a fix, time-stamped now.
+		@param name The subscriber, "IMSI" + digits.
+	*/
+	void add(const std::string& name, double latitude, double longitude, double error);
+
+	/**
+		Get the latest fix of a subscriber.
+		@return true if there is one.
+	*/
+	bool latest(const std::string& name, Fix& fix) const;
+
+	/** Write all queued fixes now. */
+	void flush();
+
+	/** Number of fixes waiting to be written. */
+	size_t backlog() const;
+
+	/** Print the latest fixes, of one subscriber or all if name is NULL. */
+	void dump(std::ostream&, const char* name=NULL) const;
+
+	/** Dump statistics to a stream. */
+	void dumpStats(std::ostream&) const;
+
+	private:
+
+	/** Read the latest fixes from the database. */
+	void load();
+
+	/** Flush periodically. */
+	void writerLoop();
+
+	friend void *LocationTableWriterLoopAdapter(LocationTable*);
+};
+
+void *LocationTableWriterLoopAdapter(LocationTable*);
+
+
+};	// namespace Control
+
+
+#endif
+// vim: ts=4 sw=4
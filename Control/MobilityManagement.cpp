@@ -50,6 +50,7 @@ using namespace SIP;
 
 #include <Regexp.h>
 #include <Logger.h>
+#include <HTTPClient.h>
 #undef WARNING
 
 
@@ -68,6 +69,14 @@ void Control::CMServiceResponder(const L3CMServiceRequest* cmsrq, LogicalChannel
 			MOCStarter(cmsrq,DCCH);
 			break;
 		case L3CMServiceType::ShortMessage:
+			// Under overload, the MS keeps the message and tries again later.
+			if (gBTS.overload().deferSMS()) {
+				LOG(NOTICE) << "deferring SMS under overload for " << *cmsrq;
+				// Cause 0x16 means "congestion".
+				DCCH->send(L3CMServiceReject(0x16));
+				DCCH->send(L3ChannelRelease());
+				break;
+			}
 			MOSMSController(cmsrq,DCCH);
 			break;
 		default:
@@ -148,11 +157,84 @@ class RRLPServer
 		L3MobileIdentity mobileID;
 		LogicalChannel *DCCH;
 		string query;
+		string config;
 		string name;
 		bool transact();
+		bool serverQuery(map<string,string>& response, vector<string>& apdus);
 		bool trouble;
 };
 
+
+/** Connections to the RRLP server, shared by all RRLP sessions. */
+static HTTPClient gRRLPClient;
+
+
+/**
+	The server's answer to the assistance query.
+	The query carries only the configuration, not the mobile, so the answer
+	changes only when the server refreshes its almanac or ephemeris, and
+	is kept for the shorter of their refresh times.
+*/
+class RRLPAssistCache {
+
+	private:
+
+	mutable Mutex mLock;
+	string mURL;				///< the query, including the configuration
+	string mBody;
+	Timeval mExpiration;
+	unsigned long mHits;
+	unsigned long mMisses;
+
+	public:
+
+	RRLPAssistCache()
+		:mHits(0),mMisses(0)
+	{ }
+
+	bool get(const string& URL, string& body)
+	{
+		ScopedLock lock(mLock);
+		if (URL!=mURL || mExpiration.passed()) {
+			mMisses++;
+			return false;
+		}
+		mHits++;
+		body = mBody;
+		return true;
+	}
+
+	void put(const string& URL, const string& body)
+	{
+		double hours = atof(gConfig.getStr("GSM.RRLP.EPHEMERIS.REFRESH.TIME","1").c_str());
+		double almanacHours = atof(gConfig.getStr("GSM.RRLP.ALMANAC.REFRESH.TIME","24").c_str());
+		if (almanacHours<hours) hours = almanacHours;
+		ScopedLock lock(mLock);
+		mURL = URL;
+		mBody = body;
+		mExpiration.future((unsigned)(hours*3600000));
+	}
+
+	void dump(ostream& os) const
+	{
+		ScopedLock lock(mLock);
+		os << "assist hits " << mHits << " misses " << mMisses;
+	}
+};
+
+static RRLPAssistCache gRRLPAssist;
+
+
+void Control::dumpRRLPStats(ostream& os)
+{
+	gRRLPClient.dump(os);
+	os << " ";
+	gRRLPAssist.dump(os);
+}
+
+
+static string getConfig();
+
 RRLPServer::RRLPServer(L3MobileIdentity wMobileID, LogicalChannel *wDCCH)
 {
 	trouble = false;
@@ -162,6 +244,13 @@ RRLPServer::RRLPServer(L3MobileIdentity wMobileID, LogicalChannel *wDCCH)
 		trouble = true;
 		return;
 	}
+	// The configuration goes with every query, so build it once per session.
+	config = getConfig();
+	if (config.length() == 0) {
+		LOG(INFO) << "RRLP configuration incomplete";
+		trouble = true;
+		return;
+	}
 	mobileID = wMobileID;
 	DCCH = wDCCH;
 	// name of subscriber
@@ -195,7 +284,7 @@ void clean(char *line)
 	while (p > line && *p <= ' ') *p-- = 0;
 }
 
-string getConfig()
+static string getConfig()
 {
 	const char *configs[] = {
 		"GSM.RRLP.ACCURACY",
@@ -233,41 +322,70 @@ string getConfig()
 	return config;
 }
 
+/**
+	Send the current query to the RRLP server and collect its response lines.
+	@return false if the server did not answer.
+*/
+bool RRLPServer::serverQuery(map<string,string>& response, vector<string>& apdus)
+{
+	string URL = url + "?" + query + config;
+	LOG(INFO) << "RRLP query " << URL;
+	string body;
+	bool assistQuery = (query == "query=assist");
+	if (!assistQuery || !gRRLPAssist.get(URL,body)) {
+		string host, path;
+		unsigned short port;
+		if (HTTPClient::parseURL(URL,host,port,path)) {
+			int status = gRRLPClient.get(URL,body,gConfig.getNum("GSM.RRLP.SERVER.TIMEOUT",10000));
+			if (status != 200) {
+				LOG(CRIT) << "RRLP server request \"" << URL << "\" failed, status " << status;
+				return false;
+			}
+		} else {
+			// Not plain HTTP, so let wget deal with it.
+			string cmd = "wget -qO- '" + URL + "'";
+			FILE *result = popen(cmd.c_str(), "r");
+			if (!result) {
+				LOG(CRIT) << "popen call \"" << cmd << "\" failed";
+				return false;
+			}
+			char buf[1500];
+			size_t count;
+			while ((count = fread(buf, 1, sizeof(buf), result)) > 0) body.append(buf, count);
+			pclose(result);
+		}
+		// Do not keep an error, so the next mobile asks again.
+		if (assistQuery && body.find("error=") == string::npos) gRRLPAssist.put(URL,body);
+	}
+
+	// build map of responses, and list of apdus
+	istringstream lines(body);
+	string lineStr;
+	while (getline(lines, lineStr)) {
+		vector<char> line(lineStr.begin(), lineStr.end());
+		line.push_back(0);
+		clean(&line[0]);
+		LOG(INFO) << "server return: " << &line[0];
+		char *p = strchr(&line[0], '=');
+		if (!p) continue;
+		string lhs = string(&line[0], p-&line[0]);
+		string rhs = string(p+1);
+		if (lhs == "apdu") {
+			apdus.push_back(rhs);
+		} else {
+			response[lhs] = rhs;
+		}
+	}
+	return true;
+}
+
 bool RRLPServer::transact()
 {
 	vector<string> apdus;
 	while (true) {
 		// bounce off server
-		string esc = "'";
-		string config = getConfig();
-		if (config.length() == 0) return false;
-		string cmd = "wget -qO- " + esc + url + "?" + query + config + esc;
-		LOG(INFO) << "*************** "  << cmd;
-		FILE *result = popen(cmd.c_str(), "r");
-		if (!result) {
-			LOG(CRIT) << "popen call \"" << cmd << "\" failed";
-			return NULL;
-		}
-		// build map of responses, and list of apdus
 		map<string,string> response;
-		size_t nbytes = 1500;
-		char *line = (char*)malloc(nbytes+1);
-		while (!feof(result)) {
-			if (!fgets(line, nbytes, result)) break;
-			clean(line);
-			LOG(INFO) << "server return: " << line;
-			char *p = strchr(line, '=');
-			if (!p) continue;
-			string lhs = string(line, 0, p-line);
-			string rhs = string(line, p+1-line, string::npos);
-			if (lhs == "apdu") {
-				apdus.push_back(rhs);
-			} else {
-				response[lhs] = rhs;
-			}
-		}
-		free(line);
-		pclose(result);
+		if (!serverQuery(response, apdus)) return false;
 
 		// quit if error
 		if (response.find("error") != response.end()) {
@@ -287,19 +405,17 @@ bool RRLPServer::transact()
 
 		// quit if location decoded 
 		if (response.find("latitude") != response.end() && response.find("longitude") != response.end() && response.find("positionError") != response.end()) {
-			ostringstream os;
-			os << "insert into RRLP (name, latitude, longitude, error, time) values (" <<
-				'"' << name << '"' << "," <<
-				response["latitude"] << "," <<
-				response["longitude"] << "," <<
-				response["positionError"] << "," <<
-				"datetime('now')"
-			")";
-			LOG(INFO) << os.str();
-			if (!sqlite3_command(gSubscriberRegistry.db(), os.str().c_str())) {
-				LOG(INFO) << "sqlite3_command problem";
+			char *latEnd, *lonEnd, *errEnd;
+			double latitude = strtod(response["latitude"].c_str(), &latEnd);
+			double longitude = strtod(response["longitude"].c_str(), &lonEnd);
+			double error = strtod(response["positionError"].c_str(), &errEnd);
+			if (*latEnd || *lonEnd || *errEnd) {
+				LOG(INFO) << "bad location from server";
 				return false;
 			}
+			LOG(INFO) << name << " at " << latitude << "," << longitude << " +/- " << error;
+			// Written to the RRLP table by the location table's writer.
+			gBTS.locations().add(name, latitude, longitude, error);
 			return true;
 		}
 
@@ -354,7 +470,7 @@ bool RRLPServer::transact()
 					LOG(INFO) << "MS says: message not implemented";
 					// flag unsupported in SR so we don't waste time on it again
 					os2 << "update sip_buddies set RRLPSupported = \"0\" where name = \"" << name << "\"";
-					if (!sqlite3_command(gSubscriberRegistry.db(), os2.str().c_str())) {
+					if (gSubscriberRegistry.sqlUpdate(os2.str().c_str())!=SubscriberRegistry::SUCCESS) {
 						LOG(INFO) << "sqlite3_command problem";
 					}
 					return false;
@@ -420,12 +536,11 @@ void Control::LocationUpdatingController(const L3LocationUpdatingRequest* lur, L
 	if (!preexistingTMSI) newTMSI = gTMSITable.assign(IMSI,lur);
 
 	// Try to register the IMSI.
-	// This will be set true if registration succeeded in the SIP world.
+	// This will be set true if registration succeeded in the SIP world,
+	// or, depending on Control.LUR.Pipeline, if it did recently.
 	bool success = false;
 	try {
-		SIPEngine engine(gConfig.getStr("SIP.Proxy.Registration").c_str(),IMSI);
-		LOG(DEBUG) << "waiting for registration of " << IMSI << " on " << gConfig.getStr("SIP.Proxy.Registration");
-		success = engine.Register(SIPEngine::SIPRegister); 
+		success = gBTS.registrations().registerIMSI(IMSI);
 	}
 	catch(SIPTimeout) {
 		LOG(ALERT) "SIP registration timed out.  Is the proxy running at " << gConfig.getStr("SIP.Proxy.Registration");
@@ -433,7 +548,7 @@ void Control::LocationUpdatingController(const L3LocationUpdatingRequest* lur, L
 		DCCH->send(L3LocationUpdatingReject(0x11));
 		// HACK -- wait long enough for a response
 		// FIXME -- Why are we doing this?
-		sleep(4);
+		msleep(4000);
 		// Release the channel and return.
 		DCCH->send(L3ChannelRelease());
 		return;
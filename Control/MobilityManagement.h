@@ -27,6 +27,8 @@
 #ifndef MOBILITYMANAGEMENT_H
 #define MOBILITYMANAGEMENT_H
 
+#include <ostream>
+
 
 namespace GSM {
 class LogicalChannel;
@@ -43,6 +45,9 @@ void IMSIDetachController(const GSM::L3IMSIDetachIndication* idi, GSM::LogicalCh
 
 void LocationUpdatingController(const GSM::L3LocationUpdatingRequest* lur, GSM::LogicalChannel* DCCH);
 
+/** Dump the RRLP server connection and cache statistics. */
+void dumpRRLPStats(std::ostream&);
+
 }
 
 
@@ -0,0 +1,385 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+	Overload control load-injection benchmark.
+
+	Access requests are injected as a Poisson process, with a surge in the
+	middle of the run, like the registration storm after an outage.
+	A model of the BTS answers each RACH burst as AccessGrantResponder()
+	does: a grant if an SDCCH is free and the AGCH is not congested,
+	otherwise a reject with T3122.  The AGCH sends grants first and then
+	rejects, four to a block, at a fixed number of blocks per second, and
+	drops anything older than RACHMaxAge(), as the access grant scheduler
+	does.  A dropped grant holds its SDCCH until T3101 runs out.  A mobile
+	that hears nothing tries again, so a BTS that falls behind gets more
+	load, not less.
+
+	Each run is made twice: once with only the existing checks, and once
+	with an OverloadController fed the AGCH backlog every
+	Control.Overload.Period ms, applying its responses as the BTS would:
+	stretched T3122, deferred SMS, LUR rejection and access class barring.
+
+	The benchmark reports completed requests, RACH attempts, dropped
+	messages, the worst AGCH backlog and the access delay of calls and
+	emergency calls for each run, and the time spent at each level.
+
+	usage: OverloadBench [seconds] [surge] [blocks] [SDCCHs]
+		surge		offered load during the surge, as a multiple of the normal load
+		blocks		AGCH blocks per second
+		SDCCHs		number of SDCCHs
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <map>
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+
+#include <Configuration.h>
+
+#include <TRXManager.h>
+#include <GSMConfig.h>
+
+#include "ControlCommon.h"
+#include "TransactionTable.h"
+#include "SMSSpool.h"
+#include "RadioResource.h"
+#include "OverloadControl.h"
+
+#include <SIPInterface.h>
+#include <Globals.h>
+
+#include <Logger.h>
+#include <PhysicalStatus.h>
+#include <SubscriberRegistry.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+using namespace Control;
+
+
+/** Simulation step, seconds. */
+static const double step = 0.01;
+/** Normal offered load, requests per second. */
+static const double normalRate = 1.0;
+/** How long a mobile waits for an answer, seconds; T3126 with all of its RACH retries. */
+static const double answerTimeout = 2.0;
+/** How long a mobile waits after no answer before it tries again, seconds; T3211 for LUR. */
+static const double retryWait = 15.0;
+/** How long a dropped grant holds its SDCCH, seconds. */
+static const double T3101 = 3.0;
+/** How long a mobile waits after its SMS is deferred, seconds. */
+static const double SMSRetry = 30.0;
+
+
+enum RequestType { LUR, SMS, Call, Emergency, numTypes };
+
+static const char* typeNames[numTypes] = { "LUR", "SMS", "call", "SOS" };
+
+/** SDCCH holding time for each type, seconds. */
+static const double holdTime[numTypes] = { 2.0, 3.0, 3.0, 3.0 };
+
+
+/** A mobile trying to get a channel. */
+struct Mobile {
+	double first;				///< time of the first attempt
+	RequestType type;
+	unsigned accessClass;
+	unsigned attempt;			///< the attempt that is waiting for an answer
+	bool done;
+};
+
+
+/** A grant or reject waiting for the AGCH. */
+struct Message {
+	unsigned mobile;
+	unsigned attempt;
+	double sent;				///< time of the RACH burst
+	int channel;				///< the SDCCH for a grant, -1 for a reject
+	unsigned waitTime;			///< T3122 for a reject, seconds
+};
+
+
+/** Results of one run. */
+struct Result {
+	unsigned completed[numTypes];
+	double delay[numTypes];
+	double maxDelay[numTypes];
+	unsigned attempts;
+	unsigned rejects;
+	unsigned barred;			///< attempts held back by access class barring
+	unsigned deferred;			///< SMS deferred after getting a channel
+	unsigned dropped;			///< grants and rejects dropped for age
+	double maxBacklog;
+	unsigned samplesAt[OverloadSevere+1];
+
+	Result()
+		:attempts(0),rejects(0),barred(0),deferred(0),dropped(0),maxBacklog(0)
+	{
+		for (unsigned i=0; i<numTypes; i++) completed[i]=0;
+		for (unsigned i=0; i<numTypes; i++) delay[i]=0;
+		for (unsigned i=0; i<numTypes; i++) maxDelay[i]=0;
+		for (unsigned i=0; i<=OverloadSevere; i++) samplesAt[i]=0;
+	}
+};
+
+
+/** Poisson arrivals; the rate is multiplied by surge from 20% to 50% of the run. */
+static vector<Mobile> makeMobiles(double surge, double seconds)
+{
+	vector<Mobile> mobiles;
+	double t = 0;
+	while (true) {
+		bool surging = t>0.2*seconds && t<0.5*seconds;
+		t -= log((random()+1.0)/(RAND_MAX+2.0)) / (surging ? normalRate*surge : normalRate);
+		if (t>=seconds) break;
+		Mobile m;
+		m.first = t;
+		unsigned pick = random()%100;
+		if (pick<60) m.type = LUR;
+		else if (pick<75) m.type = SMS;
+		else if (pick<95) m.type = Call;
+		else m.type = Emergency;
+		m.accessClass = random()%10;
+		m.attempt = 0;
+		m.done = false;
+		mobiles.push_back(m);
+	}
+	return mobiles;
+}
+
+
+/** Drop messages older than maxAge from the front of a queue. */
+static void clearStale(deque<Message>& q, double now, double maxAge, vector<double>& SDCCHFree, Result& result)
+{
+	while (q.size() && now-q.front().sent>maxAge) {
+		if (q.front().channel>=0) SDCCHFree[q.front().channel] = q.front().sent + T3101;
+		q.pop_front();
+		result.dropped++;
+	}
+}
+
+
+static Result run(vector<Mobile> mobiles, double seconds, double blocks, unsigned SDCCHs,
+	OverloadController* controller)
+{
+	Result result;
+	typedef multimap<double,unsigned> Agenda;
+	Agenda agenda;
+	for (unsigned i=0; i<mobiles.size(); i++) agenda.insert(Agenda::value_type(mobiles[i].first,i));
+	deque<Message> emergencyQ;
+	deque<Message> grantQ;
+	deque<Message> rejectQ;
+	// Time at which each SDCCH becomes free.
+	vector<double> SDCCHFree(SDCCHs,0);
+	const double QMax = gConfig.getNum("GSM.CCCH.AGCH.QMax");
+	const double maxAge = RACHMaxAge()*0.120/26;
+	const double period = gConfig.getNum("Control.Overload.Period")/1000.0;
+	// T3122 grows with each reject and shrinks with each grant, as in GSMConfig.
+	const double minT3122 = gConfig.getNum("GSM.Timer.T3122Min")/1000.0;
+	const double maxT3122 = gConfig.getNum("GSM.Timer.T3122Max")/1000.0;
+	double T3122 = minT3122;
+	double nextSample = period;
+	double budget = 0;
+	OverloadLevel level = OverloadNone;
+	unsigned T3122Scale = 1;
+	uint16_t barred = 0;
+	bool deferSMS = false;
+	bool rejectLUR = false;
+
+	for (double now=0; now<seconds; now+=step) {
+		// The AGCH load in blocks, as AccessGrantScheduler::load() counts it.
+		double backlog = emergencyQ.size() + grantQ.size() + (rejectQ.size()+3)/4;
+
+		// RACH bursts due now.
+		while (agenda.size() && agenda.begin()->first<=now) {
+			unsigned id = agenda.begin()->second;
+			agenda.erase(agenda.begin());
+			Mobile& m = mobiles[id];
+			if (m.done) continue;
+			if (m.type!=Emergency && (barred & (1<<m.accessClass))) {
+				// The mobile reads the barring on the BCCH and holds off.
+				result.barred++;
+				agenda.insert(Agenda::value_type(now+retryWait*(random()%100+50)/100.0,id));
+				continue;
+			}
+			result.attempts++;
+			m.attempt++;
+			// If nothing comes back in time, the mobile tries again later.
+			agenda.insert(Agenda::value_type(now+answerTimeout+retryWait,id));
+			Message msg = { id, m.attempt, now, -1, 0 };
+			bool reject = false;
+			if (m.type!=Emergency && backlog>QMax) reject = true;
+			if (m.type==LUR && rejectLUR) reject = true;
+			if (!reject) {
+				for (unsigned i=0; i<SDCCHs; i++) {
+					if (SDCCHFree[i]>now) continue;
+					msg.channel = i;
+					SDCCHFree[i] = now + seconds;
+					break;
+				}
+			}
+			if (msg.channel<0) {
+				// The wait indication, as rejectWaitTime() computes it.
+				msg.waitTime = (unsigned)T3122 * T3122Scale;
+				if (msg.waitTime>255) msg.waitTime = 255;
+				T3122 += T3122*(random()%100)/200.0;
+				if (T3122>maxT3122) T3122 = maxT3122;
+				rejectQ.push_back(msg);
+				continue;
+			}
+			T3122 -= T3122*(random()%100)/200.0;
+			if (T3122<minT3122) T3122 = minT3122;
+			if (m.type==Emergency) emergencyQ.push_back(msg);
+			else grantQ.push_back(msg);
+		}
+
+		// The AGCH sends what it can: grants first, then rejects four to a block.
+		clearStale(emergencyQ,now,maxAge,SDCCHFree,result);
+		clearStale(grantQ,now,maxAge,SDCCHFree,result);
+		clearStale(rejectQ,now,maxAge,SDCCHFree,result);
+		budget += blocks*step;
+		while (budget>=1) {
+			vector<Message> sent;
+			if (emergencyQ.size()) {
+				sent.push_back(emergencyQ.front());
+				emergencyQ.pop_front();
+			} else if (grantQ.size()) {
+				sent.push_back(grantQ.front());
+				grantQ.pop_front();
+			} else {
+				while (rejectQ.size() && sent.size()<4) {
+					sent.push_back(rejectQ.front());
+					rejectQ.pop_front();
+				}
+			}
+			if (sent.size()==0) {
+				budget = 1;
+				break;
+			}
+			budget -= 1;
+			for (unsigned i=0; i<sent.size(); i++) {
+				const Message& msg = sent[i];
+				Mobile& m = mobiles[msg.mobile];
+				if (msg.channel<0) {
+					result.rejects++;
+					if (m.done || msg.attempt!=m.attempt) continue;
+					// Supersede the timeout retry.
+					m.attempt++;
+					agenda.insert(Agenda::value_type(now+msg.waitTime,msg.mobile));
+					continue;
+				}
+				if (m.done || msg.attempt!=m.attempt) {
+					// The mobile has moved on; T3101 recovers the channel.
+					SDCCHFree[msg.channel] = msg.sent + T3101;
+					continue;
+				}
+				m.attempt++;
+				if (m.type==SMS && deferSMS) {
+					result.deferred++;
+					SDCCHFree[msg.channel] = now + 0.5;
+					agenda.insert(Agenda::value_type(now+SMSRetry,msg.mobile));
+					continue;
+				}
+				SDCCHFree[msg.channel] = now + holdTime[m.type];
+				m.done = true;
+				double delay = now - m.first;
+				result.completed[m.type]++;
+				result.delay[m.type] += delay;
+				if (delay>result.maxDelay[m.type]) result.maxDelay[m.type] = delay;
+			}
+		}
+		if (backlog>result.maxBacklog) result.maxBacklog = backlog;
+
+		// Sample the backlog, as the controller thread would.
+		if (now>=nextSample) {
+			nextSample += period;
+			if (controller) {
+				LoadSample sample;
+				sample.mAGCH = (unsigned)backlog;
+				level = controller->update(sample);
+				T3122Scale = controller->T3122Scale();
+				barred = controller->barredClasses();
+				deferSMS = controller->deferSMS();
+				rejectLUR = controller->rejectLUR();
+			}
+			result.samplesAt[level]++;
+		}
+	}
+	return result;
+}
+
+
+static void report(const char* name, const Result& r, double period)
+{
+	cout << name << ":" << endl;
+	cout << "  completed";
+	for (unsigned i=0; i<numTypes; i++) cout << " " << typeNames[i] << "=" << r.completed[i];
+	cout << endl;
+	cout << "  RACH attempts " << r.attempts << ", barred " << r.barred << ", rejects " << r.rejects
+		<< ", dropped " << r.dropped << ", SMS deferred " << r.deferred
+		<< ", max AGCH backlog " << r.maxBacklog << endl;
+	cout << fixed << setprecision(2);
+	for (unsigned i=Call; i<numTypes; i++) {
+		cout << "  " << typeNames[i] << " access delay mean "
+			<< (r.completed[i] ? r.delay[i]/r.completed[i] : 0.0)
+			<< " s, max " << r.maxDelay[i] << " s" << endl;
+	}
+	cout << "  seconds at level";
+	for (unsigned i=0; i<=OverloadSevere; i++) cout << " " << (OverloadLevel)i << "=" << r.samplesAt[i]*period;
+	cout << endl;
+	cout.unsetf(ios::floatfield);
+}
+
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc>1 ? atof(argv[1]) : 300;
+	double surge = argc>2 ? atof(argv[2]) : 40;
+	double blocks = argc>3 ? atof(argv[3]) : 12;
+	unsigned SDCCHs = argc>4 ? atoi(argv[4]) : 8;
+	double period = gConfig.getNum("Control.Overload.Period")/1000.0;
+
+	srandom(1);
+	vector<Mobile> mobiles = makeMobiles(surge,seconds);
+	cout << mobiles.size() << " mobiles over " << seconds << " s, surge " << surge << "x, "
+		<< blocks << " AGCH blocks/s, " << SDCCHs << " SDCCHs" << endl;
+
+	report("existing checks",run(mobiles,seconds,blocks,SDCCHs,NULL),period);
+	OverloadController controller;
+	report("overload control",run(mobiles,seconds,blocks,SDCCHs,&controller),period);
+	cout << "controller: ";
+	controller.dump(cout);
+	cout << endl;
+	return 0;
+}
+
+// vim: ts=4 sw=4
@@ -0,0 +1,232 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "OverloadControl.h"
+#include "TransactionTable.h"
+
+#include <GSMConfig.h>
+#include <TRXManager.h>
+#include <SIPInterface.h>
+#include <Logger.h>
+
+
+using namespace std;
+using namespace Control;
+
+
+extern TransceiverManager gTRX;
+
+
+
+ostream& Control::operator<<(ostream& os, const LoadSample& sample)
+{
+	os << "AGCH=" << sample.mAGCH << " RxLag=" << sample.mRxLag
+		<< " decode=" << sample.mDecodeDepth << " SIP=" << sample.mSIPBacklog
+		<< " transactions=" << sample.mTransactions;
+	return os;
+}
+
+
+ostream& Control::operator<<(ostream& os, OverloadLevel level)
+{
+	switch (level) {
+		case OverloadNone: os << "none"; break;
+		case OverloadLight: os << "light"; break;
+		case OverloadHeavy: os << "heavy"; break;
+		case OverloadSevere: os << "severe"; break;
+		default: os << "?" << (int)level << "?";
+	}
+	return os;
+}
+
+
+
+
+OverloadController::OverloadController()
+	:mRunning(false),
+	mLevel(OverloadNone),mCalm(0),mBarPhase(0),
+	mLastScore(0),mLastCause("none"),
+	mSamples(0),mRaises(0),mLowers(0)
+{
+	for (unsigned i=0; i<=OverloadSevere; i++) mSamplesAt[i]=0;
+}
+
+
+bool OverloadController::enabled() const
+{
+	return gConfig.defines("Control.Overload");
+}
+
+
+void OverloadController::start()
+{
+	if (!enabled()) return;
+	ScopedLock lock(mLock);
+	if (mRunning) return;
+	mRunning = true;
+	mThread.start((void*(*)(void*))OverloadControllerServiceLoopAdapter,this);
+}
+
+
+LoadSample OverloadController::sample() const
+{
+	LoadSample sample;
+	sample.mAGCH = gBTS.AGCHLoad() + gBTS.accessGrants().load();
+	ARFCNManager *radio = gTRX.ARFCN();
+	sample.mRxLag = radio->takeRxLag();
+	sample.mDecodeDepth = radio->decodePool().depth();
+	sample.mSIPBacklog = gSIPInterface.backlog();
+	sample.mTransactions = gTransactionTable.size();
+	return sample;
+}
+
+
+/** Ratio of an indicator to its threshold; a threshold of 0 ignores the indicator. */
+static float loadRatio(unsigned value, const char* key)
+{
+	long threshold = gConfig.getNum(key);
+	if (threshold<=0) return 0;
+	return (float)value / threshold;
+}
+
+
+float OverloadController::score(const LoadSample& sample, const char** cause) const
+{
+	struct { float ratio; const char* name; } ratios[] = {
+		{ loadRatio(sample.mAGCH,"Control.Overload.AGCH"), "AGCH" },
+		{ loadRatio(sample.mRxLag,"Control.Overload.RxLag"), "RxLag" },
+		{ loadRatio(sample.mDecodeDepth,"Control.Overload.DecodeDepth"), "decode" },
+		{ loadRatio(sample.mSIPBacklog,"Control.Overload.SIP"), "SIP" },
+		{ loadRatio(sample.mTransactions,"Control.Overload.Transactions"), "transactions" },
+	};
+	unsigned worst = 0;
+	for (unsigned i=1; i<sizeof(ratios)/sizeof(ratios[0]); i++) {
+		if (ratios[i].ratio>ratios[worst].ratio) worst=i;
+	}
+	if (cause) *cause = ratios[worst].ratio>0 ? ratios[worst].name : "none";
+	return ratios[worst].ratio;
+}
+
+
+OverloadLevel OverloadController::update(const LoadSample& sample)
+{
+	const char* cause;
+	float load = score(sample,&cause);
+	OverloadLevel target = OverloadNone;
+	if (load>=2.0F) target = OverloadSevere;
+	else if (load>=1.5F) target = OverloadHeavy;
+	else if (load>=1.0F) target = OverloadLight;
+	unsigned recovery = gConfig.getNum("Control.Overload.Recovery");
+
+	ScopedLock lock(mLock);
+	mSamples++;
+	mLast = sample;
+	mLastScore = load;
+	mLastCause = cause;
+	if (target>mLevel) {
+		if (mLevel<OverloadSevere && target==OverloadSevere) mNextRotation.future(barRotation);
+		mLevel = target;
+		mCalm = 0;
+		mRaises++;
+	} else if (target<mLevel) {
+		// Step down one level after a run of calmer samples.
+		mCalm++;
+		if (mCalm>=recovery) {
+			mLevel = (OverloadLevel)(mLevel-1);
+			mCalm = 0;
+			mLowers++;
+		}
+	} else {
+		mCalm = 0;
+	}
+	mSamplesAt[mLevel]++;
+	// Take turns barring each half of the normal classes,
+	// so that no mobile is locked out for the whole overload.
+	if (mLevel==OverloadSevere && mNextRotation.passed()) {
+		mBarPhase ^= 1;
+		mNextRotation.future(barRotation);
+	}
+	return mLevel;
+}
+
+
+OverloadLevel OverloadController::level() const
+{
+	ScopedLock lock(mLock);
+	return mLevel;
+}
+
+
+uint16_t OverloadController::barredClasses() const
+{
+	// Classes 0-9 are the normal classes, GSM 02.11 4.
+	// The special classes 11-15 and the emergency call bit are never touched.
+	ScopedLock lock(mLock);
+	if (mLevel<OverloadSevere) return 0;
+	return mBarPhase ? 0x03e0 : 0x001f;
+}
+
+
+void OverloadController::serviceLoop()
+{
+	while (true) {
+		msleep(gConfig.getNum("Control.Overload.Period"));
+		OverloadLevel previous = level();
+		LoadSample current = sample();
+		OverloadLevel now = update(current);
+		if (now!=previous) {
+			const char* cause;
+			float load = score(current,&cause);
+			LOG(WARNING) << "overload level " << now << " (was " << previous << "), score " << load
+				<< " from " << cause << ", " << current;
+		}
+		gBTS.barAccessClasses(barredClasses());
+	}
+}
+
+
+void *Control::OverloadControllerServiceLoopAdapter(OverloadController *controller)
+{
+	controller->serviceLoop();
+	return NULL;
+}
+
+
+void OverloadController::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "level " << mLevel << " score " << mLastScore << " (" << mLastCause << ")"
+		<< " raises " << mRaises << " lowers " << mLowers
+		<< " samples " << mSamples << " (";
+	for (unsigned i=0; i<=OverloadSevere; i++) {
+		if (i) os << "/";
+		os << mSamplesAt[i];
+	}
+	os << " by level), last " << mLast;
+}
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,171 @@
+/**@file Overload control from live queue depths. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef OVERLOADCONTROL_H
+#define OVERLOADCONTROL_H
+
+#include <stdint.h>
+#include <ostream>
+
+#include <Threads.h>
+#include <Timeval.h>
+
+
+namespace Control {
+
+
+/** One sample of the load indicators watched by the OverloadController. */
+class LoadSample {
+
+	public:
+
+	unsigned mAGCH;				///< access grants and rejects waiting for the AGCH
+	unsigned mRxLag;			///< worst delay of an uplink burst since the last sample, in frames
+	unsigned mDecodeDepth;		///< bursts waiting in the L1 decode pool
+	unsigned mSIPBacklog;		///< messages waiting in the SIP call FIFOs
+	unsigned mTransactions;		///< entries in the transaction table
+
+	LoadSample()
+		:mAGCH(0),mRxLag(0),mDecodeDepth(0),mSIPBacklog(0),mTransactions(0)
+	{ }
+};
+
+std::ostream& operator<<(std::ostream&, const LoadSample&);
+
+
+/** Graded overload levels.  Each level keeps the responses of the levels below it. */
+enum OverloadLevel {
+	OverloadNone,		///< normal service
+	OverloadLight,		///< longer T3122, SMS deferred
+	OverloadHeavy,		///< location updates rejected at the RACH
+	OverloadSevere		///< half of the normal access classes barred on the BCCH
+};
+
+std::ostream& operator<<(std::ostream&, OverloadLevel);
+
+
+/**
+	Admission throttling from the depths of the internal queues.
+
+	Each indicator is divided by its threshold from the configuration and
+	the worst ratio is the load score.  A score of 1 is light overload,
+	1.5 heavy and 2 severe.  The level goes up as soon as a sample calls
+	for it, and comes down one step at a time, after a run of calmer samples,
+	so that the responses do not flap.
+
+	The RACH, MM and SIP code ask the controller how to respond;
+	the service thread only samples and, at the severe level,
+	updates the access class barring on the BCCH.
+	While the controller is disabled, the level stays at OverloadNone.
+*/
+class OverloadController {
+
+	private:
+
+	/** How long one half of the normal access classes stays barred, in ms. */
+	static const unsigned barRotation = 30000;
+
+	mutable Mutex mLock;
+	Thread mThread;
+	bool mRunning;
+
+	OverloadLevel mLevel;
+	unsigned mCalm;				///< samples in a row calling for a lower level
+	unsigned mBarPhase;			///< 0 bars access classes 0-4, 1 bars 5-9
+	Timeval mNextRotation;		///< when to bar the other half
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	LoadSample mLast;			///< the latest sample
+	float mLastScore;
+	const char* mLastCause;		///< the indicator with the worst ratio
+	unsigned long mSamples;
+	unsigned long mSamplesAt[OverloadSevere+1];
+	unsigned long mRaises;
+	unsigned long mLowers;
+	//@}
+
+	public:
+
+	OverloadController();
+
+	/** Return true if overload control is configured. */
+	bool enabled() const;
+
+	/** Start the sampling thread, if enabled. */
+	void start();
+
+	/** Read the live indicators from the BTS. */
+	LoadSample sample() const;
+
+	/**
+		Compute the load score of a sample.
+		@param sample The indicators.
+		@param cause If not NULL, set to the name of the worst indicator.
+	*/
+	float score(const LoadSample& sample, const char** cause=NULL) const;
+
+	/**
+		Feed a sample to the controller.
+		The service thread calls this with live samples; tests can inject their own.
+		@return The new level.
+	*/
+	OverloadLevel update(const LoadSample& sample);
+
+	/**@name The graded responses. */
+	//@{
+	/** The current level. */
+	OverloadLevel level() const;
+	/** Multiplier for the T3122 wait indication in RACH rejects. */
+	unsigned T3122Scale() const { return 1 << level(); }
+	/** Return true if new SMS transfers should be deferred. */
+	bool deferSMS() const { return level()>=OverloadLight; }
+	/** Return true if location updating requests should be rejected at the RACH. */
+	bool rejectLUR() const { return level()>=OverloadHeavy; }
+	/** The access classes to bar on the BCCH, bit i for class i. */
+	uint16_t barredClasses() const;
+	//@}
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+
+	private:
+
+	/** The sampling loop. */
+	void serviceLoop();
+
+	friend void *OverloadControllerServiceLoopAdapter(OverloadController*);
+};
+
+void *OverloadControllerServiceLoopAdapter(OverloadController*);
+
+
+};	// namespace Control
+
+
+#endif
+// vim: ts=4 sw=4
@@ -0,0 +1,279 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+	Synthetic MT paging load benchmark.
+
+	MT pages arrive as a Poisson process, some of them for mobiles that
+	have a TMSI.  Each multiframe, the paging blocks are filled from the
+	pager, as the PCH service loop would do.  A mobile in DRX only hears
+	a page sent in a block of its own paging subchannel, so that is when
+	it counts as delivered and is removed from the pager.
+
+	The same arrivals are run through a model of the old pager, which
+	sent Type 1 requests in FIFO order on one PCH, each one twice,
+	with no regard to paging groups.
+
+	The benchmark reports delivered pages per second, the mean and worst
+	paging delay, and the mobiles still waiting at the end, for each rate.
+
+	usage: PagingBench [seconds] [TMSI%] [rate...]
+		rate	offered MT pages per second
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <Configuration.h>
+
+#include <TRXManager.h>
+#include <GSMConfig.h>
+#include <GSML3RRMessages.h>
+
+#include "ControlCommon.h"
+#include "TransactionTable.h"
+#include "SMSSpool.h"
+#include "RadioResource.h"
+
+#include <SIPInterface.h>
+#include <Globals.h>
+
+#include <Logger.h>
+#include <PhysicalStatus.h>
+#include <SubscriberRegistry.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+using namespace Control;
+
+
+/** Length of a 51-multiframe in seconds. */
+static const double MFSeconds = 51*0.120/26;
+
+
+/** One synthetic MT page. */
+struct Arrival {
+	double time;				///< arrival time, seconds
+	L3MobileIdentity IMSI;
+	L3MobileIdentity ID;		///< the ID given to the pager, IMSI or TMSI
+	unsigned subchannel;		///< the paging subchannel of the mobile
+};
+
+
+/** Delivery statistics for one run. */
+struct Result {
+	unsigned delivered;
+	double totalDelay;
+	double maxDelay;
+	unsigned waiting;
+	unsigned long IDsSent;		///< IDs sent on the PCH, including repeats
+	unsigned long blocks;		///< paging blocks sent
+
+	Result()
+		:delivered(0),totalDelay(0),maxDelay(0),waiting(0),IDsSent(0),blocks(0)
+	{}
+
+	void deliver(double delay)
+	{
+		delivered++;
+		totalDelay += delay;
+		if (delay>maxDelay) maxDelay=delay;
+	}
+};
+
+
+/** Make Poisson arrivals at a given rate, with a fraction having TMSIs. */
+static vector<Arrival> makeArrivals(double rate, double seconds, unsigned TMSIPercent, const Pager& pager)
+{
+	vector<Arrival> arrivals;
+	double t = 0;
+	unsigned serial = 0;
+	while (true) {
+		t -= log((random()+1.0)/(RAND_MAX+2.0)) / rate;
+		if (t>=seconds) break;
+		char digits[16];
+		sprintf(digits,"00101%010u",(unsigned)random() % 1000000000U);
+		Arrival a;
+		a.time = t;
+		a.IMSI = L3MobileIdentity(digits);
+		if ((unsigned)(random()%100) < TMSIPercent) a.ID = L3MobileIdentity(0x10000000 + serial++);
+		else a.ID = a.IMSI;
+		a.subchannel = pager.subchannel(digits);
+		arrivals.push_back(a);
+	}
+	return arrivals;
+}
+
+
+/** Run the arrivals through the real pager. */
+static Result runPager(Pager& pager, const vector<Arrival>& arrivals, double seconds)
+{
+	Result result;
+	typedef map<L3MobileIdentity,pair<const Arrival*,TransactionEntry*> > PendingMap;
+	PendingMap pending;
+	string proxy = gConfig.getStr("SIP.Proxy.SMS");
+	unsigned next = 0;
+	unsigned blocks = pager.pagingBlocks();
+	unsigned numMF = (unsigned)(seconds/MFSeconds);
+	for (unsigned mf=0; mf<numMF; mf++) {
+		double now = mf*MFSeconds;
+		while (next<arrivals.size() && arrivals[next].time<=now) {
+			const Arrival& a = arrivals[next++];
+			TransactionEntry *transaction = new TransactionEntry(proxy.c_str(),a.IMSI,NULL,
+				L3CMServiceType::MobileTerminatedShortMessage,0);
+			pager.addID(a.ID,SDCCHType,*transaction,1000*(unsigned)(2*seconds));
+			pending[a.ID] = pair<const Arrival*,TransactionEntry*>(&a,transaction);
+		}
+		for (unsigned b=0; b<blocks; b++) {
+			unsigned sub = pager.subchannel(b,Time(mf*51));
+			vector<L3MobileIdentity> paged;
+			L3RRMessage *msg = pager.nextPage(sub,&paged);
+			if (!msg) continue;
+			delete msg;
+			result.blocks++;
+			result.IDsSent += paged.size();
+			for (unsigned i=0; i<paged.size(); i++) {
+				PendingMap::iterator p = pending.find(paged[i]);
+				assert(p!=pending.end());
+				if (p->second.first->subchannel!=sub) continue;
+				result.deliver(now - p->second.first->time);
+				pager.removeID(paged[i]);
+				delete p->second.second;
+				pending.erase(p);
+			}
+		}
+	}
+	result.waiting = pending.size();
+	for (PendingMap::iterator p=pending.begin(); p!=pending.end(); ++p) {
+		pager.removeID(p->first);
+		delete p->second.second;
+	}
+	return result;
+}
+
+
+/**
+	Run the arrivals through a model of the old pager.
+	When the PCH queue runs dry, all waiting IDs are paged by pairs,
+	each message sent twice, and the PCH sends one block per multiframe.
+*/
+static Result runLegacy(const Pager& pager, const vector<Arrival>& arrivals, double seconds)
+{
+	Result result;
+	list<const Arrival*> waiting;
+	list< vector<list<const Arrival*>::iterator> > PCHQueue;
+	unsigned next = 0;
+	unsigned numMF = (unsigned)(seconds/MFSeconds);
+	for (unsigned mf=0; mf<numMF; mf++) {
+		double now = mf*MFSeconds;
+		while (next<arrivals.size() && arrivals[next].time<=now) waiting.push_back(&arrivals[next++]);
+		if (PCHQueue.size()==0) {
+			list<const Arrival*>::iterator lp = waiting.begin();
+			while (lp!=waiting.end()) {
+				vector<list<const Arrival*>::iterator> msg;
+				msg.push_back(lp++);
+				if (lp!=waiting.end()) msg.push_back(lp++);
+				PCHQueue.push_back(msg);
+				PCHQueue.push_back(msg);
+			}
+		}
+		if (PCHQueue.size()==0) continue;
+		vector<list<const Arrival*>::iterator> msg = PCHQueue.front();
+		PCHQueue.pop_front();
+		result.blocks++;
+		// The old pager used a single PCH block, which is paging block 0.
+		unsigned sub = pager.subchannel(0,Time(mf*51));
+		for (unsigned i=0; i<msg.size(); i++) {
+			// Delivered entries were already erased; their repeats are marked NULL.
+			if (*msg[i]==NULL) continue;
+			result.IDsSent++;
+			if ((*msg[i])->subchannel!=sub) continue;
+			result.deliver(now - (*msg[i])->time);
+			*msg[i] = NULL;
+		}
+		// Drop delivered entries once no queued message refers to them.
+		if (PCHQueue.size()==0) waiting.remove(NULL);
+	}
+	waiting.remove(NULL);
+	result.waiting = waiting.size();
+	return result;
+}
+
+
+static void report(const char* name, double rate, double seconds, const Result& r)
+{
+	cout << setw(8) << name
+		<< setw(8) << fixed << setprecision(2) << rate
+		<< setw(10) << r.delivered/seconds
+		<< setw(10) << (r.delivered ? r.totalDelay/r.delivered : 0.0)
+		<< setw(10) << r.maxDelay
+		<< setw(9) << r.waiting
+		<< setw(10) << (r.blocks ? (double)r.IDsSent/r.blocks : 0.0)
+		<< endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc>1 ? atof(argv[1]) : 600;
+	unsigned TMSIPercent = argc>2 ? atoi(argv[2]) : 50;
+	vector<double> rates;
+	for (int i=3; i<argc; i++) rates.push_back(atof(argv[i]));
+	if (rates.size()==0) {
+		rates.push_back(1);
+		rates.push_back(2);
+		rates.push_back(4);
+		rates.push_back(8);
+		rates.push_back(12);
+	}
+
+	// Use the pager in gBTS so that the paging parameters come from the BCCH description.
+	Pager& pager = gBTS.pager();
+	pager.start();
+
+	cout << "paging subchannels: " << pager.numSubchannels()
+		<< ", TMSI fraction: " << TMSIPercent << "%, " << seconds << " s per run" << endl;
+	cout << setw(8) << "pager" << setw(8) << "offered" << setw(10) << "delivered"
+		<< setw(10) << "meanDelay" << setw(10) << "maxDelay" << setw(9) << "waiting"
+		<< setw(10) << "IDs/block" << endl;
+	for (unsigned i=0; i<rates.size(); i++) {
+		srandom(i+1);
+		vector<Arrival> arrivals = makeArrivals(rates[i],seconds,TMSIPercent,pager);
+		report("legacy",rates[i],seconds,runLegacy(pager,arrivals,seconds));
+		report("DRX",rates[i],seconds,runPager(pager,arrivals,seconds));
+	}
+	pager.dumpStats(cout);
+	return 0;
+}
+
+// vim: ts=4 sw=4
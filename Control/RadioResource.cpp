@@ -31,7 +31,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <list>
+#include <vector>
+#include <algorithm>
 
 #include "ControlCommon.h"
 #include "TransactionTable.h"
@@ -113,6 +116,27 @@ ChannelType decodeChannelNeeded(unsigned RA)
 }
 
 
+AccessGrantPriority Control::RACHPriority(unsigned RA)
+{
+	// GSM 04.08 Table 9.9.
+	if ((RA>>5) == 0x05) return EmergencyPriority;
+	// Answer to paging, Table 9.9a, same order as decodeChannelNeeded.
+	if ((RA>>5) == 0x04) return PagingResponsePriority;
+	unsigned RA4 = RA>>4;
+	if ((RA4>=0x01) && (RA4<=0x03)) return PagingResponsePriority;
+	return NormalPriority;
+}
+
+
+int Control::RACHMaxAge()
+{
+	// See GSM 04.08 3.3.1.1.2 for the logic here.
+	static const unsigned txInteger = gConfig.getNum("GSM.RACH.TxInteger");
+	static const int maxAge = GSM::RACHSpreadSlots[txInteger] + GSM::RACHWaitSParam[txInteger];
+	return maxAge;
+}
+
+
 /** Return true if RA indicates LUR. */
 bool requestingLUR(unsigned RA)
 {
@@ -125,6 +149,16 @@ bool requestingLUR(unsigned RA)
 
 
 
+/** The T3122 wait indication for a reject, in seconds, stretched under overload. */
+static unsigned rejectWaitTime()
+{
+	unsigned waitTime = gBTS.growT3122()/1000 * gBTS.overload().T3122Scale();
+	// The IE is one octet, GSM 04.08 10.5.2.43.
+	if (waitTime>255) waitTime=255;
+	return waitTime;
+}
+
+
 /** Decode RACH bits and send an immediate assignment; may block waiting for a channel. */
 void AccessGrantResponder(
 		unsigned RA, const GSM::Time& when,
@@ -146,9 +180,7 @@ void AccessGrantResponder(
 
 	// Check "when" against current clock to see if we're too late.
 	// Calculate maximum number of frames of delay.
-	// See GSM 04.08 3.3.1.1.2 for the logic here.
-	static const unsigned txInteger = gConfig.getNum("GSM.RACH.TxInteger");
-	static const int maxAge = GSM::RACHSpreadSlots[txInteger] + GSM::RACHWaitSParam[txInteger];
+	const int maxAge = RACHMaxAge();
 	// Check burst age.
 	int age = gBTS.time() - when;
 	LOG(INFO) << "RA=0x" << hex << RA << dec
@@ -167,13 +199,17 @@ void AccessGrantResponder(
 		return;
 	}
 
-	// Get an AGCH to send on.
-	CCCHLogicalChannel *AGCH = gBTS.getAGCH();
-	// Someone had better have created a least one AGCH.
-	assert(AGCH);
+	// The AGCH scheduler sends our messages.
+	AccessGrantScheduler& AGCH = gBTS.accessGrants();
+	AccessGrantPriority priority = RACHPriority(RA);
+
 	// Check AGCH load now.
-	if (AGCH->load()>gConfig.getNum("GSM.CCCH.AGCH.QMax")) {
-		LOG(WARNING) << "AGCH congestion";
+	// Under congestion, only emergency calls and paging responses get channels.
+	// Everyone else gets a reject, which costs a quarter of a block.
+	if ((priority==NormalPriority) && (AGCH.load()>(unsigned)gConfig.getNum("GSM.CCCH.AGCH.QMax"))) {
+		unsigned waitTime = rejectWaitTime();
+		LOG(WARNING) << "AGCH congestion, RA=" << RA << " T3122=" << waitTime;
+		AGCH.reject(RA,when,waitTime,true);
 		return;
 	}
 
@@ -181,11 +217,16 @@ void AccessGrantResponder(
 	// This gives LUR a lower priority than other services.
 	if (requestingLUR(RA)) {
 		if (gBTS.SDCCHAvailable()<=gConfig.getNum("GSM.CCCH.PCH.Reserve")) {
-			unsigned waitTime = gBTS.growT3122()/1000;
+			unsigned waitTime = rejectWaitTime();
 			LOG(WARNING) << "LUR congestion, RA=" << RA << " T3122=" << waitTime;
-			const L3ImmediateAssignmentReject reject(L3RequestReference(RA,when),waitTime);
-			LOG(DEBUG) << "LUR rejection, sending " << reject;
-			AGCH->send(reject);
+			AGCH.reject(RA,when,waitTime);
+			return;
+		}
+		// Under heavy overload, registrations wait so that calls still get through.
+		if (gBTS.overload().rejectLUR()) {
+			unsigned waitTime = rejectWaitTime();
+			LOG(NOTICE) << "LUR rejected under overload, RA=" << RA << " T3122=" << waitTime;
+			AGCH.reject(RA,when,waitTime);
 			return;
 		}
 	}
@@ -215,11 +256,9 @@ void AccessGrantResponder(
 		// Rejection, GSM 04.08 3.3.1.1.3.2.
 		// But since we recognize SOS calls already,
 		// we might as well save some AGCH bandwidth.
-		unsigned waitTime = gBTS.growT3122()/1000;
+		unsigned waitTime = rejectWaitTime();
 		LOG(WARNING) << "congestion, RA=" << RA << " T3122=" << waitTime;
-		const L3ImmediateAssignmentReject reject(L3RequestReference(RA,when),waitTime);
-		LOG(DEBUG) << "rejection, sending " << reject;
-		AGCH->send(reject);
+		AGCH.reject(RA,when,waitTime);
 		return;
 	}
 
@@ -241,7 +280,7 @@ void AccessGrantResponder(
 		L3TimingAdvance(initialTA)
 	);
 	LOG(INFO) << "sending " << assign;
-	AGCH->send(assign);
+	AGCH.grant(assign,when,priority);
 
 	// On successful allocation, shrink T3122.
 	gBTS.shrinkT3122();
@@ -249,16 +288,33 @@ void AccessGrantResponder(
 
 
 
+/** Order channel requests by priority class. */
+static bool higherPriority(const ChannelRequestRecord* a, const ChannelRequestRecord* b)
+{
+	return RACHPriority(a->RA()) < RACHPriority(b->RA());
+}
+
+
 void* Control::AccessGrantServiceLoop(void*)
 {
+	vector<ChannelRequestRecord*> reqs;
 	while (true) {
 		ChannelRequestRecord *req = gBTS.nextChannelRequest();
 		if (!req) continue;
-		AccessGrantResponder(
-			req->RA(), req->frame(),
-			req->RSSI(), req->timingError()
-		);
-		delete req;
+		// Take everything else that is waiting, too,
+		// so that a RACH storm cannot hold up emergency calls and paging responses.
+		reqs.clear();
+		reqs.push_back(req);
+		while ((req = gBTS.nextChannelRequestNoBlock())) reqs.push_back(req);
+		stable_sort(reqs.begin(),reqs.end(),higherPriority);
+		for (unsigned i=0; i<reqs.size(); i++) {
+			req = reqs[i];
+			AccessGrantResponder(
+				req->RA(), req->frame(),
+				req->RSSI(), req->timingError()
+			);
+			delete req;
+		}
 	}
 	return NULL;
 }
@@ -266,6 +322,137 @@ void* Control::AccessGrantServiceLoop(void*)
 
 
 
+AccessGrantScheduler::AccessGrantScheduler()
+	:mRejectWait(0),mRunning(false),
+	mBlocks(0),mBusyBlocks(0),
+	mRejectMessages(0),mRejectsSent(0),
+	mStaleGrants(0),mStaleRejects(0),mCongestionRejects(0),
+	mMaxLoad(0)
+{
+	for (unsigned i=0; i<numAccessGrantPriorities; i++) mGrantsSent[i]=0;
+}
+
+
+void AccessGrantScheduler::start()
+{
+	if (mRunning) return;
+	mRunning=true;
+	for (unsigned i=0; i<gBTS.numAGCHs(); i++) gBTS.getAGCH(i)->addSource(this);
+}
+
+
+void AccessGrantScheduler::grant(const L3RRMessage& msg, const Time& when, AccessGrantPriority priority)
+{
+	L3Frame *frame = new L3Frame((const L3Message&)msg,UNIT_DATA);
+	ScopedLock lock(mLock);
+	mGrants[priority].push_back(AccessGrantEntry(frame,when));
+	size_t current = load();
+	if (current>mMaxLoad) mMaxLoad=current;
+}
+
+
+void AccessGrantScheduler::reject(unsigned RA, const Time& when, unsigned waitTime, bool congestion)
+{
+	ScopedLock lock(mLock);
+	mRejects.push_back(AccessRejectEntry(RA,when));
+	// All of the references in a message share one wait indication.
+	if (waitTime>mRejectWait) mRejectWait=waitTime;
+	if (congestion) mCongestionRejects++;
+	size_t current = load();
+	if (current>mMaxLoad) mMaxLoad=current;
+}
+
+
+size_t AccessGrantScheduler::load() const
+{
+	ScopedLock lock(mLock);
+	size_t retVal = (mRejects.size()+3)/4;
+	for (unsigned i=0; i<numAccessGrantPriorities; i++) retVal += mGrants[i].size();
+	return retVal;
+}
+
+
+void AccessGrantScheduler::clearStale(const Time& now)
+{
+	const int maxAge = RACHMaxAge();
+	for (unsigned i=0; i<numAccessGrantPriorities; i++) {
+		list<AccessGrantEntry>::iterator gp = mGrants[i].begin();
+		while (gp!=mGrants[i].end()) {
+			if ((now - gp->when()) <= maxAge) ++gp;
+			else {
+				// The channel was allocated, but T3101 will recover it.
+				LOG(NOTICE) << "dropping stale assignment " << *(gp->frame());
+				delete gp->frame();
+				gp = mGrants[i].erase(gp);
+				mStaleGrants++;
+			}
+		}
+	}
+	list<AccessRejectEntry>::iterator rp = mRejects.begin();
+	while (rp!=mRejects.end()) {
+		if ((now - rp->when()) <= maxAge) ++rp;
+		else {
+			LOG(INFO) << "dropping stale reject RA=" << rp->RA();
+			rp = mRejects.erase(rp);
+			mStaleRejects++;
+		}
+	}
+	if (mRejects.size()==0) mRejectWait=0;
+}
+
+
+L3Frame* AccessGrantScheduler::CCCHFrame(const CCCHLogicalChannel* AGCH, const Time& when)
+{
+	ScopedLock lock(mLock);
+	mBlocks++;
+	clearStale(when);
+
+	// Assignments first, by priority.
+	for (unsigned i=0; i<numAccessGrantPriorities; i++) {
+		if (mGrants[i].size()==0) continue;
+		L3Frame *frame = mGrants[i].front().frame();
+		mGrants[i].pop_front();
+		mGrantsSent[i]++;
+		mBusyBlocks++;
+		return frame;
+	}
+
+	// Then rejects, four to a message, GSM 04.08 9.1.20.
+	if (mRejects.size()==0) return NULL;
+	const AccessRejectEntry& first = mRejects.front();
+	L3ImmediateAssignmentReject reject(L3RequestReference(first.RA(),first.when()),mRejectWait);
+	mRejects.pop_front();
+	while (mRejects.size()) {
+		const AccessRejectEntry& next = mRejects.front();
+		if (!reject.addRequestReference(L3RequestReference(next.RA(),next.when()))) break;
+		mRejects.pop_front();
+	}
+	if (mRejects.size()==0) mRejectWait=0;
+	mRejectMessages++;
+	mRejectsSent += reject.size();
+	mBusyBlocks++;
+	LOG(DEBUG) << "sending " << reject;
+	return new L3Frame((const L3Message&)reject,UNIT_DATA);
+}
+
+
+void AccessGrantScheduler::dumpStats(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "AGCH blocks: " << mBlocks << ", busy: " << mBusyBlocks;
+	if (mBlocks) os << " (" << (100*mBusyBlocks)/mBlocks << "%)";
+	os << ", waiting: " << load() << ", max waiting: " << mMaxLoad << endl;
+	os << "AGCH assignments: emergency " << mGrantsSent[EmergencyPriority]
+		<< " paging " << mGrantsSent[PagingResponsePriority]
+		<< " normal " << mGrantsSent[NormalPriority]
+		<< ", stale " << mStaleGrants << endl;
+	os << "AGCH rejects: " << mRejectsSent << " in " << mRejectMessages << " messages"
+		<< ", congestion " << mCongestionRejects << ", stale " << mStaleRejects << endl;
+}
+
+
+
+
 
 void Control::PagingResponseHandler(const L3PagingResponse* resp, LogicalChannel* DCCH)
 {
@@ -369,29 +556,51 @@ void Control::AssignmentCompleteHandler(const L3AssignmentComplete *confirm, TCH
 
 
 
+Pager::Pager()
+	:mSubchannels(2),
+	mRunning(false),
+	mBlocks(1),mMFRMS(1),
+	mBlocksServed(0),mIDsPaged(0)
+{
+	for (int i=0; i<4; i++) mMessages[i]=0;
+}
+
+
 void Pager::addID(const L3MobileIdentity& newID, ChannelType chanType,
 		TransactionEntry& transaction, unsigned wLife)
 {
 	transaction.GSMState(GSM::Paging);
-	transaction.setTimer("3113",wLife);
+	transaction.setTimer(TransactionEntry::T3113,wLife);
 	// Add a mobile ID to the paging list for a given lifetime.
 	ScopedLock lock(mLock);
 	// If this ID is already in the list, just reset its timer.
-	// Uhg, another linear time search.
-	// This would be faster if the paging list were ordered by ID.
-	// But the list should usually be short, so it may not be worth the effort.
-	for (PagingEntryList::iterator lp = mPageIDs.begin(); lp != mPageIDs.end(); ++lp) {
-		if (lp->ID()==newID) {
-			LOG(DEBUG) << newID << " already in table";
-			lp->renew(wLife);
-			mPageSignal.signal();
-			return;
-		}
+	PagingEntryIndex::iterator ip = mIndex.find(newID);
+	if (ip!=mIndex.end()) {
+		LOG(DEBUG) << newID << " already in table";
+		ip->second->renew(wLife);
+		return;
+	}
+
+	// Find the paging subchannel.
+	// A mobile we only know by TMSI is paged in every paging block.
+	unsigned sub = numSubchannels();
+	const char *IMSI = NULL;
+	if (newID.type()==IMSIType) IMSI = newID.digits();
+	else if (transaction.subscriber().type()==IMSIType) IMSI = transaction.subscriber().digits();
+	if (IMSI) sub = subchannel(IMSI);
+
+	// Page by TMSI if the handset has been given one.
+	L3MobileIdentity pagedID = newID;
+	if ((newID.type()==IMSIType) && gConfig.defines("Control.LUR.SendTMSIs")) {
+		unsigned TMSI = gTMSITable.TMSI(newID.digits());
+		if (TMSI) pagedID = L3MobileIdentity(TMSI);
 	}
+
 	// If this ID is new, put it in the list.
-	mPageIDs.push_back(PagingEntry(newID,chanType,transaction.ID(),wLife));
-	LOG(INFO) << newID << " added to table";
-	mPageSignal.signal();
+	PagingEntryList& list = mSubchannels[sub];
+	list.push_back(PagingEntry(newID,pagedID,chanType,transaction.ID(),sub,wLife));
+	mIndex[newID] = --list.end();
+	LOG(INFO) << newID << " added to table, paging subchannel " << sub;
 }
 
 
@@ -400,123 +609,194 @@ unsigned Pager::removeID(const L3MobileIdentity& delID)
 	// Return the associated transaction ID, or 0 if none found.
 	LOG(INFO) << delID;
 	ScopedLock lock(mLock);
-	for (PagingEntryList::iterator lp = mPageIDs.begin(); lp != mPageIDs.end(); ++lp) {
-		if (lp->ID()==delID) {
-			unsigned retVal = lp->transactionID();
-			mPageIDs.erase(lp);
-			return retVal;
-		}
-	}
-	return 0;
+	PagingEntryIndex::iterator ip = mIndex.find(delID);
+	if (ip==mIndex.end()) return 0;
+	PagingEntryList::iterator lp = ip->second;
+	unsigned retVal = lp->transactionID();
+	mSubchannels[lp->subchannel()].erase(lp);
+	mIndex.erase(ip);
+	return retVal;
 }
 
 
+unsigned Pager::subchannel(const char* IMSI) const
+{
+	// GSM 05.02 6.5.2: PAGING_GROUP = (IMSI mod 1000) mod N,
+	// with only one CCCH.  Only the last three digits matter.
+	size_t len = strlen(IMSI);
+	unsigned IMSImod1000 = atoi(len>3 ? IMSI+len-3 : IMSI);
+	return IMSImod1000 % numSubchannels();
+}
 
-unsigned Pager::pageAll()
+
+unsigned Pager::subchannel(unsigned block, const Time& when) const
 {
-	// Traverse the full list and page all IDs.
-	// Remove expired IDs.
-	// Return the number of IDs paged.
-	// This is a linear time operation.
+	// GSM 05.02 6.5.2: The paging groups are spread over
+	// BS_PA_MFRMS multiframes with mBlocks groups in each.
+	return ((when.FN()/51) % mMFRMS)*mBlocks + block;
+}
 
-	ScopedLock lock(mLock);
 
-	// Clear expired entries.
-	PagingEntryList::iterator lp = mPageIDs.begin();
-	while (lp != mPageIDs.end()) {
+void Pager::clearExpired(unsigned sub)
+{
+	PagingEntryList& list = mSubchannels[sub];
+	PagingEntryList::iterator lp = list.begin();
+	while (lp != list.end()) {
 		if (!lp->expired()) ++lp;
 		else {
 			LOG(INFO) << "erasing " << lp->ID();
 			// Non-responsive, dead transaction?
 			gTransactionTable.removePaging(lp->transactionID());
 			// remove from the list
-			lp=mPageIDs.erase(lp);
+			mIndex.erase(lp->ID());
+			lp=list.erase(lp);
 		}
 	}
+}
 
-	LOG(INFO) << "paging " << mPageIDs.size() << " mobile(s)";
-
-	// Page remaining entries, two at a time if possible.
-	// These PCH send operations are non-blocking.
-	lp = mPageIDs.begin();
-	while (lp != mPageIDs.end()) {
-		// FIXME -- This completely ignores the paging groups.
-		// HACK -- So we send every page twice.
-		// That will probably mean a different Pager for each subchannel.
-		// See GSM 04.08 10.5.2.11 and GSM 05.02 6.5.2.
-		const L3MobileIdentity& id1 = lp->ID();
-		ChannelType type1 = lp->type();
-		++lp;
-		if (lp==mPageIDs.end()) {
-			// Just one ID left?
-			LOG(DEBUG) << "paging " << id1;
-			gBTS.getPCH(0)->send(L3PagingRequestType1(id1,type1));
-			gBTS.getPCH(0)->send(L3PagingRequestType1(id1,type1));
-			break;
+
+L3RRMessage* Pager::nextPage(unsigned sub, vector<L3MobileIdentity>* paged)
+{
+	ScopedLock lock(mLock);
+	mBlocksServed++;
+
+	// The last list holds mobiles with unknown paging subchannel.
+	const unsigned any = numSubchannels();
+	assert(sub<any);
+	clearExpired(sub);
+	clearExpired(any);
+
+	// Pick candidates in queue order, with this subchannel ahead of the unknowns.
+	// The first entry in the queue always gets paged, so nobody is starved.
+	vector<PagingEntryList::iterator> firsts;	// first 2 of any kind
+	vector<PagingEntryList::iterator> TMSIs;	// first 4 paged by TMSI
+	vector<PagingEntryList::iterator> others;	// first 1 paged by IMSI
+	for (unsigned l=0; l<2; l++) {
+		PagingEntryList& list = mSubchannels[l==0 ? sub : any];
+		for (PagingEntryList::iterator lp=list.begin(); lp!=list.end(); ++lp) {
+			if (firsts.size()<2) firsts.push_back(lp);
+			if (lp->pagedID().type()==TMSIType) {
+				if (TMSIs.size()<4) TMSIs.push_back(lp);
+			} else {
+				if (others.size()<1) others.push_back(lp);
+			}
+			if (TMSIs.size()==4 && others.size()==1) break;
 		}
-		// Page by pairs when possible.
-		const L3MobileIdentity& id2 = lp->ID();
-		ChannelType type2 = lp->type();
-		++lp;
-		LOG(DEBUG) << "paging " << id1 << " and " << id2;
-		gBTS.getPCH(0)->send(L3PagingRequestType1(id1,type1,id2,type2));
-		gBTS.getPCH(0)->send(L3PagingRequestType1(id1,type1,id2,type2));
+	}
+	if (firsts.size()==0) return NULL;
+
+	// Pack as many IDs as will fit, GSM 04.08 9.1.22-9.1.24.
+	// Type 3: 4 TMSIs.  Type 2: 2 TMSIs and any ID.  Type 1: 2 IDs of any kind.
+	vector<PagingEntryList::iterator> sent;
+	L3RRMessage *msg;
+	bool headIsTMSI = firsts[0]->pagedID().type()==TMSIType;
+	if (headIsTMSI && TMSIs.size()==4) {
+		L3MobileIdentity IDs[4];
+		for (unsigned i=0; i<4; i++) IDs[i] = TMSIs[i]->pagedID();
+		msg = new L3PagingRequestType3(IDs,TMSIs[0]->type(),TMSIs[1]->type());
+		sent = TMSIs;
+		mMessages[3]++;
+	} else if (TMSIs.size()+others.size()>=3) {
+		// Here, there are at least 2 TMSIs and the head of the queue is one of the 3.
+		PagingEntryList::iterator third = others.size() ? others[0] : TMSIs[2];
+		msg = new L3PagingRequestType2(TMSIs[0]->pagedID(),TMSIs[0]->type(),
+			TMSIs[1]->pagedID(),TMSIs[1]->type(),third->pagedID());
+		sent.push_back(TMSIs[0]);
+		sent.push_back(TMSIs[1]);
+		sent.push_back(third);
+		mMessages[2]++;
+	} else if (firsts.size()==1) {
+		msg = new L3PagingRequestType1(firsts[0]->pagedID(),firsts[0]->type());
+		sent = firsts;
+		mMessages[1]++;
+	} else {
+		msg = new L3PagingRequestType1(firsts[0]->pagedID(),firsts[0]->type(),
+			firsts[1]->pagedID(),firsts[1]->type());
+		sent = firsts;
+		mMessages[1]++;
+	}
+	mIDsPaged += sent.size();
+
+	// Move the paged entries to the back of their queues.
+	// List iterators survive the splice, so the index is still good.
+	for (unsigned i=0; i<sent.size(); i++) {
+		PagingEntryList& list = mSubchannels[sent[i]->subchannel()];
+		if (paged) paged->push_back(sent[i]->ID());
+		list.splice(list.end(),list,sent[i]);
 	}
 
-	return mPageIDs.size();
+	LOG(DEBUG) << "subchannel " << sub << ": " << *msg;
+	return msg;
 }
 
+
+L3Frame* Pager::CCCHFrame(const CCCHLogicalChannel* PCH, const Time& when)
+{
+	// Which paging block in the multiframe is this?
+	unsigned block = 0;
+	for (unsigned i=0; i<gBTS.numPCHs(); i++) {
+		if (gBTS.getPCH(i)==PCH) { block = i % mBlocks; break; }
+	}
+	L3RRMessage *msg = nextPage(subchannel(block,when));
+	if (!msg) return NULL;
+	L3Frame *frame = new L3Frame(*msg,UNIT_DATA);
+	delete msg;
+	return frame;
+}
+
+
 size_t Pager::pagingEntryListSize()
 {
 	ScopedLock lock(mLock);
-	return mPageIDs.size();
+	return mIndex.size();
 }
 
+
 void Pager::start()
 {
 	if (mRunning) return;
 	mRunning=true;
-	mPagingThread.start((void* (*)(void*))PagerServiceLoopAdapter, (void*)this);
-}
-
-
 
-void* Control::PagerServiceLoopAdapter(Pager *pager)
-{
-	pager->serviceLoop();
-	return NULL;
+	// Get the paging parameters from the control channel description on the BCCH.
+	L3ControlChannelDescription desc;
+	mLock.lock();
+	assert(mIndex.size()==0);
+	mBlocks = desc.pagingBlocks();
+	mMFRMS = desc.BS_PA_MFRMS();
+	mSubchannels.resize(numSubchannels()+1);
+	mLock.unlock();
+	LOG(INFO) << "pager: " << mBlocks << " paging blocks per multiframe, BS_PA_MFRMS=" << mMFRMS
+		<< ", " << numSubchannels() << " paging subchannels";
+
+	// Attach to the paging channels.
+	for (unsigned i=0; i<gBTS.numPCHs(); i++) gBTS.getPCH(i)->addSource(this);
 }
 
-void Pager::serviceLoop()
-{
-	while (mRunning) {
-
-		LOG(DEBUG) << "Pager blocking for signal";
-		mLock.lock();
-		while (mPageIDs.size()==0) mPageSignal.wait(mLock);
-		mLock.unlock();
 
-		// page everything
-		pageAll();
 
-		// Wait for pending activity to clear the channel.
-		// This wait is what causes PCH to have lower priority than AGCH.
-		unsigned load = gBTS.getPCH()->load();
-		LOG(DEBUG) << "Pager waiting for " << load << " multiframes";
-		if (load) sleepFrames(51*load);
+void Pager::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	for (unsigned sub=0; sub<mSubchannels.size(); sub++) {
+		PagingEntryList::const_iterator lp = mSubchannels[sub].begin();
+		while (lp != mSubchannels[sub].end()) {
+			os << lp->ID() << " " << lp->type() << " " << lp->expired();
+			if (sub<numSubchannels()) os << " subchannel " << sub;
+			else os << " subchannel any";
+			if (!(lp->pagedID()==lp->ID())) os << " paged as " << lp->pagedID();
+			os << endl;
+			++lp;
+		}
 	}
 }
 
 
-
-void Pager::dump(ostream& os) const
+void Pager::dumpStats(ostream& os) const
 {
 	ScopedLock lock(mLock);
-	PagingEntryList::const_iterator lp = mPageIDs.begin();
-	while (lp != mPageIDs.end()) {
-		os << lp->ID() << " " << lp->type() << " " << lp->expired() << endl;
-		++lp;
-	}
+	os << "paging subchannels: " << numSubchannels() << ", pending: " << mIndex.size() << endl;
+	os << "paging blocks: " << mBlocksServed << ", IDs paged: " << mIDsPaged << endl;
+	os << "paging requests: type1 " << mMessages[1] << " type2 " << mMessages[2] << " type3 " << mMessages[3] << endl;
 }
 
 
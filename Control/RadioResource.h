@@ -29,12 +29,19 @@
 #define RADIORESOURCE_H
 
 #include <list>
+#include <map>
+#include <vector>
+#include <Threads.h>
+#include <Timeval.h>
+#include <GSMTransfer.h>
 #include <GSML3CommonElements.h>
 
 
 namespace GSM {
 class Time;
 class TCHFACCHLogicalChannel;
+class CCCHLogicalChannel;
+class L3RRMessage;
 class L3PagingResponse;
 class L3AssignmentComplete;
 };
@@ -94,6 +101,131 @@ class ChannelRequestRecord {
 void* AccessGrantServiceLoop(void*);
 
 
+/** AGCH priority classes, highest first. */
+enum AccessGrantPriority {
+	EmergencyPriority=0,		///< emergency call establishment
+	PagingResponsePriority=1,	///< answer to paging
+	NormalPriority=2,			///< everything else
+	numAccessGrantPriorities=3
+};
+
+/** Priority class of a channel request, from the RA, GSM 04.08 Table 9.9. */
+AccessGrantPriority RACHPriority(unsigned RA);
+
+/** Maximum age in frames of a useful RACH burst, GSM 04.08 3.3.1.1.2. */
+int RACHMaxAge();
+
+
+/** An immediate assignment waiting for the AGCH. */
+class AccessGrantEntry {
+
+	private:
+
+	GSM::L3Frame* mFrame;		///< the message, owned by the scheduler
+	GSM::Time mWhen;			///< time of the RACH burst
+
+	public:
+
+	AccessGrantEntry(GSM::L3Frame* wFrame, const GSM::Time& wWhen)
+		:mFrame(wFrame),mWhen(wWhen)
+	{ }
+
+	GSM::L3Frame* frame() const { return mFrame; }
+	const GSM::Time& when() const { return mWhen; }
+};
+
+
+/** A RACH waiting for a slot in a batched immediate assignment reject. */
+class AccessRejectEntry {
+
+	private:
+
+	unsigned mRA;				///< request reference
+	GSM::Time mWhen;			///< time of the RACH burst
+
+	public:
+
+	AccessRejectEntry(unsigned wRA, const GSM::Time& wWhen)
+		:mRA(wRA),mWhen(wWhen)
+	{ }
+
+	unsigned RA() const { return mRA; }
+	const GSM::Time& when() const { return mWhen; }
+};
+
+
+/**
+	The access grant scheduler is a global object that fills the AGCH blocks.
+	Immediate assignments go out in priority order, emergency calls first,
+	then paging responses, then the rest.
+	Immediate assignment rejects are sent after that, four request references
+	to a message, GSM 04.08 9.1.20.
+	Anything that waits longer than the handset will listen for
+	is dropped instead of wasting a block.
+*/
+class AccessGrantScheduler : public GSM::CCCHSource {
+
+	private:
+
+	mutable Mutex mLock;
+	std::list<AccessGrantEntry> mGrants[numAccessGrantPriorities];	///< assignments, by priority
+	std::list<AccessRejectEntry> mRejects;	///< rejects, to be batched
+	unsigned mRejectWait;					///< largest T3122 value in mRejects, seconds
+	volatile bool mRunning;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mBlocks;					///< AGCH blocks polled
+	unsigned long mBusyBlocks;				///< AGCH blocks with a message
+	unsigned long mGrantsSent[numAccessGrantPriorities];	///< assignments sent, by priority
+	unsigned long mRejectMessages;			///< reject messages sent
+	unsigned long mRejectsSent;				///< request references in reject messages
+	unsigned long mStaleGrants;				///< assignments dropped for age
+	unsigned long mStaleRejects;			///< rejects dropped for age
+	unsigned long mCongestionRejects;		///< RACHs rejected for AGCH congestion
+	size_t mMaxLoad;						///< highest load seen
+	//@}
+
+	public:
+
+	AccessGrantScheduler();
+
+	/** Attach the scheduler to the AGCHs. */
+	void start();
+
+	/**
+		Queue an immediate assignment.
+		@param msg The assignment message.
+		@param when The time of the RACH burst.
+		@param priority The priority class.
+	*/
+	void grant(const GSM::L3RRMessage& msg, const GSM::Time& when, AccessGrantPriority priority);
+
+	/**
+		Queue a RACH for rejection.
+		@param RA The request reference.
+		@param when The time of the RACH burst.
+		@param waitTime The T3122 value in seconds.
+		@param congestion True if the reason is AGCH congestion.
+	*/
+	void reject(unsigned RA, const GSM::Time& when, unsigned waitTime, bool congestion=false);
+
+	/** Number of AGCH blocks needed for the waiting messages. */
+	size_t load() const;
+
+	/** The CCCHSource interface, called by the AGCH service loops. */
+	GSM::L3Frame* CCCHFrame(const GSM::CCCHLogicalChannel* AGCH, const GSM::Time& when);
+
+	/** Dump AGCH statistics to an ostream. */
+	void dumpStats(std::ostream&) const;
+
+	private:
+
+	/** Drop messages too old to be useful.  Caller holds mLock. */
+	void clearStale(const GSM::Time& now);
+};
+
+
 //@}
 
 /**@ Paging mechanisms */
@@ -104,9 +236,11 @@ class PagingEntry {
 
 	private:
 
-	GSM::L3MobileIdentity mID;		///< The mobile ID.
+	GSM::L3MobileIdentity mID;		///< The mobile ID, as given to the pager.
+	GSM::L3MobileIdentity mPagedID;	///< The ID sent on the PCH, a TMSI if we can.
 	GSM::ChannelType mType;			///< The needed channel type.
 	unsigned mTransactionID;		///< The associated transaction ID.
+	unsigned mSubchannel;			///< The paging subchannel, GSM 05.02 6.5.2.
 	Timeval mExpiration;			///< The expiration time for this entry.
 
 	public:
@@ -114,21 +248,29 @@ class PagingEntry {
 	/**
 		Create a new entry, with current timestamp.
 		@param wID The ID to be paged.
+		@param wPagedID The ID to put in the paging message.
+		@param wSubchannel The paging subchannel of the mobile.
 		@param wLife The number of milliseconds to keep paging.
 	*/
-	PagingEntry(const GSM::L3MobileIdentity& wID, GSM::ChannelType wType,
-			unsigned wTransactionID, unsigned wLife)
-		:mID(wID),mType(wType),mTransactionID(wTransactionID),mExpiration(wLife)
+	PagingEntry(const GSM::L3MobileIdentity& wID, const GSM::L3MobileIdentity& wPagedID,
+			GSM::ChannelType wType, unsigned wTransactionID, unsigned wSubchannel, unsigned wLife)
+		:mID(wID),mPagedID(wPagedID),mType(wType),mTransactionID(wTransactionID),
+		mSubchannel(wSubchannel),mExpiration(wLife)
 	{}
 
 	/** Access the ID. */
 	const GSM::L3MobileIdentity& ID() const { return mID; }
 
+	/** Access the ID used on the PCH. */
+	const GSM::L3MobileIdentity& pagedID() const { return mPagedID; }
+
 	/** Access the channel type needed. */
 	GSM::ChannelType type() const { return mType; }
 
 	unsigned transactionID() const { return mTransactionID; }
 
+	unsigned subchannel() const { return mSubchannel; }
+
 	/** Renew the timer. */
 	void renew(unsigned wLife) { mExpiration = Timeval(wLife); }
 
@@ -139,31 +281,51 @@ class PagingEntry {
 
 typedef std::list<PagingEntry> PagingEntryList;
 
+/** Index of the paging lists, by the ID given to the pager. */
+typedef std::map<GSM::L3MobileIdentity,PagingEntryList::iterator> PagingEntryIndex;
+
 
 /**
 	The pager is a global object that generates paging messages on the CCCH.
 	To page a mobile, add the mobile ID to the pager.
 	The entry will be deleted automatically when it expires.
-	All pager operations are linear time.
-	Not much point in optimizing since the main operation is inherently linear.
+
+	Pages are queued by paging subchannel, GSM 05.02 6.5.2, so each mobile
+	is paged only in the blocks it listens to in DRX.  The PCHs ask the pager
+	for the content of each paging block.  Each block carries as many IDs as
+	will fit: four TMSIs in a Type 3 request, two TMSIs and any ID in a Type 2,
+	or two IDs of any type in a Type 1.  Pages go out by TMSI when the
+	TMSI has been given to the handset.
+
+	Add, remove and renew use an index by mobile ID.
 */
-class Pager {
+class Pager : public GSM::CCCHSource {
 
 	private:
 
-	PagingEntryList mPageIDs;				///< List of ID's to be paged.
+	std::vector<PagingEntryList> mSubchannels;	///< pages waiting, by paging subchannel
+	PagingEntryIndex mIndex;				///< index into mSubchannels, by mobile ID
 	mutable Mutex mLock;					///< Lock for thread-safe access.
-	Signal mPageSignal;						///< signal to wake the paging loop
-	Thread mPagingThread;					///< Thread for the paging loop.
 	volatile bool mRunning;
 
+	/**@name Paging configuration, from the BCCH control channel description. */
+	//@{
+	unsigned mBlocks;						///< paging blocks per multiframe
+	unsigned mMFRMS;						///< BS_PA_MFRMS, multiframes per paging cycle
+	//@}
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mBlocksServed;			///< paging blocks polled
+	unsigned long mMessages[4];				///< paging requests sent, by type 1..3
+	unsigned long mIDsPaged;				///< mobile IDs sent in paging requests
+	//@}
+
 	public:
 
-	Pager()
-		:mRunning(false)
-	{}
+	Pager();
 
-	/** Set the output FIFO and start the paging loop. */
+	/** Attach the pager to the PCHs. */
 	void start();
 
 	/**
@@ -187,31 +349,48 @@ class Pager {
 	*/
 	unsigned removeID(const GSM::L3MobileIdentity&);
 
-	private:
+	/** Number of paging blocks in each multiframe. */
+	unsigned pagingBlocks() const { return mBlocks; }
+
+	/** Number of paging subchannels, GSM 05.02 6.5.2 "N". */
+	unsigned numSubchannels() const { return mBlocks*mMFRMS; }
+
+	/** Paging subchannel of an IMSI, GSM 05.02 6.5.2. */
+	unsigned subchannel(const char* IMSI) const;
 
 	/**
-		Traverse the paging list, paging all IDs.
-		@return Number of IDs paged.
+		Paging subchannel of a CCCH block.
+		@param block The index of the paging block in the multiframe.
+		@param when The time of the block.
 	*/
-	unsigned pageAll();
-
-	/** A loop that repeatedly calls pageAll. */
-	void serviceLoop();
+	unsigned subchannel(unsigned block, const GSM::Time& when) const;
 
-	/** C-style adapter. */
-	friend void *PagerServiceLoopAdapter(Pager*);
+	/**
+		Build the next paging request for a subchannel and rotate the paged
+		entries to the back of the subchannel queue.
+		@param subchannel The paging subchannel.
+		@param paged If not NULL, gets the IDs that were paged.
+		@return A new message, or NULL if there is nothing to page.
+	*/
+	GSM::L3RRMessage* nextPage(unsigned subchannel, std::vector<GSM::L3MobileIdentity>* paged=NULL);
 
-public:
+	/** The CCCHSource interface, called by the PCH service loops. */
+	GSM::L3Frame* CCCHFrame(const GSM::CCCHLogicalChannel* PCH, const GSM::Time& when);
 
 	/** return size of PagingEntryList */
 	size_t pagingEntryListSize();
 
 	/** Dump the paging list to an ostream. */
 	void dump(std::ostream&) const;
-};
 
+	/** Dump paging statistics to an ostream. */
+	void dumpStats(std::ostream&) const;
+
+	private:
 
-void *PagerServiceLoopAdapter(Pager*);
+	/** Remove expired entries from a subchannel queue.  Caller holds mLock. */
+	void clearExpired(unsigned subchannel);
+};
 
 
 //@}	// paging mech
@@ -0,0 +1,244 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "RegistrationCache.h"
+
+#include <Configuration.h>
+#include <Logger.h>
+#include <SIPEngine.h>
+#include <SIPUtility.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace Control;
+
+extern ConfigurationTable gConfig;
+
+
+
+ostream& Control::operator<<(ostream& os, LURPolicy policy)
+{
+	switch (policy) {
+		case LURSynchronous: os << "synchronous"; break;
+		case LURCached: os << "cached"; break;
+		case LUROptimistic: os << "optimistic"; break;
+		default: os << "?" << (int)policy << "?";
+	}
+	return os;
+}
+
+
+
+bool SIPRegistrar::registerIMSI(const char* IMSI)
+{
+	SIP::SIPEngine engine(gConfig.getStr("SIP.Proxy.Registration").c_str(),IMSI);
+	LOG(DEBUG) << "waiting for registration of " << IMSI << " on " << gConfig.getStr("SIP.Proxy.Registration");
+	return engine.Register(SIP::SIPEngine::SIPRegister);
+}
+
+
+
+
+RegistrationCache::RegistrationCache(Registrar *wRegistrar)
+	:mRegistrar(wRegistrar),
+	mCached(0),mOptimistic(0),mSynchronous(0),mRefreshes(0),mRefreshFailures(0),
+	mTimeouts(0),mCoalesced(0),mMaxQueue(0)
+{ }
+
+
+void RegistrationCache::start()
+{
+	unsigned numThreads = 4;
+	if (gConfig.defines("Control.LUR.Pipeline.Threads")) numThreads = gConfig.getNum("Control.LUR.Pipeline.Threads");
+	start(numThreads);
+}
+
+
+void RegistrationCache::start(unsigned numThreads)
+{
+	ScopedLock lock(mLock);
+	if (mThreads.size()) return;
+	// Never deleted, like the SIP interface it uses.
+	if (!mRegistrar) mRegistrar = new SIPRegistrar;
+	for (unsigned i=0; i<numThreads; i++) {
+		Thread *thread = new Thread;
+		thread->start((void*(*)(void*))RegistrationCacheServiceLoopAdapter,this);
+		mThreads.push_back(thread);
+	}
+}
+
+
+LURPolicy RegistrationCache::policy()
+{
+	if (!gConfig.defines("Control.LUR.Pipeline")) return LURSynchronous;
+	unsigned policy = gConfig.getNum("Control.LUR.Pipeline");
+	if (policy>LUROptimistic) return LUROptimistic;
+	return (LURPolicy)policy;
+}
+
+
+bool RegistrationCache::registerIMSI(const char* IMSI, LURPolicy policy)
+{
+	// Without the refresh threads, nothing would ever update the cache.
+	if (policy!=LURSynchronous && mThreads.size()) {
+		unsigned maxAge = 3600;
+		if (gConfig.defines("Control.LUR.Pipeline.MaxAge")) maxAge = gConfig.getNum("Control.LUR.Pipeline.MaxAge");
+		ScopedLock lock(mLock);
+		EntryMap::const_iterator entry = mEntries.find(IMSI);
+		if (entry!=mEntries.end() && entry->second.mTime.elapsed() < 1000*(long)maxAge) {
+			LOG(DEBUG) << "cached registration of " << IMSI << ": " << entry->second.mSuccess;
+			mCached++;
+			bool success = entry->second.mSuccess;
+			enqueue(IMSI);
+			return success;
+		}
+		if (policy==LUROptimistic) {
+			LOG(DEBUG) << "optimistic registration of " << IMSI;
+			mOptimistic++;
+			enqueue(IMSI);
+			return true;
+		}
+	}
+
+	mLock.lock();
+	mSynchronous++;
+	// The SIP interface may be running without the refresh threads.
+	if (!mRegistrar) mRegistrar = new SIPRegistrar;
+	Registrar *registrar = mRegistrar;
+	mLock.unlock();
+	bool success;
+	try {
+		success = registrar->registerIMSI(IMSI);
+	}
+	catch (SIP::SIPTimeout) {
+		ScopedLock lock(mLock);
+		mTimeouts++;
+		mEntries.erase(IMSI);
+		throw;
+	}
+	record(IMSI,success);
+	return success;
+}
+
+
+void RegistrationCache::record(const char* IMSI, bool success)
+{
+	ScopedLock lock(mLock);
+	Entry& entry = mEntries[IMSI];
+	entry.mSuccess = success;
+	entry.mTime.now();
+	if (mNextPurge.passed()) purge();
+}
+
+
+void RegistrationCache::enqueue(const char* IMSI)
+{
+	if (!mQueued.insert(IMSI).second) {
+		mCoalesced++;
+		return;
+	}
+	mQueue.push_back(IMSI);
+	if (mQueue.size()>mMaxQueue) mMaxQueue = mQueue.size();
+	mQueueSignal.signal();
+}
+
+
+void RegistrationCache::purge()
+{
+	unsigned maxAge = 3600;
+	if (gConfig.defines("Control.LUR.Pipeline.MaxAge")) maxAge = gConfig.getNum("Control.LUR.Pipeline.MaxAge");
+	EntryMap::iterator entry = mEntries.begin();
+	while (entry!=mEntries.end()) {
+		EntryMap::iterator here = entry++;
+		if (here->second.mTime.elapsed() >= 1000*(long)maxAge) mEntries.erase(here);
+	}
+	mNextPurge.future(60000);
+}
+
+
+size_t RegistrationCache::backlog() const
+{
+	ScopedLock lock(mLock);
+	return mQueue.size();
+}
+
+
+void RegistrationCache::serviceLoop()
+{
+	while (true) {
+		mLock.lock();
+		while (mQueue.size()==0) mQueueSignal.wait(mLock);
+		string IMSI = mQueue.front();
+		mQueue.pop_front();
+		mLock.unlock();
+
+		bool answered = false;
+		bool success = false;
+		try {
+			success = mRegistrar->registerIMSI(IMSI.c_str());
+			answered = true;
+		}
+		catch (SIP::SIPTimeout) {
+			LOG(ALERT) << "SIP registration refresh timed out for " << IMSI << ".  Is the proxy running at " << gConfig.getStr("SIP.Proxy.Registration");
+		}
+
+		if (answered) record(IMSI.c_str(),success);
+		ScopedLock lock(mLock);
+		mQueued.erase(IMSI);
+		if (!answered) {
+			mTimeouts++;
+			mEntries.erase(IMSI);
+			continue;
+		}
+		mRefreshes++;
+		if (!success) {
+			LOG(INFO) << "registration refresh FAILED: " << IMSI;
+			mRefreshFailures++;
+		}
+	}
+}
+
+
+void *Control::RegistrationCacheServiceLoopAdapter(RegistrationCache* cache)
+{
+	cache->serviceLoop();
+	return NULL;
+}
+
+
+void RegistrationCache::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "entries " << mEntries.size()
+		<< " cached " << mCached << " optimistic " << mOptimistic << " synchronous " << mSynchronous
+		<< " refreshes " << mRefreshes << " refused " << mRefreshFailures << " timeouts " << mTimeouts
+		<< " coalesced " << mCoalesced << " queue " << mQueue.size() << " max " << mMaxQueue;
+}
+
+
+// vim: ts=4 sw=4
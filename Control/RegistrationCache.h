@@ -0,0 +1,182 @@
+/**@file Cached SIP registration state for pipelined location updating. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#ifndef REGISTRATIONCACHE_H
+#define REGISTRATIONCACHE_H
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <Threads.h>
+#include <Timeval.h>
+
+
+namespace Control {
+
+
+/** How the location updating controller gets the SIP registration result. */
+enum LURPolicy {
+	LURSynchronous,		///< register with the SIP registrar while holding the SDCCH
+	LURCached,			///< answer a recent subscriber from the cache, register the rest synchronously
+	LUROptimistic		///< answer from the cache, and accept subscribers not in it
+};
+
+std::ostream& operator<<(std::ostream&, LURPolicy);
+
+
+/** Something that registers an IMSI with the SIP registrar. */
+class Registrar {
+
+	public:
+
+	virtual ~Registrar() {}
+
+	/**
+		Register an IMSI and wait for the answer.
+		@return true if the registrar accepted it.
+		@throws SIPTimeout if the registrar did not answer.
+	*/
+	virtual bool registerIMSI(const char* IMSI) = 0;
+};
+
+
+/** The normal registrar, SIP.Proxy.Registration through a SIPEngine. */
+class SIPRegistrar : public Registrar {
+
+	public:
+
+	bool registerIMSI(const char* IMSI);
+};
+
+
+/**
+	The result of the latest SIP registration of each IMSI.
+
+	In the synchronous policy, the location updating controller holds the
+	SDCCH for the whole SIP round trip, which limits the LUR rate to the
+	number of SDCCHs over the registrar round trip time.  In the other
+	policies, an IMSI registered within Control.LUR.Pipeline.MaxAge seconds
+	is answered at once with the cached result, and its SIP registration is
+	refreshed by the service threads after the channel is gone.  Refreshes of
+	the same IMSI are coalesced.  A refresh that times out drops the entry,
+	so that the next LUR for that IMSI asks the registrar again.
+*/
+class RegistrationCache {
+
+	private:
+
+	/** The latest answer for one IMSI. */
+	class Entry {
+		public:
+		bool mSuccess;
+		Timeval mTime;			///< when the answer came
+	};
+
+	typedef std::map<std::string,Entry> EntryMap;
+
+	mutable Mutex mLock;
+	EntryMap mEntries;
+	std::list<std::string> mQueue;		///< IMSIs waiting for a refresh
+	std::set<std::string> mQueued;		///< IMSIs in mQueue or being refreshed
+	Signal mQueueSignal;
+	Registrar *mRegistrar;
+	std::vector<Thread*> mThreads;
+	Timeval mNextPurge;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mCached;				///< answered from the cache
+	unsigned long mOptimistic;			///< accepted without a cached answer
+	unsigned long mSynchronous;			///< registered while the caller waited
+	unsigned long mRefreshes;			///< registered by the service threads
+	unsigned long mRefreshFailures;		///< refreshes the registrar refused
+	unsigned long mTimeouts;			///< registrations the registrar did not answer
+	unsigned long mCoalesced;			///< refreshes already queued
+	size_t mMaxQueue;
+	//@}
+
+	public:
+
+	/** Create a cache for a registrar, which the cache does not delete; NULL for SIPRegistrar. */
+	RegistrationCache(Registrar *wRegistrar=NULL);
+
+	/** Start the refresh threads, Control.LUR.Pipeline.Threads of them. */
+	void start();
+
+	/** Start a given number of refresh threads. */
+	void start(unsigned numThreads);
+
+	/** The configured policy, Control.LUR.Pipeline. */
+	static LURPolicy policy();
+
+	/**
+		Decide whether an IMSI may register, registering it with SIP
+		now or later according to the policy.
+		@return true if the IMSI may register.
+		@throws SIPTimeout if a synchronous registration timed out.
+	*/
+	bool registerIMSI(const char* IMSI, LURPolicy policy);
+
+	/** Same, with the configured policy. */
+	bool registerIMSI(const char* IMSI) { return registerIMSI(IMSI,policy()); }
+
+	/** Number of refreshes waiting. */
+	size_t backlog() const;
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+
+	private:
+
+	/** Record a registrar answer. */
+	void record(const char* IMSI, bool success);
+
+	/** Queue a refresh, unless one is already queued.  Caller holds mLock. */
+	void enqueue(const char* IMSI);
+
+	/** Drop entries too old to be used.  Caller holds mLock. */
+	void purge();
+
+	/** The refresh loop. */
+	void serviceLoop();
+
+	friend void *RegistrationCacheServiceLoopAdapter(RegistrationCache*);
+};
+
+void *RegistrationCacheServiceLoopAdapter(RegistrationCache*);
+
+
+};	// namespace Control
+
+
+#endif
+// vim: ts=4 sw=4
@@ -48,6 +48,7 @@
 #include "SMSControl.h"
 #include "ControlCommon.h"
 #include "TransactionTable.h"
+#include "SMSSpool.h"
 #include <Regexp.h>
 
 
@@ -428,6 +429,82 @@ bool Control::deliverSMSToMS(const char *callingPartyDigits, const char* message
 
 
 
+/** MT-SMS delivery statistics, for the channel occupancy per message. */
+class MTSMSStats {
+
+	private:
+
+	mutable Mutex mLock;
+	unsigned long mSessions;
+	unsigned long mDelivered;
+	unsigned long mFailed;			///< sessions that ended on an error
+	unsigned long mChannelMs;		///< channel time, from the paging response to the release
+	unsigned mMaxDelivered;			///< most messages in one session
+
+	public:
+
+	MTSMSStats()
+		:mSessions(0),mDelivered(0),mFailed(0),mChannelMs(0),mMaxDelivered(0)
+	{ }
+
+	void session(unsigned delivered, bool failed, unsigned ms)
+	{
+		ScopedLock lock(mLock);
+		mSessions++;
+		mDelivered += delivered;
+		if (failed) mFailed++;
+		mChannelMs += ms;
+		if (delivered>mMaxDelivered) mMaxDelivered = delivered;
+	}
+
+	void dump(ostream& os) const
+	{
+		ScopedLock lock(mLock);
+		os << "sessions " << mSessions << " delivered " << mDelivered << " failed " << mFailed
+			<< " max/session " << mMaxDelivered;
+		if (mSessions) os << " SMS/session " << (double)mDelivered/mSessions;
+		if (mDelivered) os << " channel ms/SMS " << mChannelMs/mDelivered;
+	}
+};
+
+static MTSMSStats gMTSMSStats;
+
+
+void Control::dumpMTSMSStats(ostream& os)
+{
+	gMTSMSStats.dump(os);
+}
+
+
+/**
+	Deliver spooled messages to a subscriber on an established channel, oldest first.
+	Each message is already acknowledged in SIP, so it is removed from the spool
+	only after the RP-ACK.  Anything left is paged again by the spool.
+	@param TI The L3 TI for the first message; the others get new ones.
+	@param max The most messages to deliver.
+	@param failed Set if a message was refused.
+	@return The number of messages delivered.
+*/
+static unsigned deliverSpooledSMS(const char *IMSI, unsigned TI, unsigned max, GSM::LogicalChannel *LCH, bool& failed)
+{
+	unsigned delivered = 0;
+	SMSSpool::Message message;
+	while (delivered<max && gSMSSpool.head(IMSI,message)) {
+		if (delivered) TI = gTMSITable.nextL3TI(IMSI);
+		LOG(INFO) << "delivering spooled SMS " << message.mID << " to " << IMSI << " with TI " << TI;
+		if (!deliverSMSToMS(message.mCalling.c_str(),message.mBody.c_str(),
+				message.mContentType.c_str(),TI,LCH)) {
+			failed = true;
+			break;
+		}
+		gSMSSpool.remove(IMSI,message.mID);
+		delivered++;
+	}
+	gSMSSpool.sessionDone(IMSI,delivered);
+	return delivered;
+}
+
+
 void Control::MTSMSController(TransactionEntry *transaction, GSM::LogicalChannel *LCH)
 {
 	assert(LCH);
@@ -448,27 +525,51 @@ void Control::MTSMSController(TransactionEntry *transaction, GSM::LogicalChannel
 	// MSC has given the last CP-ack and invokes the clearing procedure. 
 	// """
 
+	// Keep the link up and deliver every message waiting for this subscriber,
+	// from the spool and from other paging transactions, before releasing it.
+	// Each CP transaction gets its own L3 TI, so the MS does not take
+	// a message for a repeat of the one before.
+	GSM::L3MobileIdentity mobileID = transaction->subscriber();
+	string IMSI = mobileID.digits();
+	unsigned maxPerSession = 10;
+	if (gConfig.defines("SMS.MaxPerSession")) maxPerSession = gConfig.getNum("SMS.MaxPerSession");
+	// The channel has been ours since the paging response.
+	Timeval start;
+	unsigned setupMs = transaction->stateAge();
+	unsigned delivered = 0;
+	bool failed = false;
+	while (transaction) {
+		// Attach the channel to the transaction and update the state.
+		LOG(DEBUG) << "transaction: "<< *transaction;
+		transaction->channel(LCH);
+		transaction->GSMState(GSM::SMSDelivering);
+		LOG(INFO) << "transaction: "<< *transaction;
+
+		if (gSMSSpool.owns(IMSI.c_str(),transaction->ID())) {
+			delivered += deliverSpooledSMS(IMSI.c_str(),transaction->L3TI(),
+				maxPerSession-delivered,LCH,failed);
+		} else if (deliverSMSToMS(transaction->calling().digits(),transaction->message(),
+								transaction->messageType(),transaction->L3TI(),LCH)) {
+			// Ack in SIP domain.
+			transaction->MTSMSSendOK();
+			delivered++;
+		} else {
+			failed = true;
+		}
+		gTransactionTable.remove(transaction);
+		if (failed || delivered>=maxPerSession) break;
 
-	// Attach the channel to the transaction and update the state.
-	LOG(DEBUG) << "transaction: "<< *transaction;
-	transaction->channel(LCH);
-	transaction->GSMState(GSM::SMSDelivering);
-	LOG(INFO) << "transaction: "<< *transaction;
-
-	bool success = deliverSMSToMS(transaction->calling().digits(),transaction->message(),
-								transaction->messageType(),transaction->L3TI(),LCH);
+		// Anything else waiting?
+		transaction = gTransactionTable.answeredSMSPaging(mobileID);
+		if (transaction) transaction->L3TI(gTMSITable.nextL3TI(IMSI.c_str()));
+	}
 
 	// Close the Dm channel?
 	if (LCH->type()!=GSM::SACCHType) {
 		LCH->send(GSM::L3ChannelRelease());
-		LOG(INFO) << "closing the Um channel";
+		LOG(INFO) << "closing the Um channel after " << delivered << " MT-SMS";
 	}
-
-	// Ack in SIP domain.
-	if (success) transaction->MTSMSSendOK();
-
-	// Done.
-	gTransactionTable.remove(transaction);
+	gMTSMSStats.session(delivered,failed,setupMs+start.elapsed());
 }
 
 
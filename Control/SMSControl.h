@@ -28,6 +28,7 @@
 #ifndef SMSCONTROL_H
 #define SMSCONTROL_H
 
+#include <ostream>
 #include <SMSMessages.h>
 
 namespace GSM {
@@ -58,9 +59,15 @@ void InCallMOSMSController(const SMS::CPData *msg, TransactionEntry* transaction
 */
 bool deliverSMSToMS(const char *callingPartyDigits, const char* message, const char* contentType, unsigned TI, GSM::LogicalChannel *LCH);
 
-/** MTSMS */
+/**
+	MTSMS, delivering every MT-SMS waiting for the subscriber,
+	up to SMS.MaxPerSession, before the channel is released.
+*/
 void MTSMSController(TransactionEntry* transaction, GSM::LogicalChannel *LCH);
 
+/** Dump the MT-SMS delivery statistics, including channel time per message. */
+void dumpMTSMSStats(std::ostream&);
+
 }
 
 
@@ -0,0 +1,650 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "SMSSpool.h"
+#include "ControlCommon.h"
+#include "TransactionTable.h"
+#include "RadioResource.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include <Configuration.h>
+#include <GSMConfig.h>
+#include <Logger.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace Control;
+
+extern ConfigurationTable gConfig;
+
+
+
+/** The file starts with this. */
+static const char fileMagic[16] = "OpenBTS SMS 1\n";
+
+/** The layout of a record header in the file. */
+struct SpoolRecord {
+	uint32_t magic;
+	uint32_t type;
+	uint32_t length;		///< payload bytes, after the header
+	uint32_t checksum;		///< of the rest of the header and the payload
+	uint64_t ID;			///< the message, new or removed
+	uint64_t time;
+};
+
+static const uint32_t recordMagic = 0x534d5331;
+
+/** Record types. */
+enum { MessageRecord = 1, RemoveRecord = 2 };
+
+/** Records start on this boundary. */
+static const size_t recordAlign = 8;
+
+/** Seconds to keep the call ID of a message that left the spool, the SIP transaction lifetime of 64*T1. */
+static const time_t callIDHold = 32;
+
+/** The longest payload; a 140-octet TPDU in hex is far less. */
+static const size_t maxPayload = 16384;
+
+
+static size_t padded(size_t length)
+{
+	return (length + recordAlign - 1) & ~(recordAlign - 1);
+}
+
+
+/** FNV-1a, over the header fields after the checksum and the payload. */
+static uint32_t checksum(const SpoolRecord& record, const char* payload)
+{
+	uint32_t hash = 2166136261U;
+	const unsigned char *p = (const unsigned char*)&record.ID;
+	for (size_t i=0; i<2*sizeof(uint64_t); i++) hash = (hash ^ p[i]) * 16777619U;
+	hash = (hash ^ record.type) * 16777619U;
+	hash = (hash ^ record.length) * 16777619U;
+	p = (const unsigned char*)payload;
+	for (size_t i=0; i<record.length; i++) hash = (hash ^ p[i]) * 16777619U;
+	return hash;
+}
+
+
+/** Take the next NUL-terminated field of a payload. */
+static bool field(const char*& p, const char* end, string& dest)
+{
+	const char *nul = (const char*)memchr(p,0,end-p);
+	if (!nul) return false;
+	dest.assign(p,nul-p);
+	p = nul+1;
+	return true;
+}
+
+
+
+
+SMSSpool::SMSSpool()
+	:mFD(-1),mMap(NULL),mSize(0),mMinSize(0),mEnd(0),mLiveBytes(0),mNextID(1),mSync(true),mCount(0),
+	mPageTokens(0),mRunning(false),
+	mAdded(0),mDuplicates(0),mRejected(0),mDelivered(0),mExpired(0),mPages(0),mSessions(0),
+	mCompactions(0),mMaxCount(0),mLoadTime(0)
+{ }
+
+
+SMSSpool::~SMSSpool()
+{
+	ScopedLock lock(mLock);
+	close();
+}
+
+
+void SMSSpool::close()
+{
+	if (mMap) munmap(mMap,mSize);
+	if (mFD>=0) ::close(mFD);
+	mMap = NULL;
+	mFD = -1;
+}
+
+
+bool SMSSpool::open()
+{
+	if (!gConfig.defines("SMS.Spool")) return false;
+	size_t size = 16;
+	if (gConfig.defines("SMS.Spool.Size")) size = gConfig.getNum("SMS.Spool.Size");
+	bool sync = gConfig.defines("SMS.Spool.Sync") && gConfig.getNum("SMS.Spool.Sync");
+	return open(gConfig.getStr("SMS.Spool").c_str(),size<<20,sync);
+}
+
+
+bool SMSSpool::open(const char* path, size_t size, bool sync)
+{
+	ScopedLock lock(mLock);
+	close();
+	mPath = path;
+	mSync = sync;
+	mFD = ::open(path,O_RDWR|O_CREAT,0600);
+	if (mFD<0) {
+		LOG(ALERT) << "cannot open SMS spool " << path << ": " << strerror(errno);
+		return false;
+	}
+	// Keep a larger file; compaction shrinks it to the configured size.
+	mMinSize = size;
+	struct stat st;
+	fstat(mFD,&st);
+	if ((size_t)st.st_size>size) size = st.st_size;
+	size = (size + getpagesize() - 1) & ~(size_t)(getpagesize() - 1);
+	if ((size_t)st.st_size<size && ftruncate(mFD,size)!=0) {
+		LOG(ALERT) << "cannot size SMS spool " << path << ": " << strerror(errno);
+		close();
+		return false;
+	}
+	mSize = size;
+	void *base = mmap(NULL,mSize,PROT_READ|PROT_WRITE,MAP_SHARED,mFD,0);
+	if (base==MAP_FAILED) {
+		LOG(ALERT) << "cannot map SMS spool " << path << ": " << strerror(errno);
+		mMap = NULL;
+		close();
+		return false;
+	}
+	mMap = (char*)base;
+	Timeval start;
+	load();
+	mLoadTime = start.elapsed();
+	LOG(INFO) << "SMS spool " << path << " has " << mCount << " messages for " << mQueues.size()
+		<< " subscribers, read in " << mLoadTime << " ms";
+	return true;
+}
+
+
+void SMSSpool::load()
+{
+	mQueues.clear();
+	mCallIDs.clear();
+	mDoneCallIDs.clear();
+	mCount = 0;
+	mLiveBytes = 0;
+	mNextID = 1;
+	if (memcmp(mMap,fileMagic,sizeof(fileMagic))!=0) {
+		// A new file, or not ours.
+		memset(mMap,0,mSize);
+		memcpy(mMap,fileMagic,sizeof(fileMagic));
+		mEnd = sizeof(fileMagic);
+		return;
+	}
+
+	// Messages in log order, so that each queue is in arrival order.
+	map<uint64_t,string> IMSIs;
+	size_t offset = sizeof(fileMagic);
+	while (offset+sizeof(SpoolRecord)<=mSize) {
+		const SpoolRecord *record = (const SpoolRecord*)(mMap+offset);
+		if (record->magic!=recordMagic) break;
+		if (record->length>maxPayload || offset+sizeof(SpoolRecord)+record->length>mSize) break;
+		const char *payload = mMap+offset+sizeof(SpoolRecord);
+		if (checksum(*record,payload)!=record->checksum) {
+			LOG(ALERT) << "SMS spool " << mPath << " damaged at offset " << offset << ", dropping the rest";
+			break;
+		}
+		if (record->ID>=mNextID) mNextID = record->ID+1;
+		if (record->type==MessageRecord) {
+			const char *p = payload;
+			const char *end = payload + record->length;
+			string IMSI, callID;
+			if (field(p,end,IMSI) && field(p,end,callID)) {
+				mQueues[IMSI].push_back(Entry(record->ID,offset,record->time,callID));
+				if (callID.size()) mCallIDs[callID] = record->ID;
+				IMSIs[record->ID] = IMSI;
+				mCount++;
+				mLiveBytes += sizeof(SpoolRecord) + padded(record->length);
+			}
+		} else if (record->type==RemoveRecord) {
+			map<uint64_t,string>::iterator ip = IMSIs.find(record->ID);
+			if (ip!=IMSIs.end()) {
+				QueueMap::iterator qp = mQueues.find(ip->second);
+				Queue& queue = qp->second;
+				for (Queue::iterator ep=queue.begin(); ep!=queue.end(); ++ep) {
+					if (ep->mID!=record->ID) continue;
+					const SpoolRecord *removed = (const SpoolRecord*)(mMap+ep->mOffset);
+					mLiveBytes -= sizeof(SpoolRecord) + padded(removed->length);
+					mCallIDs.erase(ep->mCallID);
+					retire(ep->mCallID,record->time);
+					queue.erase(ep);
+					mCount--;
+					break;
+				}
+				if (queue.size()==0) mQueues.erase(qp);
+				IMSIs.erase(ip);
+			}
+		}
+		offset += sizeof(SpoolRecord) + padded(record->length);
+	}
+	mEnd = offset;
+	// Clear any torn record, so that it cannot show through a shorter one written over it.
+	size_t tail = sizeof(SpoolRecord) + maxPayload;
+	if (mEnd+tail>mSize) tail = mSize - mEnd;
+	memset(mMap+mEnd,0,tail);
+	if (mCount>mMaxCount) mMaxCount = mCount;
+}
+
+
+bool SMSSpool::read(size_t offset, Message& message) const
+{
+	const SpoolRecord *record = (const SpoolRecord*)(mMap+offset);
+	const char *p = mMap + offset + sizeof(SpoolRecord);
+	const char *end = p + record->length;
+	message.mID = record->ID;
+	message.mTime = record->time;
+	if (!field(p,end,message.mIMSI)) return false;
+	if (!field(p,end,message.mCallID)) return false;
+	if (!field(p,end,message.mCalling)) return false;
+	if (!field(p,end,message.mContentType)) return false;
+	message.mBody.assign(p,end-p);
+	return true;
+}
+
+
+size_t SMSSpool::append(uint32_t type, uint64_t ID, time_t when, const string& payload)
+{
+	size_t needed = sizeof(SpoolRecord) + padded(payload.size());
+	if (mEnd+needed>mSize) {
+		if (!compact() || mEnd+needed>mSize) return 0;
+	}
+	size_t offset = mEnd;
+	SpoolRecord *record = (SpoolRecord*)(mMap+offset);
+	char *dest = mMap + offset + sizeof(SpoolRecord);
+	memcpy(dest,payload.data(),payload.size());
+	memset(dest+payload.size(),0,padded(payload.size())-payload.size());
+	record->type = type;
+	record->length = payload.size();
+	record->ID = ID;
+	record->time = when;
+	record->checksum = checksum(*record,dest);
+	record->magic = recordMagic;
+	mEnd += needed;
+	if (mSync) {
+		size_t page = offset & ~(size_t)(getpagesize() - 1);
+		if (msync(mMap+page,mEnd-page,MS_SYNC)!=0) {
+			LOG(ALERT) << "cannot sync SMS spool " << mPath << ": " << strerror(errno);
+		}
+	}
+	return offset;
+}
+
+
+bool SMSSpool::compact()
+{
+	mCompactions++;
+	// Write the waiting messages to a new file and put it in place of the old one.
+	string newPath = mPath + ".new";
+	size_t newSize = mMinSize;
+	// Leave at least as much room again as the waiting messages take.
+	size_t needed = sizeof(fileMagic) + 2*mLiveBytes + sizeof(SpoolRecord) + maxPayload;
+	if (newSize<needed) newSize = needed;
+	newSize = (newSize + getpagesize() - 1) & ~(size_t)(getpagesize() - 1);
+	int fd = ::open(newPath.c_str(),O_RDWR|O_CREAT|O_TRUNC,0600);
+	if (fd<0 || ftruncate(fd,newSize)!=0) {
+		LOG(ALERT) << "cannot create " << newPath << ": " << strerror(errno);
+		if (fd>=0) ::close(fd);
+		return false;
+	}
+	void *base = mmap(NULL,newSize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	if (base==MAP_FAILED) {
+		LOG(ALERT) << "cannot map " << newPath << ": " << strerror(errno);
+		::close(fd);
+		return false;
+	}
+	char *newMap = (char*)base;
+	memcpy(newMap,fileMagic,sizeof(fileMagic));
+	size_t end = sizeof(fileMagic);
+	// Copy in log order, so that the queues stay in arrival order on the next load.
+	map<size_t,Entry*> entries;
+	for (QueueMap::iterator qp=mQueues.begin(); qp!=mQueues.end(); ++qp) {
+		for (Queue::iterator ep=qp->second.begin(); ep!=qp->second.end(); ++ep) entries[ep->mOffset] = &*ep;
+	}
+	for (map<size_t,Entry*>::iterator p=entries.begin(); p!=entries.end(); ++p) {
+		const SpoolRecord *record = (const SpoolRecord*)(mMap+p->first);
+		size_t length = sizeof(SpoolRecord) + padded(record->length);
+		memcpy(newMap+end,record,length);
+		p->second->mOffset = end;
+		end += length;
+	}
+	bool ok = msync(newMap,newSize,MS_SYNC)==0 && fsync(fd)==0
+		&& rename(newPath.c_str(),mPath.c_str())==0;
+	if (!ok) {
+		LOG(ALERT) << "cannot replace SMS spool " << mPath << ": " << strerror(errno);
+		// Put the offsets back.
+		for (map<size_t,Entry*>::iterator p=entries.begin(); p!=entries.end(); ++p) p->second->mOffset = p->first;
+		munmap(newMap,newSize);
+		::close(fd);
+		unlink(newPath.c_str());
+		return false;
+	}
+	close();
+	mFD = fd;
+	mMap = newMap;
+	mSize = newSize;
+	LOG(INFO) << "compacted SMS spool from " << mEnd << " to " << end << " bytes";
+	mEnd = end;
+	return true;
+}
+
+
+bool SMSSpool::add(const char* IMSI, const char* callID, const char* calling,
+	const char* contentType, const char* body, size_t length)
+{
+	if (!IMSI) return false;
+	if (!callID) callID = "";
+	if (!calling) calling = "";
+	if (!contentType) contentType = "";
+	string payload;
+	payload.append(IMSI).append(1,'\0');
+	payload.append(callID).append(1,'\0');
+	payload.append(calling).append(1,'\0');
+	payload.append(contentType).append(1,'\0');
+	if (body) payload.append(body,length);
+
+	ScopedLock lock(mLock);
+	if (!mMap) {
+		mRejected++;
+		return false;
+	}
+	if (*callID && mCallIDs.find(callID)!=mCallIDs.end()) {
+		LOG(INFO) << "SMS spool already has call ID " << callID;
+		mDuplicates++;
+		return true;
+	}
+	// A retransmission can also come after delivery, if our 200 OK was lost.
+	map<string,time_t>::const_iterator dp = mDoneCallIDs.find(callID);
+	if (*callID && dp!=mDoneCallIDs.end() && dp->second>time(NULL)) {
+		LOG(INFO) << "SMS spool already delivered call ID " << callID;
+		mDuplicates++;
+		return true;
+	}
+	if (payload.size()>maxPayload) {
+		LOG(NOTICE) << "SMS for " << IMSI << " too long to spool, " << payload.size() << " bytes";
+		mRejected++;
+		return false;
+	}
+	uint64_t ID = mNextID++;
+	time_t now = time(NULL);
+	size_t offset = append(MessageRecord,ID,now,payload);
+	if (!offset) {
+		LOG(ALERT) << "SMS spool " << mPath << " full, " << mCount << " messages waiting";
+		mRejected++;
+		return false;
+	}
+	mQueues[IMSI].push_back(Entry(ID,offset,now,callID));
+	if (*callID) mCallIDs[callID] = ID;
+	mCount++;
+	mLiveBytes += sizeof(SpoolRecord) + padded(payload.size());
+	if (mCount>mMaxCount) mMaxCount = mCount;
+	mAdded++;
+	mServiceSignal.signal();
+	return true;
+}
+
+
+bool SMSSpool::head(const char* IMSI, Message& message) const
+{
+	ScopedLock lock(mLock);
+	QueueMap::const_iterator qp = mQueues.find(IMSI);
+	if (qp==mQueues.end() || !mMap) return false;
+	return read(qp->second.front().mOffset,message);
+}
+
+
+void SMSSpool::unindex(QueueMap::iterator qp)
+{
+	Queue& queue = qp->second;
+	const Entry& entry = queue.front();
+	const SpoolRecord *record = (const SpoolRecord*)(mMap+entry.mOffset);
+	mLiveBytes -= sizeof(SpoolRecord) + padded(record->length);
+	mCallIDs.erase(entry.mCallID);
+	retire(entry.mCallID,time(NULL));
+	queue.pop_front();
+	mCount--;
+	if (queue.size()==0) mQueues.erase(qp);
+}
+
+
+void SMSSpool::retire(const string& callID, time_t when)
+{
+	if (callID.size()) mDoneCallIDs[callID] = when + callIDHold;
+}
+
+
+bool SMSSpool::remove(const char* IMSI, uint64_t ID)
+{
+	ScopedLock lock(mLock);
+	QueueMap::iterator qp = mQueues.find(IMSI);
+	if (qp==mQueues.end() || qp->second.front().mID!=ID) return false;
+	// If this fails, the message will be delivered again after a restart.
+	if (!append(RemoveRecord,ID,time(NULL),"")) {
+		LOG(ALERT) << "cannot record delivery of SMS " << ID << " in " << mPath;
+	}
+	// The append may have compacted the log, so find the queue again.
+	qp = mQueues.find(IMSI);
+	unindex(qp);
+	mDelivered++;
+	return true;
+}
+
+
+size_t SMSSpool::pending(const char* IMSI) const
+{
+	ScopedLock lock(mLock);
+	QueueMap::const_iterator qp = mQueues.find(IMSI);
+	if (qp==mQueues.end()) return 0;
+	return qp->second.size();
+}
+
+
+size_t SMSSpool::size() const
+{
+	ScopedLock lock(mLock);
+	return mCount;
+}
+
+
+bool SMSSpool::owns(const char* IMSI, unsigned transactionID) const
+{
+	ScopedLock lock(mLock);
+	DeliveryMap::const_iterator dp = mDeliveries.find(IMSI);
+	return dp!=mDeliveries.end() && dp->second.mTransactionID==transactionID;
+}
+
+
+void SMSSpool::sessionDone(const char* IMSI, unsigned delivered)
+{
+	ScopedLock lock(mLock);
+	if (delivered) mSessions++;
+	// Let the service thread page again for anything left.
+	mServiceSignal.signal();
+}
+
+
+void SMSSpool::start()
+{
+	ScopedLock lock(mLock);
+	if (!mMap || mRunning) return;
+	mRunning = true;
+	mLastRefill.now();
+	mServiceThread.start((void*(*)(void*))SMSSpoolServiceLoopAdapter,this);
+}
+
+
+void SMSSpool::dispatch()
+{
+	unsigned maxAge = 172800;
+	if (gConfig.defines("SMS.Spool.MaxAge")) maxAge = gConfig.getNum("SMS.Spool.MaxAge");
+	unsigned retry = 60;
+	if (gConfig.defines("SMS.Spool.RetryInterval")) retry = gConfig.getNum("SMS.Spool.RetryInterval");
+	unsigned maxPaging = 8;
+	if (gConfig.defines("SMS.Spool.MaxPaging")) maxPaging = gConfig.getNum("SMS.Spool.MaxPaging");
+	double rate = 4;
+	if (gConfig.defines("SMS.Spool.PageRate")) rate = gConfig.getNum("SMS.Spool.PageRate");
+
+	vector<string> toPage;
+	{
+		ScopedLock lock(mLock);
+		time_t now = time(NULL);
+
+		// Expire old messages.  The oldest message of each subscriber is first.
+		QueueMap::iterator qp = mQueues.begin();
+		while (qp!=mQueues.end()) {
+			QueueMap::iterator here = qp++;
+			while (now - here->second.front().mTime > (time_t)maxAge) {
+				LOG(NOTICE) << "SMS " << here->second.front().mID << " for " << here->first << " expired undelivered";
+				append(RemoveRecord,here->second.front().mID,now,"");
+				mExpired++;
+				bool last = here->second.size()==1;
+				unindex(here);
+				if (last) break;
+			}
+		}
+
+		// Forget the call IDs that are past any retransmission.
+		map<string,time_t>::iterator cp = mDoneCallIDs.begin();
+		while (cp!=mDoneCallIDs.end()) {
+			map<string,time_t>::iterator here = cp++;
+			if (here->second<=now) mDoneCallIDs.erase(here);
+		}
+
+		// Find the finished attempts.
+		unsigned paging = 0;
+		DeliveryMap::iterator dp = mDeliveries.begin();
+		while (dp!=mDeliveries.end()) {
+			DeliveryMap::iterator here = dp++;
+			Delivery& delivery = here->second;
+			QueueMap::const_iterator queue = mQueues.find(here->first);
+			if (delivery.mTransactionID && gTransactionTable.find(delivery.mTransactionID)) {
+				paging++;
+				continue;
+			}
+			if (queue==mQueues.end()) {
+				mDeliveries.erase(here);
+				continue;
+			}
+			if (delivery.mTransactionID) {
+				// Page again at once if the session got anything through, otherwise wait.
+				if (queue->second.front().mID!=delivery.mHeadID) delivery.mNextAttempt.now();
+				else delivery.mNextAttempt.future(retry*1000);
+				delivery.mTransactionID = 0;
+			}
+		}
+
+		// Refill the paging budget, up to one second's worth.
+		mPageTokens += rate * mLastRefill.elapsed() / 1000.0;
+		if (mPageTokens>rate) mPageTokens = rate;
+		mLastRefill.now();
+
+		// Take the subscribers in turn from where the last scan stopped.
+		size_t available = gBTS.SDCCHAvailable();
+		bool defer = gBTS.overload().deferSMS();
+		qp = mQueues.upper_bound(mLastPaged);
+		for (size_t i=0; i<mQueues.size(); i++, ++qp) {
+			if (defer || mPageTokens<1 || paging>=maxPaging || toPage.size()>=available) break;
+			if (qp==mQueues.end()) qp = mQueues.begin();
+			Delivery& delivery = mDeliveries[qp->first];
+			if (delivery.mTransactionID || !delivery.mNextAttempt.passed()) continue;
+			// Mark it busy now; the transaction ID comes below.
+			delivery.mTransactionID = ~0U;
+			delivery.mHeadID = qp->second.front().mID;
+			toPage.push_back(qp->first);
+			mLastPaged = qp->first;
+			mPageTokens -= 1;
+			paging++;
+		}
+	}
+
+	// Page outside of the lock, since MTSMSController() asks the spool about transactions.
+	string proxy = gConfig.getStr("SIP.Proxy.SMS");
+	for (unsigned i=0; i<toPage.size(); i++) {
+		GSM::L3MobileIdentity mobileID(toPage[i].c_str());
+		unsigned ID = 0;
+		// A handset with a channel is busy; try again later.
+		if (!gTransactionTable.findChannel(mobileID)) {
+			TransactionEntry *transaction = new TransactionEntry(proxy.c_str(),mobileID,NULL,
+				GSM::L3CMServiceType::MobileTerminatedShortMessage,GSM::L3CallingPartyBCDNumber(""));
+			ID = transaction->ID();
+			gTransactionTable.add(transaction);
+			LOG(INFO) << "paging " << mobileID << " for " << pending(toPage[i].c_str()) << " spooled SMS";
+			gBTS.pager().addID(mobileID,GSM::SDCCHType,*transaction);
+		}
+		ScopedLock lock(mLock);
+		Delivery& delivery = mDeliveries[toPage[i]];
+		if (ID) {
+			delivery.mTransactionID = ID;
+			mPages++;
+		} else {
+			delivery.mTransactionID = 0;
+			delivery.mNextAttempt.future(retry*1000);
+		}
+	}
+}
+
+
+void SMSSpool::serviceLoop()
+{
+	while (true) {
+		dispatch();
+		ScopedLock lock(mLock);
+		// Wake for new messages, or to page more as the budget refills.
+		mServiceSignal.wait(mLock,250);
+	}
+}
+
+
+void *Control::SMSSpoolServiceLoopAdapter(SMSSpool *spool)
+{
+	spool->serviceLoop();
+	return NULL;
+}
+
+
+void SMSSpool::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	if (!mMap) {
+		os << "off";
+		return;
+	}
+	os << "waiting " << mCount << " for " << mQueues.size() << " subscribers, max " << mMaxCount
+		<< " added " << mAdded << " duplicates " << mDuplicates << " rejected " << mRejected
+		<< " delivered " << mDelivered << " expired " << mExpired << " pages " << mPages
+		<< " sessions " << mSessions << " log " << mEnd << "/" << mSize << " bytes"
+		<< " compactions " << mCompactions << " load " << mLoadTime << " ms";
+}
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,260 @@
+/**@file A durable spool for mobile-terminated SMS. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#ifndef SMSSPOOL_H
+#define SMSSPOOL_H
+
+#include <stdint.h>
+#include <time.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <ostream>
+
+#include <Threads.h>
+#include <Timeval.h>
+
+
+namespace Control {
+
+
+/**
+	A durable spool of MT-SMS waiting for delivery.
+
+	When SMS.Spool names a file, an incoming SIP MESSAGE is appended to
+	the spool and answered with 200 OK right away, instead of being held
+	open while the handset is paged.  The spool is an append-only log in
+	a memory-mapped file of SMS.Spool.Size MB.  A delivered or expired
+	message is cancelled by a later record, and when the file fills up,
+	the undelivered messages are copied to a new file that replaces it.
+	Each record has a checksum, so a record torn by a crash is found when
+	the log is read at startup, and the log ends there.  With SMS.Spool.Sync,
+	each message is on disk before it is acknowledged.
+
+	The messages are indexed by IMSI in arrival order.  A service thread
+	pages the subscribers with waiting messages, no more than
+	SMS.Spool.PageRate per second and SMS.Spool.MaxPaging at a time, taking
+	subscribers in turn.  When a handset answers, MTSMSController() delivers
+	its messages in order, up to SMS.MaxPerSession on one SDCCH.
+	A handset that does not answer is paged again after
+	SMS.Spool.RetryInterval seconds, until its messages are
+	SMS.Spool.MaxAge seconds old.
+*/
+class SMSSpool {
+
+	public:
+
+	/** One spooled message. */
+	class Message {
+		public:
+		uint64_t mID;
+		time_t mTime;					///< arrival time
+		std::string mIMSI;
+		std::string mCallID;			///< SIP call ID, to catch retransmissions
+		std::string mCalling;			///< calling party digits
+		std::string mContentType;
+		std::string mBody;
+	};
+
+	private:
+
+	/** Where a message is in the log. */
+	class Entry {
+		public:
+		uint64_t mID;
+		size_t mOffset;
+		time_t mTime;
+		std::string mCallID;
+		Entry(uint64_t wID, size_t wOffset, time_t wTime, const std::string& wCallID)
+			:mID(wID),mOffset(wOffset),mTime(wTime),mCallID(wCallID)
+		{ }
+	};
+
+	typedef std::deque<Entry> Queue;
+	typedef std::map<std::string,Queue> QueueMap;
+
+	/** The delivery state of a subscriber with waiting messages. */
+	class Delivery {
+		public:
+		unsigned mTransactionID;		///< the paging transaction, 0 if none
+		uint64_t mHeadID;				///< the first waiting message when it was paged
+		Timeval mNextAttempt;
+		Delivery()
+			:mTransactionID(0),mHeadID(0)
+		{ }
+	};
+
+	typedef std::map<std::string,Delivery> DeliveryMap;
+
+	mutable Mutex mLock;
+	std::string mPath;
+	int mFD;
+	char *mMap;						///< the log file, mapped, or NULL if the spool is off
+	size_t mSize;					///< file size
+	size_t mMinSize;				///< configured file size, kept by compaction
+	size_t mEnd;					///< end of the last record
+	size_t mLiveBytes;				///< bytes in records of waiting messages
+	uint64_t mNextID;
+	bool mSync;						///< msync each record
+	QueueMap mQueues;				///< waiting messages, by IMSI, oldest first
+	std::map<std::string,uint64_t> mCallIDs;	///< waiting messages, by SIP call ID
+	std::map<std::string,time_t> mDoneCallIDs;	///< call IDs of messages gone from the spool, with the time to forget them
+	size_t mCount;					///< waiting messages
+
+	DeliveryMap mDeliveries;
+	std::string mLastPaged;			///< where the round-robin page scan left off
+	double mPageTokens;				///< paging rate budget
+	Timeval mLastRefill;
+	Thread mServiceThread;
+	Signal mServiceSignal;
+	bool mRunning;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mAdded;
+	unsigned long mDuplicates;		///< retransmitted MESSAGEs
+	unsigned long mRejected;		///< spool full or broken
+	unsigned long mDelivered;
+	unsigned long mExpired;
+	unsigned long mPages;
+	unsigned long mSessions;		///< SDCCH sessions that delivered anything
+	unsigned long mCompactions;
+	size_t mMaxCount;
+	long mLoadTime;					///< ms to read the log at startup
+	//@}
+
+	public:
+
+	SMSSpool();
+
+	~SMSSpool();
+
+	/**
+		Open the spool named by SMS.Spool, if any, and read it.
+		@return true if the spool is on.
+	*/
+	bool open();
+
+	/**
+		Open a spool file, creating it if needed, and read it.
+		@param path The file.
+		@param size The file size in bytes.
+		@param sync Sync each record to disk.
+		@return true on success.
+	*/
+	bool open(const char* path, size_t size, bool sync);
+
+	/** True if the spool is open. */
+	bool enabled() const { return mMap!=NULL; }
+
+	/** Start paging for the waiting messages. */
+	void start();
+
+	/**
+		Add a message.
+		A message with the call ID of a waiting message is taken for a
+		retransmission, and accepted without being added again.
+		@return true if the message is in the spool.
+	*/
+	bool add(const char* IMSI, const char* callID, const char* calling,
+		const char* contentType, const char* body, size_t length);
+
+	/**
+		Get the oldest waiting message for a subscriber.
+		@return true if there is one.
+	*/
+	bool head(const char* IMSI, Message& message) const;
+
+	/**
+		Remove a message, after delivery.
+		@return true if it was waiting.
+	*/
+	bool remove(const char* IMSI, uint64_t ID);
+
+	/** Number of messages waiting for a subscriber. */
+	size_t pending(const char* IMSI) const;
+
+	/** Number of messages waiting. */
+	size_t size() const;
+
+	/** True if a transaction is a spool delivery attempt for a subscriber. */
+	bool owns(const char* IMSI, unsigned transactionID) const;
+
+	/** Note the end of an SDCCH session that delivered messages. */
+	void sessionDone(const char* IMSI, unsigned delivered);
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+
+	private:
+
+	/** Close the file.  Caller holds mLock. */
+	void close();
+
+	/** Read the log into the index.  Caller holds mLock. */
+	void load();
+
+	/** Read a message record.  Caller holds mLock. */
+	bool read(size_t offset, Message& message) const;
+
+	/**
+		Append a record, making room if needed.  Caller holds mLock.
+		@return The record offset, or 0 on failure.
+	*/
+	size_t append(uint32_t type, uint64_t ID, time_t when, const std::string& payload);
+
+	/** Copy the waiting messages to a new file.  Caller holds mLock. */
+	bool compact();
+
+	/** Take a message out of the index.  Caller holds mLock. */
+	void unindex(QueueMap::iterator queue);
+
+	/** Remember the call ID of a message that left the spool, to catch retransmissions.  Caller holds mLock. */
+	void retire(const std::string& callID, time_t when);
+
+	/** Expire old messages and page subscribers. */
+	void dispatch();
+
+	/** The paging loop. */
+	void serviceLoop();
+
+	friend void *SMSSpoolServiceLoopAdapter(SMSSpool*);
+};
+
+void *SMSSpoolServiceLoopAdapter(SMSSpool*);
+
+
+};	// namespace Control
+
+
+/** The MT-SMS spool. */
+extern Control::SMSSpool gSMSSpool;
+
+
+#endif
+// vim: ts=4 sw=4
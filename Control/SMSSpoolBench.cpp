@@ -0,0 +1,377 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+	MT-SMS spool benchmark.
+
+	The first part measures the spool itself: messages for a population of
+	subscribers are added with and without SMS.Spool.Sync, the spool is
+	reopened to time recovery, and every queue is drained to check that
+	each subscriber gets its messages in arrival order.  A small spool is
+	then filled past its size to exercise compaction.
+
+	The second part is a time-stepped model of delivery, since paging and
+	the SDCCHs cannot run here.  MT-SMS arrive as a Poisson process for a
+	small population, so that some subscribers have several waiting.
+	A delivery pages the handset (paging delay, no SDCCH), then holds an
+	SDCCH for the channel setup plus a fixed time per SMS.  The legacy
+	model pages each SMS separately, one session per message, as the
+	old MESSAGE path did.  The direct model still pages for each SMS, but
+	the first session delivers all the messages waiting, up to
+	SMS.MaxPerSession, as MTSMSController() does without a spool.
+	The spool model pages each subscriber once for up to SMS.MaxPerSession
+	messages, limited by the page rate and the number of pages outstanding,
+	as SMSSpool::dispatch() does.
+
+	The benchmark reports SMS delivered per second, the mean and worst
+	delay, the SDCCH seconds used per SMS, and the messages still waiting.
+
+	usage: SMSSpoolBench [file] [seconds] [rate] [SDCCHs] [subscribers]
+		file		spool file to create, default /tmp/SMSSpoolBench.spool
+		rate		offered MT-SMS per second
+		SDCCHs		number of SDCCHs
+		subscribers	size of the subscriber population
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <map>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <Configuration.h>
+
+#include <TRXManager.h>
+#include <GSMConfig.h>
+
+#include "ControlCommon.h"
+#include "TransactionTable.h"
+#include "SMSSpool.h"
+
+#include <SIPInterface.h>
+#include <Globals.h>
+
+#include <Logger.h>
+#include <PhysicalStatus.h>
+#include <SubscriberRegistry.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+using namespace Control;
+
+
+/** A 160-character SMS as an RP-DATA in hex, about what smqueue sends. */
+static const string sampleBody(330,'4');
+
+
+static string IMSIOf(unsigned subscriber)
+{
+	char digits[16];
+	sprintf(digits,"00101%010u",subscriber);
+	return digits;
+}
+
+
+/** Add messages round robin over the subscribers, and return adds per second. */
+static double fill(SMSSpool& spool, unsigned count, unsigned subscribers, unsigned serial)
+{
+	Timeval start;
+	for (unsigned i=0; i<count; i++) {
+		char callID[32];
+		sprintf(callID,"bench-%u-%u",serial,i);
+		char body[400];
+		sprintf(body,"%u:%s",i,sampleBody.c_str());
+		string IMSI = IMSIOf(i%subscribers);
+		if (!spool.add(IMSI.c_str(),callID,"2125551212","application/vnd.3gpp.sms",body,strlen(body))) {
+			cout << "add " << i << " failed" << endl;
+			exit(1);
+		}
+	}
+	long ms = start.elapsed();
+	return ms ? count*1000.0/ms : 0;
+}
+
+
+/** Drain every queue, checking arrival order, and return the number of messages. */
+static unsigned drain(SMSSpool& spool, unsigned subscribers)
+{
+	unsigned total = 0;
+	for (unsigned s=0; s<subscribers; s++) {
+		string IMSI = IMSIOf(s);
+		uint64_t last = 0;
+		SMSSpool::Message message;
+		while (spool.head(IMSI.c_str(),message)) {
+			// IDs are given in arrival order.
+			unsigned serial = atoi(message.mBody.c_str());
+			if (message.mID<=last || serial%subscribers!=s || message.mIMSI!=IMSI) {
+				cout << "order broken for " << IMSI << ": " << last << " then " << message.mID << endl;
+				exit(1);
+			}
+			last = message.mID;
+			spool.remove(IMSI.c_str(),message.mID);
+			total++;
+		}
+	}
+	return total;
+}
+
+
+/**
+	Time adds, recovery and compaction.
+	Each open() of gSMSSpool closes the file before and recovers it like a restart.
+*/
+static void storageTests(const char* path, unsigned subscribers)
+{
+	SMSSpool& spool = gSMSSpool;
+	const unsigned count = 20000;
+	cout << "storage, " << count << " messages for " << subscribers << " subscribers" << endl;
+	for (int sync=0; sync<2; sync++) {
+		unlink(path);
+		if (!spool.open(path,64<<20,sync)) exit(1);
+		// Synced adds are slow; a tenth of them is enough to time.
+		unsigned n = sync ? count/10 : count;
+		double rate = fill(spool,n,subscribers,sync);
+		// A retransmitted MESSAGE is accepted again without a second copy.
+		char callID[32];
+		sprintf(callID,"bench-%d-0",sync);
+		spool.add(IMSIOf(0).c_str(),callID,"2125551212","application/vnd.3gpp.sms","x",1);
+		if (spool.size()!=n) {
+			cout << "duplicate call ID was spooled" << endl;
+			exit(1);
+		}
+		cout << "  sync " << sync << ": " << fixed << setprecision(0) << rate << " adds/s" << endl;
+	}
+
+	// Recovery, with half of each subscriber's messages delivered before the "restart".
+	if (!spool.open(path,64<<20,false)) exit(1);
+	fill(spool,count,subscribers,2);
+	for (unsigned s=0; s<subscribers; s++) {
+		string IMSI = IMSIOf(s);
+		SMSSpool::Message message;
+		for (unsigned i=0; i<count/subscribers/2 && spool.head(IMSI.c_str(),message); i++) {
+			spool.remove(IMSI.c_str(),message.mID);
+		}
+	}
+	size_t before = spool.size();
+	Timeval start;
+	if (!spool.open(path,64<<20,false)) exit(1);
+	long ms = start.elapsed();
+	size_t waiting = spool.size();
+	unsigned drained = drain(spool,subscribers);
+	cout << "  reopen: " << waiting << " of " << before << " messages in " << ms << " ms, "
+		<< drained << " drained in order" << endl;
+	if (waiting!=before || drained!=waiting) exit(1);
+
+	// Compaction: a 1 MB spool holds about 2500 of these.  Remove most of each
+	// round while adding, so that the spool both compacts and has to grow.
+	unlink(path);
+	if (!spool.open(path,1<<20,false)) exit(1);
+	for (unsigned round=0; round<20; round++) {
+		fill(spool,1000,subscribers,100+round);
+		for (unsigned s=0; s<subscribers; s++) {
+			string IMSI = IMSIOf(s);
+			SMSSpool::Message message;
+			for (unsigned i=0; i<1000/subscribers-1 && spool.head(IMSI.c_str(),message); i++) {
+				spool.remove(IMSI.c_str(),message.mID);
+			}
+		}
+	}
+	waiting = spool.size();
+	if (!spool.open(path,1<<20,false)) exit(1);
+	if (spool.size()!=waiting) {
+		cout << "compacted spool reopened with " << spool.size() << " of " << waiting << " messages" << endl;
+		exit(1);
+	}
+	drained = drain(spool,subscribers);
+	cout << "  compaction: " << waiting << " left after 20000 adds to a 1 MB spool, "
+		<< drained << " drained in order" << endl;
+	cout << "  ";
+	spool.dump(cout);
+	cout << endl;
+	unlink(path);
+	if (drained!=waiting) exit(1);
+}
+
+
+
+/**@name Delivery model parameters, seconds. */
+//@{
+static const double stepTime = 0.05;
+static const double pagingDelay = 1.0;		///< page to channel request
+static const double setupTime = 1.5;		///< SDCCH assignment to first CP-DATA
+static const double perSMSTime = 1.2;		///< CP-DATA to the final CP-ACK
+static const double releaseTime = 0.5;		///< channel release
+//@}
+
+
+/** Delivery statistics for one run. */
+struct Result {
+	unsigned delivered;
+	double totalDelay;
+	double maxDelay;
+	double SDCCHTime;
+	unsigned sessions;
+	unsigned waiting;
+
+	Result()
+		:delivered(0),totalDelay(0),maxDelay(0),SDCCHTime(0),sessions(0),waiting(0)
+	{}
+};
+
+
+/** One subscriber in the model. */
+struct Subscriber {
+	deque<double> waiting;		///< arrival times
+	double busyUntil;			///< end of the current page or session
+	Subscriber():busyUntil(0) {}
+};
+
+
+/**
+	Run the model.
+	@param perSession Messages per session; 1 with no page limits is the legacy path.
+	@param pageRate Pages per second, 0 for no limit.
+	@param maxPaging Pages outstanding at once, 0 for no limit.
+*/
+static Result runModel(const vector<pair<double,unsigned> >& arrivals, double seconds,
+	unsigned SDCCHs, unsigned subscribers, unsigned perSession, double pageRate, unsigned maxPaging)
+{
+	Result result;
+	vector<Subscriber> subs(subscribers);
+	// SDCCH release times, and page response times waiting for an SDCCH.
+	vector<double> SDCCHFree(SDCCHs,0);
+	multimap<double,unsigned> pages;
+	double tokens = 0;
+	unsigned next = 0;
+	unsigned lastPaged = 0;
+	for (double now=0; now<seconds; now+=stepTime) {
+		while (next<arrivals.size() && arrivals[next].first<=now) {
+			subs[arrivals[next].second].waiting.push_back(arrivals[next].first);
+			next++;
+		}
+		// Page responses take an SDCCH if one is free, or are lost and paged again later.
+		while (pages.size() && pages.begin()->first<=now) {
+			unsigned s = pages.begin()->second;
+			pages.erase(pages.begin());
+			unsigned chan = 0;
+			while (chan<SDCCHs && SDCCHFree[chan]>now) chan++;
+			if (chan==SDCCHs) {
+				subs[s].busyUntil = now;
+				continue;
+			}
+			unsigned n = subs[s].waiting.size();
+			if (n>perSession) n = perSession;
+			double t = now + setupTime;
+			for (unsigned i=0; i<n; i++) {
+				t += perSMSTime;
+				double delay = t - subs[s].waiting.front();
+				subs[s].waiting.pop_front();
+				result.delivered++;
+				result.totalDelay += delay;
+				if (delay>result.maxDelay) result.maxDelay = delay;
+			}
+			t += releaseTime;
+			result.SDCCHTime += t - now;
+			result.sessions++;
+			SDCCHFree[chan] = t;
+			subs[s].busyUntil = t;
+		}
+		// Page subscribers with waiting messages, round robin.
+		if (pageRate) {
+			tokens += pageRate*stepTime;
+			if (tokens>pageRate) tokens = pageRate;
+		}
+		for (unsigned i=0; i<subscribers; i++) {
+			if (pageRate && tokens<1) break;
+			if (maxPaging && pages.size()>=maxPaging) break;
+			unsigned s = (lastPaged+1+i) % subscribers;
+			if (subs[s].waiting.size()==0 || subs[s].busyUntil>now) continue;
+			pages.insert(pair<double,unsigned>(now+pagingDelay,s));
+			subs[s].busyUntil = now + pagingDelay + seconds;
+			if (pageRate) tokens -= 1;
+			lastPaged = s;
+		}
+	}
+	for (unsigned s=0; s<subscribers; s++) result.waiting += subs[s].waiting.size();
+	return result;
+}
+
+
+static void report(const char* name, double seconds, const Result& r)
+{
+	cout << setw(12) << name
+		<< setw(10) << fixed << setprecision(2) << r.delivered/seconds
+		<< setw(10) << (r.delivered ? r.totalDelay/r.delivered : 0.0)
+		<< setw(10) << r.maxDelay
+		<< setw(12) << (r.delivered ? r.SDCCHTime/r.delivered : 0.0)
+		<< setw(10) << (r.sessions ? (double)r.delivered/r.sessions : 0.0)
+		<< setw(9) << r.waiting
+		<< endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+	const char *path = argc>1 ? argv[1] : "/tmp/SMSSpoolBench.spool";
+	double seconds = argc>2 ? atof(argv[2]) : 600;
+	double rate = argc>3 ? atof(argv[3]) : 4;
+	unsigned SDCCHs = argc>4 ? atoi(argv[4]) : 8;
+	unsigned subscribers = argc>5 ? atoi(argv[5]) : 100;
+
+	storageTests(path,subscribers);
+
+	srandom(1);
+	vector<pair<double,unsigned> > arrivals;
+	double t = 0;
+	while (true) {
+		t -= log((random()+1.0)/(RAND_MAX+2.0)) / rate;
+		if (t>=seconds) break;
+		arrivals.push_back(pair<double,unsigned>(t,random()%subscribers));
+	}
+	double pageRate = gConfig.defines("SMS.Spool.PageRate") ? gConfig.getNum("SMS.Spool.PageRate") : 4;
+	unsigned maxPaging = gConfig.defines("SMS.Spool.MaxPaging") ? gConfig.getNum("SMS.Spool.MaxPaging") : 8;
+	unsigned perSession = gConfig.defines("SMS.MaxPerSession") ? gConfig.getNum("SMS.MaxPerSession") : 10;
+
+	cout << endl << "delivery model, " << arrivals.size() << " SMS at " << rate << "/s for "
+		<< subscribers << " subscribers, " << SDCCHs << " SDCCHs, " << seconds << " s" << endl;
+	cout << setw(12) << "path" << setw(10) << "SMS/s" << setw(10) << "meanDelay"
+		<< setw(10) << "maxDelay" << setw(12) << "SDCCHs/SMS" << setw(10) << "SMS/sess"
+		<< setw(9) << "waiting" << endl;
+	report("legacy",seconds,runModel(arrivals,seconds,SDCCHs,subscribers,1,0,0));
+	report("direct",seconds,runModel(arrivals,seconds,SDCCHs,subscribers,perSession,0,0));
+	report("spool x1",seconds,runModel(arrivals,seconds,SDCCHs,subscribers,1,pageRate,maxPaging));
+	report("spool",seconds,runModel(arrivals,seconds,SDCCHs,subscribers,perSession,pageRate,maxPaging));
+	return 0;
+}
+
+// vim: ts=4 sw=4
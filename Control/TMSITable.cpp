@@ -33,8 +33,15 @@
 #include <GSML3MMMessages.h>
 
 #include <string>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <iostream>
 #include <iomanip>
+#include <vector>
 
 using namespace std;
 using namespace Control;
@@ -63,7 +70,85 @@ static const char* createTMSITable = {
 
 
 
+static const char* insertTMSI = {
+	"INSERT OR IGNORE INTO TMSI_TABLE (TMSI,IMSI,CREATED,ACCESSED) VALUES (?,?,?,?)"
+};
+
+static const char* updateTMSI = {
+	"UPDATE TMSI_TABLE SET "
+		"ACCESSED=?, IMEI=?, L3TI=?, A5_SUPPORT=?, POWER_CLASS=?, "
+		"OLD_TMSI=?, PREV_MCC=?, PREV_MNC=?, PREV_LAC=? "
+	"WHERE TMSI=?"
+};
+
+
+
+/** The start of a snapshot file. */
+struct SnapshotHeader {
+	char magic[16];
+	uint32_t serial;		///< user_version of the database written with the snapshot
+	uint32_t reserved;		///< first TMSI not reserved in the database
+	uint32_t count;			///< number of records
+	uint32_t checksum;		///< of the fields above and the records
+};
+
+/** One record of a snapshot file, followed by its IMSI and IMEI. */
+struct SnapshotRecord {
+	int64_t created;
+	int64_t accessed;
+	int64_t oldTMSI;
+	uint32_t TMSI;
+	uint32_t L3TI;
+	int32_t A5Support;
+	int32_t powerClass;
+	int32_t prevMCC;
+	int32_t prevMNC;
+	int32_t prevLAC;
+	uint16_t IMSILength;
+	uint16_t IMEILength;
+};
+
+static const char snapshotMagic[16] = "OpenBTS TMSI 1\n";
+
+
+/** FNV-1a, over the header fields after the magic, without the checksum, and the records. */
+static uint32_t checksum(const SnapshotHeader& header, const char* records, size_t length)
+{
+	uint32_t hash = 2166136261U;
+	const unsigned char *p = (const unsigned char*)&header.serial;
+	for (size_t i=0; i<3*sizeof(uint32_t); i++) hash = (hash ^ p[i]) * 16777619U;
+	p = (const unsigned char*)records;
+	for (size_t i=0; i<length; i++) hash = (hash ^ p[i]) * 16777619U;
+	return hash;
+}
+
+
+
+
+/** Read an integer column, with NULL as -1. */
+static long long columnInt(sqlite3_stmt *stmt, int col)
+{
+	if (sqlite3_column_type(stmt,col)==SQLITE_NULL) return -1;
+	return sqlite3_column_int64(stmt,col);
+}
+
+/** Bind an integer parameter, with negative values as NULL. */
+static void bindInt(sqlite3_stmt *stmt, int param, long long val)
+{
+	if (val<0) sqlite3_bind_null(stmt,param);
+	else sqlite3_bind_int64(stmt,param,val);
+}
+
+
+
+
 TMSITable::TMSITable(const char* wPath)
+	:mDirtyCount(0),mClearPending(false),mNextTMSI(1),mReservedTMSI(1),
+	mInsert(NULL),mUpdate(NULL),
+	mLookups(0),mHits(0),mAssignments(0),
+	mFlushes(0),mRows(0),mFailures(0),mLastFlushTime(0),mLoadTime(0),
+	mLoadSource("none"),mSnapshots(0),mLastSnapshotTime(0),
+	mLoaded(false),mSerial(0),mSnapshotSerial(0)
 {
 	int rc = sqlite3_open(wPath,&mDB);
 	if (rc) {
@@ -72,80 +157,320 @@ TMSITable::TMSITable(const char* wPath)
 		mDB = NULL;
 		return;
 	}
+	sqlite3_setup(mDB);
 	if (!sqlite3_command(mDB,createTMSITable)) {
 		LOG(EMERG) << "Cannot create TMSI table";
 	}
+	if (sqlite3_prepare_statement(mDB,&mInsert,insertTMSI) || sqlite3_prepare_statement(mDB,&mUpdate,updateTMSI)) {
+		LOG(EMERG) << "Cannot prepare TMSI table updates";
+		if (mInsert) sqlite3_finalize(mInsert);
+		mInsert = NULL;
+		mUpdate = NULL;
+	}
 }
 
 
 
 TMSITable::~TMSITable()
 {
-	if (mDB) sqlite3_close(mDB);
+	if (mInsert) sqlite3_finalize(mInsert);
+	if (mUpdate) sqlite3_finalize(mUpdate);
+	if (!mDB) return;
+	sqlite3_clear_cache(mDB);
+	sqlite3_close(mDB);
+}
+
+
+
+void TMSITable::load()
+{
+	ScopedLock lock(mLock);
+	if (mLoaded) return;
+	mLoaded = true;
+	if (!mDB) return;
+	Timeval start;
+
+	// The count of committed flushes, to match against the snapshot.
+	sqlite3_stmt *stmt;
+	if (!sqlite3_prepare_statement(mDB,&stmt,"PRAGMA user_version")) {
+		if (sqlite3_run_query(mDB,stmt)==SQLITE_ROW) mSerial = (unsigned)sqlite3_column_int64(stmt,0);
+		sqlite3_finalize(stmt);
+	}
+
+	bool fromSnapshot = false;
+	if (gConfig.defines("Control.Reporting.TMSISnapshot")) {
+		fromSnapshot = loadSnapshot(gConfig.getStr("Control.Reporting.TMSISnapshot"));
+	}
+	if (fromSnapshot) mLoadSource = "snapshot";
+	else {
+		// Drop whatever a bad snapshot left behind.
+		mRecords.clear();
+		mByIMSI.clear();
+		mNextTMSI = 1;
+		mLoadSource = "database";
+		loadDatabase();
+	}
+
+	// The AUTOINCREMENT counter is the top of the last reserved block,
+	// which may be past any record that made it to the database.
+	unsigned reserved = 0;
+	if (!sqlite3_prepare_statement(mDB,&stmt,"SELECT seq FROM sqlite_sequence WHERE name='TMSI_TABLE'")) {
+		if (sqlite3_run_query(mDB,stmt)==SQLITE_ROW) reserved = (unsigned)sqlite3_column_int64(stmt,0);
+		sqlite3_finalize(stmt);
+	}
+	if (mRecords.size() && reserved<mRecords.rbegin()->first) reserved = mRecords.rbegin()->first;
+	if (mNextTMSI<reserved+1) mNextTMSI = reserved + 1;
+	mReservedTMSI = mNextTMSI;
+	mLoadTime = start.elapsed();
+	LOG(INFO) << "loaded " << mRecords.size() << " TMSIs from " << mLoadSource << " in " << mLoadTime << " ms, next TMSI " << mNextTMSI;
+}
+
+
+void TMSITable::loadDatabase()
+{
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_statement(mDB,&stmt,
+			"SELECT TMSI,IMSI,CREATED,ACCESSED,IMEI,L3TI,A5_SUPPORT,POWER_CLASS,"
+			"OLD_TMSI,PREV_MCC,PREV_MNC,PREV_LAC FROM TMSI_TABLE")) {
+		LOG(EMERG) << "Cannot read TMSI table";
+		return;
+	}
+	while (sqlite3_run_query(mDB,stmt)==SQLITE_ROW) {
+		const unsigned char* IMSI = sqlite3_column_text(stmt,1);
+		if (!IMSI) continue;
+		unsigned TMSI = (unsigned)sqlite3_column_int64(stmt,0);
+		Record& rec = mRecords[TMSI];
+		rec.mTMSI = TMSI;
+		rec.mIMSI = (const char*)IMSI;
+		rec.mCreated = sqlite3_column_int64(stmt,2);
+		rec.mAccessed = sqlite3_column_int64(stmt,3);
+		const unsigned char* IMEI = sqlite3_column_text(stmt,4);
+		if (IMEI) rec.mIMEI = (const char*)IMEI;
+		rec.mL3TI = sqlite3_column_int(stmt,5);
+		rec.mA5Support = columnInt(stmt,6);
+		rec.mPowerClass = columnInt(stmt,7);
+		rec.mOldTMSI = columnInt(stmt,8);
+		rec.mPrevMCC = columnInt(stmt,9);
+		rec.mPrevMNC = columnInt(stmt,10);
+		rec.mPrevLAC = columnInt(stmt,11);
+		mByIMSI[rec.mIMSI] = TMSI;
+	}
+	sqlite3_finalize(stmt);
 }
 
 
+bool TMSITable::loadSnapshot(const string& path)
+{
+	int fd = ::open(path.c_str(),O_RDONLY);
+	if (fd<0) {
+		LOG(NOTICE) << "no TMSI snapshot at " << path;
+		return false;
+	}
+	string buffer;
+	struct stat st;
+	if (fstat(fd,&st)==0 && st.st_size>=(off_t)sizeof(SnapshotHeader)) {
+		buffer.resize(st.st_size);
+		size_t done = 0;
+		while (done<buffer.size()) {
+			ssize_t n = ::read(fd,&buffer[done],buffer.size()-done);
+			if (n<=0) break;
+			done += n;
+		}
+		buffer.resize(done);
+	}
+	::close(fd);
+
+	SnapshotHeader header;
+	if (buffer.size()<sizeof(header)) {
+		LOG(WARNING) << "TMSI snapshot " << path << " is truncated";
+		return false;
+	}
+	memcpy(&header,buffer.data(),sizeof(header));
+	const char* records = buffer.data() + sizeof(header);
+	size_t length = buffer.size() - sizeof(header);
+	if (memcmp(header.magic,snapshotMagic,sizeof(header.magic))!=0 || header.checksum!=checksum(header,records,length)) {
+		LOG(WARNING) << "TMSI snapshot " << path << " is corrupt";
+		return false;
+	}
+	if (header.serial!=mSerial) {
+		LOG(NOTICE) << "TMSI snapshot " << path << " is of flush " << header.serial << ", the database is at " << mSerial;
+		return false;
+	}
+
+	size_t offset = 0;
+	for (unsigned i=0; i<header.count; i++) {
+		SnapshotRecord sr;
+		if (offset+sizeof(sr)>length) return false;
+		memcpy(&sr,records+offset,sizeof(sr));
+		offset += sizeof(sr);
+		if (offset+sr.IMSILength+sr.IMEILength>length) return false;
+		// The records are in TMSI order, so each one goes at the end of the map.
+		Record& rec = mRecords.insert(mRecords.end(),RecordMap::value_type(sr.TMSI,Record()))->second;
+		rec.mTMSI = sr.TMSI;
+		rec.mIMSI.assign(records+offset,sr.IMSILength);
+		offset += sr.IMSILength;
+		rec.mIMEI.assign(records+offset,sr.IMEILength);
+		offset += sr.IMEILength;
+		rec.mCreated = sr.created;
+		rec.mAccessed = sr.accessed;
+		rec.mL3TI = sr.L3TI;
+		rec.mA5Support = sr.A5Support;
+		rec.mPowerClass = sr.powerClass;
+		rec.mOldTMSI = sr.oldTMSI;
+		rec.mPrevMCC = sr.prevMCC;
+		rec.mPrevMNC = sr.prevMNC;
+		rec.mPrevLAC = sr.prevLAC;
+		mByIMSI[rec.mIMSI] = sr.TMSI;
+	}
+	mNextTMSI = header.reserved;
+	mSnapshotSerial = mSerial;
+	return true;
+}
+
+
+void TMSITable::serialize(string& buffer, unsigned serial, unsigned reserved) const
+{
+	SnapshotHeader header;
+	memcpy(header.magic,snapshotMagic,sizeof(header.magic));
+	header.serial = serial;
+	header.reserved = reserved;
+	header.count = mRecords.size();
+	buffer.clear();
+	buffer.reserve(sizeof(header) + mRecords.size()*(sizeof(SnapshotRecord)+32));
+	buffer.append((const char*)&header,sizeof(header));
+	for (RecordMap::const_iterator p=mRecords.begin(); p!=mRecords.end(); ++p) {
+		const Record& rec = p->second;
+		SnapshotRecord sr;
+		sr.created = rec.mCreated;
+		sr.accessed = rec.mAccessed;
+		sr.oldTMSI = rec.mOldTMSI;
+		sr.TMSI = rec.mTMSI;
+		sr.L3TI = rec.mL3TI;
+		sr.A5Support = rec.mA5Support;
+		sr.powerClass = rec.mPowerClass;
+		sr.prevMCC = rec.mPrevMCC;
+		sr.prevMNC = rec.mPrevMNC;
+		sr.prevLAC = rec.mPrevLAC;
+		sr.IMSILength = rec.mIMSI.size();
+		sr.IMEILength = rec.mIMEI.size();
+		buffer.append((const char*)&sr,sizeof(sr));
+		buffer.append(rec.mIMSI);
+		buffer.append(rec.mIMEI);
+	}
+	header.checksum = checksum(header,buffer.data()+sizeof(header),buffer.size()-sizeof(header));
+	buffer.replace(0,sizeof(header),(const char*)&header,sizeof(header));
+}
+
+
+bool TMSITable::writeSnapshot(const string& path, const string& buffer)
+{
+	// Write a new file and rename it, so that a crash leaves the old one.
+	string newPath = path + ".new";
+	int fd = ::open(newPath.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0600);
+	if (fd<0) {
+		LOG(ALERT) << "cannot create TMSI snapshot " << newPath;
+		return false;
+	}
+	size_t done = 0;
+	while (done<buffer.size()) {
+		ssize_t n = ::write(fd,buffer.data()+done,buffer.size()-done);
+		if (n<=0) break;
+		done += n;
+	}
+	bool ok = done==buffer.size() && fsync(fd)==0;
+	::close(fd);
+	ok = ok && rename(newPath.c_str(),path.c_str())==0;
+	if (!ok) {
+		LOG(ALERT) << "cannot write TMSI snapshot " << path;
+		unlink(newPath.c_str());
+	}
+	return ok;
+}
+
+
+
+void TMSITable::start()
+{
+	mFlushThread.start((void*(*)(void*))TMSITableFlushLoopAdapter,this);
+}
+
+
+
+
+TMSITable::Record* TMSITable::find(const char* IMSI)
+{
+	IMSIMap::const_iterator p = mByIMSI.find(IMSI);
+	if (p==mByIMSI.end()) return NULL;
+	RecordMap::iterator r = mRecords.find(p->second);
+	assert(r!=mRecords.end());
+	return &r->second;
+}
+
 
 
 unsigned TMSITable::assign(const char* IMSI, const GSM::L3LocationUpdatingRequest* lur)
 {
 	// Create or find an entry based on IMSI.
 	// Return assigned TMSI.
-	assert(mDB);
 
 	LOG(DEBUG) << "IMSI=" << IMSI;
+	// Never hand out a TMSI before the reserved block is known.
+	load();
+	ScopedLock lock(mLock);
 	// Is there already a record?
-	unsigned TMSI;
-	if (sqlite3_single_lookup(mDB,"TMSI_TABLE","IMSI",IMSI,"TMSI",TMSI)) {
-		LOG(DEBUG) << "found TMSI " << TMSI;
-		touch(TMSI);
-		return TMSI;
+	Record* found = find(IMSI);
+	if (found) {
+		LOG(DEBUG) << "found TMSI " << found->mTMSI;
+		touch(*found);
+		return found->mTMSI;
+	}
+
+	if (mDB && mNextTMSI>=mReservedTMSI) {
+		// The flush thread normally keeps a block reserved ahead of us.
+		mLock.unlock();
+		flush();
+		mLock.lock();
+		found = find(IMSI);
+		if (found) return found->mTMSI;
+		if (mNextTMSI>=mReservedTMSI) LOG(ERR) << "cannot reserve TMSIs in the database";
 	}
 
 	// Create a new record.
 	LOG(NOTICE) << "new entry for IMSI " << IMSI;
-	char query[1000];
-	unsigned now = (unsigned)time(NULL);
-	if (!lur) {
-		sprintf(query,
-				"INSERT INTO TMSI_TABLE (IMSI,CREATED,ACCESSED) "
-				"VALUES ('%s',%u,%u)",
-				IMSI,now,now);
-	} else {
+	Record& rec = mRecords[mNextTMSI];
+	rec.mTMSI = mNextTMSI++;
+	rec.mIMSI = IMSI;
+	rec.mCreated = time(NULL);
+	rec.mAccessed = rec.mCreated;
+	if (lur) {
 		const GSM::L3LocationAreaIdentity &lai = lur->LAI();
 		const GSM::L3MobileIdentity &mid = lur->mobileID();
-		if (mid.type()==GSM::TMSIType) {
-			sprintf(query,
-					"INSERT INTO TMSI_TABLE (IMSI,CREATED,ACCESSED,PREV_MCC,PREV_MNC,PREV_LAC,OLD_TMSI) "
-					"VALUES ('%s',%u,%u,%u,%u,%u,%u)",
-					IMSI,now,now,lai.MCC(),lai.MNC(),lai.LAC(),mid.TMSI());
-		} else {
-			sprintf(query,
-					"INSERT INTO TMSI_TABLE (IMSI,CREATED,ACCESSED,PREV_MCC,PREV_MNC,PREV_LAC) "
-					"VALUES ('%s',%u,%u,%u,%u,%u)",
-					IMSI,now,now,lai.MCC(),lai.MNC(),lai.LAC());
-		}
-	}
-	if (!sqlite3_command(mDB,query)) {
-		LOG(ALERT) << "TMSI creation failed";
-		return 0;
+		rec.mPrevMCC = lai.MCC();
+		rec.mPrevMNC = lai.MNC();
+		rec.mPrevLAC = lai.LAC();
+		if (mid.type()==GSM::TMSIType) rec.mOldTMSI = mid.TMSI();
 	}
-	if (!sqlite3_single_lookup(mDB,"TMSI_TABLE","IMSI",IMSI,"TMSI",TMSI)) {
-		LOG(ERR) << "TMSI database inconsistancy";
-		return 0;
-	}
-	return TMSI;
+	mByIMSI[rec.mIMSI] = rec.mTMSI;
+	mAssignments++;
+	dirty(rec);
+	return rec.mTMSI;
 }
 	
 
 
-void TMSITable::touch(unsigned TMSI) const
+void TMSITable::dirty(const Record& rec) const
+{
+	if (rec.mDirty) return;
+	rec.mDirty = true;
+	mDirtyCount++;
+}
+
+
+void TMSITable::touch(const Record& rec) const
 {
 	// Update timestamp.
-	char query[100];
-	sprintf(query,"UPDATE TMSI_TABLE SET ACCESSED = %u WHERE TMSI == %u",
-		(unsigned)time(NULL),TMSI);
-	sqlite3_command(mDB,query);
+	rec.mAccessed = time(NULL);
+	dirty(rec);
 }
 
 
@@ -153,16 +478,26 @@ void TMSITable::touch(unsigned TMSI) const
 // Returned string must be free'd by the caller.
 char* TMSITable::IMSI(unsigned TMSI) const
 {
-	char* IMSI = NULL;
-	if (sqlite3_single_lookup(mDB,"TMSI_TABLE","TMSI",TMSI,"IMSI",IMSI)) touch(TMSI);
-	return IMSI;
+	ScopedLock lock(mLock);
+	mLookups++;
+	RecordMap::const_iterator p = mRecords.find(TMSI);
+	if (p==mRecords.end()) return NULL;
+	mHits++;
+	touch(p->second);
+	return strdup(p->second.mIMSI.c_str());
 }
 
 unsigned TMSITable::TMSI(const char* IMSI) const
 {
-	unsigned TMSI=0;
-	if (sqlite3_single_lookup(mDB,"TMSI_TABLE","IMSI",IMSI,"TMSI",TMSI)) touch(TMSI);
-	return TMSI;
+	ScopedLock lock(mLock);
+	mLookups++;
+	IMSIMap::const_iterator p = mByIMSI.find(IMSI);
+	if (p==mByIMSI.end()) return 0;
+	mHits++;
+	RecordMap::const_iterator r = mRecords.find(p->second);
+	assert(r!=mRecords.end());
+	touch(r->second);
+	return p->second;
 }
 
 
@@ -191,71 +526,249 @@ void printAge(unsigned seconds, ostream& os)
 
 void TMSITable::dump(ostream& os) const
 {
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(mDB,&stmt,"SELECT TMSI,IMSI,CREATED,ACCESSED FROM TMSI_TABLE")) {
-		LOG(ERR) << "sqlite3_prepare_statement failed";
-		return;
-	}
+	ScopedLock lock(mLock);
 	time_t now = time(NULL);
-	while (sqlite3_run_query(mDB,stmt)==SQLITE_ROW) {
-		os << hex << setw(8) << sqlite3_column_int64(stmt,0) << ' ' << dec;
-		os << sqlite3_column_text(stmt,1) << ' ';
-		printAge(now-sqlite3_column_int(stmt,2),os); os << ' ';
-		printAge(now-sqlite3_column_int(stmt,3),os); os << ' ';
+	for (RecordMap::const_iterator p=mRecords.begin(); p!=mRecords.end(); ++p) {
+		os << hex << setw(8) << p->first << ' ' << dec;
+		os << p->second.mIMSI << ' ';
+		printAge(now-p->second.mCreated,os); os << ' ';
+		printAge(now-p->second.mAccessed,os); os << ' ';
 		os << endl;
 	}
-	sqlite3_finalize(stmt);
+}
+
+
+void TMSITable::dumpStats(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "records " << mRecords.size() << " lookups " << mLookups << " hits " << mHits
+		<< " assigned " << mAssignments << " pending " << mDirtyCount
+		<< " flushes " << mFlushes << " rows " << mRows << " failures " << mFailures
+		<< " last flush " << mLastFlushTime << " ms load " << mLoadTime << " ms from " << mLoadSource
+		<< " snapshots " << mSnapshots << " last snapshot " << mLastSnapshotTime << " ms";
 }
 
 
 
 void TMSITable::clear()
 {
-	sqlite3_command(mDB,"DELETE FROM TMSI_TABLE WHERE 1");
+	// The database is cleared by the next flush, before anything newer is written.
+	ScopedLock lock(mLock);
+	mRecords.clear();
+	mByIMSI.clear();
+	mDirtyCount = 0;
+	mClearPending = true;
 }
 
 
 
 bool TMSITable::IMEI(const char* IMSI, const char *IMEI)
 {
-	char query[100];
-	sprintf(query,"UPDATE TMSI_TABLE SET IMEI=\"%s\",ACCESSED=%u WHERE IMSI=\"%s\"",
-		IMEI,(unsigned)time(NULL),IMSI);
-	return sqlite3_command(mDB,query);
+	ScopedLock lock(mLock);
+	Record* rec = find(IMSI);
+	if (!rec) return false;
+	rec->mIMEI = IMEI;
+	touch(*rec);
+	return true;
 }
 
 
 
 bool TMSITable::classmark(const char* IMSI, const GSM::L3MobileStationClassmark2& classmark)
 {
-	int A5Bits = (classmark.A5_1()<<2) + (classmark.A5_2()<<1) + classmark.A5_3();
-	char query[100];
-	sprintf(query,
-		"UPDATE TMSI_TABLE SET A5_SUPPORT=%u,ACCESSED=%u,POWER_CLASS=%u "
-		" WHERE IMSI=\"%s\"",
-		A5Bits,(unsigned)time(NULL),classmark.powerClass(),IMSI);
-	return sqlite3_command(mDB,query);
+	ScopedLock lock(mLock);
+	Record* rec = find(IMSI);
+	if (!rec) return false;
+	rec->mA5Support = (classmark.A5_1()<<2) + (classmark.A5_2()<<1) + classmark.A5_3();
+	rec->mPowerClass = classmark.powerClass();
+	touch(*rec);
+	return true;
 }
 
 
 
 unsigned TMSITable::nextL3TI(const char* IMSI)
 {
-	// FIXME -- This should be a single atomic operation.
-	unsigned l3ti;
-	if (!sqlite3_single_lookup(mDB,"TMSI_TABLE","IMSI",IMSI,"L3TI",l3ti)) {
-		LOG(ERR) << "cannot read L3TI from TMSI_TABLE, using randon L3TI";
+	ScopedLock lock(mLock);
+	Record* rec = find(IMSI);
+	if (!rec) {
+		LOG(ERR) << "no L3TI in TMSI_TABLE for " << IMSI << ", using randon L3TI";
 		return random() % 8;
 	}
 	// Note that TI=7 is a reserved value, so value values are 0-6.  See GSM 04.07 11.2.3.1.3.
-	unsigned next = (l3ti+1) % 7;
-	char query[200];
-	sprintf(query,"UPDATE TMSI_TABLE SET L3TI=%u,ACCESSED=%u WHERE IMSI='%s'",
-		next, (unsigned)time(NULL),IMSI);
-	if (!sqlite3_command(mDB,query)) {
-		LOG(ALERT) << "cannot write L3TI to TMSI_TABLE";
-	}
-	return next;
+	rec->mL3TI = (rec->mL3TI+1) % 7;
+	touch(*rec);
+	return rec->mL3TI;
+}
+
+
+
+
+bool TMSITable::write(const Record& rec)
+{
+	sqlite3_bind_int64(mInsert,1,rec.mTMSI);
+	sqlite3_bind_text(mInsert,2,rec.mIMSI.c_str(),-1,SQLITE_STATIC);
+	sqlite3_bind_int64(mInsert,3,rec.mCreated);
+	sqlite3_bind_int64(mInsert,4,rec.mAccessed);
+	int src = sqlite3_run_query(mDB,mInsert);
+	sqlite3_reset(mInsert);
+	sqlite3_clear_bindings(mInsert);
+	if (src!=SQLITE_DONE) return false;
+
+	sqlite3_bind_int64(mUpdate,1,rec.mAccessed);
+	if (rec.mIMEI.size()) sqlite3_bind_text(mUpdate,2,rec.mIMEI.c_str(),-1,SQLITE_STATIC);
+	else sqlite3_bind_null(mUpdate,2);
+	sqlite3_bind_int(mUpdate,3,rec.mL3TI);
+	bindInt(mUpdate,4,rec.mA5Support);
+	bindInt(mUpdate,5,rec.mPowerClass);
+	bindInt(mUpdate,6,rec.mOldTMSI);
+	bindInt(mUpdate,7,rec.mPrevMCC);
+	bindInt(mUpdate,8,rec.mPrevMNC);
+	bindInt(mUpdate,9,rec.mPrevLAC);
+	sqlite3_bind_int64(mUpdate,10,rec.mTMSI);
+	src = sqlite3_run_query(mDB,mUpdate);
+	sqlite3_reset(mUpdate);
+	sqlite3_clear_bindings(mUpdate);
+	return src==SQLITE_DONE;
+}
+
+
+bool TMSITable::reserve(unsigned limit)
+{
+	// sqlite_sequence holds the last TMSI used, so that is one less than the limit.
+	const char* queries[] = {
+		"UPDATE sqlite_sequence SET seq=? WHERE name='TMSI_TABLE'",
+		"INSERT INTO sqlite_sequence (name,seq) VALUES ('TMSI_TABLE',?)"
+	};
+	for (unsigned i=0; i<2; i++) {
+		sqlite3_stmt *stmt = sqlite3_cached_statement(mDB,queries[i]);
+		if (!stmt) return false;
+		sqlite3_bind_int64(stmt,1,limit-1);
+		int src = sqlite3_run_query(mDB,stmt);
+		sqlite3_release_statement(mDB,stmt);
+		if (src!=SQLITE_DONE) return false;
+		if (sqlite3_changes(mDB)) return true;
+	}
+	return false;
+}
+
+
+void TMSITable::flush(bool snapshot)
+{
+	if (!mDB || !mInsert || !mUpdate) return;
+	// Never clear or write the database before it is loaded.
+	load();
+	string snapshotPath;
+	if (snapshot && gConfig.defines("Control.Reporting.TMSISnapshot")) snapshotPath = gConfig.getStr("Control.Reporting.TMSISnapshot");
+	ScopedLock flushLock(mFlushLock);
+
+	// Copy the changed records under the lock and write them without it.
+	std::vector<Record> changed;
+	mLock.lock();
+	bool clearing = mClearPending;
+	mClearPending = false;
+	// Keep at least half a block reserved ahead of the assignments.
+	unsigned reserved = mReservedTMSI;
+	if (mNextTMSI+reserveBlock/2 > reserved) reserved = mNextTMSI + reserveBlock;
+	if (mDirtyCount) {
+		changed.reserve(mDirtyCount);
+		for (RecordMap::iterator p=mRecords.begin(); p!=mRecords.end(); ++p) {
+			if (!p->second.mDirty) continue;
+			changed.push_back(p->second);
+			p->second.mDirty = false;
+		}
+		mDirtyCount = 0;
+	}
+	// Only flushes change mReservedTMSI and mSerial, so they are safe to read without mLock.
+	bool writing = clearing || changed.size() || reserved!=mReservedTMSI;
+	unsigned serial = writing ? mSerial+1 : mSerial;
+	// The records as of this transaction, taken under the same lock as the changes.
+	string buffer;
+	if (snapshotPath.size() && serial!=mSnapshotSerial) serialize(buffer,serial,reserved);
+	mLock.unlock();
+	if (!writing && buffer.size()==0) return;
+
+	Timeval start;
+	unsigned failures = 0;
+	bool committed = true;
+	if (writing) {
+		sqlite3_command(mDB,"BEGIN TRANSACTION");
+		if (clearing) sqlite3_command(mDB,"DELETE FROM TMSI_TABLE WHERE 1");
+		bool reservedOK = reserved==mReservedTMSI || reserve(reserved);
+		if (!reservedOK) reserved = mReservedTMSI;
+		for (unsigned i=0; i<changed.size(); i++) {
+			if (!write(changed[i])) failures++;
+		}
+		// Count the transaction, so that a snapshot can tell if it is current.
+		char setSerial[40];
+		sprintf(setSerial,"PRAGMA user_version=%u",serial);
+		sqlite3_command(mDB,setSerial);
+		committed = sqlite3_command(mDB,"COMMIT");
+	}
+	if (!committed) {
+		LOG(ALERT) << "TMSI table flush of " << changed.size() << " rows failed: " << sqlite3_errmsg(mDB);
+		sqlite3_command(mDB,"ROLLBACK");
+		failures = changed.size();
+	}
+	long elapsed = start.elapsed();
+	LOG(DEBUG) << "wrote " << changed.size() << " rows in " << elapsed << " ms";
+
+	// The snapshot is only good if the transaction it matches is in the database.
+	bool snapshotOK = false;
+	Timeval snapshotStart;
+	if (buffer.size() && committed) snapshotOK = writeSnapshot(snapshotPath,buffer);
+	long snapshotTime = snapshotStart.elapsed();
+
+	ScopedLock lock(mLock);
+	if (committed) {
+		mReservedTMSI = reserved;
+		mSerial = serial;
+	} else {
+		// Try again next time, unless the records were changed or removed in the meantime.
+		if (clearing) mClearPending = true;
+		for (unsigned i=0; i<changed.size(); i++) {
+			RecordMap::iterator p = mRecords.find(changed[i].mTMSI);
+			if (p!=mRecords.end() && p->second.mIMSI==changed[i].mIMSI) dirty(p->second);
+		}
+	}
+	if (snapshotOK) {
+		LOG(INFO) << "wrote TMSI snapshot of " << buffer.size() << " bytes in " << snapshotTime << " ms";
+		mSnapshotSerial = serial;
+		mSnapshots++;
+		mLastSnapshotTime = snapshotTime;
+	}
+	if (!writing) return;
+	mFlushes++;
+	mRows += changed.size() - failures;
+	mFailures += failures;
+	mLastFlushTime = elapsed;
+}
+
+
+void TMSITable::flushLoop()
+{
+	Timeval nextSnapshot;
+	while (true) {
+		// Flush first, to reserve the first block of TMSIs right away.
+		// The first flush also writes the snapshot, if the table was not loaded from a current one.
+		bool snapshot = nextSnapshot.passed();
+		flush(snapshot);
+		if (snapshot) {
+			unsigned snapshotInterval = 300;
+			if (gConfig.defines("Control.Reporting.TMSISnapshotInterval")) snapshotInterval = gConfig.getNum("Control.Reporting.TMSISnapshotInterval");
+			nextSnapshot.future(snapshotInterval*1000);
+		}
+		unsigned interval = 2000;
+		if (gConfig.defines("Control.Reporting.TMSIFlush")) interval = gConfig.getNum("Control.Reporting.TMSIFlush");
+		msleep(interval);
+	}
+}
+
+
+void *Control::TMSITableFlushLoopAdapter(TMSITable *table)
+{
+	table->flushLoop();
+	return NULL;
 }
 
 
@@ -28,12 +28,16 @@
 #define TMSITABLE_H
 
 #include <map>
+#include <string>
+#include <ostream>
+#include <time.h>
 
 #include <Timeval.h>
 #include <Threads.h>
 
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 namespace GSM {
 class L3LocationUpdatingRequest;
@@ -44,19 +48,116 @@ class L3MobileIdentity;
 
 namespace Control {
 
+/**
+	The table of TMSIs assigned by this BTS.
+
+	The whole table is loaded into memory at startup and all lookups
+	and updates are done there, indexed both ways, so the control threads
+	never wait on the database.  A background thread writes the records that
+	changed to the sqlite3 table in one transaction every
+	Control.Reporting.TMSIFlush ms.
+
+	A crash loses at most the changes since the last flush, and the database
+	is always left consistent, since each flush is one transaction.  New TMSIs
+	are handed out from a block that is reserved in the database before it is
+	used, so a TMSI that was given to a handset is never given to another one
+	after a restart, even if its record was lost.
+
+	If Control.Reporting.TMSISnapshot is defined, the flush thread also
+	writes the whole table to that file every
+	Control.Reporting.TMSISnapshotInterval seconds, as packed binary records
+	that load much faster than a scan of the sqlite3 table.  Each flush
+	transaction counts up the user_version of the database, and the snapshot
+	carries the count of the transaction it matches, so a snapshot is used
+	only if the database was not written after it.
+*/
 class TMSITable {
 
 	private:
 
-	sqlite3 *mDB;			///< database connection
-
+	/** One subscriber.  Negative values are NULL in the database. */
+	class Record {
+
+		public:
+
+		unsigned mTMSI;
+		std::string mIMSI;
+		time_t mCreated;
+		mutable time_t mAccessed;
+		std::string mIMEI;
+		unsigned mL3TI;
+		int mA5Support;
+		int mPowerClass;
+		long long mOldTMSI;			///< TMSI in the previous network
+		int mPrevMCC;
+		int mPrevMNC;
+		int mPrevLAC;
+		mutable bool mDirty;		///< changed since the last flush
+
+		Record()
+			:mTMSI(0),mCreated(0),mAccessed(0),mL3TI(0),
+			mA5Support(-1),mPowerClass(-1),mOldTMSI(-1),
+			mPrevMCC(-1),mPrevMNC(-1),mPrevLAC(-1),
+			mDirty(false)
+		{ }
+	};
+
+	typedef std::map<unsigned,Record> RecordMap;
+	typedef std::map<std::string,unsigned> IMSIMap;
+
+	/** Number of TMSIs reserved in the database at a time. */
+	static const unsigned reserveBlock = 1000;
+
+	mutable Mutex mLock;			///< protects the records, the counters and statistics
+	RecordMap mRecords;				///< by TMSI
+	IMSIMap mByIMSI;				///< IMSI to TMSI
+	mutable unsigned mDirtyCount;	///< records not yet flushed
+	bool mClearPending;				///< the table was cleared since the last flush
+	unsigned mNextTMSI;				///< next TMSI to assign
+	unsigned mReservedTMSI;			///< first TMSI not reserved in the database
+
+	Mutex mFlushLock;				///< serializes flushes
+	sqlite3 *mDB;					///< database connection, used only by flushes after startup
+	sqlite3_stmt *mInsert;			///< prepared INSERT OR IGNORE for a new record
+	sqlite3_stmt *mUpdate;			///< prepared UPDATE of one record
+	Thread mFlushThread;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	mutable unsigned long mLookups;
+	mutable unsigned long mHits;
+	unsigned long mAssignments;
+	unsigned long mFlushes;
+	unsigned long mRows;			///< rows written
+	unsigned long mFailures;		///< rows that failed
+	long mLastFlushTime;			///< ms for the last flush
+	long mLoadTime;					///< ms for the warm load
+	const char* mLoadSource;		///< "snapshot" or "database"
+	unsigned long mSnapshots;		///< snapshots written
+	long mLastSnapshotTime;			///< ms for the last snapshot
+	//@}
+
+	bool mLoaded;					///< load() is done, protected by mLock
+	unsigned mSerial;				///< user_version of the database, changed only by flushes
+	unsigned mSnapshotSerial;		///< mSerial of the last snapshot written or loaded
 
 	public:
 
+	/** Open the database.  The table is loaded by load(). */
 	TMSITable(const char*wPath);
 
 	~TMSITable();
 
+	/**
+		Load the table and the reserved TMSI block, from the snapshot if it
+		is current, or else from the database.  Only the first call does
+		anything, so assign() and flush() call it too, in case nobody did.
+	*/
+	void load();
+
+	/** Start the thread that writes the table. */
+	void start();
+
 	/**
 		Create a new entry in the table.
 		@param IMSI	The IMSI to create an entry for.
@@ -75,7 +176,7 @@ class TMSITable {
 
 	/**
 		Find a TMSI in the table.
-		This is a linear-time operation.
+		This is a log-time operation.
 		@param IMSI The IMSI to mach.
 		@return A TMSI value or zero on failure.
 	*/
@@ -83,6 +184,9 @@ class TMSITable {
 
 	/** Write entries as text to a stream. */
 	void dump(std::ostream&) const;
+
+	/** Dump statistics to a stream. */
+	void dumpStats(std::ostream&) const;
 	
 	/** Clear the table completely. */
 	void clear();
@@ -96,12 +200,52 @@ class TMSITable {
 	/** Get the next TI value to use for this IMSI or TMSI. */
 	unsigned nextL3TI(const char* IMSI);
 
+	/**
+		Write the changed records to the database in one transaction.
+		@param snapshot If true, also write the snapshot of the table
+			as of that transaction, if it is configured and the database
+			changed since the last one.
+	*/
+	void flush(bool snapshot=false);
+
 	private:
 
-	/** Update the "accessed" time on a record. */
-	void touch(unsigned TMSI) const;
+	/** Update the "accessed" time on a record.  Caller holds mLock. */
+	void touch(const Record&) const;
+
+	/** Mark a record as changed.  Caller holds mLock. */
+	void dirty(const Record&) const;
+
+	/** Find a record by IMSI.  Caller holds mLock. */
+	Record* find(const char* IMSI);
+
+	/** Load the table from the snapshot file.  Caller holds mLock. */
+	bool loadSnapshot(const std::string& path);
+
+	/** Load the table from the database.  Caller holds mLock. */
+	void loadDatabase();
+
+	/** Serialize the table for a snapshot.  Caller holds mLock. */
+	void serialize(std::string& buffer, unsigned serial, unsigned reserved) const;
+
+	/** Write a serialized snapshot to its file. */
+	bool writeSnapshot(const std::string& path, const std::string& buffer);
+
+	/** Write one record with the prepared statements.  Caller holds the transaction. */
+	bool write(const Record&);
+
+	/** Reserve TMSIs up to a given value in the database.  Caller holds the transaction. */
+	bool reserve(unsigned limit);
+
+	/** Flush periodically. */
+	void flushLoop();
+
+	friend void* TMSITableFlushLoopAdapter(TMSITable*);
 };
 
+/** Thread adapter for the flush loop. */
+void* TMSITableFlushLoopAdapter(TMSITable*);
+
 
 }
 
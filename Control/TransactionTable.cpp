@@ -63,17 +63,31 @@ void TransactionEntry::initTimers()
 {
 	// Call this only once.
 	// TODO -- It would be nice if these were all configurable.
-	assert(mTimers.size()==0);
-	mTimers["301"] = Z100Timer(T301ms);
-	mTimers["302"] = Z100Timer(T302ms);
-	mTimers["303"] = Z100Timer(T303ms);
-	mTimers["304"] = Z100Timer(T304ms);
-	mTimers["305"] = Z100Timer(T305ms);
-	mTimers["308"] = Z100Timer(T308ms);
-	mTimers["310"] = Z100Timer(T310ms);
-	mTimers["313"] = Z100Timer(T313ms);
-	mTimers["3113"] = Z100Timer(gConfig.getNum("GSM.Timer.T3113"));
-	mTimers["TR1M"] = Z100Timer(TR1Mms);
+	mTimers[T301] = Z100Timer(T301ms);
+	mTimers[T302] = Z100Timer(T302ms);
+	mTimers[T303] = Z100Timer(T303ms);
+	mTimers[T304] = Z100Timer(T304ms);
+	mTimers[T305] = Z100Timer(T305ms);
+	mTimers[T308] = Z100Timer(T308ms);
+	mTimers[T310] = Z100Timer(T310ms);
+	mTimers[T313] = Z100Timer(T313ms);
+	mTimers[T3113] = Z100Timer(gConfig.getNum("GSM.Timer.T3113"));
+	mTimers[TR1M] = Z100Timer(TR1Mms);
+	for (unsigned i=0; i<numTimers; i++) mTimerIDs[i]=0;
+	mExpiredTimers = 0;
+	mDying = false;
+}
+
+
+const char* TransactionEntry::timerName(TimerName name)
+{
+	static const char* names[numTimers] = {
+		"T301", "T302", "T303", "T304", "T305", "T308", "T310", "T313",
+		"T3113",
+		"TR1M"
+	};
+	assert(name<numTimers);
+	return names[name];
 }
 
 
@@ -97,7 +111,8 @@ TransactionEntry::TransactionEntry(
 	mGSMState(wState),
 	mNumSQLTries(gConfig.getNum("Control.NumSQLTries")),
 	mChannel(wChannel),
-	mTerminationRequested(false)
+	mTerminationRequested(false),
+	mIndexedChannel(NULL)
 {
 	if (wMessage) mMessage.assign(wMessage); //strncpy(mMessage,wMessage,160);
 	else mMessage.assign(""); //mMessage[0]='\0';
@@ -120,7 +135,8 @@ TransactionEntry::TransactionEntry(
 	mGSMState(GSM::MOCInitiated),
 	mNumSQLTries(gConfig.getNum("Control.NumSQLTries")),
 	mChannel(wChannel),
-	mTerminationRequested(false)
+	mTerminationRequested(false),
+	mIndexedChannel(NULL)
 {
 	assert(mSubscriber.type()==GSM::IMSIType);
 	mMessage.assign(""); //mMessage[0]='\0';
@@ -142,7 +158,8 @@ TransactionEntry::TransactionEntry(
 	mGSMState(GSM::MOCInitiated),
 	mNumSQLTries(2*gConfig.getNum("Control.NumSQLTries")),
 	mChannel(wChannel),
-	mTerminationRequested(false)
+	mTerminationRequested(false),
+	mIndexedChannel(NULL)
 {
 	mMessage.assign(""); //mMessage[0]='\0';
 	initTimers();
@@ -164,7 +181,8 @@ TransactionEntry::TransactionEntry(
 	mGSMState(GSM::SMSSubmitting),
 	mNumSQLTries(gConfig.getNum("Control.NumSQLTries")),
 	mChannel(wChannel),
-	mTerminationRequested(false)
+	mTerminationRequested(false),
+	mIndexedChannel(NULL)
 {
 	assert(mSubscriber.type()==GSM::IMSIType);
 	if (wMessage!=NULL) mMessage.assign(wMessage); //strncpy(mMessage,wMessage,160);
@@ -185,7 +203,8 @@ TransactionEntry::TransactionEntry(
 	mGSMState(GSM::SMSSubmitting),
 	mNumSQLTries(gConfig.getNum("Control.NumSQLTries")),
 	mChannel(wChannel),
-	mTerminationRequested(false)
+	mTerminationRequested(false),
+	mIndexedChannel(NULL)
 {
 	assert(mSubscriber.type()==GSM::IMSIType);
 	mMessage[0]='\0';
@@ -196,40 +215,94 @@ TransactionEntry::TransactionEntry(
 
 TransactionEntry::~TransactionEntry()
 {
+	// Once mDying is set, a timeout() still running cannot arm a timer again.
+	{
+		ScopedLock lock(mLock);
+		mDying = true;
+		for (unsigned i=0; i<numTimers; i++) gBTS.timers().cancel(mTimerIDs[i]);
+	}
+	// Don't hold mLock here; timeout() takes it.
+	gBTS.timers().wait(this);
+}
+
+
+void TransactionEntry::armTimer(TimerName name)
+{
+	// Caller holds mLock.
+	disarmTimer(name);
+	if (mDying) return;
+	mTimerIDs[name] = gBTS.timers().schedule(mTimers[name].remaining(),this,name);
+}
+
+
+void TransactionEntry::disarmTimer(TimerName name)
+{
+	// Caller holds mLock.
+	gBTS.timers().cancel(mTimerIDs[name]);
+	mTimerIDs[name] = 0;
+	mExpiredTimers &= ~(1<<name);
+}
+
+
+void TransactionEntry::setTimer(TimerName name)
+{
+	ScopedLock lock(mLock);
+	mTimers[name].set();
+	armTimer(name);
+}
+
+
+void TransactionEntry::setTimer(TimerName name, long newLimit)
+{
+	ScopedLock lock(mLock);
+	mTimers[name].set(newLimit);
+	armTimer(name);
+}
+
+
+void TransactionEntry::resetTimer(TimerName name)
+{
+	ScopedLock lock(mLock);
+	mTimers[name].reset();
+	disarmTimer(name);
 }
 
 
-bool TransactionEntry::timerExpired(const char* name) const
+void TransactionEntry::timeout(unsigned tag)
 {
-	TimerTable::const_iterator itr = mTimers.find(name);
-	assert(itr!=mTimers.end());
+	TimerName name = (TimerName)tag;
+	assert(name<numTimers);
 	ScopedLock lock(mLock);
-	return (itr->second).expired();
+	if (mDying) return;
+	// The timer may have been reset or restarted since the wheel took it.
+	if (!mTimers[name].active()) return;
+	if (!mTimers[name].expired()) {
+		armTimer(name);
+		return;
+	}
+	mTimerIDs[name] = 0;
+	mExpiredTimers |= 1<<name;
+	LOG(INFO) << timerName(name) << " expired in transaction " << mID;
 }
 
 
 bool TransactionEntry::anyTimerExpired() const
 {
 	ScopedLock lock(mLock);
-	TimerTable::const_iterator itr = mTimers.begin();
-	while (itr!=mTimers.end()) {
-		if ((itr->second).expired()) {
-			LOG(INFO) << itr->first << " expired in " << *this;
-			return true;
-		}
-		++itr;
+	if (mExpiredTimers==0) return false;
+	for (unsigned i=0; i<numTimers; i++) {
+		if (mExpiredTimers & (1<<i)) LOG(INFO) << timerName((TimerName)i) << " expired in " << *this;
 	}
-	return false;
+	return true;
 }
 
 
 void TransactionEntry::resetTimers()
 {
 	ScopedLock lock(mLock);
-	TimerTable::iterator itr = mTimers.begin();
-	while (itr!=mTimers.end()) {
-		(itr->second).reset();
-		++itr;
+	for (unsigned i=0; i<numTimers; i++) {
+		mTimers[i].reset();
+		disarmTimer((TimerName)i);
 	}
 }
 
@@ -245,11 +318,7 @@ bool TransactionEntry::dead() const
 	if (mSIP.state()==Proceeding && stateAge()>180*1000) return true;
 	
 	// Paging timed out?
-	if (mGSMState==GSM::Paging) {
-		TimerTable::const_iterator itr = mTimers.find("3113");
-		assert(itr!=mTimers.end());
-		return (itr->second).expired();
-	}
+	if (mGSMState==GSM::Paging) return mExpiredTimers & (1<<T3113);
 
 	return false;
 }
@@ -307,8 +376,10 @@ void TransactionEntry::messageType(const char *wContentType)
 
 void TransactionEntry::channel(GSM::LogicalChannel* wChannel)
 {
-	ScopedLock lock(mLock);
+	mLock.lock();
 	mChannel = wChannel;
+	mLock.unlock();
+	gTransactionTable.reindex(this);
 }
 
 
@@ -484,14 +555,19 @@ bool TransactionEntry::sendINFOAndWaitForOK(unsigned info)
 
 void TransactionEntry::SIPUser(const char* IMSI)
 {
-	ScopedLock lock(mLock);
+	// This makes a new call ID.
+	mLock.lock();
 	mSIP.user(IMSI);
+	mLock.unlock();
+	gTransactionTable.reindex(this);
 }
 
 void TransactionEntry::SIPUser(const char* callID, const char *IMSI , const char *origID, const char *origHost)
 {
-	ScopedLock lock(mLock);
+	mLock.lock();
 	mSIP.user(callID,IMSI,origID,origHost);
+	mLock.unlock();
+	gTransactionTable.reindex(this);
 }
 
 void TransactionEntry::called(const L3CalledPartyBCDNumber& wCalled)
@@ -520,7 +596,7 @@ bool TransactionEntry::terminationRequested()
 
 TransactionTable::TransactionTable()
 	// This assumes the main application uses sdevrandom.
-	:mIDCounter(random())
+	:mDB(NULL),mIDCounter(random()),mReapTimer(0)
 {
 }
 
@@ -548,6 +624,33 @@ void TransactionTable::add(TransactionEntry* value)
 	LOG(INFO) << "new transaction " << *value;
 	ScopedLock lock(mLock);
 	mTable[value->ID()]=value;
+	value->mIndexedChannel = value->channel();
+	value->mIndexedCallID = value->SIPCallID();
+	if (value->mIndexedChannel) mByChannel.add(value->mIndexedChannel,value);
+	mBySubscriber.add(value->subscriber(),value);
+	if (value->mIndexedCallID.size()) mByCallID.add(value->mIndexedCallID,value);
+	// Start the reaper with the first entry, since gBTS may not be built before the table.
+	if (!mReapTimer) mReapTimer = gBTS.timers().schedule(reapInterval,this);
+}
+
+
+void TransactionTable::reindex(TransactionEntry* entry)
+{
+	ScopedLock lock(mLock);
+	TransactionMap::iterator itr = mTable.find(entry->ID());
+	if (itr==mTable.end() || itr->second!=entry) return;
+	const GSM::LogicalChannel* chan = entry->channel();
+	if (chan!=entry->mIndexedChannel) {
+		if (entry->mIndexedChannel) mByChannel.remove(entry->mIndexedChannel,entry);
+		if (chan) mByChannel.add(chan,entry);
+		entry->mIndexedChannel = chan;
+	}
+	string callID = entry->SIPCallID();
+	if (callID!=entry->mIndexedCallID) {
+		if (entry->mIndexedCallID.size()) mByCallID.remove(entry->mIndexedCallID,entry);
+		if (callID.size()) mByCallID.add(callID,entry);
+		entry->mIndexedCallID = callID;
+	}
 }
 
 
@@ -572,10 +675,16 @@ TransactionEntry* TransactionTable::find(unsigned key)
 
 void TransactionTable::innerRemove(TransactionMap::iterator itr)
 {
-	LOG(DEBUG) << "removing transaction: " << *(itr->second);
-	gSIPInterface.removeCall(itr->second->SIPCallID());
-	delete itr->second;
+	// Caller holds mLock.
+	TransactionEntry *entry = itr->second;
+	LOG(DEBUG) << "removing transaction: " << *entry;
+	// Take it out of the indexes before deleting it, since lookups only hold the index locks.
+	if (entry->mIndexedChannel) mByChannel.remove(entry->mIndexedChannel,entry);
+	mBySubscriber.remove(entry->subscriber(),entry);
+	if (entry->mIndexedCallID.size()) mByCallID.remove(entry->mIndexedCallID,entry);
 	mTable.erase(itr);
+	gSIPInterface.removeCall(entry->SIPCallID());
+	delete entry;
 }
 
 
@@ -611,7 +720,7 @@ bool TransactionTable::removePaging(unsigned key)
 
 void TransactionTable::clearDeadEntries()
 {
-	// Caller should hold mLock.
+	ScopedLock lock(mLock);
 	TransactionMap::iterator itr = mTable.begin();
 	while (itr!=mTable.end()) {
 		if (!itr->second->dead()) ++itr;
@@ -625,43 +734,91 @@ void TransactionTable::clearDeadEntries()
 }
 
 
+void TransactionTable::timeout(unsigned)
+{
+	clearDeadEntries();
+	ScopedLock lock(mLock);
+	mReapTimer = gBTS.timers().schedule(reapInterval,this);
+}
 
 
-TransactionEntry* TransactionTable::find(const GSM::LogicalChannel *chan)
-{
-	LOG(DEBUG) << "by channel: " << *chan << " (" << chan << ")";
 
-	// Yes, it's linear time.
-	// Since clearDeadEntries is also linear, do that here, too.
-	clearDeadEntries();
 
-	// Brute force search.
-	ScopedLock lock(mLock);
-	for (TransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
-		const GSM::LogicalChannel* thisChan = itr->second->channel();
-		//LOG(DEBUG) << "looking for " << *chan << " (" << chan << ")" << ", found " << *(thisChan) << " (" << thisChan << ")";
-		if ((void*)thisChan == (void*)chan) return itr->second;
+/**@name Tests for the index lookups, called with the index stripe locked. */
+//@{
+
+/** Any entry. */
+class AnyTransaction {
+	public:
+	bool operator()(TransactionEntry*) const { return true; }
+};
+
+/** An entry in a given GSM state. */
+class TransactionInState {
+	GSM::CallState mState;
+	public:
+	TransactionInState(GSM::CallState wState) :mState(wState) {}
+	bool operator()(TransactionEntry* entry) const { return entry->GSMState()==mState; }
+};
+
+/** An entry for a given subscriber. */
+class TransactionForSubscriber {
+	const L3MobileIdentity& mID;
+	public:
+	TransactionForSubscriber(const L3MobileIdentity& wID) :mID(wID) {}
+	bool operator()(TransactionEntry* entry) const { return entry->subscriber()==mID; }
+};
+
+/** An entry in the Paging state, which is moved to AnsweredPaging. */
+class TransactionAnswersPaging {
+	public:
+	bool operator()(TransactionEntry* entry) const
+	{
+		if (entry->GSMState()!=GSM::Paging) return false;
+		// Stop T3113 and change the state.
+		entry->GSMState(AnsweredPaging);
+		entry->resetTimer(TransactionEntry::T3113);
+		return true;
+	}
+};
+
+/** An MT-SMS entry in the Paging state, which is changed as for TransactionAnswersPaging. */
+class TransactionAnswersSMSPaging {
+	public:
+	bool operator()(TransactionEntry* entry) const
+	{
+		if (entry->service().type()!=L3CMServiceType::MobileTerminatedShortMessage) return false;
+		return TransactionAnswersPaging()(entry);
 	}
-	//LOG(DEBUG) << "no match for " << *chan << " (" << chan << ")";
-	return NULL;
+};
+
+/** An entry with a dedicated channel, TCH/FACCH or SDCCH. */
+class TransactionOnDCCH {
+	public:
+	bool operator()(TransactionEntry* entry) const
+	{
+		GSM::LogicalChannel* chan = entry->channel();
+		if (!chan) return false;
+		return chan->type()==FACCHType || chan->type()==SDCCHType;
+	}
+};
+
+//@}
+
+
+
+
+TransactionEntry* TransactionTable::find(const GSM::LogicalChannel *chan)
+{
+	LOG(DEBUG) << "by channel: " << *chan << " (" << chan << ")";
+	return mByChannel.find(chan,AnyTransaction());
 }
 
 
 TransactionEntry* TransactionTable::find(const L3MobileIdentity& mobileID, GSM::CallState state)
 {
 	LOG(DEBUG) << "by ID and state: " << mobileID << " in " << state;
-
-	// Yes, it's linear time.
-	// Since clearDeadEntries is also linear, do that here, too.
-	clearDeadEntries();
-
-	// Brtue force search.
-	ScopedLock lock(mLock);
-	for (TransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
-		if (itr->second->GSMState() != state) continue;
-		if (itr->second->subscriber() == mobileID) return itr->second;
-	}
-	return NULL;
+	return mBySubscriber.find(mobileID,TransactionInState(state));
 }
 
 
@@ -669,75 +826,33 @@ TransactionEntry* TransactionTable::find(const L3MobileIdentity& mobileID, const
 {
 	assert(callID);
 	LOG(DEBUG) << "by ID and call-ID: " << mobileID << ", call " << callID;
-
-	string callIDString = string(callID);
-	// Yes, it's linear time.
-	// Since clearDeadEntries is also linear, do that here, too.
-	clearDeadEntries();
-
-	// Brtue force search.
-	ScopedLock lock(mLock);
-	for (TransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
-		if (itr->second->mSIP.callID() != callIDString) continue;
-		if (itr->second->subscriber() == mobileID) return itr->second;
-	}
-	return NULL;
+	return mByCallID.find(string(callID),TransactionForSubscriber(mobileID));
 }
 
 
 TransactionEntry* TransactionTable::answeredPaging(const L3MobileIdentity& mobileID)
 {
-	// Yes, it's linear time.
-	// Even in a 6-ARFCN system, it should rarely be more than a dozen entries.
+	return mBySubscriber.find(mobileID,TransactionAnswersPaging());
+}
 
-	// Since clearDeadEntries is also linear, do that here, too.
-	clearDeadEntries();
 
-	// Brtue force search.
-	ScopedLock lock(mLock);
-	for (TransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
-		if (itr->second->GSMState() != GSM::Paging) continue;
-		if (itr->second->subscriber() == mobileID) {
-			// Stop T3113 and change the state.
-			itr->second->GSMState(AnsweredPaging);
-			itr->second->resetTimer("3113");
-			return itr->second;
-		}
-	}
-	return NULL;
+TransactionEntry* TransactionTable::answeredSMSPaging(const L3MobileIdentity& mobileID)
+{
+	return mBySubscriber.find(mobileID,TransactionAnswersSMSPaging());
 }
 
 
 GSM::LogicalChannel* TransactionTable::findChannel(const L3MobileIdentity& mobileID)
 {
-	// Yes, it's linear time.
-	// Even in a 6-ARFCN system, it should rarely be more than a dozen entries.
-
-	// Since clearDeadEntries is also linear, do that here, too.
-	clearDeadEntries();
-
-	// Brtue force search.
-	ScopedLock lock(mLock);
-	for (TransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
-		if (itr->second->subscriber() != mobileID) continue;
-		GSM::LogicalChannel* chan = itr->second->channel();
-		if (!chan) continue;
-		if (chan->type() == FACCHType) return chan;
-		if (chan->type() == SDCCHType) return chan;
-	}
-	return NULL;
+	TransactionEntry* entry = mBySubscriber.find(mobileID,TransactionOnDCCH());
+	if (!entry) return NULL;
+	return entry->channel();
 }
 
 
 unsigned TransactionTable::countChan(const GSM::LogicalChannel* chan)
 {
-	ScopedLock lock(mLock);
-	clearDeadEntries();
-	unsigned count = 0;
-	for (TransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
-		if (itr->second->channel() == chan) count++;
-	}
-	return count;
+	return mByChannel.count(chan);
 }
 
 
@@ -755,10 +870,10 @@ size_t TransactionTable::dump(ostream& os) const
 TransactionEntry* TransactionTable::findLongestCall()
 {
 	ScopedLock lock(mLock);
-	clearDeadEntries();
 	long longTime = 0;
 	TransactionMap::iterator longCall = mTable.end();
 	for (TransactionMap::iterator itr = mTable.begin(); itr!=mTable.end(); ++itr) {
+		if (itr->second->dead()) continue;
 		if (!(itr->second->channel())) continue;
 		if (itr->second->GSMState() != GSM::Active) continue;
 		long runTime = itr->second->stateAge();
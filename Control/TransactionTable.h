@@ -27,11 +27,15 @@
 
 
 #include <stdio.h>
+#include <stdint.h>
 #include <list>
+#include <map>
+#include <string>
 
 #include <Logger.h>
 #include <Interthread.h>
 #include <Timeval.h>
+#include <TimerWheel.h>
 
 
 #include <GSML3CommonElements.h>
@@ -48,8 +52,6 @@ struct sqlite3;
 /**@namespace Control This namepace is for use by the control layer. */
 namespace Control {
 
-typedef std::map<std::string, GSM::Z100Timer> TimerTable;
-
 
 
 
@@ -57,8 +59,21 @@ typedef std::map<std::string, GSM::Z100Timer> TimerTable;
 	A TransactionEntry object is used to maintain the state of a transaction
 	as it moves from channel to channel.
 	The object itself is not thread safe.
+
+	The Q.931 and GSM timers run on gBTS.timers(), which marks them
+	expired when they run out, so checking them costs no clock reads.
 */
-class TransactionEntry {
+class TransactionEntry : public TimerWheelClient {
+
+	public:
+
+	/** Q.931 (network side) and GSM timers, GSM 04.08 11.2, 11.3. */
+	enum TimerName {
+		T301, T302, T303, T304, T305, T308, T310, T313,
+		T3113,
+		TR1M,
+		numTimers
+	};
 
 	private:
 
@@ -85,7 +100,10 @@ class TransactionEntry {
 	mutable SIP::SIPState mPrevSIPState;	///< previous SIP state, prior to most recent transactions
 	GSM::CallState mGSMState;				///< the GSM/ISDN/Q.931 call state
 	Timeval mStateTimer;					///< timestamp of last state change.
-	TimerTable mTimers;						///< table of Z100-type state timers
+	GSM::Z100Timer mTimers[numTimers];		///< Z100-type state timers
+	unsigned mTimerIDs[numTimers];			///< gBTS.timers() IDs, 0 if not running
+	unsigned mExpiredTimers;				///< bit mask of expired timers, set by timeout()
+	bool mDying;							///< set by the destructor, so that no timer is armed again
 
 	unsigned mNumSQLTries;					///< number of SQL tries for DB operations
 
@@ -93,6 +111,12 @@ class TransactionEntry {
 
 	bool mTerminationRequested;
 
+	/**@name The keys this entry is filed under in the table indexes, protected by the table lock. */
+	//@{
+	const GSM::LogicalChannel *mIndexedChannel;
+	std::string mIndexedCallID;
+	//@}
+
 	public:
 
 	/** This form is used for MTC or MT-SMS with TI generated by the network. */
@@ -236,22 +260,26 @@ class TransactionEntry {
 	/**@name Timer access. */
 	//@{
 
-	bool timerExpired(const char* name) const;
+	bool timerExpired(TimerName name) const
+		{ ScopedLock lock(mLock); return mExpiredTimers & (1<<name); }
 
-	void setTimer(const char* name)
-		{ ScopedLock lock(mLock); return mTimers[name].set(); }
+	void setTimer(TimerName name);
 
-	void setTimer(const char* name, long newLimit)
-		{ ScopedLock lock(mLock); return mTimers[name].set(newLimit); }
+	void setTimer(TimerName name, long newLimit);
 
-	void resetTimer(const char* name)
-		{ ScopedLock lock(mLock); return mTimers[name].reset(); }
+	void resetTimer(TimerName name);
 
 	/** Return true if any Q.931 timer is expired. */
 	bool anyTimerExpired() const;
 
 	/** Reset all Q.931 timers. */
 	void resetTimers();
+
+	/** Timer wheel callback. */
+	void timeout(unsigned tag);
+
+	/** The name of a timer, for logging. */
+	static const char* timerName(TimerName);
 	
 	//@}
 
@@ -272,6 +300,12 @@ class TransactionEntry {
 	/** Create L3 timers from GSM and Q.931 (network side) */
 	void initTimers();
 
+	/** Start the wheel timer for a Z100 timer that was just set.  Caller holds mLock. */
+	void armTimer(TimerName name);
+
+	/** Stop the wheel timer for a Z100 timer.  Caller holds mLock. */
+	void disarmTimer(TimerName name);
+
 	/** Echo latest SIPSTATE to the database. */
 	void echoSIPState(SIP::SIPState state) const;
 };
@@ -283,18 +317,133 @@ std::ostream& operator<<(std::ostream& os, const TransactionEntry&);
 /** A map of transactions keyed by ID. */
 class TransactionMap : public std::map<unsigned,TransactionEntry*> {};
 
+
+
+/**@name Stripe selection for the transaction indexes. */
+//@{
+inline unsigned transactionIndexHash(const GSM::LogicalChannel* chan)
+	{ return (unsigned)((uintptr_t)chan >> 4); }
+
+inline unsigned transactionIndexHash(const std::string& key)
+{
+	unsigned hash = 2166136261U;
+	for (size_t i=0; i<key.size(); i++) hash = (hash ^ (unsigned char)key[i]) * 16777619U;
+	return hash;
+}
+
+inline unsigned transactionIndexHash(const GSM::L3MobileIdentity& ID)
+{
+	if (ID.type()==GSM::TMSIType) return ID.TMSI();
+	return transactionIndexHash(std::string(ID.digits()));
+}
+//@}
+
+
+/**
+	A secondary index of the transaction table.
+	The index is split into stripes, each with its own lock,
+	so that lookups of different keys do not contend with each other
+	or with the table lock.
+	Entries are only deleted after they are taken out of every index,
+	so a test run under the stripe lock may safely look at the entry.
+*/
+template <class Key> class TransactionIndex {
+
+	private:
+
+	static const unsigned numStripes = 16;
+
+	typedef std::multimap<Key,TransactionEntry*> Stripe;
+
+	mutable Mutex mLocks[numStripes];
+	Stripe mStripes[numStripes];
+
+	unsigned stripe(const Key& key) const { return transactionIndexHash(key) % numStripes; }
+
+	public:
+
+	void add(const Key& key, TransactionEntry* entry)
+	{
+		unsigned s = stripe(key);
+		ScopedLock lock(mLocks[s]);
+		mStripes[s].insert(typename Stripe::value_type(key,entry));
+	}
+
+	void remove(const Key& key, TransactionEntry* entry)
+	{
+		unsigned s = stripe(key);
+		ScopedLock lock(mLocks[s]);
+		std::pair<typename Stripe::iterator,typename Stripe::iterator> range = mStripes[s].equal_range(key);
+		for (typename Stripe::iterator itr=range.first; itr!=range.second; ++itr) {
+			if (itr->second!=entry) continue;
+			mStripes[s].erase(itr);
+			return;
+		}
+	}
+
+	/**
+		Find the first live entry filed under a key that passes a test.
+		The test is called with the stripe lock held, as test(entry).
+		@return The entry or NULL.
+	*/
+	template <class Test> TransactionEntry* find(const Key& key, const Test& test) const
+	{
+		unsigned s = stripe(key);
+		ScopedLock lock(mLocks[s]);
+		std::pair<typename Stripe::const_iterator,typename Stripe::const_iterator> range = mStripes[s].equal_range(key);
+		for (typename Stripe::const_iterator itr=range.first; itr!=range.second; ++itr) {
+			if (itr->second->dead()) continue;
+			if (test(itr->second)) return itr->second;
+		}
+		return NULL;
+	}
+
+	/** Count the live entries filed under a key. */
+	unsigned count(const Key& key) const
+	{
+		unsigned s = stripe(key);
+		ScopedLock lock(mLocks[s]);
+		unsigned retVal = 0;
+		std::pair<typename Stripe::const_iterator,typename Stripe::const_iterator> range = mStripes[s].equal_range(key);
+		for (typename Stripe::const_iterator itr=range.first; itr!=range.second; ++itr) {
+			if (!itr->second->dead()) retVal++;
+		}
+		return retVal;
+	}
+};
+
+
 /**
 	A table for tracking the states of active transactions.
+
+	Besides the table itself, keyed by ID, the entries are indexed
+	by channel, subscriber and SIP call ID, so that lookups stay fast
+	with thousands of entries.  Dead entries are skipped by lookups
+	and reaped from gBTS.timers() every reapInterval ms.
+
+	Lock order: the table lock, then the index stripe locks, then the entry locks.
+	An entry never holds its own lock while calling into the table.
 */
-class TransactionTable {
+class TransactionTable : public TimerWheelClient {
 
 	private:
 
+	/** How often dead entries are reaped, in ms. */
+	static const unsigned reapInterval = 1000;
+
 	sqlite3 *mDB;			///< database connection
 
 	TransactionMap mTable;
 	mutable Mutex mLock;
 	unsigned mIDCounter;
+	unsigned mReapTimer;	///< gBTS.timers() ID of the reaper, 0 until the first add()
+
+	/**@name Secondary indexes, with their own locks, updated under mLock. */
+	//@{
+	TransactionIndex<const GSM::LogicalChannel*> mByChannel;
+	TransactionIndex<GSM::L3MobileIdentity> mBySubscriber;
+	TransactionIndex<std::string> mByCallID;
+	//@}
 
 	public:
 
@@ -352,7 +501,7 @@ class TransactionTable {
 
 	/**
 		Find an entry by its channel pointer.
-		Also clears dead entries during search.
+		Dead entries are skipped.
 		@param chan The channel pointer to the first record found.
 		@return pointer to entry or NULL if no active match
 	*/
@@ -360,7 +509,7 @@ class TransactionTable {
 
 	/**
 		Find an entry in the given state by its mobile ID.
-		Also clears dead entries during search.
+		Dead entries are skipped.
 		@param mobileID The mobile to search for.
 		@return pointer to entry or NULL if no match
 	*/
@@ -372,12 +521,20 @@ class TransactionTable {
 
 	/**
 		Find an entry in the Paging state by its mobile ID, change state to AnsweredPaging and reset T3113.
-		Also clears dead entries during search.
+		Dead entries are skipped.
 		@param mobileID The mobile to search for.
 		@return pointer to entry or NULL if no match
 	*/
 	TransactionEntry* answeredPaging(const GSM::L3MobileIdentity& mobileID);
 
+	/**
+		Find an MT-SMS entry in the Paging state by its mobile ID, as answeredPaging() does.
+		This lets a channel brought up for one message carry the others.
+		@param mobileID The mobile to search for.
+		@return pointer to entry or NULL if no match
+	*/
+	TransactionEntry* answeredSMSPaging(const GSM::L3MobileIdentity& mobileID);
+
 
 	/**
 		Find the channel, if any, used for current transactions by this mobile ID.
@@ -393,6 +550,9 @@ class TransactionTable {
 
 	size_t dump(std::ostream& os) const;
 
+	/** Timer wheel callback, for the reaper. */
+	void timeout(unsigned tag);
+
 
 	private:
 
@@ -401,10 +561,16 @@ class TransactionTable {
 	/** Accessor to database connection. */
 	sqlite3* DB() { return mDB; }
 
+	/**
+		Refile an entry in the indexes after its channel or call ID changes.
+		Entries not in the table are ignored.
+		The caller must not hold the entry lock.
+	*/
+	void reindex(TransactionEntry*);
+
 	/**
 		Remove "dead" entries from the table.
 		A "dead" entry is a transaction that is no longer active.
-		The caller should hold mLock.
 	*/
 	void clearDeadEntries();
 
@@ -0,0 +1,87 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "GSMChannelPool.h"
+#include <string.h>
+#include <Logger.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+
+
+
+
+unsigned PackedChannelSelection::select(const vector<unsigned>& free, const vector<unsigned>& active)
+{
+	for (unsigned i=0; i<free.size(); i++) {
+		if (free[i]) return i;
+	}
+	assert(0);
+	return 0;
+}
+
+
+unsigned SpreadChannelSelection::select(const vector<unsigned>& free, const vector<unsigned>& active)
+{
+	// Ties go to the lower bucket.
+	unsigned best = free.size();
+	for (unsigned i=0; i<free.size(); i++) {
+		if (!free[i]) continue;
+		if ((best==free.size()) || (active[i]<active[best])) best = i;
+	}
+	assert(best<free.size());
+	return best;
+}
+
+
+unsigned RoundRobinChannelSelection::select(const vector<unsigned>& free, const vector<unsigned>& active)
+{
+	const unsigned sz = free.size();
+	for (unsigned i=1; i<=sz; i++) {
+		unsigned bucket = (mLast+i) % sz;
+		if (free[bucket]) {
+			mLast = bucket;
+			return bucket;
+		}
+	}
+	assert(0);
+	return 0;
+}
+
+
+ChannelSelectionPolicy* GSM::makeChannelSelectionPolicy(const char* name)
+{
+	if (strcmp(name,"packed")==0) return new PackedChannelSelection;
+	if (strcmp(name,"roundrobin")==0) return new RoundRobinChannelSelection;
+	if (strcmp(name,"spread")!=0) LOG(ALERT) << "unknown channel selection policy " << name << ", using spread";
+	return new SpreadChannelSelection;
+}
+
+
+
+// vim: ts=4 sw=4
@@ -0,0 +1,284 @@
+/**@file Free lists and selection policies for allocatable channels. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef GSMCHANNELPOOL_H
+#define GSMCHANNELPOOL_H
+
+#include <assert.h>
+#include <deque>
+#include <list>
+#include <vector>
+#include <ostream>
+
+#include <Threads.h>
+#include <Timeval.h>
+
+
+namespace GSM {
+
+
+/**
+	A policy for picking the timeslot to allocate a new channel from.
+	The free lists group the channels by ARFCN and timeslot ("buckets").
+*/
+class ChannelSelectionPolicy {
+
+	public:
+
+	virtual ~ChannelSelectionPolicy() {}
+
+	/**
+		Pick a bucket.
+		@param free The number of free channels in each bucket.
+		@param active The number of channels in use in each bucket.
+		@return The index of a bucket with a free channel.
+	*/
+	virtual unsigned select(const std::vector<unsigned>& free, const std::vector<unsigned>& active) = 0;
+
+	virtual const char* name() const = 0;
+};
+
+
+/** Fill the first timeslot before using the next, like the old linear search. */
+class PackedChannelSelection : public ChannelSelectionPolicy {
+
+	public:
+
+	unsigned select(const std::vector<unsigned>& free, const std::vector<unsigned>& active);
+
+	const char* name() const { return "packed"; }
+};
+
+
+/** Use the timeslot with the fewest channels in use, spreading load over timeslots and ARFCNs. */
+class SpreadChannelSelection : public ChannelSelectionPolicy {
+
+	public:
+
+	unsigned select(const std::vector<unsigned>& free, const std::vector<unsigned>& active);
+
+	const char* name() const { return "spread"; }
+};
+
+
+/** Take the timeslots in turn. */
+class RoundRobinChannelSelection : public ChannelSelectionPolicy {
+
+	private:
+
+	unsigned mLast;
+
+	public:
+
+	RoundRobinChannelSelection()
+		:mLast(0)
+	{ }
+
+	unsigned select(const std::vector<unsigned>& free, const std::vector<unsigned>& active);
+
+	const char* name() const { return "roundrobin"; }
+};
+
+
+/**
+	Make a selection policy from its name.
+	Unknown names get the spread policy.
+*/
+ChannelSelectionPolicy* makeChannelSelectionPolicy(const char* name);
+
+
+
+
+/**
+	Free lists for one type of allocatable channel.
+
+	A channel becomes reusable when its L1 timers run out (recyclable()),
+	not on any event we could hook, so channels in use sit on a busy list
+	and are moved back to the free lists by a sweep.  The sweep runs when
+	the free lists are empty, or when the available count is asked for and
+	the last sweep is old.  A sweep that finds nothing is not repeated for
+	emptySweepInterval, so that allocations failing at full load do not each
+	scan the busy list.  That makes allocation O(1) amortized, under load too,
+	with its own lock rather than the GSMConfig lock.
+
+	The free lists are a cache of recyclable(), so they are updated
+	even through const methods.
+*/
+template <class ChanType> class ChannelFreeList {
+
+	private:
+
+	/** A channel and the index of its bucket. */
+	class Entry {
+		public:
+		ChanType *mChan;
+		unsigned mBucket;
+		Entry(ChanType *wChan, unsigned wBucket)
+			:mChan(wChan),mBucket(wBucket)
+		{ }
+	};
+
+	/** How long the available count may go without a sweep, in ms. */
+	static const unsigned sweepInterval = 100;
+
+	/** How long an allocation waits to sweep again after a sweep found nothing, in ms. */
+	static const unsigned emptySweepInterval = 10;
+
+	mutable Mutex mLock;
+	ChannelSelectionPolicy *mPolicy;
+
+	std::vector<unsigned> mBucketKeys;			///< ARFCN*8+TN for each bucket
+	std::vector<unsigned> mBucketSizes;			///< channels in each bucket
+	mutable std::vector< std::deque<Entry> > mFree;	///< recyclable channels, by bucket
+	mutable std::list<Entry> mBusy;				///< channels that were allocated
+	mutable unsigned mFreeCount;
+	mutable Timeval mNextSweep;
+	Timeval mNextEmptySweep;					///< earliest sweep for an allocation on empty free lists
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mAllocations;
+	unsigned long mFailures;
+	mutable unsigned long mSweeps;
+	//@}
+
+	public:
+
+	ChannelFreeList()
+		:mPolicy(NULL),mFreeCount(0),
+		mAllocations(0),mFailures(0),mSweeps(0)
+	{ }
+
+	~ChannelFreeList() { delete mPolicy; }
+
+	/** Set the selection policy, which the free list will delete. */
+	void policy(ChannelSelectionPolicy *wPolicy)
+	{
+		ScopedLock lock(mLock);
+		delete mPolicy;
+		mPolicy = wPolicy;
+	}
+
+	/** Add a channel.  It goes on the free lists at the next sweep. */
+	void add(ChanType *chan)
+	{
+		ScopedLock lock(mLock);
+		unsigned key = chan->ARFCN()*8 + chan->TN();
+		unsigned bucket = 0;
+		while (bucket<mBucketKeys.size() && mBucketKeys[bucket]!=key) bucket++;
+		if (bucket==mBucketKeys.size()) {
+			mBucketKeys.push_back(key);
+			mBucketSizes.push_back(0);
+			mFree.push_back(std::deque<Entry>());
+		}
+		mBucketSizes[bucket]++;
+		mBusy.push_back(Entry(chan,bucket));
+		// Make sure the next query sweeps.
+		mNextSweep = Timeval(0);
+		mNextEmptySweep = Timeval(0);
+	}
+
+	/**
+		Take a recyclable channel off the free lists and open it.
+		The open is done under the lock, so that a sweep cannot
+		put the channel back before it stops being recyclable.
+		@return The channel, or NULL if none is available.
+	*/
+	ChanType* allocate()
+	{
+		ScopedLock lock(mLock);
+		mAllocations++;
+		if (mFreeCount==0 && mNextEmptySweep.passed()) {
+			sweep();
+			if (mFreeCount==0) mNextEmptySweep.future(emptySweepInterval);
+		}
+		if (!mPolicy) mPolicy = new SpreadChannelSelection;
+		while (mFreeCount) {
+			std::vector<unsigned> free(mFree.size());
+			std::vector<unsigned> active(mFree.size());
+			for (unsigned i=0; i<mFree.size(); i++) {
+				free[i] = mFree[i].size();
+				active[i] = mBucketSizes[i] - free[i];
+			}
+			unsigned bucket = mPolicy->select(free,active);
+			assert(bucket<mFree.size() && mFree[bucket].size());
+			Entry entry = mFree[bucket].front();
+			mFree[bucket].pop_front();
+			mFreeCount--;
+			mBusy.push_back(entry);
+			// Someone else may have opened it since the sweep.
+			if (!entry.mChan->recyclable()) continue;
+			entry.mChan->open();
+			return entry.mChan;
+		}
+		mFailures++;
+		return NULL;
+	}
+
+	/** Number of recyclable channels, swept at most sweepInterval ms ago. */
+	size_t available() const
+	{
+		ScopedLock lock(mLock);
+		if (mNextSweep.passed()) sweep();
+		return mFreeCount;
+	}
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream& os) const
+	{
+		ScopedLock lock(mLock);
+		os << "allocations " << mAllocations << " failures " << mFailures
+			<< " sweeps " << mSweeps << " free " << mFreeCount << "/" << (mFreeCount+mBusy.size());
+		if (mPolicy) os << " policy " << mPolicy->name();
+	}
+
+	private:
+
+	/** Move recyclable channels from the busy list to the free lists. */
+	void sweep() const
+	{
+		mSweeps++;
+		typename std::list<Entry>::iterator bp = mBusy.begin();
+		while (bp!=mBusy.end()) {
+			if (!bp->mChan->recyclable()) ++bp;
+			else {
+				mFree[bp->mBucket].push_back(*bp);
+				mFreeCount++;
+				bp = mBusy.erase(bp);
+			}
+		}
+		mNextSweep.future(sweepInterval);
+	}
+};
+
+
+};	// namespace GSM
+
+
+#endif
+
+// vim: ts=4 sw=4
@@ -84,13 +84,19 @@ class GSMError {};
 const unsigned gFrameMicroseconds = 4615;
 
 
-/** Sleep for a given number of GSM frame periods. */
+/**
+	Sleep for a given number of GSM frame periods.
+	A coroutine task sleeps on the timer wheel, to the next whole ms.
+*/
 inline void sleepFrames(unsigned frames)
-	{ usleep(frames*gFrameMicroseconds); }
+{
+	if (currentTask()) msleep((frames*gFrameMicroseconds+999)/1000);
+	else usleep(frames*gFrameMicroseconds);
+}
 
 /** Sleep for 1 GSM frame period. */
 inline void sleepFrame()
-	{ usleep(gFrameMicroseconds); }
+	{ sleepFrames(1); }
 
 
 
@@ -38,20 +38,43 @@ using namespace GSM;
 
 GSMConfig::GSMConfig()
 	:mBand((GSMBand)gConfig.getNum("GSM.Radio.Band")),
+	mTasks(mTimers),
 	mSI5Frame(UNIT_DATA),mSI6Frame(UNIT_DATA),
 	mT3122(gConfig.getNum("GSM.Timer.T3122Min")),
-	mStartTime(::time(NULL))
+	mStartTime(::time(NULL)),
+	mWarmLoadTime(-1),mFirstBCCHTime(-1),
+	mBarredClasses(0)
 {
 	regenerateBeacon();
 }
 
 void GSMConfig::start()
 {
+	mTimers.start();
+	// The dispatchers spawned before now are queued until the pool starts.
+	if (gConfig.defines("Control.Tasks")) {
+		unsigned threads = gConfig.getNum("Control.Tasks.Threads");
+		if (threads<1) threads = 1;
+		mTasks.start(threads);
+	}
+	// Channel selection policies.
+	std::string policy = gConfig.getStr("GSM.Channels.SelectionPolicy");
+	mSDCCHFree.policy(makeChannelSelectionPolicy(policy.c_str()));
+	mTCHFree.policy(makeChannelSelectionPolicy(policy.c_str()));
+	mPDTCHFree.policy(makeChannelSelectionPolicy(policy.c_str()));
+	// Do not call this until the beacon encoders are open.
+	mL1Scheduler.start();
+	mL2Reactor.start();
 	mPowerManager.start();
 	// Do not call this until the paging channels are installed.
 	mPager.start();
-	// Do not call this until AGCHs are installed.
+	// Do not call these until AGCHs are installed.
+	// Start the pager first, so it comes first on a shared PCH/AGCH.
+	mAccessGrants.start();
 	mAccessGrantThread.start(Control::AccessGrantServiceLoop,NULL);
+	mOverload.start();
+	mRegistrations.start();
+	mLocations.start();
 }
 
 
@@ -71,10 +94,17 @@ void GSMConfig::regenerateBeacon()
 	// MCC/MNC/LAC
 	mLAI = L3LocationAreaIdentity();
 
+	// RACH control, with any barring from overload control.
+	// The frames are rewritten in place, and only the access class bits
+	// change at run time, so a BCCH block caught mid-update is still valid.
+	L3RACHControlParameters RACHControl;
+	RACHControl.barAccessClasses(barredClasses());
+
 	// Now regenerate all of the system information messages.
 
 	// SI1
 	L3SystemInformationType1 SI1;
+	SI1.RACHControlParameters(RACHControl);
 	LOG(INFO) << SI1;
 	L3Frame SI1L3(UNIT_DATA);
 	SI1.write(SI1L3);
@@ -84,6 +114,7 @@ void GSMConfig::regenerateBeacon()
 
 	// SI2
 	L3SystemInformationType2 SI2;
+	SI2.RACHControlParameters(RACHControl);
 	LOG(INFO) << SI2;
 	L3Frame SI2L3(UNIT_DATA);
 	SI2.write(SI2L3);
@@ -93,6 +124,7 @@ void GSMConfig::regenerateBeacon()
 
 	// SI3
 	L3SystemInformationType3 SI3;
+	SI3.RACHControlParameters(RACHControl);
 	LOG(INFO) << SI3;
 	L3Frame SI3L3(UNIT_DATA);
 	SI3.write(SI3L3);
@@ -102,6 +134,7 @@ void GSMConfig::regenerateBeacon()
 
 	// SI4
 	L3SystemInformationType4 SI4;
+	SI4.RACHControlParameters(RACHControl);
 	LOG(INFO) << SI4;
 	L3Frame SI4L3(UNIT_DATA);
 	SI4.write(SI4L3);
@@ -166,81 +199,56 @@ CCCHLogicalChannel* GSMConfig::minimumLoad(CCCHList &chanList)
 
 
 
-template <class ChanType> ChanType* getChan(vector<ChanType*>& chanList)
+void GSMConfig::addSDCCH(SDCCHLogicalChannel *wSDCCH)
 {
-	const unsigned sz = chanList.size();
-	if (sz==0) return NULL;
-	// Start the search from a random point in the list.
-	//unsigned pos = random() % sz;
-	// HACK -- Try in-order allocation for debugging.
-	for (unsigned i=0; i<sz; i++) {
-		ChanType *chan = chanList[i];
-		//ChanType *chan = chanList[pos];
-		if (chan->recyclable()) return chan;
-		//pos = (pos+1) % sz;
-	}
-	return NULL;
+	mSDCCHPool.push_back(wSDCCH);
+	mSDCCHFree.add(wSDCCH);
 }
 
+void GSMConfig::addTCH(TCHFACCHLogicalChannel *wTCH)
+{
+	mTCHPool.push_back(wTCH);
+	mTCHFree.add(wTCH);
+}
 
-
+void GSMConfig::addPDTCH(PDTCHLogicalChannel *wPDTCH)
+{
+	mPDTCHPool.push_back(wPDTCH);
+	mPDTCHFree.add(wPDTCH);
+}
 
 
 SDCCHLogicalChannel *GSMConfig::getSDCCH()
 {
-	ScopedLock lock(mLock);
-	SDCCHLogicalChannel *chan = getChan<SDCCHLogicalChannel>(mSDCCHPool);
-	if (chan) chan->open();
-	return chan;
+	return mSDCCHFree.allocate();
 }
 
 
 TCHFACCHLogicalChannel *GSMConfig::getTCH()
 {
-	ScopedLock lock(mLock);
-	TCHFACCHLogicalChannel *chan = getChan<TCHFACCHLogicalChannel>(mTCHPool);
-	if (chan) chan->open();
-	return chan;
+	return mTCHFree.allocate();
 }
 
 PDTCHLogicalChannel *GSMConfig::getPDTCH()
 {
-	mLock.lock();
-	PDTCHLogicalChannel *chan = getChan<PDTCHLogicalChannel>(mPDTCHPool);
-	if (chan) chan->open();
-	mLock.unlock();
-	return chan;
-}
-
-template <class ChanType> size_t chanAvailable(const vector<ChanType*>& chanList)
-{
-	size_t count = 0;
-	for (unsigned i=0; i<chanList.size(); i++) {
-		if (chanList[i]->recyclable()) count++;
-	}
-	return count;
+	return mPDTCHFree.allocate();
 }
 
 
 
 size_t GSMConfig::SDCCHAvailable() const
 {
-	ScopedLock lock(mLock);
-	return chanAvailable<SDCCHLogicalChannel>(mSDCCHPool);
+	return mSDCCHFree.available();
 }
 
 size_t GSMConfig::TCHAvailable() const
 {
-	ScopedLock lock(mLock);
-	return chanAvailable<TCHFACCHLogicalChannel>(mTCHPool);
+	return mTCHFree.available();
 }
 
 size_t GSMConfig::PDTCHAvailable() const
 {
-	mLock.lock();
-	size_t retVal = chanAvailable<PDTCHLogicalChannel>(mPDTCHPool);
-	mLock.unlock();
-	return retVal;
+	return mPDTCHFree.available();
 }
 
 size_t GSMConfig::totalLoad(const CCCHList& chanList) const
@@ -254,33 +262,40 @@ size_t GSMConfig::totalLoad(const CCCHList& chanList) const
 
 
 
-template <class ChanType> unsigned countActive(const vector<ChanType*>& chanList)
+void GSMConfig::dumpChannelStats(ostream& os) const
 {
-	unsigned active = 0;
-	const unsigned sz = chanList.size();
-	// Start the search from a random point in the list.
-	for (unsigned i=0; i<sz; i++) {
-		if (!chanList[i]->recyclable()) active++;
-	}
-	return active;
+	os << "SDCCH free list: "; mSDCCHFree.dump(os); os << endl;
+	os << "TCH/F free list: "; mTCHFree.dump(os); os << endl;
+	os << "PDTCH free list: "; mPDTCHFree.dump(os); os << endl;
 }
 
 
-unsigned GSMConfig::SDCCHActive() const
+void GSMConfig::warmLoadTime(long ms)
 {
-	return countActive(mSDCCHPool);
+	ScopedLock lock(mLock);
+	mWarmLoadTime = ms;
 }
 
-unsigned GSMConfig::TCHActive() const
+
+void GSMConfig::BCCHSent()
 {
-	return countActive(mTCHPool);
+	ScopedLock lock(mLock);
+	if (mFirstBCCHTime>=0) return;
+	mFirstBCCHTime = mBootTime.elapsed();
+	LOG(NOTICE) << "first BCCH block " << mFirstBCCHTime << " ms after startup, warm load " << mWarmLoadTime << " ms";
 }
 
-unsigned GSMConfig::PDTCHActive() const
+
+void GSMConfig::dumpStartup(ostream& os) const
 {
-	return countActive(mPDTCHPool);
+	ScopedLock lock(mLock);
+	os << "warm load " << mWarmLoadTime << " ms first BCCH ";
+	if (mFirstBCCHTime<0) os << "not sent";
+	else os << mFirstBCCHTime << " ms";
+	os << " uptime " << uptime() << " s";
 }
 
+
 unsigned GSMConfig::T3122() const
 {
 	ScopedLock lock(mLock);
@@ -346,8 +361,7 @@ void GSMConfig::createCombinationVII(TransceiverManager& TRX, unsigned TN)
 	for (int i=0; i<8; i++) {
 		SDCCHLogicalChannel* chan = new SDCCHLogicalChannel(TN,gSDCCH8[i]);
 		chan->downstream(radio);
-		Thread* thread = new Thread;
-		thread->start((void*(*)(void*))Control::DCCHDispatcher,chan);
+		Control::startSDCCHDispatcher(chan);
 		chan->open();
 		gBTS.addSDCCH(chan);
 	}
@@ -367,5 +381,24 @@ bool GSMConfig::hold() const
 }
 
 
+void GSMConfig::barAccessClasses(unsigned classes)
+{
+	{
+		ScopedLock lock(mLock);
+		if (classes==mBarredClasses) return;
+		mBarredClasses = classes;
+	}
+	LOG(NOTICE) << "barring access classes 0x" << hex << classes << dec;
+	regenerateBeacon();
+}
+
+
+unsigned GSMConfig::barredClasses() const
+{
+	ScopedLock lock(mLock);
+	return mBarredClasses;
+}
+
+
 
 // vim: ts=4 sw=4
@@ -32,6 +32,9 @@
 
 //#include <ControlCommon.h>
 #include <RadioResource.h>
+#include <OverloadControl.h>
+#include <RegistrationCache.h>
+#include <LocationTable.h>
 #include <PowerManager.h>
 
 #include "GSML3RRElements.h"
@@ -39,6 +42,11 @@
 #include "GSML3RRMessages.h"
 
 #include "TRXManager.h"
+#include "GSML1Scheduler.h"
+#include "GSML2Reactor.h"
+#include <TimerWheel.h>
+#include <Coroutines.h>
+#include "GSMChannelPool.h"
 
 
 namespace GSM {
@@ -64,6 +72,10 @@ class GSMConfig {
 
 	/** The paging mechanism is built-in. */
 	Control::Pager mPager;
+	Control::AccessGrantScheduler mAccessGrants;
+	Control::OverloadController mOverload;
+	Control::RegistrationCache mRegistrations;
+	Control::LocationTable mLocations;
 
 	PowerManager mPowerManager;
 
@@ -83,6 +95,13 @@ class GSMConfig {
 	PDTCHList mPDTCHPool;
 	//@}
 
+	/**@name Free lists for the channel pools, with their own locks. */
+	//@{
+	ChannelFreeList<SDCCHLogicalChannel> mSDCCHFree;
+	ChannelFreeList<TCHFACCHLogicalChannel> mTCHFree;
+	ChannelFreeList<PDTCHLogicalChannel> mPDTCHFree;
+	//@}
+
 	/**@name BSIC. */
 	//@{
 	unsigned mNCC;		///< network color code
@@ -93,6 +112,11 @@ class GSMConfig {
 
 	Clock mClock;		///< local copy of BTS master clock
 
+	L1Scheduler mL1Scheduler;	///< frame-tick service for L1 encoders, if enabled
+	L2Reactor mL2Reactor;		///< event-driven service for LAPDm links, if enabled
+	TimerWheel mTimers;			///< shared wheel for protocol timers
+	TaskPool mTasks;			///< coroutine tasks for the SDCCH dispatchers, if enabled
+
 	/**@name Encoded L2 frames to be sent on the BCCH. */
 	//@{
 	L2Frame mSI1Frame;
@@ -112,9 +136,17 @@ class GSMConfig {
 
 	time_t mStartTime;
 
+	/**@name Startup timing, protected by mLock. */
+	//@{
+	Timeval mBootTime;			///< when this object was built, at the start of the process
+	long mWarmLoadTime;			///< ms to preload the control-plane state, -1 until done
+	long mFirstBCCHTime;		///< ms from mBootTime to the first BCCH block, -1 until sent
+	//@}
+
 	L3LocationAreaIdentity mLAI;
 
 	bool mHold;		///< If true, do not respond to RACH bursts.
+	unsigned mBarredClasses;	///< access classes barred by overload control
 
 	InterthreadQueue<Control::ChannelRequestRecord> mChannelRequestQueue;
 	Thread mAccessGrantThread;
@@ -149,10 +181,18 @@ class GSMConfig {
 	/**@name Accessors. */
 	//@{
 	Control::Pager& pager() { return mPager; }
+	Control::AccessGrantScheduler& accessGrants() { return mAccessGrants; }
+	Control::OverloadController& overload() { return mOverload; }
+	Control::RegistrationCache& registrations() { return mRegistrations; }
+	Control::LocationTable& locations() { return mLocations; }
 	GSMBand band() const { return mBand; }
 	unsigned BCC() const { return mBCC; }
 	unsigned NCC() const { return mNCC; }
 	GSM::Clock& clock() { return mClock; }
+	L1Scheduler& scheduler() { return mL1Scheduler; }
+	L2Reactor& reactor() { return mL2Reactor; }
+	TimerWheel& timers() { return mTimers; }
+	TaskPool& tasks() { return mTasks; }
 	const L3LocationAreaIdentity& LAI() const { return mLAI; }
 	//@}
 
@@ -176,6 +216,16 @@ class GSMConfig {
 	*/
 	bool hold() const;
 
+	/**
+		Bar access classes on the BCCH, on top of GSM.RACH.AC,
+		regenerating the beacon if the set changes.
+		@param classes Bit i bars access class i; 0 clears the barring.
+	*/
+	void barAccessClasses(unsigned classes);
+
+	/** The access classes barred by barAccessClasses(). */
+	unsigned barredClasses() const;
+
 	protected:
 
 	/** Find a minimum-load CCCH from a list. */
@@ -204,6 +254,13 @@ class GSMConfig {
 	/** Return a minimum-load PCH. */
 	CCCHLogicalChannel* getPCH() { return minimumLoad(mPCHPool); }
 
+	/** Return a specific AGCH. */
+	CCCHLogicalChannel* getAGCH(size_t index)
+	{
+		assert(index<mAGCHPool.size());
+		return mAGCHPool[index];
+	}
+
 	/** Return a specific PCH. */
 	CCCHLogicalChannel* getPCH(size_t index)
 	{
@@ -211,6 +268,9 @@ class GSMConfig {
 		return mPCHPool[index];
 	}
 
+	/** Return the number of configured PCHs */
+	unsigned numPCHs() const { return mPCHPool.size(); }
+
 	/** Return the number of configured AGCHs */
 	unsigned numAGCHs() const { return mAGCHPool.size(); }
 
@@ -221,6 +281,10 @@ class GSMConfig {
 	Control::ChannelRequestRecord* nextChannelRequest()
 		{ return mChannelRequestQueue.read(); }
 
+	/** Return the next RACH channel request, or NULL if none is waiting. */
+	Control::ChannelRequestRecord* nextChannelRequestNoBlock()
+		{ return mChannelRequestQueue.readNoBlock(); }
+
 	void flushChannelRequests()
 		{ mChannelRequestQueue.clear(); }
 
@@ -230,7 +294,7 @@ class GSMConfig {
 	/**@name Manage SDCCH Pool. */
 	//@{
 	/** The add method is not mutex protected and should only be used during initialization. */
-	void addSDCCH(SDCCHLogicalChannel *wSDCCH) { mSDCCHPool.push_back(wSDCCH); }
+	void addSDCCH(SDCCHLogicalChannel *wSDCCH);
 	/** Return a pointer to a usable channel. */
 	SDCCHLogicalChannel *getSDCCH();
 	/** Return true if an SDCCH is available, but do not allocate it. */
@@ -238,7 +302,7 @@ class GSMConfig {
 	/** Return number of total SDCCH. */
 	unsigned SDCCHTotal() const { return mSDCCHPool.size(); }
 	/** Return number of active SDCCH. */
-	unsigned SDCCHActive() const;
+	unsigned SDCCHActive() const { return SDCCHTotal() - SDCCHAvailable(); }
 	/** Just a reference to the SDCCH pool. */
 	const SDCCHList& SDCCHPool() const { return mSDCCHPool; }
 	//@}
@@ -246,7 +310,7 @@ class GSMConfig {
 	/**@name Manage TCH pool. */
 	//@{
 	/** The add method is not mutex protected and should only be used during initialization. */
-	void addTCH(TCHFACCHLogicalChannel *wTCH) { mTCHPool.push_back(wTCH); }
+	void addTCH(TCHFACCHLogicalChannel *wTCH);
 	/** Return a pointer to a usable channel. */
 	TCHFACCHLogicalChannel *getTCH();
 	/** Return true if an TCH is available, but do not allocate it. */
@@ -254,7 +318,7 @@ class GSMConfig {
 	/** Return number of total TCH. */
 	unsigned TCHTotal() const { return mTCHPool.size(); }
 	/** Return number of active TCH. */
-	unsigned TCHActive() const;
+	unsigned TCHActive() const { return TCHTotal() - TCHAvailable(); }
 	/** Just a reference to the TCH pool. */
 	const TCHList& TCHPool() const { return mTCHPool; }
 	//@}
@@ -262,7 +326,7 @@ class GSMConfig {
 	/**@name Manage PDTCH Pool. */
 	//@{
 	/** The add method is not mutex protected and should only be used during initialization. */
-	void addPDTCH(PDTCHLogicalChannel *wPDTCH) { mPDTCHPool.push_back(wPDTCH); }
+	void addPDTCH(PDTCHLogicalChannel *wPDTCH);
 	/** Return a pointer to a usable channel. */
 	PDTCHLogicalChannel *getPDTCH();
 	/** Return true if an PDTCH is available, but do not allocate it. */
@@ -270,11 +334,24 @@ class GSMConfig {
 	/** Return number of total PDTCH. */
 	unsigned PDTCHTotal() const { return mPDTCHPool.size(); }
 	/** Return number of active PDTCH. */
-	unsigned PDTCHActive() const;
+	unsigned PDTCHActive() const { return PDTCHTotal() - PDTCHAvailable(); }
 	/** Just a reference to the PDTCH pool. */
 	const PDTCHList& PDTCHPool() const { return mPDTCHPool; }
 	//@}
 
+	/** Dump channel allocation statistics. */
+	void dumpChannelStats(std::ostream&) const;
+
+	/**@name Startup timing. */
+	//@{
+	/** Record the time taken to preload the control-plane state, in ms. */
+	void warmLoadTime(long ms);
+	/** Called by the BCCH encoder for its first block. */
+	void BCCHSent();
+	/** Dump the startup timing. */
+	void dumpStartup(std::ostream&) const;
+	//@}
+
 	/**@name T3122 management */
 	//@{
 	unsigned T3122() const;
@@ -0,0 +1,144 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "GSML1DecodePool.h"
+#include "GSML1FEC.h"
+#include <Globals.h>
+#include <Logger.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+
+
+
+
+void L1DecodeWorker::start(L1DecodePool *wPool, unsigned wIndex)
+{
+	mPool = wPool;
+	mIndex = wIndex;
+	mThread.start((void*(*)(void*))L1DecodeWorkerAdapter,this);
+}
+
+
+void L1DecodeWorker::serviceLoop()
+{
+	while (true) {
+		L1DecodeJob *job = mQueue.read();
+		job->mDecoder->writeLowSide(job->mBurst);
+		job->mDecoder->countLatency(job->mReceived);
+		delete job;
+	}
+}
+
+
+void *GSM::L1DecodeWorkerAdapter(L1DecodeWorker *worker)
+{
+	worker->serviceLoop();
+	return NULL;
+}
+
+
+
+
+L1DecodePool::L1DecodePool()
+	:mWorkers(NULL),mNumWorkers(0),mRunning(false),
+	mNextWorker(0),
+	mPosted(0),mMaxDepth(0)
+{ }
+
+
+bool L1DecodePool::enabled() const
+{
+	return gConfig.defines("GSM.L1DecodePool");
+}
+
+
+void L1DecodePool::start()
+{
+	if (!enabled()) return;
+	ScopedLock lock(mLock);
+	if (mRunning) return;
+
+	mNumWorkers = gConfig.getNum("GSM.L1DecodePool.Workers");
+	if (mNumWorkers<1) mNumWorkers=1;
+	if (mNumWorkers>8) mNumWorkers=8;
+	LOG(NOTICE) << "starting L1 decode pool with " << mNumWorkers << " workers";
+	mWorkers = new L1DecodeWorker[mNumWorkers];
+	for (unsigned i=0; i<mNumWorkers; i++) mWorkers[i].start(this,i);
+	mRunning = true;
+}
+
+
+void L1DecodePool::post(L1Decoder *decoder, const RxBurst& burst)
+{
+	assert(mRunning);
+
+	// Bind the decoder to a worker on first use.
+	// Round-robin spreads the channels of a slot across the pool.
+	unsigned index;
+	map<L1Decoder*,unsigned>::const_iterator itr = mBindings.find(decoder);
+	if (itr!=mBindings.end()) index = itr->second;
+	else {
+		index = mNextWorker;
+		mNextWorker = (mNextWorker+1) % mNumWorkers;
+		ScopedLock lock(mLock);
+		mBindings[decoder] = index;
+		LOG(DEBUG) << "L1 decode pool bound TN " << decoder->TN() << " " << decoder->typeAndOffset() << " to worker " << index;
+	}
+
+	L1DecodeWorker& worker = mWorkers[index];
+	worker.mQueue.write(new L1DecodeJob(decoder,burst));
+
+	unsigned depth = worker.mQueue.size();
+	ScopedLock lock(mLock);
+	mPosted++;
+	if (depth>mMaxDepth) mMaxDepth = depth;
+}
+
+
+unsigned L1DecodePool::depth() const
+{
+	if (!mRunning) return 0;
+	unsigned total = 0;
+	for (unsigned i=0; i<mNumWorkers; i++) total += mWorkers[i].mQueue.size();
+	return total;
+}
+
+
+void L1DecodePool::dump(ostream& os) const
+{
+	unsigned current = depth();
+	ScopedLock lock(mLock);
+	os << "L1 decode pool: " << mNumWorkers << " workers, " << mBindings.size() << " decoders" << endl;
+	os << "L1 decode pool bursts: " << mPosted << ", queued: " << current << ", max queue depth: " << mMaxDepth << endl;
+}
+
+
+
+// vim: ts=4 sw=4
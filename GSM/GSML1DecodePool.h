@@ -0,0 +1,160 @@
+/**@file Worker pool for uplink L1 decoding. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef GSML1DECODEPOOL_H
+#define GSML1DECODEPOOL_H
+
+#include <map>
+#include <ostream>
+
+#include <Threads.h>
+#include <Interthread.h>
+#include <Timeval.h>
+
+#include "GSMTransfer.h"
+
+
+namespace GSM {
+
+
+class L1Decoder;
+class L1DecodePool;
+
+
+/** A received burst waiting for its decoder. */
+class L1DecodeJob {
+
+	public:
+
+	L1Decoder *mDecoder;
+	RxBurst mBurst;
+	Timeval mReceived;		///< when the burst came off the demux
+
+	L1DecodeJob(L1Decoder *wDecoder, const RxBurst& wBurst)
+		:mDecoder(wDecoder),mBurst(wBurst)
+	{ }
+};
+
+
+typedef InterthreadQueue<L1DecodeJob> L1DecodeJobFIFO;
+
+
+/** One worker thread of the L1DecodePool. */
+class L1DecodeWorker {
+
+	private:
+
+	L1DecodePool *mPool;
+	unsigned mIndex;			///< position in the pool
+	Thread mThread;
+	L1DecodeJobFIFO mQueue;		///< bursts for the decoders owned by this worker
+
+	public:
+
+	L1DecodeWorker()
+		:mPool(NULL),mIndex(0)
+	{ }
+
+	void start(L1DecodePool *wPool, unsigned wIndex);
+
+	/** The worker service loop. */
+	void serviceLoop();
+
+	friend class L1DecodePool;
+	friend void *L1DecodeWorkerAdapter(L1DecodeWorker*);
+};
+
+void *L1DecodeWorkerAdapter(L1DecodeWorker*);
+
+
+
+/**
+	A pool of threads that run the uplink L1 decoders.
+
+	When GSM.L1DecodePool is defined, the ARFCNManager receive thread only
+	demultiplexes bursts and posts them here, so that deinterleaving,
+	Viterbi decoding and the hand-off to L2 do not hold up the receipt of
+	later bursts.  Each decoder is bound to one worker the first time it
+	gets a burst, and each worker has a single FIFO, so bursts for a
+	given channel are always processed in order.
+*/
+class L1DecodePool {
+
+	private:
+
+	mutable Mutex mLock;
+	L1DecodeWorker *mWorkers;
+	unsigned mNumWorkers;
+	bool mRunning;
+
+	/**
+		Decoder-to-worker bindings.
+		Only the receive thread reads or inserts, but inserts take mLock for dump().
+	*/
+	std::map<L1Decoder*,unsigned> mBindings;
+	unsigned mNextWorker;		///< next worker for round-robin binding
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mPosted;		///< total bursts posted to the pool
+	unsigned mMaxDepth;			///< deepest worker queue seen at posting time
+	//@}
+
+	public:
+
+	L1DecodePool();
+
+	/** Return true if the pool is configured to replace inline decoding. */
+	bool enabled() const;
+
+	/** Start the workers, if enabled. */
+	void start();
+
+	/** Return true if the workers are running. */
+	bool running() const { return mRunning; }
+
+	/**
+		Queue a burst for decoding.
+		Must only be called from one thread, the ARFCNManager receive thread.
+	*/
+	void post(L1Decoder *decoder, const RxBurst& burst);
+
+	/** Total number of bursts waiting in the pool. */
+	unsigned depth() const;
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+};
+
+
+
+};	// namespace GSM
+
+
+#endif
+
+// vim: ts=4 sw=4
@@ -31,6 +31,7 @@
 #include "GSMConfig.h"
 #include "GSMTDMA.h"
 #include "GSMTAPDump.h"
+#include "GSML1Scheduler.h"
 #include <ControlCommon.h>
 #include <Globals.h>
 #include <TRXManager.h>
@@ -190,7 +191,8 @@ L1Encoder::L1Encoder(unsigned wTN, const TDMAMapping& wMapping, L1FEC *wParent)
 	mTotalBursts(0),
 	mPrevWriteTime(gBTS.time().FN(),wTN),
 	mNextWriteTime(gBTS.time().FN(),wTN),
-	mRunning(false),mActive(false)
+	mRunning(false),mActive(false),
+	mScheduled(false),mDeferred(false)
 {
 	assert(mMapping.allowedSlot(mTN));
 	assert(mMapping.downlink());
@@ -283,6 +285,19 @@ void L1Encoder::resync()
 }
 
 
+Time L1Encoder::nextWriteTime() const
+{
+	// This is the same test as in resync(), without changing anything.
+	Time now = gBTS.time();
+	int32_t delta = mNextWriteTime-now;
+	if ((delta>=0) && (delta<=(51*26))) return mNextWriteTime;
+	Time next = now;
+	next.TN(mTN);
+	next.rollForward(mMapping.frameMapping(mTotalBursts),mMapping.repeatLength());
+	return next;
+}
+
+
 void L1Encoder::waitToSend() const
 {
 	// Block until the BTS clock catches up to the
@@ -291,6 +306,43 @@ void L1Encoder::waitToSend() const
 }
 
 
+void L1Encoder::defer(const Time& when)
+{
+	if (!mScheduled) {
+		gBTS.clock().wait(when);
+		return;
+	}
+	mDeferTime = when;
+	mDeferred = true;
+}
+
+
+bool L1Encoder::dueForService(const Time& now) const
+{
+	// This is the non-blocking equivalent of waitToSend().
+	// Like Clock::wait, treat anything more than a superframe
+	// ahead as a clock reset and let resync() sort it out.
+	static const int32_t maxAhead = 51*26;
+	if (mDeferred) {
+		int32_t hold = FNDelta(mDeferTime.FN(),now.FN());
+		if ((hold>0) && (hold<=maxAhead)) return false;
+	}
+	int32_t ahead = FNDelta(mPrevWriteTime.FN(),now.FN());
+	return (ahead<1) || (ahead>maxAhead);
+}
+
+
+void L1Encoder::startService(Thread& thread, void *(*adapter)(void*))
+{
+	if (gBTS.scheduler().enabled()) {
+		mScheduled = true;
+		gBTS.scheduler().add(this);
+		return;
+	}
+	thread.start(adapter,(void*)this);
+}
+
+
 void L1Encoder::sendIdleFill()
 {
 	// Send the L1 idle filling pattern, if any.
@@ -299,11 +351,17 @@ void L1Encoder::sendIdleFill()
 	resync();
 	for (unsigned i=0; i<mMapping.numFrames(); i++) {
 		mFillerBurst.time(mNextWriteTime);
-		mDownstream->writeHighSide(mFillerBurst);
+		sendBurst(mFillerBurst);
 		rollForward();
 	}
 }
 
+void L1Encoder::sendBurst(const TxBurst& burst)
+{
+	mDownstream->writeHighSide(burst);
+}
+
+
 unsigned L1Encoder::ARFCN() const
 {
 	assert(mDownstream);
@@ -330,6 +388,11 @@ void L1Decoder::open()
 	ScopedLock lock(mLock);
 	if (!mRunning) start();
 	mFER=0.0F;
+	mLatencyCount=0;
+	mLatencyTotal=0.0;
+	mLatencyMax=0;
+	mCombineTries=0;
+	mCombineHits=0;
 	mT3111.reset();
 	mT3109.reset();
 	mT3101.set();
@@ -388,6 +451,55 @@ void L1Decoder::countGoodFrame()
 }
 
 
+void L1Decoder::countLatency(const Timeval& received)
+{
+	Timeval now;
+	long usec = (long)(now.sec()-received.sec())*1000000L + (long)now.usec() - (long)received.usec();
+	if (usec<0) usec=0;
+	ScopedLock lock(mLock);
+	mLatencyCount++;
+	mLatencyTotal += usec;
+	if ((unsigned)usec>mLatencyMax) mLatencyMax=usec;
+}
+
+
+float L1Decoder::latency() const
+{
+	ScopedLock lock(mLock);
+	if (mLatencyCount==0) return 0.0F;
+	return mLatencyTotal / mLatencyCount;
+}
+
+
+unsigned L1Decoder::maxLatency() const
+{
+	ScopedLock lock(mLock);
+	return mLatencyMax;
+}
+
+
+void L1Decoder::countCombine(bool hit)
+{
+	ScopedLock lock(mLock);
+	mCombineTries++;
+	if (hit) mCombineHits++;
+}
+
+
+unsigned L1Decoder::combineTries() const
+{
+	ScopedLock lock(mLock);
+	return mCombineTries;
+}
+
+
+unsigned L1Decoder::combineHits() const
+{
+	ScopedLock lock(mLock);
+	return mCombineHits;
+}
+
+
 void L1Decoder::countBadFrame()
 {
 	static const float a = 1.0F / ((float)mFERMemory);
@@ -528,7 +640,8 @@ XCCHL1Decoder::XCCHL1Decoder(
 	:L1Decoder(wTN,wMapping,wParent),
 	mBlockCoder(0x10004820009ULL, 40, 224),
 	mC(456), mU(228),
-	mP(mU.segment(184,40)),mDP(mU.head(224)),mD(mU.head(184))
+	mP(mU.segment(184,40)),mDP(mU.head(224)),mD(mU.head(184)),
+	mSavedC(456),mHaveSavedC(false)
 {
 	for (int i=0; i<4; i++) {
 		mI[i] = SoftVector(114);
@@ -538,6 +651,14 @@ XCCHL1Decoder::XCCHL1Decoder(
 }
 
 
+void XCCHL1Decoder::open()
+{
+	L1Decoder::open();
+	ScopedLock lock(mLock);
+	mHaveSavedC = false;
+}
+
+
 
 void XCCHL1Decoder::writeLowSide(const RxBurst& inBurst)
 {
@@ -551,7 +672,7 @@ void XCCHL1Decoder::writeLowSide(const RxBurst& inBurst)
 	// Return true if we are ready to interleave.
 	if (!processBurst(inBurst)) return;
 	deinterleave();
-	if (decode()) {
+	if (decodeCombined(mReadTime)) {
 		countGoodFrame();
 		mD.LSB8MSB();
 		handleGoodFrame();
@@ -640,6 +761,51 @@ bool XCCHL1Decoder::decode()
 }
 
 
+/** Combine two soft bits as a sum of log-likelihood ratios. */
+static float combineSoftBits(float a, float b)
+{
+	// Keep away from the poles; 0.001 is about 7 in LLR terms.
+	if (a<0.001F) a=0.001F; else if (a>0.999F) a=0.999F;
+	if (b<0.001F) b=0.001F; else if (b>0.999F) b=0.999F;
+	float LLR = logf(a/(1.0F-a)) + logf(b/(1.0F-b));
+	return 1.0F / (1.0F + expf(-LLR));
+}
+
+
+bool XCCHL1Decoder::decodeCombined(const GSM::Time& when)
+{
+	// Try the block by itself first.
+	if (decode()) {
+		mHaveSavedC = false;
+		return true;
+	}
+	if (!gConfig.defines("GSM.SoftCombining")) return false;
+
+	bool recent = mHaveSavedC && ((when-mSavedTime) <= (int)gConfig.getNum("GSM.SoftCombining.Window"));
+	if (!recent) {
+		// Save this block for the next try.
+		mC.copyToSegment(mSavedC,0);
+		mSavedTime = when;
+		mHaveSavedC = true;
+		return false;
+	}
+
+	// Combine into c[] and keep the new block in the save buffer,
+	// so that a failed combination does not poison the next one.
+	for (size_t k=0; k<mC.size(); k++) {
+		float current = mC[k];
+		mC[k] = combineSoftBits(current,mSavedC[k]);
+		mSavedC[k] = current;
+	}
+	mSavedTime = when;
+	bool good = decode();
+	countCombine(good);
+	OBJLOG(DEBUG) <<"XCCHL1Decoder soft combining " << (good ? "recovered" : "failed");
+	mHaveSavedC = !good;
+	return good;
+}
+
+
 
 void XCCHL1Decoder::handleGoodFrame()
 {
@@ -724,8 +890,93 @@ void SACCHL1Decoder::handleGoodFrame()
 	XCCHL1Decoder::handleGoodFrame();
 }
 
+
+
+
+/**@name PDTCH coding schemes, GSM 05.03 5.1.  Tables are indexed by CS, 1..4. */
+//@{
+
+/** Radio block size d[], in bits. */
+static const unsigned PDTCHBlockBits[5] = { 0, 184, 271, 315, 431 };
+
+/** RLC/MAC block size, in octets; the rest of d[] is spare. */
+static const unsigned PDTCHFrameOctets[5] = { 0, 23, 33, 39, 53 };
+
+/** Stealing flags q(0)..q(7), with q(0) in the MSB. */
+static const unsigned PDTCHStealingFlags[5] = { 0, 0xff, 0xc8, 0x21, 0x16 };
+
+/** USF precoding for CS-2 and CS-3, indexed by USF, u'(0) is the USF LSB. */
+static const char* PDTCHUSF6[8] = {
+	"000000", "100101", "010110", "110011",
+	"001011", "101110", "011101", "111000"
+};
+
+/** USF precoding for CS-4, indexed by USF. */
+static const char* PDTCHUSF12[8] = {
+	"000000000000", "110100001011", "001101110110", "111001111101",
+	"000011011101", "110111010110", "001110101011", "111010100000"
+};
+
+/** Smallest coding scheme that carries a frame of the given size, or 0 if none. */
+static unsigned PDTCHCodingScheme(size_t frameBits)
+{
+	for (unsigned CS=1; CS<=4; CS++) {
+		if (frameBits <= PDTCHFrameOctets[CS]*8) return CS;
+	}
+	return 0;
+}
+
+/** Size of u[] for the convolutionally coded schemes: precoded USF, data, BCS, tail. */
+static unsigned PDTCHUBits(unsigned CS)
+{
+	return 6 + (PDTCHBlockBits[CS]-3) + 16 + 4;
+}
+
+/** Return true if c(k) is punctured, GSM 05.03 5.1.2.3 and 5.1.3.3. */
+static bool PDTCHPunctured(unsigned CS, unsigned k)
+{
+	switch (CS) {
+		case 2: {
+			if (k%4 != 3) return false;
+			unsigned i = k/4;
+			return (i>=3) && (i<=146) && (i%12 != 9);
+		}
+		case 3: {
+			if ((k%6 != 3) && (k%6 != 5)) return false;
+			unsigned i = k/6;
+			return (i>=2) && (i<=111);
+		}
+		default: return false;
+	}
+}
+
+/** Return the USF whose precoded form is closest to the given soft bits. */
+static unsigned PDTCHNearestUSF(const SoftVector& soft, const char** table)
+{
+	unsigned best = 0;
+	float bestCost = soft.size();
+	for (unsigned USF=0; USF<8; USF++) {
+		float cost = 0.0F;
+		for (unsigned i=0; i<soft.size(); i++) {
+			float want = (table[USF][i]=='1') ? 1.0F : 0.0F;
+			cost += fabsf(soft[i]-want);
+		}
+		if (cost<bestCost) { bestCost=cost; best=USF; }
+	}
+	return best;
+}
+
+//@}
+
+
+
 bool PDTCHL1Decoder::processBurst(const RxBurst& inBurst)
 {
+	// Keep the stealing flags for coding scheme detection, GSM 05.03 5.1.
+	int B = mMapping.reverseMapping(inBurst.time().FN()) % 4;
+	assert(B>=0);
+	mQ[2*B] = inBurst[gHlIndex];
+	mQ[2*B+1] = inBurst[gHuIndex];
 	return XCCHL1Decoder::processBurst(inBurst);
 }
 
@@ -733,12 +984,127 @@ void PDTCHL1Decoder::writeLowSide(const RxBurst& burst)
 {
 	OBJLOG(INFO) <<"PDTCHL1Decoder burst=" << burst.time() << " " << burst.RSSI() << " "
                                            << burst.data1() << burst.data2() << (burst.Hu()?"1":"0") << (burst.Hl()?"1":"0");
-	XCCHL1Decoder::writeLowSide(burst);
+	// If the channel is closed, ignore the burst.
+	if (!active()) {
+		OBJLOG(DEBUG) <<"PDTCHL1Decoder not active, ignoring input";
+		return;
+	}
+	if (!processBurst(burst)) return;
+	deinterleave();
+	unsigned CS = detectCS();
+	bool good;
+	if (CS==1) {
+		good = decode();
+		if (good) mD.LSB8MSB();
+	} else {
+		good = decodeCS(CS);
+	}
+	// Stealing flags are marked unknown until the next block.
+	for (int i=0; i<8; i++) mQ[i]=0.5F;
+	if (good) {
+		mUplinkCS = CS;
+		countGoodFrame();
+		handleGoodFrame();
+	} else {
+		countBadFrame();
+	}
+	adaptCS();
+}
+
+unsigned PDTCHL1Decoder::detectCS() const
+{
+	// Correlate the soft stealing flags against the code words.
+	unsigned best = 1;
+	float bestCost = 9.0F;
+	for (unsigned CS=1; CS<=4; CS++) {
+		float cost = 0.0F;
+		for (unsigned n=0; n<8; n++) {
+			float want = ((PDTCHStealingFlags[CS]>>(7-n)) & 0x01) ? 1.0F : 0.0F;
+			cost += fabsf(mQ[n]-want);
+		}
+		if (cost<bestCost) { bestCost=cost; best=CS; }
+	}
+	return best;
+}
+
+bool PDTCHL1Decoder::decodeCS(unsigned CS)
+{
+	// GSM 05.03 5.1.2-5.1.4, in reverse.
+	const unsigned blockBits = PDTCHBlockBits[CS];
+	BitVector d(blockBits);
+	BitVector p(16);
+	unsigned USF;
+	if (CS==4) {
+		// No convolutional code, just USF precoding.
+		USF = PDTCHNearestUSF(mC.head(12),PDTCHUSF12);
+		mC.segment(12,blockBits-3).sliced().copyToSegment(d,3);
+		mC.segment(12+blockBits-3,16).sliced().copyToSegment(p,0);
+	} else {
+		// Depuncture c[], marking the punctured bits as unknown.
+		// The punctured tail is weak, so extend c[] with the all-zero output
+		// of a few more zero inputs to tell the decoder where the trellis ends.
+		const unsigned uBits = PDTCHUBits(CS);
+		const unsigned flush = 8;
+		SoftVector c(2*(uBits+flush));
+		c.fill(0.0F);
+		unsigned j = 0;
+		for (unsigned k=0; k<2*uBits; k++) {
+			if (PDTCHPunctured(CS,k)) c[k] = 0.5F;
+			else c[k] = mC[j++];
+		}
+		assert(j==mC.size());
+		BitVector u(uBits+flush);
+		c.decode(mVCoder,u);
+		USF = PDTCHNearestUSF(SoftVector(u.head(6)),PDTCHUSF6);
+		u.segment(6,blockBits-3).copyToSegment(d,3);
+		u.segment(6+blockBits-3,16).copyToSegment(p,0);
+	}
+	d[0] = USF & 0x01;
+	d[1] = (USF>>1) & 0x01;
+	d[2] = (USF>>2) & 0x01;
+
+	// Block check sequence, GSM 05.03 5.1.2.2.
+	Parity BCS(0x11021,16,blockBits+16);
+	BitVector expected(16);
+	BCS.writeParityWord(d,expected);
+	for (unsigned i=0; i<16; i++) {
+		if (expected.bit(i)!=p.bit(i)) {
+			OBJLOG(DEBUG) <<"PDTCHL1Decoder CS-" << CS << " BCS failure";
+			return false;
+		}
+	}
+
+	// Drop the spare bits.
+	mCSD = d.head(PDTCHFrameOctets[CS]*8);
+	mCSD.LSB8MSB();
+	return true;
+}
+
+void PDTCHL1Decoder::adaptCS()
+{
+	// Link adaptation, driven by the FER from countGoodFrame()/countBadFrame().
+	// Move one step at a time and give the FER estimate time to settle.
+	if (mCSHold) {
+		mCSHold--;
+		return;
+	}
+	unsigned maxCS = gConfig.getNum("GPRS.CS.Max");
+	if (maxCS<1) maxCS=1;
+	if (maxCS>4) maxCS=4;
+	float FERPercent = 100.0F * mFER;
+	unsigned CS = mRecommendedCS;
+	if (CS>maxCS) CS = maxCS;
+	else if ((FERPercent > gConfig.getNum("GPRS.CS.FERDown")) && (CS>1)) CS--;
+	else if ((FERPercent < gConfig.getNum("GPRS.CS.FERUp")) && (CS<maxCS)) CS++;
+	if (CS==mRecommendedCS) return;
+	OBJLOG(INFO) <<"PDTCHL1Decoder FER=" << mFER << " CS-" << mRecommendedCS << " -> CS-" << CS;
+	mRecommendedCS = CS;
+	mCSHold = mFERMemory;
 }
 
 void PDTCHL1Decoder::handleGoodFrame()
 {
-	RLCMACFrame* frame = new RLCMACFrame(mD);
+	RLCMACFrame* frame = (mUplinkCS==1) ? new RLCMACFrame(mD) : new RLCMACFrame(mCSD);
 	mFramesQ.write(frame);
 	XCCHL1Decoder::handleGoodFrame();
 }
@@ -901,7 +1267,7 @@ void XCCHL1Encoder::transmit()
 		mI[B].segment(57,57).copyToSegment(mBurst,88);
 		// Send it to the radio.
 		OBJLOG(DEBUG) << "XCCHL1Encoder mBurst=" << mBurst;
-		mDownstream->writeHighSide(mBurst);
+		sendBurst(mBurst);
 		rollForward();
 	}
 }
@@ -911,7 +1277,7 @@ void XCCHL1Encoder::transmit()
 void GeneratorL1Encoder::start()
 {
 	L1Encoder::start();
-	mSendThread.start((void*(*)(void*))GeneratorL1EncoderServiceLoopAdapter,(void*)this);
+	startService(mSendThread,(void*(*)(void*))GeneratorL1EncoderServiceLoopAdapter);
 }
 
 
@@ -932,6 +1298,13 @@ void GeneratorL1Encoder::serviceLoop()
 	}
 }
 
+void GeneratorL1Encoder::serviceFrame()
+{
+	mDeferred = false;
+	resync();
+	generate();
+}
+
 
 
 
@@ -973,7 +1346,7 @@ void SCHL1Encoder::generate()
 	mE1.copyToSegment(mBurst,3);
 	mE2.copyToSegment(mBurst,106);
 	// Send it already!
-	mDownstream->writeHighSide(mBurst);
+	sendBurst(mBurst);
 	rollForward();
 }
 
@@ -997,10 +1370,12 @@ void FCCHL1Encoder::generate()
 	resync();
 	for (int i=0; i<5; i++) {
 		mBurst.time(mNextWriteTime);
-		mDownstream->writeHighSide(mBurst);
+		sendBurst(mBurst);
 		rollForward();
 	}
-	sleep(1);
+	// The transceiver repeats these bursts on its own,
+	// so we only need to refresh them about once a second.
+	defer(mNextWriteTime+217);
 }
 
 
@@ -1009,7 +1384,7 @@ void FCCHL1Encoder::generate()
 void NDCCHL1Encoder::start()
 {
 	L1Encoder::start();
-	mSendThread.start((void*(*)(void*))NDCCHL1EncoderServiceLoopAdapter,(void*)this);
+	startService(mSendThread,(void*(*)(void*))NDCCHL1EncoderServiceLoopAdapter);
 }
 
 
@@ -1035,6 +1410,11 @@ void NDCCHL1Encoder::serviceLoop()
 void BCCHL1Encoder::generate()
 {
 	OBJLOG(DEBUG) << "BCCHL1Encoder " << mNextWriteTime;
+	// The first block marks the end of startup.
+	if (!mSent) {
+		mSent = true;
+		gBTS.BCCHSent();
+	}
 	// BCCH mapping, GSM 05.02 6.3.1.3
 	// Since we're not doing GPRS or VGCS, it's just SI1-4 over and over.
 	switch (mNextWriteTime.TC()) {
@@ -1130,7 +1510,7 @@ bool TCHFACCHL1Decoder::processBurst( const RxBurst& inBurst)
 	bool stolen = inBurst.Hl();
 	OBJLOG(DEBUG) <<"TCHFACCHL1Decoder Hl=" << inBurst.Hl() << " Hu=" << inBurst.Hu();
 	if (stolen) {
-		if (decode()) {
+		if (decodeCombined(inBurst.time())) {
 			OBJLOG(DEBUG) <<"TCHFACCHL1Decoder good FACCH frame";
 			countGoodFrame();
 			mD.LSB8MSB();
@@ -1290,7 +1670,7 @@ void TCHFACCHL1Encoder::start()
 {
 	L1Encoder::start();
 	OBJLOG(DEBUG) <<"TCHFACCHL1Encoder";
-	mEncoderThread.start((void*(*)(void*))TCHFACCHL1EncoderRoutine,(void*)this);
+	startService(mEncoderThread,(void*(*)(void*))TCHFACCHL1EncoderRoutine);
 }
 
 
@@ -1363,9 +1743,10 @@ void TCHFACCHL1Encoder::dispatch()
 	// from above.  TCH/FACCH, however, must feed the interleaver on time.
 	if (!active()) {
 		mNextWriteTime += 26;
-		gBTS.clock().wait(mNextWriteTime);
+		defer(mNextWriteTime);
 		return;
 	}
+	mDeferred = false;
 
 	// Let previous data get transmitted.
 	resync();
@@ -1425,7 +1806,7 @@ void TCHFACCHL1Encoder::dispatch()
 		mBurst.Hl(mPreviousFACCH);
 		// send
 		OBJLOG(DEBUG) <<"TCHFACCHEncoder sending burst=" << mBurst;
-		mDownstream->writeHighSide(mBurst);	
+		sendBurst(mBurst);	
 		rollForward();
 	}	
 
@@ -1510,6 +1891,10 @@ void PDTCHL1Decoder::open()
 {
 	OBJLOG(DEBUG) << "PDTCHL1Decoder";
 	XCCHL1Decoder::open();
+	for (int i=0; i<8; i++) mQ[i]=0.5F;
+	mUplinkCS = 1;
+	mRecommendedCS = 1;
+	mCSHold = 0;
 }
 
 void SACCHL1Encoder::setPhy(float wRSSI, float wTimingError)
@@ -1581,7 +1966,7 @@ void PDTCHL1Encoder::start()
 {
 	L1Encoder::start();
 	OBJLOG(DEBUG) <<"PDTCHL1Encoder";
-	mEncoderThread.start((void*(*)(void*))PDTCHL1EncoderRoutine,(void*)this);
+	startService(mEncoderThread,(void*(*)(void*))PDTCHL1EncoderRoutine);
 }
 
 void PDTCHL1Encoder::open()
@@ -1598,12 +1983,28 @@ void PDTCHL1Encoder::dispatch()
 	waitToSend();
 
 	// Send, by priority: (1) PDTCH, (2) filler.
-	if (RLCMACFrame *frame = mRLCMACQ.readNoBlock()) {
+	// The coding scheme follows from the size of the RLC/MAC block.
+	unsigned CS = 1;
+	RLCMACFrame *frame = mRLCMACQ.readNoBlock();
+	if (frame && !PDTCHCodingScheme(frame->size())) {
+		OBJLOG(ERR) <<"PDTCH Encoder dropping oversized block, " << frame->size() << " bits";
+		delete frame;
+		frame = NULL;
+	}
+	if (frame) {
 		OBJLOG(NOTICE) <<"PDTCH Encoder " << *frame;
+		CS = PDTCHCodingScheme(frame->size());
 		frame->LSB8MSB();
-		frame->copyTo(mU);
-		// Encode u[] to c[], GSM 05.03 4.1.2 and 4.1.3.
-		encode();
+		if (CS==1) {
+			frame->copyTo(mU);
+			// Encode u[] to c[], GSM 05.03 4.1.2 and 4.1.3.
+			encode();
+		} else {
+			BitVector d(PDTCHBlockBits[CS]);
+			d.zero();
+			frame->copyToSegment(d,0);
+			encodeCS(d,CS);
+		}
 		delete frame;
 	} else {
 		// We have no ready data but must send SOMETHING.
@@ -1629,17 +2030,54 @@ void PDTCHL1Encoder::dispatch()
 		//OBJLOG(DEEPDEBUG) << "PDTCHL1Encoder mI["<<B<<"]=" << mI[B];
 		mI[B].segment(0,57).copyToSegment(mBurst,3);
 		mI[B].segment(57,57).copyToSegment(mBurst,88);
-		// stealing bits
-		//use CS1 now
-		mBurst.Hu(true);
-		mBurst.Hl(true);
+		// Stealing bits mark the coding scheme, GSM 05.03 5.1.
+		mBurst.Hl((PDTCHStealingFlags[CS]>>(7-2*B)) & 0x01);
+		mBurst.Hu((PDTCHStealingFlags[CS]>>(6-2*B)) & 0x01);
 		// Send it to the radio.
 		//OBJLOG(NOTICE) << "PDTCHL1Encoder mBurst=" << mBurst;
-		mDownstream->writeHighSide(mBurst);
+		sendBurst(mBurst);
 		rollForward();
 	}
 }
 
+void PDTCHL1Encoder::encodeCS(const BitVector& d, unsigned CS)
+{
+	const unsigned blockBits = PDTCHBlockBits[CS];
+	unsigned USF = d.bit(0) | (d.bit(1)<<1) | (d.bit(2)<<2);
+
+	// Block check sequence, GSM 05.03 5.1.2.2.
+	Parity BCS(0x11021,16,blockBits+16);
+	BitVector p(16);
+	BCS.writeParityWord(d,p);
+
+	if (CS==4) {
+		// GSM 05.03 5.1.4.2.  No convolutional code.
+		BitVector(PDTCHUSF12[USF]).copyToSegment(mC,0);
+		d.segment(3,blockBits-3).copyToSegment(mC,12);
+		p.copyToSegment(mC,12+blockBits-3);
+		return;
+	}
+
+	// GSM 05.03 5.1.2.2 and 5.1.3.2.
+	// USF precoding, data, BCS, tail.
+	BitVector u(PDTCHUBits(CS));
+	BitVector(PDTCHUSF6[USF]).copyToSegment(u,0);
+	d.segment(3,blockBits-3).copyToSegment(u,6);
+	p.copyToSegment(u,6+blockBits-3);
+	u.segment(u.size()-4,4).zero();
+
+	// GSM 05.03 5.1.2.3 and 5.1.3.3.
+	// Convolutional code, then puncture down to 456 bits.
+	BitVector c(2*u.size());
+	u.encode(mVCoder,c);
+	unsigned j = 0;
+	for (unsigned k=0; k<c.size(); k++) {
+		if (PDTCHPunctured(CS,k)) continue;
+		mC[j++] = c[k];
+	}
+	assert(j==mC.size());
+}
+
 SACCHL1Encoder* SACCHL1Decoder::SACCHSibling() 
 {
 	return mSACCHParent->encoder();
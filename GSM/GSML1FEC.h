@@ -112,6 +112,9 @@ class L1Encoder {
 	GSM::Time mNextWriteTime;		///< timestamp of next generated burst
 	volatile bool mRunning;			///< true while the service loop is running
 	bool mActive;					///< true between open() and close()
+	bool mScheduled;				///< true if driven by the L1Scheduler instead of a thread
+	bool mDeferred;					///< true if service is held off until mDeferTime
+	GSM::Time mDeferTime;			///< hold-off time for scheduled service
 	//@}
 
 	ViterbiR2O4 mVCoder;	///< nearly all GSM channels use the same convolutional code
@@ -147,6 +150,8 @@ class L1Encoder {
 	unsigned ARFCN() const;
 	TypeAndOffset typeAndOffset() const;	///< this comes from mMapping
 	//@}
+	/** Time of the first burst of the next block to be written, allowing for resync(). */
+	Time nextWriteTime() const;
 	//@}
 
 	/** Close the channel after blocking for flush.  */
@@ -174,8 +179,26 @@ class L1Encoder {
 
 	const char* descriptiveString() const { return mDescriptiveString; }
 
+	/**@name Hooks for the L1Scheduler. */
+	//@{
+	/**
+		Do one pass of the service loop without blocking on the clock.
+		Only called from the L1Scheduler, and only when dueForService() is true.
+	*/
+	virtual void serviceFrame() {}
+
+	/** Return true if a pass of the service loop would not block at this time. */
+	bool dueForService(const Time& now) const;
+	//@}
+
 	protected:
 
+	/**
+		Run the service loop in the given thread, or register
+		with the L1Scheduler if that is enabled.
+	*/
+	void startService(Thread& thread, void *(*adapter)(void*));
+
 	/** Roll write times forward to the next positions. */
 	void rollForward();
 
@@ -191,12 +214,24 @@ class L1Encoder {
 	/** Block until the BTS clock catches up to mPrevWriteTime.  */
 	void waitToSend() const;
 
+	/**
+		Block until the BTS clock reaches a given time.
+		For a scheduled encoder, hold off the next service pass instead.
+	*/
+	void defer(const Time& when);
+
 	/**
 		Send the idle filling pattern, if any.
 		The default is a dummy burst.
 	*/
 	virtual void sendIdleFill();
 
+	/**
+		Hand one burst to the radio.
+		The L1 loopback benchmark overrides this to capture the bursts.
+	*/
+	virtual void sendBurst(const TxBurst& burst);
+
 };
 
 
@@ -232,6 +267,19 @@ class L1Decoder {
 	static const int mFERMemory=20;				///< FER decay time, in frames
 	//@}
 
+	/**@name Decode latency since last open(), burst receipt to end of processing, protected by mLock. */
+	//@{
+	unsigned long mLatencyCount;		///< bursts measured
+	double mLatencyTotal;				///< sum of latencies, microseconds
+	unsigned mLatencyMax;				///< worst latency, microseconds
+	//@}
+
+	/**@name Soft combining since last open(), protected by mLock. */
+	//@{
+	unsigned mCombineTries;				///< failed blocks combined with a saved failed block
+	unsigned mCombineHits;				///< combinations that passed the parity check
+	//@}
+
 	/**@name Parameters fixed by the constructor, not requiring mutex protection. */
 	//@{
 	unsigned mTN;					///< timeslot number 
@@ -256,6 +304,8 @@ class L1Decoder {
 			mActive(false),
 			mRunning(false),
 			mFER(0.0F),
+			mLatencyCount(0),mLatencyTotal(0.0),mLatencyMax(0),
+			mCombineTries(0),mCombineHits(0),
 			mTN(wTN),
 			mMapping(wMapping),mParent(wParent)
 	{
@@ -305,6 +355,26 @@ class L1Decoder {
 	/** Accept an RxBurst and process it into the deinterleaver. */
 	virtual void writeLowSide(const RxBurst&) = 0;
 
+	/**@name Decode latency. */
+	//@{
+	/** Record the latency of a burst that was received at the given time. */
+	void countLatency(const Timeval& received);
+	/** Mean decode latency since last open(), microseconds. */
+	float latency() const;
+	/** Worst decode latency since last open(), microseconds. */
+	unsigned maxLatency() const;
+	//@}
+
+	/**@name Soft combining. */
+	//@{
+	/** Record a soft combining attempt. */
+	void countCombine(bool hit);
+	/** Soft combining attempts since last open(). */
+	unsigned combineTries() const;
+	/** Soft combining attempts that decoded, since last open(). */
+	unsigned combineHits() const;
+	//@}
+
 	/**@name Components of the channel description. */
 	//@{
 	unsigned TN() const { return mTN; }
@@ -395,6 +465,18 @@ class L1FEC {
 	float FER() const
 		{ assert(mDecoder); return mDecoder->FER(); }
 
+	float latency() const
+		{ assert(mDecoder); return mDecoder->latency(); }
+
+	unsigned maxLatency() const
+		{ assert(mDecoder); return mDecoder->maxLatency(); }
+
+	unsigned combineTries() const
+		{ assert(mDecoder); return mDecoder->combineTries(); }
+
+	unsigned combineHits() const
+		{ assert(mDecoder); return mDecoder->combineHits(); }
+
 	bool recyclable() const
 		{ assert(mDecoder); return mDecoder->recyclable(); }
 
@@ -501,11 +583,21 @@ class XCCHL1Decoder : public L1Decoder {
 	GSM::Time mReadTime;		///< timestamp of the first burst
 	unsigned mRSSIHistory[4];
 
+	/**@name Soft combining of repeated blocks. */
+	//@{
+	SoftVector mSavedC;			///< c[] of the last block that failed
+	GSM::Time mSavedTime;		///< timestamp of mSavedC
+	bool mHaveSavedC;			///< true if mSavedC is valid
+	//@}
+
 	public:
 
 	XCCHL1Decoder(unsigned wTN, const TDMAMapping& wMapping,
 		L1FEC *wParent);
 
+	/** Clear the decoder for a new transaction, including any saved block. */
+	void open();
+
 	protected:
 
 	/** Offset to the start of the L2 header. */
@@ -538,6 +630,17 @@ class XCCHL1Decoder : public L1Decoder {
 	  @return True if frame passed parity check.
 	 */
 	bool decode();
+
+	/**
+	  Decode the frame, falling back to soft combining if GSM.SoftCombining is set.
+	  A block that fails the parity check is saved.  If the next block also fails
+	  and arrives within GSM.SoftCombining.Window frames, it is probably a repetition
+	  (SACCH or FACCH repetition, or a LAPDm retransmission), so the two are
+	  combined and decoded again.
+	  @param when The time of the block.
+	  @return True if the frame, alone or combined, passed the parity check.
+	*/
+	bool decodeCombined(const GSM::Time& when);
 	
 	/** Finish off a properly-received L2Frame in mU and send it up to L2. */
 	virtual void handleGoodFrame();
@@ -646,6 +749,15 @@ class PDTCHL1Decoder : public XCCHL1Decoder {
 
 	RLCMACFrameFIFO mFramesQ;					///< output queue for PDTCH frames
 
+	/**@name Coding scheme state, GSM 05.03 5.1. */
+	//@{
+	float mQ[8];								///< soft stealing flags q[] of the current block
+	unsigned mUplinkCS;							///< coding scheme of the last uplink block
+	BitVector mCSD;								///< d[] of the last CS-2/3/4 block
+	volatile unsigned mRecommendedCS;			///< link adaptation result for the downlink
+	unsigned mCSHold;							///< blocks left before the next CS change
+	//@}
+
 	public:
 
 	PDTCHL1Decoder(
@@ -653,8 +765,11 @@ class PDTCHL1Decoder : public XCCHL1Decoder {
 		const TDMAMapping& wMapping,
 		PDTCHL1FEC *wParent)
 		:XCCHL1Decoder(wTN,wMapping,(L1FEC*)wParent),
-		mPDTCHParent(wParent)
-	{ }
+		mPDTCHParent(wParent),
+		mUplinkCS(1),mRecommendedCS(1),mCSHold(0)
+	{
+		for (int i=0; i<8; i++) mQ[i]=0.5F;
+	}
 
 	ChannelType channelType() const { return PDTCHType; }
 
@@ -678,6 +793,15 @@ class PDTCHL1Decoder : public XCCHL1Decoder {
 	/** Return count of internally-queued PDTCH frames. */
 	unsigned queueSize() const { return mFramesQ.size(); }
 
+	/** Coding scheme (1..4) of the last uplink block. */
+	unsigned uplinkCS() const { return mUplinkCS; }
+
+	/**
+		Coding scheme (1..4) recommended for the downlink,
+		from the FER tracked by countGoodFrame() and countBadFrame().
+	*/
+	unsigned recommendedCS() const { return mRecommendedCS; }
+
 	protected:
 
 	PDTCHL1FEC *PDTCHParent() { return mPDTCHParent; }
@@ -689,6 +813,18 @@ class PDTCHL1Decoder : public XCCHL1Decoder {
 	*/
 	void handleGoodFrame();
 
+	/** Pick the coding scheme from the stealing flags, GSM 05.03 5.1. */
+	unsigned detectCS() const;
+
+	/**
+		Decode a CS-2, CS-3 or CS-4 block from c[] into mCSD.
+		@return true if the BCS checks.
+	*/
+	bool decodeCS(unsigned CS);
+
+	/** Step the recommended coding scheme, with hysteresis. */
+	void adaptCS();
+
 	unsigned headerOffset() const { return 16; }
 
 };
@@ -805,6 +941,9 @@ protected:
 	*/
 	void dispatch();
 
+	/** One dispatch, for the L1Scheduler. */
+	void serviceFrame() { dispatch(); }
+
 	/** Will start the dispatch thread. */
 	void start();
 
@@ -911,6 +1050,9 @@ class GeneratorL1Encoder : public L1Encoder {
 	/** The core service loop calls generate repeatedly. */
 	void serviceLoop();
 
+	/** One pass of the service loop, for the L1Scheduler. */
+	void serviceFrame();
+
 	/** Provide a C interface for pthreads. */
 	friend void *GeneratorL1EncoderServiceLoopAdapter(GeneratorL1Encoder*);
 
@@ -998,6 +1140,9 @@ class NDCCHL1Encoder : public XCCHL1Encoder {
 	/** The core service loop. */
 	void serviceLoop();
 
+	/** One pass of the service loop, for the L1Scheduler. */
+	void serviceFrame() { generate(); }
+
 	friend void *NDCCHL1EncoderServiceLoopAdapter(NDCCHL1Encoder*);
 };
 
@@ -1010,10 +1155,15 @@ void *NDCCHL1EncoderServiceLoopAdapter(NDCCHL1Encoder*);
 */
 class BCCHL1Encoder : public NDCCHL1Encoder {
 
+	private:
+
+	bool mSent;		///< the first block went out
+
 	public:
 
 	BCCHL1Encoder(L1FEC *wParent)
-		:NDCCHL1Encoder(0,gBCCHMapping,wParent)
+		:NDCCHL1Encoder(0,gBCCHMapping,wParent),
+		mSent(false)
 	{}
 
 	private:
@@ -1111,10 +1261,19 @@ class PDTCHL1Encoder : public XCCHL1Encoder {
 
 	void dispatch();
 
+	/** One dispatch, for the L1Scheduler. */
+	void serviceFrame() { dispatch(); }
+
 	void start();
 
 	unsigned headerOffset() const { return 16; }
 
+	/**
+		Encode a CS-2, CS-3 or CS-4 radio block d[] into c[].
+		GSM 05.03 5.1.2-5.1.4.
+	*/
+	void encodeCS(const BitVector& d, unsigned CS);
+
 	/** A warpper to send an L2 frame with a physical header.  */
 	virtual void sendFrame(const L2Frame&);
 
@@ -1264,6 +1423,8 @@ class PDTCHL1FEC : public L1FEC {
 	void sendRLCMAC(RLCMACFrame *frame) { return mPDTCHEncoder->sendRLCMAC(frame); }
 	PDTCHL1Decoder *decoder() { return mPDTCHDecoder; }
 	PDTCHL1Encoder *encoder() { return mPDTCHEncoder; }
+	unsigned recommendedCS() const { return mPDTCHDecoder->recommendedCS(); }
+	unsigned uplinkCS() const { return mPDTCHDecoder->uplinkCS(); }
 
 };
 
@@ -0,0 +1,229 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include "GSML1Scheduler.h"
+#include "GSML1FEC.h"
+#include "GSMConfig.h"
+#include <Globals.h>
+#include <Logger.h>
+
+#include <sched.h>
+#include <pthread.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+
+
+
+
+void L1SchedulerWorker::start(L1Scheduler *wScheduler, unsigned wIndex, int wCPU)
+{
+	mScheduler = wScheduler;
+	mIndex = wIndex;
+	mCPU = wCPU;
+	mThread.start((void*(*)(void*))L1SchedulerWorkerAdapter,this);
+}
+
+
+void L1SchedulerWorker::serviceLoop()
+{
+	// Pin this worker, if requested.
+	if (mCPU>=0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(mCPU,&cpus);
+		if (pthread_setaffinity_np(pthread_self(),sizeof(cpus),&cpus)!=0) {
+			LOG(WARNING) << "L1 scheduler worker " << mIndex << " cannot pin to CPU " << mCPU;
+		} else {
+			LOG(INFO) << "L1 scheduler worker " << mIndex << " pinned to CPU " << mCPU;
+		}
+	}
+
+	unsigned generation = 0;
+	while (true) {
+		generation = mScheduler->waitForWork(generation);
+		// mWork is only touched by the tick thread while no worker is pending.
+		for (unsigned i=0; i<mWork.size(); i++) mWork[i]->serviceFrame();
+		mScheduler->workDone();
+	}
+}
+
+
+void *GSM::L1SchedulerWorkerAdapter(L1SchedulerWorker *worker)
+{
+	worker->serviceLoop();
+	return NULL;
+}
+
+
+
+
+L1Scheduler::L1Scheduler()
+	:mWorkers(NULL),mNumWorkers(0),
+	mPending(0),mGeneration(0),
+	mRunning(false),
+	mTicks(0),mServiceCalls(0),mDeadlineMisses(0),mSkippedFrames(0),
+	mMaxLateness(0)
+{ }
+
+
+bool L1Scheduler::enabled() const
+{
+	return gConfig.defines("GSM.L1Scheduler");
+}
+
+
+void L1Scheduler::add(L1Encoder *encoder)
+{
+	ScopedLock lock(mLock);
+	// Keep the list in TDMA order so that the service order is deterministic.
+	// Encoders on the same slot stay in registration order.
+	vector<L1Encoder*>::iterator pos = mEncoders.begin();
+	while ((pos!=mEncoders.end()) && ((*pos)->TN() <= encoder->TN())) ++pos;
+	mEncoders.insert(pos,encoder);
+	LOG(INFO) << "L1 scheduler added " << encoder->descriptiveString() << ", " << mEncoders.size() << " total";
+}
+
+
+size_t L1Scheduler::size() const
+{
+	ScopedLock lock(mLock);
+	return mEncoders.size();
+}
+
+
+void L1Scheduler::start()
+{
+	if (!enabled()) return;
+	ScopedLock lock(mLock);
+	if (mRunning) return;
+	mRunning = true;
+
+	mNumWorkers = gConfig.getNum("GSM.L1Scheduler.Workers");
+	if (mNumWorkers<1) mNumWorkers=1;
+	if (mNumWorkers>8) mNumWorkers=8;
+	vector<unsigned> CPUs;
+	if (gConfig.defines("GSM.L1Scheduler.CPUs")) CPUs = gConfig.getVector("GSM.L1Scheduler.CPUs");
+
+	LOG(NOTICE) << "starting L1 scheduler with " << mNumWorkers << " workers";
+	mWorkers = new L1SchedulerWorker[mNumWorkers];
+	for (unsigned i=0; i<mNumWorkers; i++) {
+		int CPU = -1;
+		if (CPUs.size()) CPU = CPUs[i % CPUs.size()];
+		mWorkers[i].start(this,i,CPU);
+	}
+	mTickThread.start((void*(*)(void*))L1SchedulerTickAdapter,this);
+}
+
+
+unsigned L1Scheduler::waitForWork(unsigned lastGeneration)
+{
+	ScopedLock lock(mLock);
+	while (mGeneration==lastGeneration) mWorkSignal.wait(mLock);
+	return mGeneration;
+}
+
+
+void L1Scheduler::workDone()
+{
+	ScopedLock lock(mLock);
+	assert(mPending>0);
+	mPending--;
+	if (mPending==0) mDoneSignal.signal();
+}
+
+
+void L1Scheduler::tickLoop()
+{
+	Time tick = gBTS.time();
+	while (true) {
+		// Wait for the frame clock to move.
+		gBTS.clock().wait(tick+1);
+		Time now = gBTS.time();
+		int32_t advance = now - tick;
+		// Clock::wait can return a hair early.
+		if (advance<1) continue;
+		// A big jump means the clock was reset by the transceiver.
+		// Don't count that against ourselves.
+		if (advance>51*26) advance = 1;
+
+		ScopedLock lock(mLock);
+		mSkippedFrames += advance-1;
+
+		// Collect due encoders.
+		// A given timeslot always maps to the same worker.
+		for (unsigned w=0; w<mNumWorkers; w++) mWorkers[w].mWork.clear();
+		unsigned calls = 0;
+		for (unsigned i=0; i<mEncoders.size(); i++) {
+			L1Encoder *encoder = mEncoders[i];
+			if (!encoder->dueForService(now)) continue;
+			mWorkers[encoder->TN() % mNumWorkers].mWork.push_back(encoder);
+			calls++;
+		}
+
+		// Run the tick and wait for the pool to finish it.
+		if (calls) {
+			mPending = mNumWorkers;
+			mGeneration++;
+			mWorkSignal.broadcast();
+			while (mPending>0) mDoneSignal.wait(mLock);
+		}
+
+		// Deadline accounting.
+		mTicks++;
+		mServiceCalls += calls;
+		int32_t lateness = gBTS.time() - now;
+		if (lateness>0) {
+			mDeadlineMisses++;
+			if (lateness>mMaxLateness) mMaxLateness = lateness;
+			LOG(DEBUG) << "L1 scheduler missed frame " << now.FN() << " by " << lateness << " frames";
+		}
+		tick = now;
+	}
+}
+
+
+void *GSM::L1SchedulerTickAdapter(L1Scheduler *scheduler)
+{
+	scheduler->tickLoop();
+	return NULL;
+}
+
+
+void L1Scheduler::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "L1 scheduler: " << mEncoders.size() << " encoders, " << mNumWorkers << " workers" << endl;
+	os << "L1 scheduler ticks: " << mTicks << ", service calls: " << mServiceCalls << endl;
+	os << "L1 scheduler deadline misses: " << mDeadlineMisses << ", skipped frames: " << mSkippedFrames
+		<< ", worst lateness: " << mMaxLateness << " frames" << endl;
+}
+
+
+
+// vim: ts=4 sw=4
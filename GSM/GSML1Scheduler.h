@@ -0,0 +1,160 @@
+/**@file Frame-clock driven service of L1 encoders. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#ifndef GSML1SCHEDULER_H
+#define GSML1SCHEDULER_H
+
+#include <vector>
+#include <ostream>
+
+#include <Threads.h>
+
+
+namespace GSM {
+
+
+class L1Encoder;
+class L1Scheduler;
+
+
+/**
+	One worker in the L1Scheduler pool.
+	Each worker owns a fixed set of timeslots, so a given encoder
+	is always serviced from the same (optionally pinned) thread.
+*/
+class L1SchedulerWorker {
+
+	private:
+
+	L1Scheduler *mScheduler;
+	unsigned mIndex;					///< position in the pool
+	int mCPU;							///< CPU to pin to, or -1 for none
+	Thread mThread;
+	std::vector<L1Encoder*> mWork;		///< encoders due in the current frame
+
+	public:
+
+	L1SchedulerWorker()
+		:mScheduler(NULL),mIndex(0),mCPU(-1)
+	{ }
+
+	void start(L1Scheduler *wScheduler, unsigned wIndex, int wCPU);
+
+	/** The worker service loop. */
+	void serviceLoop();
+
+	friend class L1Scheduler;
+	friend void *L1SchedulerWorkerAdapter(L1SchedulerWorker*);
+};
+
+void *L1SchedulerWorkerAdapter(L1SchedulerWorker*);
+
+
+
+/**
+	A single frame-tick scheduler for the transmit side of L1.
+
+	When GSM.L1Scheduler is defined, encoders that would otherwise run their
+	own service threads (generators, BCCH, TCH/FACCH, PDTCH) register here instead.
+	On every frame tick the scheduler collects the encoders that are due,
+	in TDMA order (TN, then registration order), and hands them to a small
+	worker pool.  The tick is finished when all of the workers are done.
+	If the BTS clock has moved past the tick frame by then, the tick counts
+	as a deadline miss.
+*/
+class L1Scheduler {
+
+	private:
+
+	mutable Mutex mLock;
+	Signal mWorkSignal;					///< new work posted to the pool
+	Signal mDoneSignal;					///< a worker finished its share of a tick
+
+	std::vector<L1Encoder*> mEncoders;	///< all registered encoders, in TDMA order
+	L1SchedulerWorker *mWorkers;
+	unsigned mNumWorkers;
+	unsigned mPending;					///< workers still busy with the current tick
+	unsigned mGeneration;				///< tick counter used to release the workers
+
+	Thread mTickThread;
+	bool mRunning;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mTicks;				///< frame ticks serviced
+	unsigned long mServiceCalls;		///< encoder service calls made
+	unsigned long mDeadlineMisses;		///< ticks that finished after their frame
+	unsigned long mSkippedFrames;		///< frames with no tick at all (tick thread late)
+	int mMaxLateness;					///< worst observed lateness, in frames
+	//@}
+
+	public:
+
+	L1Scheduler();
+
+	/** Return true if the scheduler is configured to replace encoder threads. */
+	bool enabled() const;
+
+	/**
+		Register an encoder for per-frame service.
+		The encoder will be called from a worker thread from then on.
+	*/
+	void add(L1Encoder *encoder);
+
+	/** Start the tick thread and worker pool, if enabled. */
+	void start();
+
+	/** Number of registered encoders. */
+	size_t size() const;
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream&) const;
+
+	private:
+
+	/** Wait for frame ticks and dispatch the due encoders. */
+	void tickLoop();
+
+	/** Block a worker until the tick after lastGeneration is posted. */
+	unsigned waitForWork(unsigned lastGeneration);
+
+	/** Mark a worker's share of the current tick as done. */
+	void workDone();
+
+	friend void *L1SchedulerTickAdapter(L1Scheduler*);
+	friend class L1SchedulerWorker;
+};
+
+void *L1SchedulerTickAdapter(L1Scheduler*);
+
+
+};	// namespace GSM
+
+
+#endif
+
+// vim: ts=4 sw=4
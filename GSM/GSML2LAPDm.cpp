@@ -42,6 +42,7 @@ implementation, although no code is copied directly.
 
 #include "GSML2LAPDm.h"
 #include "GSMSAPMux.h"
+#include "GSMConfig.h"
 #include <Logger.h>
 
 using namespace std;
@@ -79,9 +80,10 @@ void CCCHL2::writeHighSide(const GSM::L3Frame& l3)
 
 L2LAPDm::L2LAPDm(unsigned wC, unsigned wSAPI)
 	:mRunning(false),
+	mReactor(NULL),mT200Timer(0),mPosted(false),
 	mC(wC),mR(1-wC),mSAPI(wSAPI),
 	mMaster(NULL),
-	mT200(T200ms),
+	mT200(T200ms),mT200Expirations(0),
 	mIdleFrame(DATA)
 {
 	// sanity checks
@@ -123,7 +125,7 @@ void L2LAPDm::writeL1Ack(const L2Frame& frame)
 	frame.copyTo(mSentFrame);
 	mSentFrame.primitive(frame.primitive());
 	writeL1(frame);
-	mT200.set(T200());
+	startT200();
 }
 
 
@@ -276,7 +278,7 @@ void L2LAPDm::retransmissionProcedure()
 	OBJLOG(DEBUG) << "VS=" << mVS << " VA=" << mVA << " RC=" << mRC;
 	mRC++;
 	writeL1(mSentFrame);
-	mT200.set(T200());
+	startT200();
 	mAckSignal.signal();
 }
 
@@ -293,11 +295,13 @@ void L2LAPDm::open()
 			// since N201 may not be defined yet.
 			mMaxIPayloadBits = 8*N201(L2Control::IFormat);
 			mRunning = true;
-			mUpstreamThread.start((void *(*)(void*))LAPDmServiceLoopAdapter,this);
+			if (gBTS.reactor().enabled()) mReactor = &gBTS.reactor();
+			else mUpstreamThread.start((void *(*)(void*))LAPDmServiceLoopAdapter,this);
 		}
 		mL3Out.clear();
 		mL1In.clear();
 		clearCounters();
+		mT200Expirations = 0;
 		mState = LinkReleased;
 		mAckSignal.signal();
 	}
@@ -350,7 +354,7 @@ void L2LAPDm::writeHighSide(const L3Frame& frame)
 			clearCounters();
 			mEstablishmentInProgress=false;
 			mState=AwaitingRelease;
-			mT200.set(T200());	// HACK?
+			startT200();	// HACK?
 			// Send DISC and wait for UA.
 			// Don't return until released.
 			sendUFrameDISC();
@@ -382,6 +386,7 @@ void L2LAPDm::writeLowSide(const L2Frame& frame)
 {
 	OBJLOG(DEBUG) << frame;
 	mL1In.write(new L2Frame(frame));
+	if (mReactor) mReactor->post(this);
 }
 
 
@@ -420,6 +425,47 @@ void L2LAPDm::serviceLoop()
 
 
 
+bool L2LAPDm::serviceEvents()
+{
+	if (!mLock.trylock()) return false;
+	// If SAP0 is released, other SAPs need to release also.
+	if (mMaster) {
+		if (mMaster->mState==LinkReleased) mState=LinkReleased;
+	}
+	while (L2Frame* frame = mL1In.readNoBlock()) {
+		OBJLOG(DEBUG) << "state=" << mState << " received " << *frame;
+		receiveFrame(*frame);
+		delete frame;
+		if (mT200.expired()) T200Expiration();
+	}
+	if (mT200.expired()) T200Expiration();
+	else if (mT200.active() && !gBTS.timers().pending(mT200Timer)) {
+		// The wheel rounds up, but T200 may have been restarted since the timer fired.
+		mT200Timer = gBTS.timers().schedule(mT200.remaining(),this,T200Timer);
+	}
+	mLock.unlock();
+	return true;
+}
+
+
+void L2LAPDm::timeout(unsigned tag)
+{
+	assert(mReactor);
+	mReactor->post(this);
+}
+
+
+void L2LAPDm::startT200()
+{
+	// Caller should hold mLock.
+	mT200.set(T200());
+	if (!mReactor) return;
+	gBTS.timers().cancel(mT200Timer);
+	mT200Timer = gBTS.timers().schedule(T200(),this,T200Timer);
+}
+
+
+
 void L2LAPDm::T200Expiration()
 {
 	// Caller should hold mLock.
@@ -427,6 +473,7 @@ void L2LAPDm::T200Expiration()
 	// GSM 04.06 5.4.1.3, 5.4.4.3, 5.5.7, 5.7.2.
 	OBJLOG(INFO) << "state=" << mState << " RC=" << mRC;
 	mT200.reset();
+	mT200Expirations++;
 	switch (mState) {
 		case AwaitingRelease:
 			releaseLink();
@@ -536,7 +583,7 @@ void L2LAPDm::receiveUFrameSABM(const L2Frame& frame)
 				// GSM 04.06 5.4.1.4.
 				mState=ContentionResolution;
 				mContentionCheck = frame.sum();
-				mL3Out.write(new L3Frame(frame.L3Part(),DATA));
+				mL3Out.write(new L3Frame(frame));
 				// Echo back payload.
 				sendUFrameUA(frame);
 			} else {
@@ -34,12 +34,14 @@ implementation, although no code is copied directly.
 
 #include "GSMCommon.h"
 #include "GSMTransfer.h"
+#include <TimerWheel.h>
 
 
 namespace GSM {
 
 // Forward refs.
 class SAPMux;
+class L2Reactor;
 
 /**@name L2 Processing Errors */
 //@{
@@ -94,6 +96,9 @@ class L2DL {
 	/** Check for establishment of multifame mode; only valid for LAPDm. */
 	virtual bool multiframeMode() const { assert(0); }
 
+	/** Number of T200 expirations since open(); zero if there is no T200. */
+	virtual unsigned T200Expirations() const { return 0; }
+
 	/**
 		The L3->L2 interface.
 		This is a blocking call and does not return until
@@ -166,8 +171,11 @@ class CCCHL2 : public L2DL {
 		- using the Bbis format for L3 messages that use the L2 pseudolength element
 		- just using independent L2s for each active SAP
 		- just using independent L2s on each dedicated channel, which works with k=1
+
+	Each LAPDm normally has its own upstream thread.  When GSM.LAPDm.Reactor
+	is defined, it is serviced by the L2Reactor instead; see serviceEvents().
 */
-class L2LAPDm : public L2DL {
+class L2LAPDm : public L2DL, public TimerWheelClient {
 
 	public:
 
@@ -183,6 +191,12 @@ class L2LAPDm : public L2DL {
 		ContentionResolution	///< GMS 04.06 5.4.1.4
 	};
 
+	/** Tags for reactor timers. */
+	enum ReactorTimer {
+		T200Timer,				///< T200 may have expired
+		RetryTimer				///< the link was busy when serviced
+	};
+
 
 	protected:
 
@@ -191,6 +205,13 @@ class L2LAPDm : public L2DL {
 	L3FrameFIFO mL3Out;			///< we connect L2->L3 through a FIFO
 	L2FrameFIFO mL1In;			///< we connect L1->L2 through a FIFO
 
+	/**@name Reactor mode. */
+	//@{
+	L2Reactor *mReactor;		///< the reactor servicing this link, or NULL for a thread
+	unsigned mT200Timer;		///< gBTS.timers() ID for T200, protected by mLock
+	bool mPosted;				///< on the reactor ready queue, protected by the reactor lock
+	//@}
+
 	unsigned mC;			///< the "C" bit for commands, 1 for BTS, 0 for MS
 	unsigned mR;			///< this "R" bit for commands, 0 for BTS, 1 for MS
 
@@ -220,6 +241,7 @@ class L2LAPDm : public L2DL {
 	unsigned mContentionCheck;	///< checksum used for contention resolution, GSM 04.06 5.4.1.4.
 	unsigned mRC;				///< retransmission counter, GSM 04.06 5.4.1-5.4.4
 	Z100Timer mT200;			///< retransmission timer, GSM 04.06 5.8.1
+	unsigned mT200Expirations;	///< T200 expirations since open()
 	size_t mMaxIPayloadBits;	///< N201*8 for the I-frame
 	//@}
 	//@}
@@ -281,6 +303,12 @@ class L2LAPDm : public L2DL {
 	bool multiframeMode() const
 		{ ScopedLock lock(mLock); return mState==LinkEstablished; }
 
+	unsigned T200Expirations() const
+		{ ScopedLock lock(mLock); return mT200Expirations; }
+
+	/** Reactor timer callback; posts the link for service. */
+	void timeout(unsigned tag);
+
 
 	protected:
 
@@ -314,6 +342,9 @@ class L2LAPDm : public L2DL {
 	/** Process an ack.  Also forces state to LinkEstablished. */
 	void processAck(unsigned NR);
 
+	/** Start or restart T200, and its reactor timer, if any. */
+	void startT200();
+
 	/** Retransmit last ackable frame. */
 	void retransmissionProcedure();
 
@@ -406,7 +437,15 @@ class L2LAPDm : public L2DL {
 	*/
 	void serviceLoop();
 
+	/**
+		The reactor equivalent of one pass of serviceLoop():
+		process the queued uplink frames and check T200, without blocking.
+		@return false if the link is locked by another thread.
+	*/
+	bool serviceEvents();
+
 	friend void *LAPDmServiceLoopAdapter(L2LAPDm*);
+	friend class L2Reactor;
 };
 
 
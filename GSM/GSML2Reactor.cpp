@@ -0,0 +1,158 @@
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#include "GSML2Reactor.h"
+#include "GSML2LAPDm.h"
+#include "GSMConfig.h"
+#include <Globals.h>
+#include <Logger.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+
+#undef WARNING
+
+using namespace std;
+using namespace GSM;
+
+
+
+
+L2Reactor::L2Reactor()
+	:mThreads(NULL),mNumThreads(0),mRunning(false),
+	mPosts(0),mServiceCalls(0),mBusyRetries(0),mMaxReady(0)
+{ }
+
+
+bool L2Reactor::enabled() const
+{
+	return gConfig.defines("GSM.LAPDm.Reactor");
+}
+
+
+void L2Reactor::start()
+{
+	if (!enabled()) return;
+	ScopedLock lock(mLock);
+	if (mRunning) return;
+	mRunning = true;
+
+	mNumThreads = gConfig.getNum("GSM.LAPDm.Reactor.Threads");
+	if (mNumThreads<1) mNumThreads=1;
+	if (mNumThreads>16) mNumThreads=16;
+	LOG(NOTICE) << "starting LAPDm reactor with " << mNumThreads << " threads";
+	mThreads = new Thread[mNumThreads];
+	for (unsigned i=0; i<mNumThreads; i++) {
+		mThreads[i].start((void*(*)(void*))L2ReactorServiceLoopAdapter,this);
+	}
+}
+
+
+void L2Reactor::post(L2LAPDm *link)
+{
+	ScopedLock lock(mLock);
+	mPosts++;
+	if (link->mPosted) return;
+	link->mPosted = true;
+	mReady.push_back(link);
+	if (mReady.size()>mMaxReady) mMaxReady = mReady.size();
+	mReadySignal.signal();
+}
+
+
+void L2Reactor::serviceLoop()
+{
+	while (true) {
+		L2LAPDm *link;
+		{
+			ScopedLock lock(mLock);
+			while (mReady.size()==0) mReadySignal.wait(mLock);
+			link = mReady.front();
+			mReady.pop_front();
+			link->mPosted = false;
+			mServiceCalls++;
+		}
+
+		// If another thread has the link locked, try again on the next timer tick
+		// rather than tie up a worker.
+		if (!link->serviceEvents()) {
+			gBTS.timers().schedule(gBTS.timers().tickMs(),link,L2LAPDm::RetryTimer);
+			ScopedLock lock(mLock);
+			mBusyRetries++;
+		}
+	}
+}
+
+
+void *GSM::L2ReactorServiceLoopAdapter(L2Reactor *reactor)
+{
+	reactor->serviceLoop();
+	return NULL;
+}
+
+
+void L2Reactor::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "LAPDm reactor: " << mNumThreads << " threads, posts " << mPosts
+		<< ", service calls " << mServiceCalls << ", busy retries " << mBusyRetries
+		<< ", ready " << mReady.size() << " (max " << mMaxReady << ")" << endl;
+}
+
+
+
+bool GSM::processThreadStats(unsigned& threads, unsigned long& voluntary, unsigned long& involuntary)
+{
+	threads = 0;
+	voluntary = 0;
+	involuntary = 0;
+	DIR *dir = opendir("/proc/self/task");
+	if (!dir) return false;
+	// Each thread has its own switch counts; /proc/self/status has only the main thread's.
+	while (struct dirent *entry = readdir(dir)) {
+		if (entry->d_name[0]=='.') continue;
+		char path[64];
+		snprintf(path,sizeof(path),"/proc/self/task/%s/status",entry->d_name);
+		FILE *fp = fopen(path,"r");
+		if (!fp) continue;
+		threads++;
+		char line[128];
+		while (fgets(line,sizeof(line),fp)) {
+			unsigned long count;
+			if (sscanf(line,"voluntary_ctxt_switches: %lu",&count)==1) voluntary += count;
+			else if (sscanf(line,"nonvoluntary_ctxt_switches: %lu",&count)==1) involuntary += count;
+		}
+		fclose(fp);
+	}
+	closedir(dir);
+	return true;
+}
+
+
+
+// vim: ts=4 sw=4
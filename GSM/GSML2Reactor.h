@@ -0,0 +1,117 @@
+/**@file Event-driven service of LAPDm links from a small thread pool. */
+/*
+* Copyright 2011 Range Networks, Inc.
+*
+* This software is distributed under the terms of the GNU Affero Public License.
+* See the COPYING file in the main directory for details.
+*
+* This use of this software may be subject to additional restrictions.
+* See the LEGAL file in the main directory for details.
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+
+#ifndef GSML2REACTOR_H
+#define GSML2REACTOR_H
+
+#include <deque>
+#include <ostream>
+
+#include <Threads.h>
+
+
+namespace GSM {
+
+
+class L2LAPDm;
+
+
+/**
+	A reactor for LAPDm links.
+
+	When GSM.LAPDm.Reactor is defined, L2LAPDm links do not start their
+	own upstream threads.  Instead, an uplink frame or a T200 expiration
+	posts the link on a ready queue, and a small pool of worker threads
+	services the posted links, one at a time per link.  T200 runs on the
+	BTS timer wheel, so an idle or released link costs no thread and no
+	wakeups at all.
+*/
+class L2Reactor {
+
+	private:
+
+	mutable Mutex mLock;
+	Signal mReadySignal;				///< a link was posted
+	std::deque<L2LAPDm*> mReady;		///< posted links, each at most once
+
+	Thread *mThreads;
+	unsigned mNumThreads;
+	bool mRunning;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mPosts;				///< links posted
+	unsigned long mServiceCalls;		///< links serviced
+	unsigned long mBusyRetries;			///< links found locked by another thread
+	size_t mMaxReady;					///< ready queue high-water mark
+	//@}
+
+	public:
+
+	L2Reactor();
+
+	/** Return true if the reactor is configured to replace the LAPDm threads. */
+	bool enabled() const;
+
+	/** Start the worker threads, if enabled. */
+	void start();
+
+	/** Post a link for service, if it is not already posted. */
+	void post(L2LAPDm *link);
+
+	/**
+		Dump statistics to a stream.
+		This includes the thread count and context switches of the whole process,
+		to compare runs with the reactor on and off.
+	*/
+	void dump(std::ostream&) const;
+
+	private:
+
+	/** The worker service loop. */
+	void serviceLoop();
+
+	friend void *L2ReactorServiceLoopAdapter(L2Reactor*);
+};
+
+void *L2ReactorServiceLoopAdapter(L2Reactor*);
+
+
+/**
+	Thread and context switch counts for this process, from /proc.
+	@return false if /proc is not readable.
+*/
+bool processThreadStats(unsigned& threads, unsigned long& voluntary, unsigned long& involuntary);
+
+
+};	// namespace GSM
+
+
+#endif
+
+// vim: ts=4 sw=4
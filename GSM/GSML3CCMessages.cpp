@@ -86,23 +86,23 @@ ostream& GSM::operator<<(ostream& os, L3CCMessage::MessageType val)
 
 
 
-L3CCMessage * GSM::L3CCFactory(L3CCMessage::MessageType MTI)
+L3CCMessage * GSM::L3CCFactory(L3CCMessage::MessageType MTI, L3MessageBuffer* buffer)
 {
 	switch (MTI) {
-		case L3CCMessage::Connect: return new L3Connect();
-		case L3CCMessage::Alerting: return new L3Alerting();
-		case L3CCMessage::Setup: return new L3Setup();
-		case L3CCMessage::EmergencySetup: return new L3EmergencySetup();
-		case L3CCMessage::Disconnect: return new L3Disconnect();
-		case L3CCMessage::CallProceeding: return new L3CallProceeding();
-		case L3CCMessage::Release: return new L3Release();
-		case L3CCMessage::ReleaseComplete: return new L3ReleaseComplete();
-		case L3CCMessage::ConnectAcknowledge: return new L3ConnectAcknowledge();
-		case L3CCMessage::CCStatus: return new L3CCStatus();
-		case L3CCMessage::CallConfirmed: return new L3CallConfirmed();
-		case L3CCMessage::StartDTMF: return new L3StartDTMF();
-		case L3CCMessage::StopDTMF: return new L3StopDTMF();
-		case L3CCMessage::Hold: return new L3Hold();
+		case L3CCMessage::Connect: return makeL3Message<L3Connect>(buffer);
+		case L3CCMessage::Alerting: return makeL3Message<L3Alerting>(buffer);
+		case L3CCMessage::Setup: return makeL3Message<L3Setup>(buffer);
+		case L3CCMessage::EmergencySetup: return makeL3Message<L3EmergencySetup>(buffer);
+		case L3CCMessage::Disconnect: return makeL3Message<L3Disconnect>(buffer);
+		case L3CCMessage::CallProceeding: return makeL3Message<L3CallProceeding>(buffer);
+		case L3CCMessage::Release: return makeL3Message<L3Release>(buffer);
+		case L3CCMessage::ReleaseComplete: return makeL3Message<L3ReleaseComplete>(buffer);
+		case L3CCMessage::ConnectAcknowledge: return makeL3Message<L3ConnectAcknowledge>(buffer);
+		case L3CCMessage::CCStatus: return makeL3Message<L3CCStatus>(buffer);
+		case L3CCMessage::CallConfirmed: return makeL3Message<L3CallConfirmed>(buffer);
+		case L3CCMessage::StartDTMF: return makeL3Message<L3StartDTMF>(buffer);
+		case L3CCMessage::StopDTMF: return makeL3Message<L3StopDTMF>(buffer);
+		case L3CCMessage::Hold: return makeL3Message<L3Hold>(buffer);
 		default: {
 			LOG(NOTICE) << "no L3 CC factory support for message "<< MTI;
 			return NULL;
@@ -114,13 +114,13 @@ L3CCMessage * GSM::L3CCFactory(L3CCMessage::MessageType MTI)
 
 
 /* parser for Call control messages, will only parse uplink */
-L3CCMessage * GSM::parseL3CC(const L3Frame& source)
+L3CCMessage * GSM::parseL3CC(const L3Frame& source, L3MessageBuffer* buffer)
 {
     // mask out bit #7 (1011 1111) so use 0xbf, see GSM 04.08 Table 10.3/3.
     L3CCMessage::MessageType MTI = (L3CCMessage::MessageType)(0xbf & source.MTI());
 	LOG(DEBUG) << "MTI="<<MTI;
 
-	L3CCMessage *retVal = L3CCFactory(MTI);
+	L3CCMessage *retVal = L3CCFactory(MTI,buffer);
 	if (retVal==NULL) return NULL;
 
 	retVal->TI(source.TI());
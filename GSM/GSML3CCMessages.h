@@ -119,15 +119,16 @@ std::ostream& operator<<(std::ostream& os, L3CCMessage::MessageType MTI);
 /**
 	Parse a complete L3 call control message into its object type.
 	@param source The L3 bits.
+	@param buffer Storage for the message, or NULL to put it on the heap.
 	@return A pointer to a new message or NULL on failure.
 */
-L3CCMessage* parseL3CC(const L3Frame& source);
+L3CCMessage* parseL3CC(const L3Frame& source, L3MessageBuffer* buffer=NULL);
 
 /**
 	A Factory function to return a L3CCMessage of the specified MTI.
 	Returns NULL if the MTI is not supported.
 */
-L3CCMessage* L3CCFactory(L3CCMessage::MessageType MTI);
+L3CCMessage* L3CCFactory(L3CCMessage::MessageType MTI, L3MessageBuffer* buffer=NULL);
 
 
 /** GSM 04.08 9.3.19 */
@@ -83,29 +83,29 @@ ostream& GSM::operator<<(ostream& os, L3MMMessage::MessageType val)
 
 
 
-L3MMMessage* GSM::L3MMFactory(L3MMMessage::MessageType MTI)
+L3MMMessage* GSM::L3MMFactory(L3MMMessage::MessageType MTI, L3MessageBuffer* buffer)
 {
 	switch (MTI) {
-	  case L3MMMessage::LocationUpdatingRequest: return new L3LocationUpdatingRequest;
-	  case L3MMMessage::IMSIDetachIndication: return new L3IMSIDetachIndication;
-	  case L3MMMessage::CMServiceRequest: return new L3CMServiceRequest;
+	  case L3MMMessage::LocationUpdatingRequest: return makeL3Message<L3LocationUpdatingRequest>(buffer);
+	  case L3MMMessage::IMSIDetachIndication: return makeL3Message<L3IMSIDetachIndication>(buffer);
+	  case L3MMMessage::CMServiceRequest: return makeL3Message<L3CMServiceRequest>(buffer);
 	  // Since we don't support re-establishment, don't bother parsing this.
 	  //case L3MMMessage::CMReestablishmentRequest: return new L3CMReestablishmentRequest;
-	  case L3MMMessage::MMStatus: return new L3MMStatus;
-	  case L3MMMessage::IdentityResponse: return new L3IdentityResponse;
-	  case L3MMMessage::AuthenticationResponse: return new L3AuthenticationResponse;
+	  case L3MMMessage::MMStatus: return makeL3Message<L3MMStatus>(buffer);
+	  case L3MMMessage::IdentityResponse: return makeL3Message<L3IdentityResponse>(buffer);
+	  case L3MMMessage::AuthenticationResponse: return makeL3Message<L3AuthenticationResponse>(buffer);
 	  default:
 	    LOG(WARNING) << "no L3 MM factory support for message " << MTI;
 		return NULL;
 	}
 }
 
-L3MMMessage * GSM::parseL3MM(const L3Frame& source)
+L3MMMessage * GSM::parseL3MM(const L3Frame& source, L3MessageBuffer* buffer)
 {
 	L3MMMessage::MessageType MTI = (L3MMMessage::MessageType)(0xbf & source.MTI());
 	LOG(DEBUG) << "parseL3MM MTI=" << MTI;
 
-	L3MMMessage *retVal = L3MMFactory(MTI);
+	L3MMMessage *retVal = L3MMFactory(MTI,buffer);
 	if (retVal==NULL) return NULL;
 
 	retVal->parse(source);
@@ -95,14 +95,15 @@ std::ostream& operator<<(std::ostream& os, L3MMMessage::MessageType val);
 	A Factory function to return a L3MMMessage of the specified MTI.
 	Returns NULL if the MTI is not supported.
 */
-L3MMMessage* L3MMFactory(L3MMMessage::MessageType MTI);
+L3MMMessage* L3MMFactory(L3MMMessage::MessageType MTI, L3MessageBuffer* buffer=NULL);
 
 /**
 	Parse a complete L3 mobility management message into its object type.
 	@param source The L3 bits.
+	@param buffer Storage for the message, or NULL to put it on the heap.
 	@return A pointer to a new message or NULL on failure.
 */
-L3MMMessage* parseL3MM(const L3Frame& source);
+L3MMMessage* parseL3MM(const L3Frame& source, L3MessageBuffer* buffer=NULL);
 
 
 
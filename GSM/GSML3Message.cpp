@@ -165,7 +165,28 @@ ostream& GSM::operator<<(ostream& os, const L3Message& msg)
 
 
 
-GSM::L3Message* GSM::parseL3(const GSM::L3Frame& source)
+void L3MessageBuffer::clear()
+{
+	if (mMessage) mMessage->~L3Message();
+	mMessage = NULL;
+	if (mHeap) ::operator delete(mHeap);
+	mHeap = NULL;
+}
+
+
+void* L3MessageBuffer::allocate(size_t size)
+{
+	clear();
+	if (size<=capacity) return mStorage;
+	LOG(DEBUG) << "L3 message of " << size << " bytes does not fit in the buffer";
+	mHeap = ::operator new(size);
+	return mHeap;
+}
+
+
+
+
+GSM::L3Message* GSM::parseL3(const GSM::L3Frame& source, L3MessageBuffer* buffer)
 {
 	if (source.size()==0) return NULL;
 
@@ -175,10 +196,10 @@ GSM::L3Message* GSM::parseL3(const GSM::L3Frame& source)
 	L3Message *retVal = NULL;
 	try {
 		switch (PD) {
-			case L3RadioResourcePD: retVal=parseL3RR(source); break;
-			case L3MobilityManagementPD: retVal=parseL3MM(source); break;
-			case L3CallControlPD: retVal=parseL3CC(source); break;
-			case L3SMSPD: retVal=SMS::parseSMS(source); break;
+			case L3RadioResourcePD: retVal=parseL3RR(source,buffer); break;
+			case L3MobilityManagementPD: retVal=parseL3MM(source,buffer); break;
+			case L3CallControlPD: retVal=parseL3CC(source,buffer); break;
+			case L3SMSPD: retVal=SMS::parseSMS(source,buffer); break;
 			default:
 				LOG(NOTICE) << "L3 parsing failed for unsupported protocol " << PD;
 				return NULL;
@@ -186,6 +207,7 @@ GSM::L3Message* GSM::parseL3(const GSM::L3Frame& source)
 	}
 	catch (L3ReadError) {
 		LOG(NOTICE) << "L3 parsing failed for " << source;
+		if (buffer) buffer->clear();
 		return NULL;
 	}
 
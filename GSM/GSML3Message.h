@@ -28,6 +28,9 @@
 #ifndef GSML3MESSAGE_H
 #define GSML3MESSAGE_H
 
+#include <new>
+#include <stdint.h>
+
 #include "GSMCommon.h"
 #include "GSMTransfer.h"
 
@@ -133,6 +136,75 @@ class L3Message {
 };
 
 
+
+/**
+	Storage for one parsed L3 message, so that parsing need not use the heap.
+	A dispatcher keeps one of these (on its stack) and parses into it.
+	The buffer owns the message: it is destroyed when the buffer is
+	reused, cleared or destroyed, and must not be deleted.
+	A message too big for the buffer goes on the heap, still owned by the buffer.
+*/
+class L3MessageBuffer {
+
+	private:
+
+	/** Big enough for the usual uplink messages; see L3ParseBench. */
+	static const size_t capacity = 512;
+
+	union {
+		char mStorage[capacity];
+		uint64_t mAlign;
+		void* mAlignPointer;
+		double mAlignDouble;
+	};
+	L3Message *mMessage;		///< the message in the buffer, or NULL
+	void *mHeap;				///< heap space for a big message, or NULL
+
+	public:
+
+	L3MessageBuffer()
+		:mMessage(NULL),mHeap(NULL)
+	{ }
+
+	~L3MessageBuffer() { clear(); }
+
+	/** Destroy the message, if any. */
+	void clear();
+
+	/** Construct a message of type T in the buffer, replacing any earlier one. */
+	template <class T> T* construct()
+	{
+		T* msg = new(allocate(sizeof(T))) T;
+		mMessage = msg;
+		return msg;
+	}
+
+	/** The message in the buffer, or NULL. */
+	L3Message* message() const { return mMessage; }
+
+	/** True if the message had to go on the heap. */
+	bool onHeap() const { return mHeap!=NULL; }
+
+	private:
+
+	/** Clear the buffer and return space for an object of a given size. */
+	void* allocate(size_t size);
+
+	/** Not copyable. */
+	L3MessageBuffer(const L3MessageBuffer&);
+	L3MessageBuffer& operator=(const L3MessageBuffer&);
+};
+
+
+/** Make a new message of type T in a buffer, if given, otherwise on the heap. */
+template <class T> T* makeL3Message(L3MessageBuffer* buffer)
+{
+	if (buffer) return buffer->construct<T>();
+	return new T;
+}
+
+
+
 /**
 	This is virtual base class for the blocks of GPRS RLC/MAC layer.
 	It defines almost nothing, but is the origination of other classes.
@@ -225,11 +297,12 @@ size_t skipTV(unsigned IEI, size_t numBits, const L3Frame& source, size_t &readP
 
 /**
 	Parse a complete L3 message into its object type.
-	Caller is responsible for deleting allocated memory.
+	Caller is responsible for deleting allocated memory, unless a buffer is given.
 	@param source The L3 bits.
+	@param buffer Storage for the message, or NULL to put it on the heap.
 	@return A pointer to a new message or NULL on failure.
 */
-L3Message* parseL3(const L3Frame& source);
+L3Message* parseL3(const L3Frame& source, L3MessageBuffer* buffer=NULL);
 
 
 std::ostream& operator<<(std::ostream& os, const GSM::L3Message& msg);
@@ -780,11 +780,20 @@ void L3MeasurementResults::parseV(const L3Frame& frame, size_t &rp)
 	mRXQUAL_FULL_SERVING_CELL = frame.readField(rp,3);
 	mRXQUAL_SUB_SERVING_CELL = frame.readField(rp,3);
 	mNO_NCELL = frame.readField(rp,3);
-	for (unsigned i=0; i<6; i++) {
+	// Only decode the neighbor cells that are reported.
+	// 7 means there is no neighbor information.
+	unsigned numNCells = (mNO_NCELL>6) ? 0 : mNO_NCELL;
+	for (unsigned i=0; i<numNCells; i++) {
 		mRXLEV_NCELL[i] = frame.readField(rp,6);
 		mBCCH_FREQ_NCELL[i] = frame.readField(rp,5);
 		mBSIC_NCELL[i] = frame.readField(rp,6);
 	}
+	for (unsigned i=numNCells; i<6; i++) {
+		mRXLEV_NCELL[i] = 0;
+		mBCCH_FREQ_NCELL[i] = 0;
+		mBSIC_NCELL[i] = 0;
+	}
+	rp += (6-numNCells)*17;
 }
 
 
@@ -164,6 +164,18 @@ class L3ControlChannelDescription : public L3ProtocolElement {
 		mT3212=gConfig.getNum("GSM.Timer.T3212")/6;
 	}
 
+	/**@name Paging parameters, GSM 05.02 6.5. */
+	//@{
+	/** Number of multiframes between paging blocks for a paging group. */
+	unsigned BS_PA_MFRMS() const { return mBS_PA_MFRMS + 2; }
+	/** Number of paging blocks in each 51-multiframe. */
+	unsigned pagingBlocks() const
+	{
+		if (mCCCH_CONF==1) return (mBS_AG_BLKS_RES<2) ? 3-mBS_AG_BLKS_RES : 1;
+		return 9 - mBS_AG_BLKS_RES;
+	}
+	//@}
+
 	size_t lengthV() const { return 3; }
 	void writeV(L3Frame& dest, size_t &wp) const;
 	void parseV(const L3Frame&, size_t&) { assert(0); }
@@ -325,6 +337,9 @@ class L3RACHControlParameters : public L3ProtocolElement {
 		mAC = gConfig.getNum("GSM.RACH.AC");
 	}
 
+	/** Bar more access classes, on top of the configured ones. */
+	void barAccessClasses(uint16_t classes) { mAC |= classes; }
+
 	size_t lengthV() const { return 3; }
 	void writeV(L3Frame& dest, size_t &wp) const;
 	void parseV(const L3Frame&, size_t&) { assert(0); }
@@ -149,33 +149,33 @@ void L3RRMessage::text(ostream& os) const
 
 
 
-L3RRMessage* GSM::L3RRFactory(L3RRMessage::MessageType MTI)
+L3RRMessage* GSM::L3RRFactory(L3RRMessage::MessageType MTI, L3MessageBuffer* buffer)
 {
 	switch (MTI) {
-		case L3RRMessage::ChannelRelease: return new L3ChannelRelease();
-		case L3RRMessage::AssignmentComplete: return new L3AssignmentComplete();
-		case L3RRMessage::AssignmentFailure: return new L3AssignmentFailure();
-		case L3RRMessage::RRStatus: return new L3RRStatus();
-		case L3RRMessage::PagingResponse: return new L3PagingResponse();
-		case L3RRMessage::ChannelModeModifyAcknowledge: return new L3ChannelModeModifyAcknowledge();
-		case L3RRMessage::ClassmarkChange: return new L3ClassmarkChange();
-		case L3RRMessage::ClassmarkEnquiry: return new L3ClassmarkEnquiry();
-		case L3RRMessage::MeasurementReport: return new L3MeasurementReport();
-		case L3RRMessage::ApplicationInformation: return new L3ApplicationInformation();
+		case L3RRMessage::ChannelRelease: return makeL3Message<L3ChannelRelease>(buffer);
+		case L3RRMessage::AssignmentComplete: return makeL3Message<L3AssignmentComplete>(buffer);
+		case L3RRMessage::AssignmentFailure: return makeL3Message<L3AssignmentFailure>(buffer);
+		case L3RRMessage::RRStatus: return makeL3Message<L3RRStatus>(buffer);
+		case L3RRMessage::PagingResponse: return makeL3Message<L3PagingResponse>(buffer);
+		case L3RRMessage::ChannelModeModifyAcknowledge: return makeL3Message<L3ChannelModeModifyAcknowledge>(buffer);
+		case L3RRMessage::ClassmarkChange: return makeL3Message<L3ClassmarkChange>(buffer);
+		case L3RRMessage::ClassmarkEnquiry: return makeL3Message<L3ClassmarkEnquiry>(buffer);
+		case L3RRMessage::MeasurementReport: return makeL3Message<L3MeasurementReport>(buffer);
+		case L3RRMessage::ApplicationInformation: return makeL3Message<L3ApplicationInformation>(buffer);
         // Partial support just to get along with some phones.
-        case L3RRMessage::GPRSSuspensionRequest: return new L3GPRSSuspensionRequest();
+        case L3RRMessage::GPRSSuspensionRequest: return makeL3Message<L3GPRSSuspensionRequest>(buffer);
 		default:
 			LOG(WARNING) << "no L3 RR factory support for " << MTI;
 			return NULL;
 	}
 }
 
-L3RRMessage* GSM::parseL3RR(const L3Frame& source)
+L3RRMessage* GSM::parseL3RR(const L3Frame& source, L3MessageBuffer* buffer)
 {
 	L3RRMessage::MessageType MTI = (L3RRMessage::MessageType)source.MTI();
 	LOG(DEBUG) << "parseL3RR MTI="<<MTI;
 
-	L3RRMessage *retVal = L3RRFactory(MTI);
+	L3RRMessage *retVal = L3RRFactory(MTI,buffer);
 	if (retVal==NULL) return NULL;
 
 	retVal->parse(source);
@@ -247,6 +247,74 @@ void L3PagingRequestType1::text(ostream& os) const
 }
 
 
+size_t L3PagingRequestType2::l2BodyLength() const
+{
+	size_t sum = 1 + 4 + 4;
+	if (mMobileID3.type()!=NoIDType) sum += mMobileID3.lengthTLV();
+	return sum;
+}
+
+
+
+void L3PagingRequestType2::writeBody(L3Frame& dest, size_t &wp) const
+{
+	// See GSM 04.08 9.1.23.
+	// Page Mode Page Mode M V 1/2 10.5.2.26
+	// Channels Needed  M V 1/2
+	// Mobile Identity 1 M V 4 10.5.2.42 (packed TMSI)
+	// Mobile Identity 2 M V 4 10.5.2.42 (packed TMSI)
+	// 0x17 Mobile Identity 3 O TLV  3-10 10.5.1.4
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[1]),2);
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[0]),2);
+	// "normal paging", GSM 04.08 Table 10.5.63
+	dest.writeField(wp,0x0,4);
+	dest.writeField(wp,mTMSIs[0].TMSI(),32);
+	dest.writeField(wp,mTMSIs[1].TMSI(),32);
+	if (mMobileID3.type()!=NoIDType) mMobileID3.writeTLV(0x17,dest,wp);
+}
+
+
+void L3PagingRequestType2::text(ostream& os) const
+{
+	L3RRMessage::text(os);
+	os << " mobileIDs=(";
+	for (unsigned i=0; i<2; i++) {
+		os << "(" << mTMSIs[i] << "," << mChannelsNeeded[i] << "),";
+	}
+	if (mMobileID3.type()!=NoIDType) os << "(" << mMobileID3 << "),";
+	os << ")";
+}
+
+
+
+void L3PagingRequestType3::writeBody(L3Frame& dest, size_t &wp) const
+{
+	// See GSM 04.08 9.1.24.
+	// Page Mode Page Mode M V 1/2 10.5.2.26
+	// Channels Needed  M V 1/2
+	// Mobile Identity 1-4 M V 4 10.5.2.42 (packed TMSI)
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[1]),2);
+	dest.writeField(wp,channelNeededCode(mChannelsNeeded[0]),2);
+	// "normal paging", GSM 04.08 Table 10.5.63
+	dest.writeField(wp,0x0,4);
+	for (unsigned i=0; i<4; i++) dest.writeField(wp,mTMSIs[i].TMSI(),32);
+}
+
+
+void L3PagingRequestType3::text(ostream& os) const
+{
+	L3RRMessage::text(os);
+	os << " mobileIDs=(";
+	for (unsigned i=0; i<4; i++) {
+		os << "(" << mTMSIs[i];
+		if (i<2) os << "," << mChannelsNeeded[i];
+		os << "),";
+	}
+	os << ")";
+}
+
+
+
 size_t L3PagingResponse::l2BodyLength() const
 {
 	return 1 + mClassmark.lengthLV() + mMobileID.lengthLV();
@@ -670,6 +738,17 @@ void L3MeasurementReport::parseBody(const L3Frame& frame, size_t &rp)
 	mResults.parseV(frame,rp);
 }
 
+bool L3MeasurementReport::parseResults(const L3Frame& frame, L3MeasurementResults& results)
+{
+	// Header, then the 16-octet results.
+	if (frame.size() < 8*(2+16)) return false;
+	if (frame.PD()!=L3RadioResourcePD) return false;
+	if (frame.MTI()!=MeasurementReport) return false;
+	size_t rp = 16;
+	results.parseV(frame,rp);
+	return true;
+}
+
 void L3MeasurementReport::text(ostream& os) const
 {
 	L3RRMessage::text(os);
@@ -157,14 +157,15 @@ class L3RRMessageRO : public L3RRMessage {
 	A Factory function to return a L3RRMessage of the specified MTI.
 	Returns NULL if the MTI is not supported.
 */
-L3RRMessage* L3RRFactory(L3RRMessage::MessageType MTI);
+L3RRMessage* L3RRFactory(L3RRMessage::MessageType MTI, L3MessageBuffer* buffer=NULL);
 
 /**
 	Parse a complete L3 radio resource message into its object type.
 	@param source The L3 bits.
+	@param buffer Storage for the message, or NULL to put it on the heap.
 	@return A pointer to a new message or NULL on failure.
 */
-L3RRMessage* parseL3RR(const L3Frame& source);
+L3RRMessage* parseL3RR(const L3Frame& source, L3MessageBuffer* buffer=NULL);
 
 
 /** Paging Request Type 1, GSM 04.08 9.1.22 */
@@ -217,6 +218,75 @@ class L3PagingRequestType1 : public L3RRMessageNRO {
 
 
 
+/**
+	Paging Request Type 2, GSM 04.08 9.1.23
+	Two TMSIs and an optional third mobile ID of any type.
+	The channel needed for the third mobile goes in the P2 rest octets,
+	which we leave empty, so that mobile sees "any channel".
+*/
+class L3PagingRequestType2 : public L3RRMessageNRO {
+
+	private:
+
+	L3MobileIdentity mTMSIs[2];
+	L3MobileIdentity mMobileID3;	///< optional, NoIDType if absent
+	ChannelType mChannelsNeeded[2];
+
+	public:
+
+	L3PagingRequestType2(const L3MobileIdentity& wTMSI1, ChannelType wType1,
+			const L3MobileIdentity& wTMSI2, ChannelType wType2,
+			const L3MobileIdentity& wId3=L3MobileIdentity())
+		:L3RRMessageNRO(),
+		mMobileID3(wId3)
+	{
+		mTMSIs[0]=wTMSI1;
+		mChannelsNeeded[0]=wType1;
+		mTMSIs[1]=wTMSI2;
+		mChannelsNeeded[1]=wType2;
+	}
+
+	int MTI() const { return PagingRequestType2; }
+
+	size_t l2BodyLength() const;
+	void writeBody(L3Frame& dest, size_t& wp) const;
+	void text(std::ostream&) const;
+};
+
+
+
+/**
+	Paging Request Type 3, GSM 04.08 9.1.24
+	Four TMSIs.  The channels needed for the third and fourth mobiles go
+	in the P3 rest octets, which we leave empty, so they see "any channel".
+*/
+class L3PagingRequestType3 : public L3RRMessageNRO {
+
+	private:
+
+	L3MobileIdentity mTMSIs[4];
+	ChannelType mChannelsNeeded[2];
+
+	public:
+
+	L3PagingRequestType3(const L3MobileIdentity* wTMSIs, ChannelType wType1, ChannelType wType2)
+		:L3RRMessageNRO()
+	{
+		for (int i=0; i<4; i++) mTMSIs[i]=wTMSIs[i];
+		mChannelsNeeded[0]=wType1;
+		mChannelsNeeded[1]=wType2;
+	}
+
+	int MTI() const { return PagingRequestType3; }
+
+	size_t l2BodyLength() const { return 1 + 4*4; }
+	void writeBody(L3Frame& dest, size_t& wp) const;
+	void text(std::ostream&) const;
+};
+
+
+
+
 /** Paging Response, GSM 04.08 9.1.25 */
 class L3PagingResponse : public L3RRMessageNRO {
 
@@ -410,8 +480,8 @@ class L3SystemInformationType4 : public L3RRMessageNRO {
 	//void cellSelectionParameters (const L3CellSelectionParameters& wCellSelectionParameters)
 //		{ mCellSelectionParameters = wCellSelectionParameters; }
 
-//	void RACHControlParameters(const L3RACHControlParameters& wRACHControlParameters)
-//		{ mRACHControlParameters = wRACHControlParameters; }
+	void RACHControlParameters(const L3RACHControlParameters& wRACHControlParameters)
+		{ mRACHControlParameters = wRACHControlParameters; }
 
 	int MTI() const { return (int)SystemInformationType4; }
 
@@ -582,6 +652,20 @@ public:
 		mWaitIndication(seconds)
 	{ mRequestReference.push_back(wRequestReference); }
 
+	/**
+		Add another request reference, up to four in all.
+		@return false if the message is already full.
+	*/
+	bool addRequestReference(const L3RequestReference& wRequestReference)
+	{
+		if (mRequestReference.size()>=4) return false;
+		mRequestReference.push_back(wRequestReference);
+		return true;
+	}
+
+	/** Number of request references in the message. */
+	unsigned size() const { return mRequestReference.size(); }
+
 	int MTI() const { return (int)ImmediateAssignmentReject; }
 
 	size_t l2BodyLength() const { return 17; }
@@ -832,6 +916,13 @@ class L3MeasurementReport : public L3RRMessageNRO {
 
 	const L3MeasurementResults results() const { return mResults; }
 
+	/**
+		Decode the results of a measurement report straight from its frame,
+		without making a message.  This is the common case on the SACCH.
+		@return false if the frame is not a measurement report.
+	*/
+	static bool parseResults(const L3Frame& frame, L3MeasurementResults& results);
+
 };
 
 
@@ -74,6 +74,16 @@ void LogicalChannel::connect()
 }
 
 
+unsigned LogicalChannel::T200Expirations() const
+{
+	unsigned count = 0;
+	for (int s=0; s<4; s++) {
+		if (mL2[s]) count += mL2[s]->T200Expirations();
+	}
+	return count;
+}
+
+
 void LogicalChannel::downstream(ARFCNManager* radio)
 {
 	assert(mL1);
@@ -96,8 +106,9 @@ void LogicalChannel::send(const L3Message& msg,
 
 
 CCCHLogicalChannel::CCCHLogicalChannel(const TDMAMapping& wMapping)
-	:mRunning(false)
+	:mRunning(false),mNumSources(0)
 {
+	for (unsigned i=0; i<maxSources; i++) mSources[i]=NULL;
 	mL1 = new CCCHL1FEC(wMapping);
 	mL2[0] = new CCCHL2;
 	connect();
@@ -123,12 +134,30 @@ void CCCHLogicalChannel::serviceLoop()
 	LogicalChannel::send(idleFrame);
 	// run the loop
 	while (true) {
-		L3Frame* frame = mQ.read();
-		if (frame) {
-			LogicalChannel::send(*frame);
-			OBJLOG(DEBUG) << "CCCHLogicalChannel::serviceLoop sending " << *frame;
-			delete frame;
+		if (mNumSources) {
+			// A CCCH with sources writes every block, so that each page
+			// goes out in the block of its paging subchannel.
+			// The encoder paces this loop at one block per multiframe.
+			L3Frame* frame = mQ.readNoBlock();
+			if (!frame) {
+				Time when = mL1->encoder()->nextWriteTime();
+				for (unsigned i=0; i<mNumSources && !frame; i++) frame = mSources[i]->CCCHFrame(this,when);
+			}
+			if (frame) {
+				LogicalChannel::send(*frame);
+				OBJLOG(DEBUG) << "CCCHLogicalChannel::serviceLoop sending " << *frame;
+				delete frame;
+			} else {
+				LogicalChannel::send(idleFrame);
+			}
+			continue;
 		}
+		// Wake up now and then in case a source is attached.
+		L3Frame* frame = mQ.read(1000);
+		if (!frame) continue;
+		LogicalChannel::send(*frame);
+		OBJLOG(DEBUG) << "CCCHLogicalChannel::serviceLoop sending " << *frame;
+		delete frame;
 		if (mQ.size()==0) {
 			LogicalChannel::send(idleFrame);
 			OBJLOG(DEBUG) << "CCCHLogicalChannel::serviceLoop sending idle frame";
@@ -210,7 +239,7 @@ void SACCHLogicalChannel::open()
 
 
 
-L3Message* processSACCHMessage(L3Frame *l3frame)
+L3Message* processSACCHMessage(L3Frame *l3frame, L3MessageBuffer& buffer)
 {
 	if (!l3frame) return NULL;
 	LOG(DEBUG) << *l3frame;
@@ -221,7 +250,7 @@ L3Message* processSACCHMessage(L3Frame *l3frame)
 	}
 	// FIXME -- Why, again, do we need to do this?
 //	L3Frame realFrame = l3frame->segment(24, l3frame->size()-24);
-	L3Message* message = parseL3(*l3frame);
+	L3Message* message = parseL3(*l3frame,&buffer);
 	if (!message) {
 		LOG(WARNING) << "SACCH recevied unparsable L3 frame " << *l3frame;
 	}
@@ -233,6 +262,8 @@ void SACCHLogicalChannel::serviceLoop()
 {
 	// run the loop
 	unsigned count = 0;
+	// Inbound messages are handled before the next read, so they can share a buffer.
+	L3MessageBuffer messageBuffer;
 	while (true) {
 
 		// Throttle back if not active.
@@ -261,26 +292,24 @@ void SACCHLogicalChannel::serviceLoop()
 			// Process SAP0 -- RR Measurement reports
 			L3Frame *rrFrame = LogicalChannel::recv(0,0);
 			if (rrFrame) nothing=false;
-			L3Message* rrMessage = processSACCHMessage(rrFrame);
-			delete rrFrame;
-			if (rrMessage) {
-				L3MeasurementReport* measurement = dynamic_cast<L3MeasurementReport*>(rrMessage);
-				if (measurement) {
-					mMeasurementResults = measurement->results();
-					OBJLOG(DEBUG) << "SACCH measurement report " << mMeasurementResults;
-					// Add the measurement results to the table
-					// Note that the typeAndOffset of a SACCH match the host channel.
-					gPhysStatus.setPhysical(this, mMeasurementResults);
-				} else {
-					OBJLOG(NOTICE) << "SACCH SAP0 sent unaticipated message " << rrMessage;
-				}
-				delete rrMessage;
+			// Measurement reports are nearly all of the SAP0 traffic,
+			// so decode them straight from the frame.
+			if (rrFrame && (rrFrame->primitive()==DATA || rrFrame->primitive()==UNIT_DATA)
+				&& L3MeasurementReport::parseResults(*rrFrame,mMeasurementResults)) {
+				OBJLOG(DEBUG) << "SACCH measurement report " << mMeasurementResults;
+				// Add the measurement results to the table
+				// Note that the typeAndOffset of a SACCH match the host channel.
+				gPhysStatus.setPhysical(this, mMeasurementResults);
+			} else {
+				L3Message* rrMessage = processSACCHMessage(rrFrame,messageBuffer);
+				if (rrMessage) OBJLOG(NOTICE) << "SACCH SAP0 sent unaticipated message " << rrMessage;
 			}
+			delete rrFrame;
 
 			// Process SAP3 -- SMS
 			L3Frame *smsFrame = LogicalChannel::recv(0,3);
 			if (smsFrame) nothing=false;
-			L3Message* smsMessage = processSACCHMessage(smsFrame);
+			L3Message* smsMessage = processSACCHMessage(smsFrame,messageBuffer);
 			delete smsFrame;
 			if (smsMessage) {
 				const SMS::CPData* cpData = dynamic_cast<const SMS::CPData*>(smsMessage);
@@ -298,9 +327,8 @@ void SACCHLogicalChannel::serviceLoop()
 						gTransactionTable.remove(e.transactionID());
 					}
 				} else {
-					OBJLOG(NOTICE) << "SACCH SAP3 sent unaticipated message " << rrMessage;
+					OBJLOG(NOTICE) << "SACCH SAP3 sent unaticipated message " << smsMessage;
 				}
-				delete smsMessage;
 			}
 
 			// Anything from the SIP side?
@@ -225,6 +225,16 @@ public:
 	unsigned TN() const { assert(mL1); return mL1->TN(); }
 	/** Receive FER. */
 	float FER() const { assert(mL1); return mL1->FER(); }
+	/** Mean uplink decode latency, microseconds. */
+	float decodeLatency() const { assert(mL1); return mL1->latency(); }
+	/** Worst uplink decode latency, microseconds. */
+	unsigned maxDecodeLatency() const { assert(mL1); return mL1->maxLatency(); }
+	/** Uplink soft combining attempts since open(). */
+	unsigned combineTries() const { assert(mL1); return mL1->combineTries(); }
+	/** Uplink soft combining attempts that recovered a frame, since open(). */
+	unsigned combineHits() const { assert(mL1); return mL1->combineHits(); }
+	/** T200 expirations since open(), all SAPs. */
+	unsigned T200Expirations() const;
 	/** RSSI wrt full scale. */
 	virtual float RSSI() const;
 	/** Uplink timing error. */
@@ -421,6 +431,12 @@ class PDTCHLogicalChannel : public LogicalChannel {
 
 	void sendRLCMAC(RLCMACFrame *frame) { return mPDTCHL1->sendRLCMAC(frame); }
 
+	/**@name Coding schemes, 1..4 for CS-1..CS-4. */
+	//@{
+	unsigned recommendedCS() const { return mPDTCHL1->recommendedCS(); }
+	unsigned uplinkCS() const { return mPDTCHL1->uplinkCS(); }
+	//@}
+
 	void open();
 
 };
@@ -447,6 +463,9 @@ class CCCHLogicalChannel : public NDCCHLogicalChannel {
 	Thread mServiceThread;	///< a thread for the service loop
 	L3FrameFIFO mQ;			///< because the CCCH is written by multiple threads
 	bool mRunning;			///< a flag to indication that the service loop is running
+	static const unsigned maxSources = 2;
+	CCCHSource* volatile mSources[maxSources];	///< fill the blocks, in priority order
+	volatile unsigned mNumSources;
 
 	public:
 
@@ -454,6 +473,19 @@ class CCCHLogicalChannel : public NDCCHLogicalChannel {
 
 	void open();
 
+	/**
+		Attach a source, at lower priority than any already attached.
+		From then on, the service loop writes every block, taking queued
+		messages first, then the sources in order, then the idle frame.
+		This should only be used during initialization.
+	*/
+	void addSource(CCCHSource* wSource)
+	{
+		assert(mNumSources<maxSources);
+		mSources[mNumSources] = wSource;
+		mNumSources++;
+	}
+
 	void send(const L3RRMessage& msg)
 		{ mQ.write(new L3Frame((const L3Message&)msg,UNIT_DATA)); }
 
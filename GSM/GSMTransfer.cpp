@@ -226,8 +226,9 @@ void L2Frame::idleFill()
 
 
 L2Frame::L2Frame(const BitVector& bits, Primitive prim)
-	:BitVector(23*8),mPrimitive(prim)
+	:mPrimitive(prim)
 {
+	resize(23*8);
 	idleFill();
 	assert(bits.size()<=this->size());
 	bits.copyTo(*this);
@@ -235,8 +236,9 @@ L2Frame::L2Frame(const BitVector& bits, Primitive prim)
 
 
 L2Frame::L2Frame(const L2Header& header, const BitVector& l3)
-	:BitVector(23*8),mPrimitive(DATA)
+	:mPrimitive(DATA)
 {
+	resize(23*8);
 	idleFill();
 	assert((header.bitsNeeded()+l3.size())<=this->size());
 	size_t wp = header.write(*this);
@@ -245,8 +247,9 @@ L2Frame::L2Frame(const L2Header& header, const BitVector& l3)
 
 
 L2Frame::L2Frame(const L2Header& header)
-	:BitVector(23*8),mPrimitive(DATA)
+	:mPrimitive(DATA)
 {
+	resize(23*8);
 	idleFill();
 	header.write(*this);
 }
@@ -340,9 +343,43 @@ TxBurst::TxBurst(const RxBurst& rx)
 
 // We put this in the .cpp file to avoid a circular dependency.
 RxBurst::RxBurst(const TxBurst& source, float wTimingError, int wRSSI)
-	:SoftVector((const BitVector&) source),mTime(source.time()),
+	:mTime(source.time()),
 	mTimingError(wTimingError),mRSSI(wRSSI)
-{ }
+{
+	resize(source.size());
+	for (size_t i=0; i<size(); i++) {
+		if (source.bit(i)) mStart[i]=1.0F;
+		else mStart[i]=0.0F;
+	}
+}
+
+
+
+// The pools are never deleted, since frames may still be deleted during static destruction.
+
+ObjectPool& TxBurst::pool()
+{
+	static ObjectPool* sPool = new ObjectPool("TxBurst",sizeof(TxBurst));
+	return *sPool;
+}
+
+ObjectPool& RxBurst::pool()
+{
+	static ObjectPool* sPool = new ObjectPool("RxBurst",sizeof(RxBurst));
+	return *sPool;
+}
+
+ObjectPool& L2Frame::pool()
+{
+	static ObjectPool* sPool = new ObjectPool("L2Frame",sizeof(L2Frame));
+	return *sPool;
+}
+
+ObjectPool& L3Frame::pool()
+{
+	static ObjectPool* sPool = new ObjectPool("L3Frame",sizeof(L3Frame));
+	return *sPool;
+}
 
 
 
@@ -458,9 +495,10 @@ ostream& GSM::operator<<(ostream& os, Primitive prim)
 
 
 L3Frame::L3Frame(const L3Message& msg, Primitive wPrimitive)
-	:BitVector(msg.bitsNeeded()),mPrimitive(wPrimitive),
+	:mPrimitive(wPrimitive),
 	mL2Length(msg.L2Length())
 {
+	resize(msg.bitsNeeded());
 	msg.write(*this);
 }
 
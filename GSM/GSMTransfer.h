@@ -29,6 +29,7 @@
 
 #include "Interthread.h"
 #include "BitVector.h"
+#include "ObjectPool.h"
 #include "GSMCommon.h"
 
 
@@ -51,6 +52,12 @@ static const unsigned gHuIndex = 87;		///< index of second stealing bit, GSM 05.
 
 static const unsigned gSlotLen = 148;	///< number of symbols per slot, not counting guard periods
 
+/**
+	The largest L2 or L3 frame held inline, in bits.
+	L3 frames reassembled from several L2 frames go to the heap.
+*/
+static const unsigned gFrameBits = 23*8;
+
 
 
 
@@ -85,13 +92,15 @@ class TxBurst : public BitVector {
 	private:
 
 	Time mTime;			///< GSM frame number
+	char mBits[gSlotLen];	///< inline storage for the bits
 
 	public:
 
 	/** Create an empty TxBurst. */
 	TxBurst(const Time& wTime = Time(0))
-		:BitVector(gSlotLen),mTime(wTime)
+		:mTime(wTime)
 	{
+		resize(gSlotLen);
 		// Zero out the tail bits now.
 		mStart[0]=0; mStart[1]=0; mStart[2]=0;
 		mStart[145]=0; mStart[146]=0; mStart[147]=0;
@@ -99,12 +108,41 @@ class TxBurst : public BitVector {
 
 	/** Create a TxBurst by copying from an existing BitVector. */
 	TxBurst(const BitVector& wSig, const Time& wTime = Time(0))
-		:BitVector(wSig),mTime(wTime)
-	{ assert(wSig.size()==gSlotLen); }
+		:mTime(wTime)
+	{
+		assert(wSig.size()==gSlotLen);
+		resize(gSlotLen);
+		wSig.copyTo(*this);
+	}
+
+	TxBurst(const TxBurst& other)
+		:BitVector(),mTime(other.mTime)
+	{
+		resize(other.size());
+		other.copyTo(*this);
+	}
 
 	/** Create a TxBurst from an RxBurst (for testing). */
 	TxBurst(const RxBurst& rx);
 
+	void operator=(const TxBurst& other)
+	{
+		if (this==&other) return;
+		resize(other.size());
+		other.copyTo(*this);
+		mTime = other.mTime;
+	}
+
+	/** Change the size, keeping the bits inline if they fit. */
+	void resize(size_t len) { resizeInto(mBits,gSlotLen,len); }
+
+	/**@name Pooled allocation, see ObjectPool.h. */
+	//@{
+	static ObjectPool& pool();
+	static void* operator new(size_t size) { return pool().allocate(size); }
+	static void operator delete(void* block, size_t size) { pool().release(block,size); }
+	//@}
+
 	/**@name Basic accessors. */
 	//@{
 	Time time() const { return mTime; }
@@ -115,10 +153,10 @@ class TxBurst : public BitVector {
 		{ return mTime > other.mTime; }
 
 	/** Set upper stealing bit. */
-	void Hu(bool HuVal) { mData[gHuIndex] = HuVal; }
+	void Hu(bool HuVal) { mStart[gHuIndex] = HuVal; }
 
 	/** Set lower stealing bit. */
-	void Hl(bool HlVal) { mData[gHlIndex] = HlVal; }
+	void Hl(bool HlVal) { mStart[gHlIndex] = HlVal; }
 
 	friend std::ostream& operator<<(std::ostream& os, const TxBurst& ts);
 	
@@ -156,19 +194,52 @@ class RxBurst : public SoftVector {
 	Time mTime;				///< timeslot and frame on which this was received
 	float mTimingError;		///< Timing error in symbol steps, <0 means early.
 	float mRSSI;			///< RSSI estimate associated with the slot, dB wrt full scale.
+	float mSymbols[gSlotLen];	///< inline storage for the soft symbols, unless wrapped
 
 
 	public:
 
-	/** Initialize an RxBurst from a hard Timeslot.  Note the funny cast. */
+	/** Initialize an RxBurst from a hard Timeslot. */
 	RxBurst(const TxBurst& source, float wTimingError=0, int wRSSI=0);
 
-	/** Wrap an RxBurst around an existing float array. */
+	/**
+		Wrap an RxBurst around an existing float array.
+		The array is not copied, so copy the burst to keep it.
+	*/
 	RxBurst(float* wData, const Time &wTime, float wTimingError, int wRSSI)
 		:SoftVector(wData,gSlotLen),mTime(wTime),
 		mTimingError(wTimingError),mRSSI(wRSSI)
 	{ }
 
+	/** Copy a burst, including a wrapped one, into inline storage. */
+	RxBurst(const RxBurst& other)
+		:SoftVector(),mTime(other.mTime),
+		mTimingError(other.mTimingError),mRSSI(other.mRSSI)
+	{
+		resize(other.size());
+		other.copyTo(*this);
+	}
+
+	void operator=(const RxBurst& other)
+	{
+		if (this==&other) return;
+		resize(other.size());
+		other.copyTo(*this);
+		mTime = other.mTime;
+		mTimingError = other.mTimingError;
+		mRSSI = other.mRSSI;
+	}
+
+	/** Change the size, keeping the symbols inline if they fit. */
+	void resize(size_t len) { resizeInto(mSymbols,gSlotLen,len); }
+
+	/**@name Pooled allocation, see ObjectPool.h. */
+	//@{
+	static ObjectPool& pool();
+	static void* operator new(size_t size) { return pool().allocate(size); }
+	static void operator delete(void* block, size_t size) { pool().release(block,size); }
+	//@}
+
 
 	Time time() const { return mTime; }
 
@@ -470,6 +541,7 @@ class L2Frame : public BitVector {
 	private:
 
 	GSM::Primitive mPrimitive;
+	char mBits[gFrameBits];		///< inline storage for the bits
 
 	public:
 
@@ -478,15 +550,20 @@ class L2Frame : public BitVector {
 
 	/** Build an empty frame with a given primitive. */
 	L2Frame(GSM::Primitive wPrimitive=UNIT_DATA)
-		:BitVector(23*8),
-		mPrimitive(wPrimitive)
-	{ idleFill(); }
+		:mPrimitive(wPrimitive)
+	{
+		resize(23*8);
+		idleFill();
+	}
 
 	/** Make a new L2 frame by copying an existing one. */
 	L2Frame(const L2Frame& other)
-		:BitVector((const BitVector&)other),
+		:BitVector(),
 		mPrimitive(other.mPrimitive)
-	{ }
+	{
+		resize(other.size());
+		other.copyTo(*this);
+	}
 
 	/**
 		Make an L2Frame from a block of bits.
@@ -507,6 +584,24 @@ class L2Frame : public BitVector {
 	*/
 	L2Frame(const L2Header&);
 
+	void operator=(const L2Frame& other)
+	{
+		if (this==&other) return;
+		resize(other.size());
+		other.copyTo(*this);
+		mPrimitive = other.mPrimitive;
+	}
+
+	/** Change the size, keeping the bits inline if they fit. */
+	void resize(size_t len) { resizeInto(mBits,gFrameBits,len); }
+
+	/**@name Pooled allocation, see ObjectPool.h. */
+	//@{
+	static ObjectPool& pool();
+	static void* operator new(size_t size) { return pool().allocate(size); }
+	static void operator delete(void* block, size_t size) { pool().release(block,size); }
+	//@}
+
 	/** Get the LPD from the L2 header.  Assumes address byte is first. */
 	unsigned LPD() const;
 
@@ -586,30 +681,50 @@ class L3Frame : public BitVector {
 
 	Primitive mPrimitive;
 	size_t mL2Length;		///< length, or L2 pseudo-length, as appropriate
+	char mBits[gFrameBits];	///< inline storage for the bits, if they fit
 
 	public:
 
 	/** Empty frame with a primitive. */
 	L3Frame(Primitive wPrimitive=DATA, size_t len=0)
-		:BitVector(len),mPrimitive(wPrimitive),mL2Length(len)
-	{ }
+		:mPrimitive(wPrimitive),mL2Length(len)
+	{ resize(len); }
 
 	/** Put raw bits into the frame. */
 	L3Frame(const BitVector& source, Primitive wPrimitive=DATA)
-		:BitVector(source),mPrimitive(wPrimitive),mL2Length(source.size()/8)
-	{ if (source.size()%8) mL2Length++; }
+		:mPrimitive(wPrimitive),mL2Length(source.size()/8)
+	{
+		if (source.size()%8) mL2Length++;
+		resize(source.size());
+		source.copyTo(*this);
+	}
+
+	L3Frame(const L3Frame& other)
+		:BitVector(),mPrimitive(other.mPrimitive),mL2Length(other.mL2Length)
+	{
+		resize(other.size());
+		other.copyTo(*this);
+	}
 
 	/** Concatenate 2 L3Frames */
 	L3Frame(const L3Frame& f1, const L3Frame& f2)
-		:BitVector(f1,f2),mPrimitive(DATA),
+		:mPrimitive(DATA),
 		mL2Length(f1.mL2Length + f2.mL2Length)
-	{}
+	{
+		resize(f1.size()+f2.size());
+		f1.copyToSegment(*this,0);
+		f2.copyToSegment(*this,f1.size());
+	}
 
 	/** Build from an L2Frame. */
 	L3Frame(const L2Frame& source)
-		:BitVector(source.L3Part()),mPrimitive(DATA),
+		:mPrimitive(DATA),
 		mL2Length(source.L())
-	{ }
+	{
+		// Copy straight from the L2 frame, not through an L3Part() temporary.
+		resize(8*source.L());
+		source.segmentCopyTo(*this,8*3,size());
+	}
 
 	/** Serialize a message into the frame. */
 	L3Frame(const L3Message& msg, Primitive wPrimitive=DATA);
@@ -620,6 +735,25 @@ class L3Frame : public BitVector {
 	/** Get a frame from raw binary. */
 	L3Frame(const char*, size_t len);
 
+	void operator=(const L3Frame& other)
+	{
+		if (this==&other) return;
+		resize(other.size());
+		other.copyTo(*this);
+		mPrimitive = other.mPrimitive;
+		mL2Length = other.mL2Length;
+	}
+
+	/** Change the size, keeping the bits inline if they fit. */
+	void resize(size_t len) { resizeInto(mBits,gFrameBits,len); }
+
+	/**@name Pooled allocation, see ObjectPool.h. */
+	//@{
+	static ObjectPool& pool();
+	static void* operator new(size_t size) { return pool().allocate(size); }
+	static void operator delete(void* block, size_t size) { pool().release(block,size); }
+	//@}
+
 	/** Protocol Discriminator, GSM 04.08 10.2. */
 	L3PD PD() const { return (L3PD)peekField(4,4); }
 
@@ -653,6 +787,30 @@ typedef InterthreadQueue<L3Frame> L3FrameFIFO;
 
 
 
+class CCCHLogicalChannel;
+
+/**
+	Something that fills the blocks of a CCCH,
+	such as the Control::Pager or the Control::AccessGrantScheduler.
+	A CCCH with sources asks them for the content of each block in turn.
+*/
+class CCCHSource {
+
+	public:
+
+	virtual ~CCCHSource() {}
+
+	/**
+		Return the message for a CCCH block, or NULL for none.
+		@param CCCH The channel.
+		@param when The time of the first burst of the block.
+		@return A new UNIT_DATA frame, which the caller will delete.
+	*/
+	virtual L3Frame* CCCHFrame(const CCCHLogicalChannel* CCCH, const Time& when) = 0;
+};
+
+
+
 /** A vocoder frame for use in GSM/SIP contexts. */
 class VocoderFrame : public BitVector {
 
@@ -40,6 +40,7 @@
 #include <iomanip>
 #include <math.h>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace GSM;
@@ -62,7 +63,19 @@ static const char* createPhysicalStatus = {
 	")"
 };
 
+static const char* writePhysicalStatus = {
+	"INSERT OR REPLACE INTO PHYSTATUS "
+		"(CN_TN_TYPE_AND_OFFSET, ARFCN, ACCESSED, "
+		"RXLEV_FULL_SERVING_CELL, RXLEV_SUB_SERVING_CELL, "
+		"RXQUAL_FULL_SERVING_CELL_BER, RXQUAL_SUB_SERVING_CELL_BER, "
+		"RSSI, TIME_ERR, TRANS_PWR, TIME_ADVC, FER) "
+	"VALUES (?,?,?,?,?,?,?,?,?,?,?,?)"
+};
+
+
 PhysicalStatus::PhysicalStatus(const char* wPath)
+	:mDirtyCount(0),mWrite(NULL),
+	mReports(0),mFlushes(0),mRows(0),mFailures(0),mLastFlushTime(0)
 {
 	int rc = sqlite3_open(wPath, &mDB);
 	if (rc) {
@@ -71,83 +84,160 @@ PhysicalStatus::PhysicalStatus(const char* wPath)
 		mDB = NULL;
 		return;
 	}
+	sqlite3_setup(mDB);
 	if (!sqlite3_command(mDB, createPhysicalStatus)) {
 		LOG(EMERG) << "Cannot create TMSI table";
 	}
+	if (sqlite3_prepare_statement(mDB, &mWrite, writePhysicalStatus)) {
+		LOG(EMERG) << "Cannot prepare PhysicalStatus update";
+		mWrite = NULL;
+	}
 }
 
 PhysicalStatus::~PhysicalStatus()
 {
-	if (mDB) sqlite3_close(mDB);
+	if (mWrite) sqlite3_finalize(mWrite);
+	if (!mDB) return;
+	sqlite3_clear_cache(mDB);
+	sqlite3_close(mDB);
+}
+
+
+void PhysicalStatus::start()
+{
+	mFlushThread.start((void*(*)(void*))PhysicalStatusFlushLoopAdapter,this);
 }
 
-bool PhysicalStatus::createEntry(const LogicalChannel* chan)
+
+bool PhysicalStatus::setPhysical(const LogicalChannel* chan,
+								const L3MeasurementResults& measResults)
 {
-	assert(mDB);
 	assert(chan);
 
 	ScopedLock lock(mLock);
 
-	const char* chanString = chan->descriptiveString();
-	LOG(DEBUG) << chan->descriptiveString();
-
-	/* Check to see if the key exists. */
-	if (!sqlite3_exists(mDB, "PHYSTATUS", "CN_TN_TYPE_AND_OFFSET", chanString)) {
-		/* No? Ok, it should now. */
-		char query[500];
-		sprintf(query, "INSERT INTO PHYSTATUS (CN_TN_TYPE_AND_OFFSET, ACCESSED) VALUES "
-					   "(\"%s\", %u)",
-				chanString, (unsigned)time(NULL));
-		return sqlite3_command(mDB, query);
+	mReports++;
+	Entry& entry = mEntries[chan];
+	if (entry.mName.empty()) entry.mName = chan->descriptiveString();
+	entry.mARFCN = chan->ARFCN();
+	entry.mAccessed = time(NULL);
+	entry.mMeasValid = measResults.MEAS_VALID();
+	entry.mRXLevFull = measResults.RXLEV_FULL_SERVING_CELL_dBm();
+	entry.mRXLevSub = measResults.RXLEV_SUB_SERVING_CELL_dBm();
+	entry.mRXQualFullBER = measResults.RXQUAL_FULL_SERVING_CELL_BER();
+	entry.mRXQualSubBER = measResults.RXQUAL_SUB_SERVING_CELL_BER();
+	entry.mRSSI = chan->RSSI();
+	entry.mTimingError = chan->timingError();
+	entry.mPower = chan->actualMSPower();
+	entry.mTiming = chan->actualMSTiming();
+	entry.mFER = chan->FER();
+	if (!entry.mDirty) {
+		entry.mDirty = true;
+		mDirtyCount++;
 	}
+	return true;
+}
+
 
-	return false;
+bool PhysicalStatus::get(const LogicalChannel* chan, Entry& entry) const
+{
+	ScopedLock lock(mLock);
+	EntryMap::const_iterator p = mEntries.find(chan);
+	if (p==mEntries.end()) return false;
+	entry = p->second;
+	return true;
 }
 
-bool PhysicalStatus::setPhysical(const LogicalChannel* chan,
-								const L3MeasurementResults& measResults)
+
+bool PhysicalStatus::write(const Entry& entry)
 {
-	// TODO -- It would be better if the argument what just the channel
-	// and the key was just the descriptiveString.
+	sqlite3_bind_text(mWrite, 1, entry.mName.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_int(mWrite, 2, entry.mARFCN);
+	sqlite3_bind_int64(mWrite, 3, entry.mAccessed);
+	sqlite3_bind_int(mWrite, 4, entry.mRXLevFull);
+	sqlite3_bind_int(mWrite, 5, entry.mRXLevSub);
+	sqlite3_bind_double(mWrite, 6, entry.mRXQualFullBER);
+	sqlite3_bind_double(mWrite, 7, entry.mRXQualSubBER);
+	sqlite3_bind_double(mWrite, 8, entry.mRSSI);
+	sqlite3_bind_double(mWrite, 9, entry.mTimingError);
+	sqlite3_bind_int(mWrite, 10, entry.mPower);
+	sqlite3_bind_int(mWrite, 11, entry.mTiming);
+	sqlite3_bind_double(mWrite, 12, entry.mFER);
+	int src = sqlite3_run_query(mDB, mWrite);
+	sqlite3_reset(mWrite);
+	sqlite3_clear_bindings(mWrite);
+	return src==SQLITE_DONE;
+}
 
-	assert(mDB);
-	assert(chan);
+
+void PhysicalStatus::flush()
+{
+	if (!mDB || !mWrite) return;
+
+	// Copy the changed entries under the lock and write them without it.
+	std::vector<Entry> changed;
+	mLock.lock();
+	if (mDirtyCount) {
+		changed.reserve(mDirtyCount);
+		for (EntryMap::iterator p=mEntries.begin(); p!=mEntries.end(); ++p) {
+			if (!p->second.mDirty) continue;
+			changed.push_back(p->second);
+			p->second.mDirty = false;
+		}
+		mDirtyCount = 0;
+	}
+	mLock.unlock();
+	if (changed.size()==0) return;
+
+	Timeval start;
+	unsigned failures = 0;
+	sqlite3_command(mDB, "BEGIN TRANSACTION");
+	for (unsigned i=0; i<changed.size(); i++) {
+		if (!write(changed[i])) failures++;
+	}
+	if (!sqlite3_command(mDB, "COMMIT")) {
+		LOG(ALERT) << "PhysicalStatus flush of " << changed.size() << " rows failed: " << sqlite3_errmsg(mDB);
+		sqlite3_command(mDB, "ROLLBACK");
+		failures = changed.size();
+	}
+	long elapsed = start.elapsed();
+	LOG(DEBUG) << "wrote " << changed.size() << " rows in " << elapsed << " ms";
 
 	ScopedLock lock(mLock);
+	mFlushes++;
+	mRows += changed.size() - failures;
+	mFailures += failures;
+	mLastFlushTime = elapsed;
+}
+
+
+void PhysicalStatus::flushLoop()
+{
+	while (true) {
+		unsigned interval = 2000;
+		if (gConfig.defines("Control.Reporting.PhysStatusFlush")) interval = gConfig.getNum("Control.Reporting.PhysStatusFlush");
+		msleep(interval);
+		flush();
+	}
+}
+
+
+void *GSM::PhysicalStatusFlushLoopAdapter(PhysicalStatus *status)
+{
+	status->flushLoop();
+	return NULL;
+}
 
-	createEntry(chan);
-
-	char query[500];
-	sprintf(query,
-		"UPDATE PHYSTATUS SET "
-		"RXLEV_FULL_SERVING_CELL=%d, "
-		"RXLEV_SUB_SERVING_CELL=%d, "
-		"RXQUAL_FULL_SERVING_CELL_BER=%f, "
-		"RXQUAL_SUB_SERVING_CELL_BER=%f, "
-		"RSSI=%f, "
-		"TIME_ERR=%f, "
-		"TRANS_PWR=%u, "
-		"TIME_ADVC=%u, "
-		"FER=%f, "
-		"ACCESSED=%u, "
-		"ARFCN=%u "
-		"WHERE CN_TN_TYPE_AND_OFFSET==\"%s\"",
-		measResults.RXLEV_FULL_SERVING_CELL_dBm(),
-		measResults.RXLEV_SUB_SERVING_CELL_dBm(),
-		measResults.RXQUAL_FULL_SERVING_CELL_BER(),
-		measResults.RXQUAL_SUB_SERVING_CELL_BER(),
-		chan->RSSI(), chan->timingError(),
-		chan->actualMSPower(), chan->actualMSTiming(),
-		chan->FER(),
-		(unsigned)time(NULL),
-		chan->ARFCN(),
-		chan->descriptiveString());
-
-	LOG(DEBUG) << "Query: " << query;
-
-	return sqlite3_command(mDB, query);
+
+void PhysicalStatus::dump(ostream& os) const
+{
+	ScopedLock lock(mLock);
+	os << "channels " << mEntries.size() << " reports " << mReports << " pending " << mDirtyCount
+		<< " flushes " << mFlushes << " rows " << mRows << " failures " << mFailures
+		<< " last flush " << mLastFlushTime << " ms";
 }
 
+
 #if 0
 void PhysicalStatus::dump(ostream& os) const
 {
@@ -30,12 +30,16 @@
 #define PHYSICALSTATUS_H
 
 #include <map>
+#include <string>
+#include <ostream>
+#include <time.h>
 
 #include <Timeval.h>
 #include <Threads.h>
 
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 
 namespace GSM {
@@ -45,13 +49,65 @@ class LogicalChannel;
 
 /**
 	A table for tracking the state of channels.
+
+	The latest report of each channel is kept in memory, where the SACCH
+	service loops update it and the CLI reads it.  A background thread
+	writes the channels that changed to the sqlite3 table in one transaction
+	every Control.Reporting.PhysStatusFlush ms, so the SACCH loops never
+	wait on the database.
 */
 class PhysicalStatus {
 
+	public:
+
+	/** The latest physical status of one channel. */
+	class Entry {
+
+		public:
+
+		std::string mName;				///< the table key, the channel's descriptiveString()
+		unsigned mARFCN;
+		time_t mAccessed;				///< Unix time of the last report
+		bool mMeasValid;				///< the MEAS-VALID bit, which is 0 for valid
+		int mRXLevFull;					///< dBm
+		int mRXLevSub;					///< dBm
+		float mRXQualFullBER;
+		float mRXQualSubBER;
+		float mRSSI;					///< dB wrt full scale
+		float mTimingError;				///< symbol periods
+		int mPower;						///< handset tx power, dBm
+		int mTiming;					///< handset timing advance, symbol periods
+		float mFER;
+		bool mDirty;					///< changed since the last flush
+
+		Entry()
+			:mARFCN(0),mAccessed(0),mMeasValid(true),
+			mRXLevFull(0),mRXLevSub(0),mRXQualFullBER(0),mRXQualSubBER(0),
+			mRSSI(0),mTimingError(0),mPower(0),mTiming(0),mFER(0),
+			mDirty(false)
+		{ }
+	};
+
 private:
 
-	Mutex mLock;		///< to reduce the load on the filesystem locking
-	sqlite3 *mDB;		///< database connection
+	typedef std::map<const LogicalChannel*,Entry> EntryMap;
+
+	mutable Mutex mLock;	///< protects the entries and statistics
+	EntryMap mEntries;		///< latest status, by channel
+	unsigned mDirtyCount;	///< entries not yet flushed
+
+	sqlite3 *mDB;			///< database connection, used only by the flush thread after startup
+	sqlite3_stmt *mWrite;	///< prepared INSERT OR REPLACE for one row
+	Thread mFlushThread;
+
+	/**@name Statistics, protected by mLock. */
+	//@{
+	unsigned long mReports;
+	unsigned long mFlushes;
+	unsigned long mRows;		///< rows written
+	unsigned long mFailures;	///< rows that failed
+	long mLastFlushTime;		///< ms for the last flush
+	//@}
 
 public:
 
@@ -63,32 +119,43 @@ public:
 
 	~PhysicalStatus();
 
+	/** Start the thread that writes the table. */
+	void start();
+
 	/** 
-		Add reporting information associated with a channel to the table.
+		Record the status of a channel, to be written to the table by the next flush.
 		@param chan The channel to report.
 		@param measResults The measurement report.
-		@return The result of the SQLite query: true for the query being executed successfully, false otherwise.
+		@return Always true; the table is written later.
 	*/
 	bool setPhysical(const LogicalChannel* chan, const L3MeasurementResults& measResults);
 
 	/**
-		Dump the physical status table to the output stream.
-		@param os The output stream to dump the channel information to.
+		Get the latest status of a channel from memory.
+		@return false if the channel has never reported.
 	*/
-//	void dump(std::ostream& os) const;
+	bool get(const LogicalChannel* chan, Entry& entry) const;
+
+	/** Write the changed entries to the table in one transaction. */
+	void flush();
+
+	/** Dump statistics to a stream. */
+	void dump(std::ostream& os) const;
 
 	private:
 
-	/** 
-		Create entry in table. This is for the initial creation.
-		@param chan The channel to create an entry for.
-		@return The result of the SQLite query: true for the query being executed successfully, false otherwise.
-	*/
-	bool createEntry(const LogicalChannel* chan);
+	/** Write one entry with the prepared statement.  Caller holds the transaction. */
+	bool write(const Entry& entry);
 
+	/** Flush periodically. */
+	void flushLoop();
 
+	friend void* PhysicalStatusFlushLoopAdapter(PhysicalStatus*);
 };
 
+/** Thread adapter for the flush loop. */
+void* PhysicalStatusFlushLoopAdapter(PhysicalStatus*);
+
 
 }
 
@@ -33,6 +33,7 @@
 #include <GSMConfig.h>
 #include <ControlCommon.h>
 #include <TransactionTable.h>
+#include <SMSSpool.h>
 
 #include <Sockets.h>
 
@@ -66,6 +67,9 @@ void SIPMessageMap::write(const std::string& call_id, osip_message_t * msg)
 		throw SIPError();
 	}
 	LOG(DEBUG) << "write on fifo " << fifo;
+	mBacklogLock.lock();
+	mBacklog++;
+	mBacklogLock.unlock();
 	fifo->write(msg);	
 }
 
@@ -80,6 +84,9 @@ osip_message_t * SIPMessageMap::read(const std::string& call_id, unsigned readTi
 	LOG(DEBUG) << "blocking on fifo " << fifo;
 	osip_message_t * msg =  fifo->read(readTimeout);	
 	if (!msg) throw SIPTimeout();
+	mBacklogLock.lock();
+	if (mBacklog) mBacklog--;
+	mBacklogLock.unlock();
 	return msg;
 }
 
@@ -95,11 +102,23 @@ bool SIPMessageMap::remove(const std::string& call_id)
 {
 	OSIPMessageFIFO * fifo = mMap.readNoBlock(call_id);
 	if(fifo == NULL) return false;
+	// Messages never read go away with the FIFO.
+	unsigned unread = fifo->size();
+	mBacklogLock.lock();
+	mBacklog = mBacklog>unread ? mBacklog-unread : 0;
+	mBacklogLock.unlock();
 	mMap.remove(call_id);
 	return true;
 }
 
 
+unsigned SIPMessageMap::backlog() const
+{
+	ScopedLock lock(mBacklogLock);
+	return mBacklog;
+}
+
+
 
 
 
@@ -218,6 +237,12 @@ void SIPInterface::drive()
 
 		if (msg->sip_method) LOG(DEBUG) << "read method " << msg->sip_method;
 
+		// A spooled MESSAGE needs nothing more.
+		if (spoolMessage(msg)) {
+			osip_message_free(msg);
+			return;
+		}
+
 		// Must check if msg is an invite.
 		// if it is, handle appropriatly.
 		// FIXME -- Check return value in case this failed.
@@ -282,6 +307,47 @@ const char* extractCallID(const osip_message_t* msg)
 
 
 
+bool SIPInterface::spoolMessage(osip_message_t * msg)
+{
+	// With a spool, MT SMS is accepted as soon as it is on disk,
+	// and the spool pages the handset and delivers it later.
+	if (!gSMSSpool.enabled()) return false;
+	if (!msg->sip_method || strcmp(msg->sip_method,"MESSAGE")!=0) return false;
+	const char* IMSI = extractIMSI(msg);
+	const char* callIDNum = extractCallID(msg);
+	if (!IMSI || !callIDNum) return false;
+	// A repeat of a MESSAGE that is already being delivered the old way?
+	if (mSIPMap.map().readNoBlock(callIDNum) != NULL) return false;
+
+	const char *callerID = "";
+	osip_from_t *from = osip_message_get_from(msg);
+	if (from) {
+		osip_uri_t* url = osip_contact_get_url(from);
+		if (url && url->username) callerID = url->username;
+	}
+	osip_body_t *body = NULL;
+	osip_message_get_body(msg,0,&body);
+	if (!body || !body->body) return false;
+	string type;
+	osip_content_type_t *contentType = osip_message_get_content_type(msg);
+	if (contentType && contentType->type && contentType->subtype) {
+		type = string(contentType->type) + "/" + contentType->subtype;
+	}
+	if (!gSMSSpool.add(IMSI,callIDNum,callerID,type.c_str(),body->body,body->length)) {
+		// Deliver it the old way.
+		LOG(NOTICE) << "cannot spool MT SMS " << callIDNum << " for IMSI " << IMSI;
+		return false;
+	}
+	LOG(INFO) << "spooled MT SMS " << callIDNum << " for IMSI " << IMSI;
+	SIPEngine engine(gConfig.getStr("SIP.Proxy.SMS").c_str(),IMSI);
+	engine.saveINVITE(msg,false);
+	engine.MTSMSSendOK();
+	return true;
+}
+
+
+
+
 bool SIPInterface::checkInvite( osip_message_t * msg)
 {
 	LOG(DEBUG);
@@ -387,6 +453,12 @@ bool SIPInterface::checkInvite( osip_message_t * msg)
 		LOG(NOTICE) << "MTC CONGESTION, no " << requiredChannel << " availble for assignment";
 		return false;
 	}
+	// Under overload, leave new MT SMS with the SMSC, which will send it again.
+	// This is no reply at all, like the congestion case above.
+	if (!chan && serviceType==L3CMServiceType::MobileTerminatedShortMessage && gBTS.overload().deferSMS()) {
+		LOG(NOTICE) << "deferring MT SMS under overload for " << mobileID;
+		return false;
+	}
 	if (chan)  { LOG(INFO) << "using existing channel " << chan->descriptiveString(); }
 	else { LOG(INFO) << "set up MTC paging for channel=" << requiredChannel; }
 
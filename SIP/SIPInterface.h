@@ -99,8 +99,15 @@ private:
 
 	OSIPMessageFIFOMap mMap;
 
+	mutable Mutex mBacklogLock;
+	unsigned mBacklog;			///< messages written and not yet read, over all FIFOs
+
 public:
 
+	SIPMessageMap()
+		:mBacklog(0)
+	{ }
+
 	/** Write sip message to the map+fifo. used by sip interface. */
 	void write(const std::string& call_id, osip_message_t * sip_msg );
 
@@ -117,6 +124,9 @@ public:
 	*/
 	bool remove(const std::string& call_id);
 
+	/** Number of messages waiting in all of the FIFOs. */
+	unsigned backlog() const;
+
 	/** Direct access to the map. */
 	// FIXME -- This should probably be replaced with more specific methods.
 	OSIPMessageFIFOMap& map() {return mMap;}
@@ -173,6 +183,13 @@ public:
 	*/
 	bool checkInvite( osip_message_t *);
 
+	/**
+		Put an incoming MESSAGE into the SMS spool and acknowledge it.
+		@param msg The SIP message to check.
+		@return true if the message was spooled and answered
+	*/
+	bool spoolMessage( osip_message_t *);
+
 
 	/**
 		Schedule SMS for delivery.
@@ -196,6 +213,9 @@ public:
 
 	int fifoSize(const std::string& call_id );
 
+	/** Number of inbound messages waiting to be read by the call controllers. */
+	unsigned backlog() const { return mSIPMap.backlog(); }
+
 };
 
 void driveLoop(SIPInterface*);
@@ -49,12 +49,12 @@ ostream& SMS::operator<<(ostream& os, CPMessage::MessageType val)
 }
 
 
-CPMessage * SMS::CPFactory(CPMessage::MessageType val)
+CPMessage * SMS::CPFactory(CPMessage::MessageType val, L3MessageBuffer* buffer)
 {
 	switch(val) {
-		case CPMessage::DATA: return new CPData();
-		case CPMessage::ACK: return new CPAck();
-		case CPMessage::ERROR: return new CPError();
+		case CPMessage::DATA: return makeL3Message<CPData>(buffer);
+		case CPMessage::ACK: return makeL3Message<CPAck>(buffer);
+		case CPMessage::ERROR: return makeL3Message<CPError>(buffer);
 		default: {
 			LOG(NOTICE) << "no factory support for MTI="<<val;
 			return NULL;
@@ -64,12 +64,12 @@ CPMessage * SMS::CPFactory(CPMessage::MessageType val)
 
 
 
-CPMessage * SMS::parseSMS( const GSM::L3Frame& frame )
+CPMessage * SMS::parseSMS( const GSM::L3Frame& frame, L3MessageBuffer* buffer )
 {
 	CPMessage::MessageType MTI = (CPMessage::MessageType)(frame.MTI());	
 	LOG(DEBUG) << "MTI="<<MTI;
 	
-	CPMessage * retVal = CPFactory(MTI);
+	CPMessage * retVal = CPFactory(MTI,buffer);
 	if( retVal==NULL ) return NULL;
 	retVal->TI(frame.TI());
 	retVal->parse(frame);
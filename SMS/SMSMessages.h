@@ -801,8 +801,9 @@ std::ostream& operator<<(std::ostream& os, CPMessage::MessageType MTI);
 /**
 	Parse a complete SMS L3 (CM) message.
 	This is the top-level SMS parser, called along side other L3 parsers.
+	@param buffer Storage for the message, or NULL to put it on the heap.
 */
-CPMessage * parseSMS( const GSM::L3Frame& frame );
+CPMessage * parseSMS( const GSM::L3Frame& frame, GSM::L3MessageBuffer* buffer=NULL );
 
 /**
    Parse msgtext from a hex string to RPData struct.
@@ -820,7 +821,7 @@ RPData *hex2rpdata(const char *hexstring);
 TLMessage *parseTPDU(const TLFrame& TPDU);
 
 /** A factory method for SMS L3 (CM) messages. */
-CPMessage * CPFactory( CPMessage::MessageType MTI );
+CPMessage * CPFactory( CPMessage::MessageType MTI, GSM::L3MessageBuffer* buffer=NULL );
 
 
 
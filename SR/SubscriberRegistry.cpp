@@ -29,6 +29,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sqlite3util.h>
 #include "sqlite3.h"
 #include <iostream>
 #include <sstream>
@@ -145,8 +147,12 @@ static const char* createSBTable = {
 
 
 SubscriberRegistry::SubscriberRegistry()
+	:mCacheSize(1000),mCacheTTL(60),mDataVersion(false),mFileFD(-1),mChangeCounter(0),mGeneration(0),
+	mHits(0),mMisses(0),mExpirations(0),mEvictions(0),mInvalidations(0),mExternalFlushes(0)
 {
 	string ldb = gConfig.getStr("SubscriberRegistry.db");
+	if (gConfig.defines("SubscriberRegistry.Cache.Size")) mCacheSize = gConfig.getNum("SubscriberRegistry.Cache.Size");
+	if (gConfig.defines("SubscriberRegistry.Cache.TTL")) mCacheTTL = gConfig.getNum("SubscriberRegistry.Cache.TTL");
 	int rc = sqlite3_open(ldb.c_str(),&mDB);
 	if (rc) {
 		LOG(EMERG) << "Cannot open SubscriberRegistry database: " << sqlite3_errmsg(mDB);
@@ -154,6 +160,7 @@ SubscriberRegistry::SubscriberRegistry()
 		mDB = NULL;
 		return;
 	}
+	sqlite3_setup(mDB);
     if (!sqlite3_command(mDB,createRRLPTable)) {
         LOG(EMERG) << "Cannot create RRLP table";
     }
@@ -163,13 +170,23 @@ SubscriberRegistry::SubscriberRegistry()
     if (!sqlite3_command(mDB,createSBTable)) {
         LOG(EMERG) << "Cannot create SIP_BUDDIES table";
     }
+	sqlite3_update_hook(mDB,SubscriberRegistryUpdateHook,this);
+	mDataVersion = sqlite3_libversion_number()>=3008008;
+	if (!mDataVersion) {
+		mFileFD = open(ldb.c_str(),O_RDONLY);
+		if (mFileFD<0) LOG(WARNING) << "cannot open " << ldb << " to watch for external writes";
+	}
+	mChangeCounter = changeCounter();
 }
 
 
 
 SubscriberRegistry::~SubscriberRegistry()
 {
-	if (mDB) sqlite3_close(mDB);
+	if (mFileFD>=0) close(mFileFD);
+	if (!mDB) return;
+	sqlite3_clear_cache(mDB);
+	sqlite3_close(mDB);
 }
 
 
@@ -180,8 +197,15 @@ SubscriberRegistry::Status SubscriberRegistry::sqlLocal(const char *query, char
 	LOG(INFO) << query;
 
 	if (!resultptr) {
-		if (!sqlite3_command(db(), query)) return FAILURE;
-		return SUCCESS;
+		ScopedLock writeLock(mWriteLock);
+		uint32_t before = changeCounter();
+		bool success = sqlite3_command(db(), query);
+		// Don't take our own write for another writer's; the file header counts both.
+		// The update hook already invalidated the rows it touched.
+		uint32_t after = changeCounter();
+		ScopedLock lock(mCacheLock);
+		if (before==mChangeCounter && after==before+1) mChangeCounter = after;
+		return success ? SUCCESS : FAILURE;
 	}
 
 	sqlite3_stmt *stmt;
@@ -209,17 +233,213 @@ SubscriberRegistry::Status SubscriberRegistry::sqlLocal(const char *query, char
 
 char *SubscriberRegistry::sqlQuery(const char *unknownColumn, const char *table, const char *knownColumn, const char *knownValue)
 {
-	char *result = NULL;
-	SubscriberRegistry::Status st;
+	string key = string(table) + '\t' + unknownColumn + '\t' + knownColumn + '\t' + knownValue;
+	unsigned generation = 0;
+	uint32_t counter = 0;
+	if (mCacheSize) {
+		// Read the counter outside of the cache lock, since the update hook takes that lock inside sqlite.
+		uint32_t current = changeCounter();
+		ScopedLock lock(mCacheLock);
+		checkExternalWrites(current);
+		CacheMap::iterator p = mCache.find(key);
+		if (p!=mCache.end() && p->second.mExpiration.passed()) {
+			mExpirations++;
+			erase(p);
+			p = mCache.end();
+		}
+		if (p!=mCache.end()) {
+			mHits++;
+			mLRU.splice(mLRU.begin(),mLRU,p->second.mLRU);
+			if (!p->second.mFound) return NULL;
+			LOG(INFO) << "cached result = " << p->second.mValue;
+			return strdup(p->second.mValue.c_str());
+		}
+		mMisses++;
+		generation = mGeneration;
+		counter = mChangeCounter;
+	}
+
+	// Get the rowid too, so that the update hook can find the entry.
 	ostringstream os;
-	os << "select " << unknownColumn << " from " << table << " where " << knownColumn << " = \"" << knownValue << "\"";
-	st = sqlLocal(os.str().c_str(), &result);
-	if (st == SUCCESS) {
-		LOG(INFO) << "result = " << result;
-		return result;
-	} else {
+	os << "select rowid, " << unknownColumn << " from " << table << " where " << knownColumn << " = ?";
+	LOG(INFO) << os.str() << " with " << knownValue;
+	sqlite3_stmt *stmt = sqlite3_cached_statement(db(),os.str().c_str());
+	if (!stmt) {
+		LOG(ERR) << "sqlite3_prepare_statement problem";
 		return NULL;
 	}
+	sqlite3_bind_text(stmt,1,knownValue,-1,SQLITE_STATIC);
+	CacheEntry entry;
+	entry.mTable = table;
+	entry.mRowID = 0;
+	entry.mFound = false;
+	char *result = NULL;
+	if (sqlite3_run_query(db(),stmt)==SQLITE_ROW) {
+		entry.mRowID = sqlite3_column_int64(stmt,0);
+		const char *column = (const char*)sqlite3_column_text(stmt,1);
+		if (!column) {
+			LOG(ERR) << "Subscriber registry returned a NULL column.";
+		} else {
+			LOG(INFO) << "result = " << column;
+			result = strdup(column);
+			entry.mFound = true;
+			entry.mValue = column;
+		}
+	}
+	sqlite3_release_statement(db(),stmt);
+	if (!mCacheSize) return result;
+
+	uint32_t current = changeCounter();
+	ScopedLock lock(mCacheLock);
+	// Don't cache a result that a write may have overtaken.
+	if (generation!=mGeneration || current!=counter) return result;
+	if (mCache.find(key)!=mCache.end()) return result;
+	while (mCache.size() && mCache.size()>=mCacheSize) {
+		mEvictions++;
+		erase(mCache.find(mLRU.back()));
+	}
+	entry.mExpiration.future(mCacheTTL*1000);
+	CacheMap::iterator p = mCache.insert(CacheMap::value_type(key,entry)).first;
+	mLRU.push_front(key);
+	p->second.mLRU = mLRU.begin();
+	return result;
+}
+
+
+
+uint32_t SubscriberRegistry::changeCounter() const
+{
+	// Newer libraries count commits by other connections, in any journal mode.
+	if (mDataVersion) {
+		sqlite3_stmt *stmt = sqlite3_cached_statement(mDB,"PRAGMA data_version");
+		if (!stmt) return 0;
+		uint32_t version = 0;
+		if (sqlite3_run_query(mDB,stmt)==SQLITE_ROW) version = sqlite3_column_int64(stmt,0);
+		sqlite3_release_statement(mDB,stmt);
+		return version;
+	}
+	// Otherwise, a big-endian 32-bit count at offset 24 of the file header,
+	// bumped by every write transaction outside of WAL mode.
+	if (mFileFD<0) return 0;
+	unsigned char header[4];
+	if (pread(mFileFD,header,4,24)!=4) return 0;
+	return (header[0]<<24) | (header[1]<<16) | (header[2]<<8) | header[3];
+}
+
+
+void SubscriberRegistry::checkExternalWrites(uint32_t counter)
+{
+	if (counter==mChangeCounter) return;
+	mChangeCounter = counter;
+	if (mCache.size()==0) return;
+	LOG(INFO) << "subscriber database changed by another writer, dropping " << mCache.size() << " cached lookups";
+	mExternalFlushes++;
+	mCache.clear();
+	mLRU.clear();
+}
+
+
+void SubscriberRegistry::erase(CacheMap::iterator p)
+{
+	mLRU.erase(p->second.mLRU);
+	mCache.erase(p);
+}
+
+
+void SubscriberRegistry::invalidate(const char* table, sqlite3_int64 rowID)
+{
+	// A changed row can only affect entries read from it, but an insert
+	// can turn any miss on its table into a hit.
+	ScopedLock lock(mCacheLock);
+	mGeneration++;
+	CacheMap::iterator p = mCache.begin();
+	while (p!=mCache.end()) {
+		CacheMap::iterator here = p++;
+		if (strcasecmp(here->second.mTable.c_str(),table)!=0) continue;
+		if (here->second.mFound && here->second.mRowID!=rowID) continue;
+		mInvalidations++;
+		erase(here);
+	}
+}
+
+
+void SubscriberRegistryUpdateHook(void* arg, int op, const char* dbName, const char* table, sqlite3_int64 rowID)
+{
+	((SubscriberRegistry*)arg)->invalidate(table,rowID);
+}
+
+
+unsigned SubscriberRegistry::preload()
+{
+	if (!mDB || mCacheSize<2) return 0;
+	Timeval start;
+	unsigned generation;
+	uint32_t counter;
+	{
+		// Read the counter outside of the cache lock, as in sqlQuery().
+		uint32_t current = changeCounter();
+		ScopedLock lock(mCacheLock);
+		checkExternalWrites(current);
+		generation = mGeneration;
+		counter = mChangeCounter;
+	}
+
+	// Read the rows without mCacheLock, as in sqlQuery().
+	// Each subscriber takes two entries, the same ones that getCLIDLocal() and getRegistrationIP() make.
+	ostringstream os;
+	os << "select rowid, name, callerid, ipaddr from sip_buddies order by regTime desc limit " << mCacheSize/2;
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_statement(mDB,&stmt,os.str().c_str())) {
+		LOG(ERR) << "sqlite3_prepare_statement problem";
+		return 0;
+	}
+	static const char* columns[] = { "callerid", "ipaddr" };
+	vector< pair<string,CacheEntry> > entries;
+	while (sqlite3_run_query(mDB,stmt)==SQLITE_ROW) {
+		const char* name = (const char*)sqlite3_column_text(stmt,1);
+		if (!name) continue;
+		for (unsigned i=0; i<2; i++) {
+			CacheEntry entry;
+			entry.mTable = "sip_buddies";
+			entry.mRowID = sqlite3_column_int64(stmt,0);
+			const char* value = (const char*)sqlite3_column_text(stmt,i+2);
+			// A NULL column is a miss in sqlQuery() too.
+			entry.mFound = value!=NULL;
+			if (value) entry.mValue = value;
+			entries.push_back(pair<string,CacheEntry>(string("sip_buddies\t") + columns[i] + "\tname\t" + name,entry));
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	uint32_t current = changeCounter();
+	ScopedLock lock(mCacheLock);
+	// Don't cache rows that a write may have overtaken, here or by another writer.
+	if (generation!=mGeneration || current!=counter) return 0;
+	Timeval expiration(mCacheTTL*1000);
+	unsigned count = 0;
+	for (unsigned i=0; i<entries.size() && mCache.size()<mCacheSize; i++) {
+		if (mCache.find(entries[i].first)!=mCache.end()) continue;
+		// The most recent registrations are the last to be evicted.
+		CacheMap::iterator p = mCache.insert(entries[i]).first;
+		p->second.mExpiration = expiration;
+		mLRU.push_back(entries[i].first);
+		p->second.mLRU = --mLRU.end();
+		count++;
+	}
+	LOG(INFO) << "preloaded " << count/2 << " subscribers in " << start.elapsed() << " ms";
+	return count/2;
+}
+
+
+
+void SubscriberRegistry::dumpCacheStats(ostream& os) const
+{
+	ScopedLock lock(mCacheLock);
+	unsigned long lookups = mHits + mMisses;
+	os << "entries " << mCache.size() << "/" << mCacheSize << " hits " << mHits << " misses " << mMisses;
+	if (lookups) os << " (" << (100*mHits)/lookups << "% hits)";
+	os << " expired " << mExpirations << " evicted " << mEvictions
+		<< " invalidated " << mInvalidations << " external flushes " << mExternalFlushes;
 }
 
 
@@ -232,6 +452,42 @@ SubscriberRegistry::Status SubscriberRegistry::sqlUpdate(const char *stmt)
 
 
 
+SubscriberRegistry::Status SubscriberRegistry::sqlBatch(const char *stmt, const vector< vector<string> >& rows)
+{
+	LOG(INFO) << stmt << " for " << rows.size() << " rows";
+	if (rows.size()==0) return SUCCESS;
+	sqlite3_stmt *prepared = sqlite3_cached_statement(db(), stmt);
+	if (!prepared) {
+		LOG(ERR) << "sqlite3_cached_statement problem";
+		return FAILURE;
+	}
+	// Other writes on this connection would join the transaction, and be lost with a rollback.
+	ScopedLock writeLock(mWriteLock);
+	uint32_t before = changeCounter();
+	bool success = sqlite3_command(db(), "BEGIN TRANSACTION");
+	for (unsigned i=0; success && i<rows.size(); i++) {
+		sqlite3_reset(prepared);
+		sqlite3_clear_bindings(prepared);
+		for (unsigned j=0; j<rows[i].size(); j++) {
+			sqlite3_bind_text(prepared, j+1, rows[i][j].c_str(), -1, SQLITE_TRANSIENT);
+		}
+		success = (sqlite3_run_query(db(), prepared) == SQLITE_DONE);
+	}
+	sqlite3_release_statement(db(), prepared);
+	if (success) success = sqlite3_command(db(), "COMMIT");
+	if (!success) {
+		LOG(ALERT) << "batch of " << rows.size() << " rows failed: " << sqlite3_errmsg(db());
+		sqlite3_command(db(), "ROLLBACK");
+	}
+	// One transaction is one change of the file header counter, like one sqlLocal() write.
+	uint32_t after = changeCounter();
+	ScopedLock lock(mCacheLock);
+	if (before==mChangeCounter && after==before+1) mChangeCounter = after;
+	return success ? SUCCESS : FAILURE;
+}
+
+
+
 char *SubscriberRegistry::getIMSI(const char *ISDN)
 {
 	if (!ISDN) {
@@ -28,21 +28,70 @@
 
 #include <map>
 #include <stdlib.h>
+#include <stdint.h>
 #include <Logger.h>
-// #include <Timeval.h>
-// #include <Threads.h>
+#include <Timeval.h>
+#include <Threads.h>
+#include <list>
 #include <map>
 #include <string>
+#include <vector>
+#include <ostream>
 #include "sqlite3.h"
 
 using namespace std;
 
+/**
+	The subscriber database, which is shared with the PBX.
+
+	Lookups go through a bounded LRU cache, negative results included.
+	Entries expire after SubscriberRegistry.Cache.TTL seconds.  Writes made
+	through this connection invalidate the rows they touch, by the sqlite
+	update hook.  Writes by other connections, such as the PBX, are found by
+	PRAGMA data_version, or on older libraries by the change counter in the
+	database file header, and they invalidate the whole cache.
+*/
 class SubscriberRegistry {
 
 	private:
 
 	sqlite3 *mDB;			///< database connection
-
+	Mutex mWriteLock;		///< held by each write on mDB, so that no write runs inside another's transaction
+
+	/** One cached lookup. */
+	class CacheEntry {
+
+		public:
+
+		std::string mTable;
+		sqlite3_int64 mRowID;				///< row the value came from, if found
+		bool mFound;
+		std::string mValue;
+		Timeval mExpiration;
+		std::list<std::string>::iterator mLRU;	///< position in mLRU
+	};
+
+	typedef std::map<std::string,CacheEntry> CacheMap;
+
+	mutable Mutex mCacheLock;	///< protects the cache and statistics
+	CacheMap mCache;			///< by table, columns and key value
+	std::list<std::string> mLRU;	///< cache keys, most recently used first
+	unsigned mCacheSize;		///< most entries, 0 to disable the cache
+	unsigned mCacheTTL;			///< entry lifetime, seconds
+	bool mDataVersion;			///< the library has PRAGMA data_version
+	int mFileFD;				///< the database file, for reading the change counter otherwise
+	uint32_t mChangeCounter;	///< the change counter when the cache was last valid
+	unsigned mGeneration;		///< bumped by each invalidation, to catch writes racing a query
+
+	/**@name Statistics, protected by mCacheLock. */
+	//@{
+	unsigned long mHits;
+	unsigned long mMisses;
+	unsigned long mExpirations;
+	unsigned long mEvictions;
+	unsigned long mInvalidations;		///< entries dropped by local writes
+	unsigned long mExternalFlushes;		///< whole cache dropped for other writers
+	//@}
 
 	public:
 
@@ -117,6 +166,33 @@ class SubscriberRegistry {
 	bool useGateway(const char* ISDN);
 
 
+	/**
+		Run an insert or update once for each row of parameters, all in one transaction.
+		@param stmt The sql statement, with a ? for each parameter.
+		@param rows The parameters for each run, bound as text; column affinity converts them.
+		@return SUCCESS if the transaction committed.
+	*/
+	Status sqlBatch(const char *stmt, const std::vector< std::vector<std::string> >& rows);
+
+	/**
+		Run an sql update.
+		@param stmt The update statement.
+	*/
+	Status sqlUpdate(const char *stmt);
+
+
+	/**
+		Fill the cache with the caller ID and registration address of the
+		subscribers that registered most recently, in one scan, so that the
+		first lookups after a restart do not each go to the disk.
+		@return The number of subscribers loaded.
+	*/
+	unsigned preload();
+
+	/** Dump cache statistics to a stream. */
+	void dumpCacheStats(std::ostream&) const;
+
+
 	private:
 
 
@@ -131,31 +207,38 @@ class SubscriberRegistry {
 
 
 	/**
-		Run an sql query (select unknownColumn from table where knownColumn = knownValue).
+		Run an sql query (select unknownColumn from table where knownColumn = knownValue),
+		through the cache.
 		@param unknownColumn The column whose value you want.
 		@param table The table to look in.
 		@param knownColumn The column with the value you know.
 		@param knownValue The known value of knownColumn.
+		@return A C-string to be freed by the caller, or NULL.
 	*/
 	char *sqlQuery(const char *unknownColumn, const char *table, const char *knownColumn, const char *knownValue);
 
-
-
 	/**
-		Run an sql update.
-		@param stmt The update statement.
+		Read a counter that changes when another connection writes the database.
+		Call this without mCacheLock, since it may run a query.
 	*/
-	Status sqlUpdate(const char *stmt);
-
-
-
+	uint32_t changeCounter() const;
 
+	/** Drop the whole cache if the change counter moved.  Caller holds mCacheLock. */
+	void checkExternalWrites(uint32_t counter);
 
+	/** Remove a cache entry.  Caller holds mCacheLock. */
+	void erase(CacheMap::iterator);
 
+	/** Invalidate the entries for a changed row.  Called from the sqlite update hook. */
+	void invalidate(const char* table, sqlite3_int64 rowID);
 
+	friend void SubscriberRegistryUpdateHook(void*,int,const char*,const char*,sqlite3_int64);
 
 };
 
+/** The sqlite update hook for the subscriber database. */
+void SubscriberRegistryUpdateHook(void*,int,const char*,const char*,sqlite3_int64);
+
 
 
 #endif
@@ -117,7 +117,8 @@ void TransceiverManager::clockHandler()
 ::ARFCNManager::ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTransceiver)
 	:mTransceiver(wTransceiver),
 	mDataSocket(wBasePort+100+1,wTRXAddress,wBasePort+1),
-	mControlSocket(wBasePort+100,wTRXAddress,wBasePort)
+	mControlSocket(wBasePort+100,wTRXAddress,wBasePort),
+	mMaxRxLag(0)
 {
 	// The default demux table is full of NULL pointers.
 	for (int i=0; i<8; i++) {
@@ -132,6 +133,7 @@ void TransceiverManager::clockHandler()
 
 void ::ARFCNManager::start()
 {
+	mDecodePool.start();
 	mRxThread.start((void*(*)(void*))ReceiveLoopAdapter,this);
 }
 
@@ -477,15 +479,33 @@ void ::ARFCNManager::receiveBurst(const RxBurst& inBurst)
 	uint32_t FN = inBurst.time().FN() % maxModulus;
 	unsigned TN = inBurst.time().TN();
 
+	// The lag shows how far the uplink is behind, for overload control.
+	int lag = gBTS.time() - inBurst.time();
 	mTableLock.lock();
 	L1Decoder *proc = mDemuxTable[TN][FN];
+	if (lag>0 && (unsigned)lag>mMaxRxLag) mMaxRxLag = lag;
+	mTableLock.unlock();
 	if (proc==NULL) {
 		LOG(DEBUG) << "ARFNManager::receiveBurst in unconfigured TDMA position TN: " << TN << " FN: " << FN << ".";
-		mTableLock.unlock();
 		return;
 	}
+	// Decoders are never uninstalled, so proc stays valid without the lock.
+	if (mDecodePool.running()) {
+		mDecodePool.post(proc,inBurst);
+		return;
+	}
+	Timeval received;
 	proc->writeLowSide(inBurst);
-	mTableLock.unlock();
+	proc->countLatency(received);
+}
+
+
+unsigned ::ARFCNManager::takeRxLag()
+{
+	ScopedLock lock(mTableLock);
+	unsigned lag = mMaxRxLag;
+	mMaxRxLag = 0;
+	return lag;
 }
 
 
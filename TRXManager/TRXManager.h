@@ -36,6 +36,7 @@
 #include "Interthread.h"
 #include "GSMCommon.h"
 #include "GSMTransfer.h"
+#include "GSML1DecodePool.h"
 #include <list>
 
 
@@ -125,8 +126,11 @@ class ARFCNManager {
 	Mutex mTableLock;
 	static const unsigned maxModulus=51*26*4;	///< maximum unified repeat period
 	GSM::L1Decoder* mDemuxTable[8][maxModulus];		///< the demultiplexing table for received bursts
+	unsigned mMaxRxLag;			///< worst burst delay since takeRxLag(), in frames
 	//@}
 
+	GSM::L1DecodePool mDecodePool;	///< optional decoder threads fed by the demux
+
 	unsigned mARFCN;						///< the current ARFCN
 
 
@@ -134,11 +138,19 @@ class ARFCNManager {
 
 	ARFCNManager(const char* wTRXAddress, int wBasePort, TransceiverManager &wTRX);
 
-	/** Start the uplink thread. */
+	/** Start the uplink thread and the decode pool, if any. */
 	void start();
 
 	unsigned ARFCN() const { return mARFCN; }
 
+	const GSM::L1DecodePool& decodePool() const { return mDecodePool; }
+
+	/**
+		Return the worst delay of a received burst behind the BTS clock,
+		in frames, since the last call, and start over.
+	*/
+	unsigned takeRxLag();
+
 	void writeHighSide(const GSM::TxBurst& burst);
 
 
@@ -40,6 +40,7 @@ ConfigurationTable gConfig("/etc/OpenBTS/OpenBTS.db");
 
 #include <ControlCommon.h>
 #include <TransactionTable.h>
+#include <SMSSpool.h>
 
 #include <SIPInterface.h>
 #include <Globals.h>
@@ -94,6 +95,9 @@ TransceiverManager gTRX(gConfig.getStr("TRX.IP").c_str(), gConfig.getNum("TRX.Po
 // Subscriber registry
 SubscriberRegistry gSubscriberRegistry;
 
+// The MT-SMS spool, off unless SMS.Spool names a file.
+Control::SMSSpool gSMSSpool;
+
 
 /** Define a function to call any time the configuration database changes. */
 void purgeConfig(void*,int,char const*, char const*, sqlite3_int64)
@@ -105,6 +109,48 @@ void purgeConfig(void*,int,char const*, char const*, sqlite3_int64)
 
 
 
+/**@name Warm-load tasks, run in parallel at startup. */
+//@{
+void* loadTMSITable(void*)
+{
+	gTMSITable.load();
+	return NULL;
+}
+
+void* preloadSubscribers(void*)
+{
+	gSubscriberRegistry.preload();
+	return NULL;
+}
+
+void* openSMSSpool(void*)
+{
+	gSMSSpool.open();
+	return NULL;
+}
+//@}
+
+
+/**
+	Load the control-plane state into memory before anything uses it.
+	The configuration cache was loaded when gConfig was built.
+	The loads use separate databases and files, so they run in parallel.
+*/
+void warmLoad()
+{
+	Timeval start;
+	Thread threads[3];
+	threads[0].start(loadTMSITable,NULL);
+	threads[1].start(preloadSubscribers,NULL);
+	threads[2].start(openSMSSpool,NULL);
+	for (unsigned i=0; i<3; i++) threads[i].join();
+	long elapsed = start.elapsed();
+	gBTS.warmLoadTime(elapsed);
+	LOG(NOTICE) << "warm load took " << elapsed << " ms";
+}
+
+
+
 const char* transceiverPath = "./transceiver";
 
 pid_t gTransceiverPid = 0;
@@ -145,9 +191,19 @@ int main(int argc, char *argv[])
 
 	startTransceiver();
 
+	// Load the TMSI table and the subscriber cache while the transceiver starts,
+	// and recover any spooled MT-SMS before SIP can add more.
+	warmLoad();
+
 	// Start the SIP interface.
 	gSIPInterface.start();
 
+	// Start writing the channel status table.
+	gPhysStatus.start();
+
+	// Start writing the TMSI table.
+	gTMSITable.start();
+
 
 	//
 	// Configure the radio.
@@ -229,10 +285,9 @@ int main(int argc, char *argv[])
 		SDCCHLogicalChannel(0,gSDCCH_4_2),
 		SDCCHLogicalChannel(0,gSDCCH_4_3),
 	};
-	Thread C0T0SDCCHControlThread[4];
 	for (int i=0; i<4; i++) {
 		C0T0SDCCH[i].downstream(C0radio);
-		C0T0SDCCHControlThread[i].start((void*(*)(void*))Control::DCCHDispatcher,&C0T0SDCCH[i]);
+		Control::startSDCCHDispatcher(&C0T0SDCCH[i]);
 		C0T0SDCCH[i].open();
 		gBTS.addSDCCH(&C0T0SDCCH[i]);
 	}
@@ -301,7 +356,8 @@ int main(int argc, char *argv[])
 
 	// Set up the pager.
 	// Set up paging channels.
-	// HACK -- For now, use a single paging channel, since paging groups are broken.
+	// With BS_AG_BLKS_RES=2 on a combined CCCH, the only paging block is CCCH2.
+	// The pager sorts pages into the paging subchannels on it.
 	gBTS.addPCH(&CCCH2);
 
 	// Be sure we are not over-reserving.
@@ -310,6 +366,9 @@ int main(int argc, char *argv[])
 	// OK, now it is safe to start the BTS.
 	gBTS.start();
 
+	// Start paging for spooled MT-SMS.
+	gSMSSpool.start();
+
 #ifdef HAVE_LIBREADLINE // [
 	// start console
 	using_history();
@@ -378,6 +437,9 @@ int main(int argc, char *argv[])
 	}
 #endif // HAVE_LIBREADLINE ]
 
+	// Leave a current snapshot for a fast start next time.
+	gTMSITable.flush(true);
+
 	if (gTransceiverPid) kill(gTransceiverPid, SIGKILL);
 
 
@@ -2,7 +2,12 @@ PRAGMA foreign_keys=OFF;
 BEGIN TRANSACTION;
 CREATE TABLE CONFIG ( KEYSTRING TEXT UNIQUE NOT NULL, VALUESTRING TEXT, STATIC INTEGER DEFAULT 0, OPTIONAL INTEGER DEFAULT 0, COMMENTS TEXT DEFAULT '');
 INSERT INTO "CONFIG" VALUES('CLI.Prompt','OpenBTS> ',0,0,'Prompt for the OpenBTS command line interface.');
+INSERT INTO "CONFIG" VALUES('Control.Reporting.LocationFlush','1000',0,0,'Interval for writing queued RRLP position fixes to the RRLP table of the subscriber registry, in ms.  Each write is one transaction.');
+INSERT INTO "CONFIG" VALUES('Control.Reporting.PhysStatusFlush','2000',0,0,'Interval for writing the latest channel status to the reporting database, in ms.');
 INSERT INTO "CONFIG" VALUES('Control.Reporting.PhysStatusTable','/var/run/OpenBTS/ChannelTable.db',1,0,'File path for channel status reporting database.  Static.');
+INSERT INTO "CONFIG" VALUES('Control.Reporting.TMSIFlush','2000',0,0,'Interval for writing changes to the TMSI table database, in ms.');
+INSERT INTO "CONFIG" VALUES('Control.Reporting.TMSISnapshot','/var/run/OpenBTS/TMSITable.snapshot',0,1,'If defined, the file for a snapshot of the TMSI table, which loads faster than the database at startup.  A snapshot is used only if the database was not written after it.');
+INSERT INTO "CONFIG" VALUES('Control.Reporting.TMSISnapshotInterval','300',0,0,'Interval for writing the TMSI table snapshot, in seconds.  A snapshot is also written at a clean shutdown.');
 INSERT INTO "CONFIG" VALUES('Control.Reporting.TMSITable','/var/run/OpenBTS/TMSITable.db',1,0,'File path for TMSITable database.  Static.');
 INSERT INTO "CONFIG" VALUES('Control.GSMTAP.TargetIP','127.0.0.1',0,1,'Target IP address for GSMTAP packets; the IP address of Wireshark, if you use it for GSM.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.AttachDetach',1,0,0,'Attach/detach flag.  Set to 1 to use attach/detach procedure, 0 otherwise.  This will make initial LUR more prompt.  It will also cause an un-regstration if the handset powers off and really heavy LUR loads in areas with spotty coverage.');
@@ -13,16 +18,29 @@ INSERT INTO "CONFIG" VALUES('Control.LUR.NormalRegistration.ShortCode','0000',0,
 INSERT INTO "CONFIG" VALUES('Control.LUR.OpenRegistration',NULL,0,1,'If not NULL, allow unprovisioned handsets to attach in Um.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.OpenRegistration.Message','Welcome to the GSM test network.  Your IMSI is ',0,1,'If defined, send this text message, followed by the IMSI, to unprovisioned handsets when they attach on Um due to open registration.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.OpenRegistration.ShortCode','101',0,1,'The return address for the open registration message.  If the message is defined, this must also be defined.');
+INSERT INTO "CONFIG" VALUES('Control.LUR.Pipeline',NULL,0,1,'How location updating gets the SIP registration result.  NULL or 0 registers while holding the SDCCH.  1 answers a subscriber registered within Control.LUR.Pipeline.MaxAge with the cached result and refreshes the registration after the channel is released.  2 also accepts subscribers with no cached result, refusing them at their next location update if the registrar does.  The load command reports the cache.');
+INSERT INTO "CONFIG" VALUES('Control.LUR.Pipeline.MaxAge','3600',0,0,'Age, in seconds, beyond which a cached SIP registration result is not used.');
+INSERT INTO "CONFIG" VALUES('Control.LUR.Pipeline.Threads','4',1,0,'Number of threads refreshing SIP registrations in the background.  Static.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.QueryClassmark',NULL,0,1,'If not NULL, query every MS for classmark during LUR.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.QueryIMEI',NULL,0,1,'If not NULL, query every MS for IMSI during LUR.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.QueryRRLP',NULL,0,1,'If not NULL, query every MS for its location via RRLP during LUR.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.SendTMSIs',NULL,0,1,'If not NULL, send new TMSI assignments to handsets that are allowed to attach.');
 INSERT INTO "CONFIG" VALUES('Control.LUR.UnprovisionedRejectCause','0x04',0,0,'Reject cause for location updating failures for unprovisioned phones.  Reject causes come from GSM 04.08 10.5.3.6.  Reject cause 0x04, IMSI not in VLR, is usually the right one.');
 INSERT INTO "CONFIG" VALUES('Control.NumSQLTries','3',0,0,'Number of times to retry SQL queries before declaring a database access failure.');
+INSERT INTO "CONFIG" VALUES('Control.Overload',NULL,1,1,'If not NULL, sample the internal queue depths and throttle admissions under overload: longer T3122 and deferred SMS, then LUR rejection, then access class barring.  The load command reports the overload level.  Static.');
+INSERT INTO "CONFIG" VALUES('Control.Overload.AGCH','10',0,0,'AGCH backlog, in messages, at which overload control starts.  Twice this is severe overload.  0 ignores the AGCH.');
+INSERT INTO "CONFIG" VALUES('Control.Overload.DecodeDepth','64',0,0,'L1 decode pool backlog, in bursts, at which overload control starts.  0 ignores the decode pool.');
+INSERT INTO "CONFIG" VALUES('Control.Overload.Period','500',0,0,'Interval for sampling the overload indicators, in ms.');
+INSERT INTO "CONFIG" VALUES('Control.Overload.Recovery','10',0,0,'Number of calmer samples in a row before overload control steps down one level.');
+INSERT INTO "CONFIG" VALUES('Control.Overload.RxLag','20',0,0,'Delay of uplink bursts behind the BTS clock, in frames, at which overload control starts.  This includes the normal transceiver latency.  0 ignores the uplink delay.');
+INSERT INTO "CONFIG" VALUES('Control.Overload.SIP','50',0,0,'Unread inbound SIP messages at which overload control starts.  0 ignores the SIP backlog.');
+INSERT INTO "CONFIG" VALUES('Control.Overload.Transactions','200',0,0,'Transaction table size at which overload control starts.  0 ignores the transaction count.');
 INSERT INTO "CONFIG" VALUES('Control.TMSITable.MaxAge','72',0,0,'Maximum allowed age for a TMSI in hours.');
 INSERT INTO "CONFIG" VALUES('Control.TMSITable.MaxSize','100000',0,0,'Maximum size of TMSI table before oldest TMSIs are discarded.');
+INSERT INTO "CONFIG" VALUES('Control.Tasks',NULL,1,1,'If not NULL, run the SDCCH dispatchers as coroutine tasks on a small thread pool instead of one thread per channel.  TCH dispatchers still get their own threads.  The load command reports the task pool.  Static.');
+INSERT INTO "CONFIG" VALUES('Control.Tasks.Threads','2',1,0,'Number of threads running the SDCCH dispatcher tasks.  Static.');
 INSERT INTO "CONFIG" VALUES('Control.VEA',1,0,1,'If not NULL, user very early assignment for speech call establishment.  See GSM 04.08 Section 7.3.2 for a detailed explanation of assignment types. If VEA is selected, GSM.CellSelection.NECI should be set to 1.  See GSM 04.08 Sections 9.1.8 and 10.5.2.4 for an explanation of the NECI bit.');
-INSERT INTO "CONFIG" VALUES('GSM.CCCH.AGCH.QMax','5',0,0,'Maximum number of access grants to be queued for transmission on AGCH before declaring congrestion.');
+INSERT INTO "CONFIG" VALUES('GSM.CCCH.AGCH.QMax','5',0,0,'Maximum number of AGCH blocks to be queued for transmission before declaring congestion.  Under congestion, RACH bursts other than emergency calls and paging responses are rejected.');
 INSERT INTO "CONFIG" VALUES('GSM.CCCH.CCCH-CONF','1',0,0,'CCCH configuration type.  See GSM 10.5.2.11 for encoding.  Value of 1 means we are using a C-V beacon.  Any other value selects a C-IV beacon.');
 INSERT INTO "CONFIG" VALUES('GSM.CCCH.PCH.Reserve','0',0,0,'Number of CCCH subchannels to reserve for paging.');
 INSERT INTO "CONFIG" VALUES('GSM.CellSelection.CELL-RESELECT-HYSTERESIS','3',0,0,'Cell Reselection Hysteresis.  See GSM 04.08 10.5.2.4, Table 10.5.23 for encoding.  Encoding is $2N$ dB, values of $N$ are 0...7 for 0...14 dB.');
@@ -34,6 +52,7 @@ INSERT INTO "CONFIG" VALUES('GSM.CellSelection.RXLEV-ACCESS-MIN','0',0,0,'Cell s
 INSERT INTO "CONFIG" VALUES('GSM.Channels.C1sFirst',NULL,1,0,'If not NULL, allocate C-I slots first, starting at C0T1.  Otherwise, allocate C-VII slots first.  Static.');
 INSERT INTO "CONFIG" VALUES('GSM.Channels.NumC1s','5',1,0,'Number of Combination-I timeslots to configure.  The C-I slot carries a single full-rate TCH, used for speech calling.  Static.');
 INSERT INTO "CONFIG" VALUES('GSM.Channels.NumC7s','0',1,0,'Number of Combination-VII timeslots to configure.  The C-VII slot carries 8 SDCCHs, useful to handle high registration loads or SMS.  If C0T0 is C-IV, you must have at least one C-VII also.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.Channels.SelectionPolicy','spread',1,0,'How to pick a free SDCCH, TCH or PDTCH: "spread" uses the timeslot with the fewest active channels, "packed" fills timeslots in order, "roundrobin" takes timeslots in turn.  Static.');
 INSERT INTO "CONFIG" VALUES('GSM.Identity.BSIC.BCC','2',0,0,'GSM basestation color code; lower 3 bits of the BSIC.  BCC values in a multi-BTS network should be assigned so that BTS units with overlapping coverage do not share a BCC.  This value will also select the training sequence used for all slots on this unit.');
 INSERT INTO "CONFIG" VALUES('GSM.Identity.BSIC.NCC','0',0,0,'GSM network color code; upper 3 bits of the BSIC.  Assigned by your national regulator.  Must be distinct from NCCs of other GSM operators in your area.');
 INSERT INTO "CONFIG" VALUES('GSM.Identity.CI','10',0,0,'Cell ID, 16 bits.  Should be unique.');
@@ -42,6 +61,13 @@ INSERT INTO "CONFIG" VALUES('GSM.Identity.MCC','001',0,0,'Mobile country code, 2
 INSERT INTO "CONFIG" VALUES('GSM.Identity.MNC','01',0,0,'Mobile network code; Must be 3 dgits.  Assigned by your national regulator.');
 INSERT INTO "CONFIG" VALUES('GSM.Identity.ShortName','Range',0,1,'Network short name, displayed on some phones.  Optional but must be defined if you also want the network to send time-of-day.');
 INSERT INTO "CONFIG" VALUES('GSM.Identity.ShowCountry',1,0,0,'If not NULL, tell the phone to show the country name based on the MCC.');
+INSERT INTO "CONFIG" VALUES('GSM.L1DecodePool',NULL,1,1,'If not NULL, run the uplink L1 decoders on a pool of worker threads fed by the receive demux instead of on the receive thread itself.  Bursts for a given channel are always decoded in order.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.L1DecodePool.Workers','2',1,0,'Number of worker threads in the L1 decode pool, 1-8.  Channels are spread across the workers.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.L1Scheduler',NULL,1,1,'If not NULL, drive the FCCH, SCH, BCCH, TCH/FACCH and PDTCH encoders from a single frame-tick scheduler and a small worker pool instead of one thread per encoder.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.L1Scheduler.CPUs',NULL,1,1,'Optional space-separated list of CPU numbers for pinning the L1 scheduler workers.  Worker N is pinned to the Nth entry, wrapping around.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.L1Scheduler.Workers','2',1,0,'Number of worker threads in the L1 scheduler pool, 1-8.  Timeslots are spread across the workers.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.LAPDm.Reactor',NULL,1,1,'If not NULL, service the LAPDm links from a small thread pool and a shared T200 timer wheel instead of one thread per link.  The load command reports the thread count and context switches for comparison.  Static.');
+INSERT INTO "CONFIG" VALUES('GSM.LAPDm.Reactor.Threads','2',1,0,'Number of threads in the LAPDm reactor pool, 1-16.  Static.');
 INSERT INTO "CONFIG" VALUES('GSM.MS.Power.Damping','50',0,0,'Damping value for MS power control loop.');
 INSERT INTO "CONFIG" VALUES('GSM.MS.Power.Max','33',0,0,'Maximum commanded MS power level in dBm.');
 INSERT INTO "CONFIG" VALUES('GSM.MS.Power.Min','5',0,0,'Minimum commanded MS power level in dBm.');
@@ -61,6 +87,7 @@ INSERT INTO "CONFIG" VALUES('GSM.RRLP.RESPONSETIME','4',0,0,'Mobile timeout. (Op
 INSERT INTO "CONFIG" VALUES('GSM.RRLP.SEED.ALTITUDE','0',0,0,'Seed altitude in meters wrt geoidal surface.');
 INSERT INTO "CONFIG" VALUES('GSM.RRLP.SEED.LATITUDE','37.357331',0,0,'Seed latitude in degrees.  -90 (south pole) .. +90 (north pole)');
 INSERT INTO "CONFIG" VALUES('GSM.RRLP.SEED.LONGITUDE','-122.037807',0,0,'Seed longitude in degrees.  -180 (west of greenwich) .. 180 (east)');
+INSERT INTO "CONFIG" VALUES('GSM.RRLP.SERVER.TIMEOUT','10000',0,0,'Limit for each request to the RRLP server, in ms.  Connections to the server are kept open between requests.');
 INSERT INTO "CONFIG" VALUES('GSM.RRLP.SERVER.URL','http://localhost/cgi/rrlpserver.cgi',0,0,'URL of RRLP server.');
 INSERT INTO "CONFIG" VALUES('GSM.RRLP.ALMANAC.ASSIST.PRESENT','0',0,0,'1=send almanac info to mobile; 0=do not');
 INSERT INTO "CONFIG" VALUES('GSM.RRLP.EPHEMERIS.ASSIST.COUNT','9',0,0,'number of satellites to include in navigation model');
@@ -75,6 +102,8 @@ INSERT INTO "CONFIG" VALUES('GSM.Radio.PowerManager.SamplePeriod','2000',0,0,'Sa
 INSERT INTO "CONFIG" VALUES('GSM.Radio.PowerManager.TargetT3122','5000',0,0,'Target value for T3122, the random access hold-off timer, for the power control loop.');
 INSERT INTO "CONFIG" VALUES('GSM.Radio.RxGain','47',1,0,'Receiver gain setting in dB.  Ideal value is dictacted by the hardware.  This database parameter is static but the receiver gain can be modified in real time with the CLI rxgain command.  Static.');
 INSERT INTO "CONFIG" VALUES('GSM.Radio.RSSITarget','-50',0,0,'Target uplink RSSI for MS power control loop, in dB wrt to A/D full scale.  Should be 6-10 dB above the noise floor.');
+INSERT INTO "CONFIG" VALUES('GSM.SoftCombining',NULL,0,1,'If not NULL, keep the soft bits of SDCCH, SACCH and FACCH blocks that fail the parity check and combine them with the next failed block on the same channel, to recover repetitions and retransmissions.');
+INSERT INTO "CONFIG" VALUES('GSM.SoftCombining.Window','416',0,0,'Maximum age, in TDMA frames, of a saved block for soft combining.  The default covers SACCH repetition and one LAPDm T200 retransmission.');
 INSERT INTO "CONFIG" VALUES('GSM.Timer.T3113','10000',0,0,'Paging timer T3113 in ms.  This is the timeout for a handset to respond to a paging request.  This should usually be the same as SIP.Timer.B in your VoIP network.');
 INSERT INTO "CONFIG" VALUES('GSM.Timer.T3122Max','255000',0,0,'Maximum allowed value for T3122, the RACH holdoff timer, in milliseconds.');
 INSERT INTO "CONFIG" VALUES('GSM.Timer.T3122Min','2000',0,0,'Minimum allowed value for T3122, the RACH holdoff timer, in milliseconds.');
@@ -110,7 +139,18 @@ INSERT INTO "CONFIG" VALUES('SIP.Timer.I','500',0,0,'ACK retransmit period in ms
 INSERT INTO "CONFIG" VALUES('SMS.DefaultDestSMSC','0000',0,0,'Use this to fill in L4 SMSC address in SMS submission.');
 INSERT INTO "CONFIG" VALUES('SMS.FakeSrcSMSC','0000',0,0,'Use this to fill in L4 SMSC address in SMS delivery.');
 INSERT INTO "CONFIG" VALUES('SMS.MIMEType','application/vnd.3gpp.sms',0,0,'This is the MIME Type that OpenBTS will use for RFC-3428 SIP MESSAGE payloads.  Valid values are "application/vnd.3gpp.sms" and "text/plain".');
+INSERT INTO "CONFIG" VALUES('SMS.MaxPerSession','10',0,0,'Maximum number of MT-SMS delivered on one channel before it is released.  Messages waiting in the spool or in other paging transactions for the same subscriber go out on the channel the first page brought up.');
+INSERT INTO "CONFIG" VALUES('SMS.Spool',NULL,1,1,'If defined, the file that holds MT-SMS accepted from SIP until they are delivered.  Each SIP MESSAGE is answered as soon as it is written here, and the spool pages the handset and delivers its messages in order, retrying until SMS.Spool.MaxAge.  If not defined, MT-SMS are delivered while the SIP MESSAGE waits.  Static.');
+INSERT INTO "CONFIG" VALUES('SMS.Spool.MaxAge','172800',0,0,'Spooled MT-SMS not delivered in this many seconds are discarded.');
+INSERT INTO "CONFIG" VALUES('SMS.Spool.MaxPaging','8',0,0,'Maximum number of handsets paged for spooled MT-SMS at one time.');
+INSERT INTO "CONFIG" VALUES('SMS.Spool.PageRate','4',0,0,'Maximum rate of new pages for spooled MT-SMS, per second.');
+INSERT INTO "CONFIG" VALUES('SMS.Spool.RetryInterval','60',0,0,'Seconds to wait before paging a handset again after a delivery attempt that got nothing through.');
+INSERT INTO "CONFIG" VALUES('SMS.Spool.Size','16',1,0,'Size of the SMS spool file in MB.  The file is compacted when full, and grows if the waiting messages need it.  Static.');
+INSERT INTO "CONFIG" VALUES('SMS.Spool.Sync','1',0,0,'If 1, each spooled MT-SMS is synced to disk before the SIP MESSAGE is answered.');
 INSERT INTO "CONFIG" VALUES('GPRS.TS','7',0,0,'Timeslot for GPRS channels. You should check GSM Channel configuration, timeslot for GPRS must be free.');
+INSERT INTO "CONFIG" VALUES('GPRS.CS.Max','4',0,0,'Highest coding scheme (1..4) that link adaptation will recommend for the PDTCH downlink.');
+INSERT INTO "CONFIG" VALUES('GPRS.CS.FERDown','10',0,0,'PDTCH uplink FER, in percent, above which link adaptation steps down one coding scheme.');
+INSERT INTO "CONFIG" VALUES('GPRS.CS.FERUp','2',0,0,'PDTCH uplink FER, in percent, below which link adaptation steps up one coding scheme.');
 INSERT INTO "CONFIG" VALUES('GPRS.SI3.RA_COLOUR','0',0,0,'RA_COLOUR');
 INSERT INTO "CONFIG" VALUES('GPRS.SI3.SI13_POSITION','0',0,0,'SI13_POSITION');
 INSERT INTO "CONFIG" VALUES('GPRS.SI13.BCCH_CHANGE_MARK','3',0,0,'BCCH_CHANGE_MARK');
@@ -153,6 +193,8 @@ INSERT INTO "CONFIG" VALUES('GPRS.IA.GAMMA','0',0,0,'GAMMA');
 INSERT INTO "CONFIG" VALUES('GPRS.IA.TIMING_ADVANCE_INDEX_FLAG','0',0,0,'TIMING_ADVANCE_INDEX_FLAG');
 INSERT INTO "CONFIG" VALUES('GPRS.IA.TIMING_ADVANCE_INDEX','12',0,0,'TIMING_ADVANCE_INDEX');
 INSERT INTO "CONFIG" VALUES('GPRS.IA.TBF_STARTING_TIME_FLAG','0',0,0,'TBF_STARTING_TIME_FLAG');
+INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Cache.Size','1000',1,0,'Number of subscriber lookups to cache, 0 to disable the cache.  Static.');
+INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Cache.TTL','60',1,0,'Lifetime of a cached subscriber lookup, in seconds.  Static.');
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Manager.Title','Subscriber Registry',0,0,'Title of subscriber registry database manager web page.');
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Manager.Url','http://127.0.0.1/cgi/srmanager.cgi',0,0,'URL of the subscriber registry database manager.');
 INSERT INTO "CONFIG" VALUES('SubscriberRegistry.Manager.VisibleColumns','name username type context host',0,0,'Field names in subscriber registry visible in the database manager.');
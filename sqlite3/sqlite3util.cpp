@@ -10,11 +10,102 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <pthread.h>
+
+#include <map>
+#include <string>
 
 
 // Wrappers to sqlite operations.
 // These will eventually get moved to commonlibs.
 
+
+
+/**@name The statement cache and counters, protected by gCacheLock. */
+//@{
+
+/** Most statements cached for one connection. */
+static const unsigned maxCachedStatements = 64;
+
+/** An idle statement in the cache. */
+struct CachedStatement {
+	sqlite3_stmt *stmt;
+	unsigned long lastUse;
+};
+
+/** Idle statements by SQL text.  A query can have several if it is used by several threads. */
+typedef std::multimap<std::string,CachedStatement> StatementMap;
+typedef std::map<sqlite3*,StatementMap> ConnectionMap;
+
+static pthread_mutex_t gCacheLock = PTHREAD_MUTEX_INITIALIZER;
+static ConnectionMap *gCache = NULL;		///< built on first use, since users are static objects too
+static unsigned long gUseCounter = 0;
+
+static unsigned long gPrepares = 0;
+static unsigned long gHits = 0;
+static unsigned long gEvictions = 0;
+static unsigned long gContended = 0;		///< statements that found the database locked
+static unsigned long gBusyWaits = 0;		///< waits in the busy handler
+static unsigned long gBusyMs = 0;			///< total time in those waits
+static unsigned long gTimeouts = 0;			///< busy timeouts
+//@}
+
+
+
+/**
+	Busy handler that waits in short steps, like the sqlite default,
+	but counts the contention.  The argument is the timeout in ms.
+*/
+static int sqlite3_counting_busy_handler(void *arg, int count)
+{
+	static const int delays[] = { 1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100 };
+	static const int numDelays = sizeof(delays)/sizeof(delays[0]);
+	int timeout = (int)(size_t)arg;
+	int delay, prior;
+	if (count<numDelays) {
+		delay = delays[count];
+		prior = 0;
+		for (int i=0; i<count; i++) prior += delays[i];
+	} else {
+		delay = delays[numDelays-1];
+		prior = 0;
+		for (int i=0; i<numDelays; i++) prior += delays[i];
+		prior += (count-numDelays)*delay;
+	}
+	if (prior+delay > timeout) {
+		delay = timeout - prior;
+		if (delay<=0) return 0;
+	}
+	pthread_mutex_lock(&gCacheLock);
+	if (count==0) gContended++;
+	gBusyWaits++;
+	gBusyMs += delay;
+	pthread_mutex_unlock(&gCacheLock);
+	// sqlite3_sleep() rounds up to whole seconds when sqlite is built without usleep.
+	usleep(delay*1000);
+	return 1;
+}
+
+
+bool sqlite3_setup(sqlite3* DB, unsigned busyTimeout)
+{
+	sqlite3_busy_handler(DB,sqlite3_counting_busy_handler,(void*)(size_t)busyTimeout);
+	// Older libraries answer with the current mode rather than an error.
+	bool WAL = false;
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_statement(DB,&stmt,"PRAGMA journal_mode=WAL")) return false;
+	if (sqlite3_run_query(DB,stmt)==SQLITE_ROW) {
+		const char* mode = (const char*)sqlite3_column_text(stmt,0);
+		WAL = mode && strcasecmp(mode,"wal")==0;
+	}
+	sqlite3_finalize(stmt);
+	// With WAL, a commit is atomic and durable through an application crash
+	// without a sync on every transaction.
+	if (WAL) sqlite3_command(DB,"PRAGMA synchronous=NORMAL");
+	return WAL;
+}
+
+
 int sqlite3_prepare_statement(sqlite3* DB, sqlite3_stmt **stmt, const char* query)
 {
 	int prc = sqlite3_prepare_v2(DB,query,strlen(query),stmt,NULL);
@@ -25,13 +116,96 @@ int sqlite3_prepare_statement(sqlite3* DB, sqlite3_stmt **stmt, const char* quer
 	return prc;
 }
 
+
+sqlite3_stmt* sqlite3_cached_statement(sqlite3* DB, const char* query)
+{
+	pthread_mutex_lock(&gCacheLock);
+	if (!gCache) gCache = new ConnectionMap;
+	StatementMap& cache = (*gCache)[DB];
+	StatementMap::iterator p = cache.find(query);
+	if (p!=cache.end()) {
+		sqlite3_stmt *stmt = p->second.stmt;
+		cache.erase(p);
+		gHits++;
+		pthread_mutex_unlock(&gCacheLock);
+		return stmt;
+	}
+	gPrepares++;
+	pthread_mutex_unlock(&gCacheLock);
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_statement(DB,&stmt,query)) return NULL;
+	return stmt;
+}
+
+
+void sqlite3_release_statement(sqlite3* DB, sqlite3_stmt *stmt)
+{
+	if (!stmt) return;
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	sqlite3_stmt *evicted = NULL;
+	pthread_mutex_lock(&gCacheLock);
+	if (!gCache) gCache = new ConnectionMap;
+	StatementMap& cache = (*gCache)[DB];
+	if (cache.size()>=maxCachedStatements) {
+		// Drop the least recently used.
+		StatementMap::iterator oldest = cache.begin();
+		for (StatementMap::iterator p=cache.begin(); p!=cache.end(); ++p) {
+			if (p->second.lastUse<oldest->second.lastUse) oldest = p;
+		}
+		evicted = oldest->second.stmt;
+		cache.erase(oldest);
+		gEvictions++;
+	}
+	CachedStatement entry;
+	entry.stmt = stmt;
+	entry.lastUse = ++gUseCounter;
+	cache.insert(StatementMap::value_type(sqlite3_sql(stmt),entry));
+	pthread_mutex_unlock(&gCacheLock);
+	if (evicted) sqlite3_finalize(evicted);
+}
+
+
+void sqlite3_clear_cache(sqlite3* DB)
+{
+	pthread_mutex_lock(&gCacheLock);
+	ConnectionMap::iterator c;
+	if (gCache && (c=gCache->find(DB))!=gCache->end()) {
+		for (StatementMap::iterator p=c->second.begin(); p!=c->second.end(); ++p) {
+			sqlite3_finalize(p->second.stmt);
+		}
+		gCache->erase(c);
+	}
+	pthread_mutex_unlock(&gCacheLock);
+}
+
+
+void sqlite3_dump_stats(std::ostream& os)
+{
+	pthread_mutex_lock(&gCacheLock);
+	unsigned cached = 0;
+	if (gCache) {
+		for (ConnectionMap::const_iterator c=gCache->begin(); c!=gCache->end(); ++c) cached += c->second.size();
+	}
+	os << "cached " << cached << " hits " << gHits << " prepares " << gPrepares << " evictions " << gEvictions
+		<< " contended " << gContended << " busy waits " << gBusyWaits << " (" << gBusyMs << " ms)"
+		<< " timeouts " << gTimeouts;
+	pthread_mutex_unlock(&gCacheLock);
+}
+
+
 int sqlite3_run_query(sqlite3* DB, sqlite3_stmt *stmt)
 {
+	// The busy handler does the waiting, so only a timeout comes back as SQLITE_BUSY.
 	int src = SQLITE_BUSY;
 	while (src==SQLITE_BUSY) {
 		src = sqlite3_step(stmt);
 		if (src==SQLITE_BUSY) {
-			usleep(100000);
+			pthread_mutex_lock(&gCacheLock);
+			gTimeouts++;
+			pthread_mutex_unlock(&gCacheLock);
+			fprintf(stderr,"sqlite3_run_query timed out on a locked database, retrying\n");
+			sqlite3_reset(stmt);
 		}
 	}
 	if ((src!=SQLITE_DONE) && (src!=SQLITE_ROW)) {
@@ -44,15 +218,16 @@ int sqlite3_run_query(sqlite3* DB, sqlite3_stmt *stmt)
 bool sqlite3_exists(sqlite3* DB, const char *tableName,
 		const char* keyName, const char* keyData)
 {
-	size_t stringSize = 100 + strlen(tableName) + strlen(keyName) + strlen(keyData);
+	size_t stringSize = 100 + strlen(tableName) + strlen(keyName);
 	char query[stringSize];
-	sprintf(query,"SELECT * FROM %s WHERE %s == \"%s\"",tableName,keyName,keyData);
-	// Prepare the statement.
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
+	sprintf(query,"SELECT 1 FROM %s WHERE %s == ?",tableName,keyName);
+	// Get the statement.
+	sqlite3_stmt *stmt = sqlite3_cached_statement(DB,query);
+	if (!stmt) return false;
+	sqlite3_bind_text(stmt,1,keyData,-1,SQLITE_STATIC);
 	// Read the result.
 	int src = sqlite3_run_query(DB,stmt);
-	sqlite3_finalize(stmt);
+	sqlite3_release_statement(DB,stmt);
 	// Anything there?
 	return (src == SQLITE_ROW);
 }
@@ -63,12 +238,13 @@ bool sqlite3_single_lookup(sqlite3* DB, const char *tableName,
 		const char* keyName, const char* keyData,
 		const char* valueName, unsigned &valueData)
 {
-	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName) + strlen(keyData);
+	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName);
 	char query[stringSize];
-	sprintf(query,"SELECT %s FROM %s WHERE %s == \"%s\"",valueName,tableName,keyName,keyData);
-	// Prepare the statement.
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
+	sprintf(query,"SELECT %s FROM %s WHERE %s == ?",valueName,tableName,keyName);
+	// Get the statement.
+	sqlite3_stmt *stmt = sqlite3_cached_statement(DB,query);
+	if (!stmt) return false;
+	sqlite3_bind_text(stmt,1,keyData,-1,SQLITE_STATIC);
 	// Read the result.
 	int src = sqlite3_run_query(DB,stmt);
 	bool retVal = false;
@@ -76,7 +252,7 @@ bool sqlite3_single_lookup(sqlite3* DB, const char *tableName,
 		valueData = (unsigned)sqlite3_column_int64(stmt,0);
 		retVal = true;
 	}
-	sqlite3_finalize(stmt);
+	sqlite3_release_statement(DB,stmt);
 	return retVal;
 }
 
@@ -87,12 +263,13 @@ bool sqlite3_single_lookup(sqlite3* DB, const char* tableName,
 		const char* valueName, char* &valueData)
 {
 	valueData=NULL;
-	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName) + strlen(keyData);
+	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName);
 	char query[stringSize];
-	sprintf(query,"SELECT %s FROM %s WHERE %s == \"%s\"",valueName,tableName,keyName,keyData);
-	// Prepare the statement.
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
+	sprintf(query,"SELECT %s FROM %s WHERE %s == ?",valueName,tableName,keyName);
+	// Get the statement.
+	sqlite3_stmt *stmt = sqlite3_cached_statement(DB,query);
+	if (!stmt) return false;
+	sqlite3_bind_text(stmt,1,keyData,-1,SQLITE_STATIC);
 	// Read the result.
 	int src = sqlite3_run_query(DB,stmt);
 	bool retVal = false;
@@ -101,7 +278,7 @@ bool sqlite3_single_lookup(sqlite3* DB, const char* tableName,
 		if (ptr) valueData = strdup(ptr);
 		retVal = true;
 	}
-	sqlite3_finalize(stmt);
+	sqlite3_release_statement(DB,stmt);
 	return retVal;
 }
 
@@ -112,12 +289,13 @@ bool sqlite3_single_lookup(sqlite3* DB, const char* tableName,
 		const char* valueName, char* &valueData)
 {
 	valueData=NULL;
-	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName) + 20;
+	size_t stringSize = 100 + strlen(valueName) + strlen(tableName) + strlen(keyName);
 	char query[stringSize];
-	sprintf(query,"SELECT %s FROM %s WHERE %s == %u",valueName,tableName,keyName,keyData);
-	// Prepare the statement.
-	sqlite3_stmt *stmt;
-	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
+	sprintf(query,"SELECT %s FROM %s WHERE %s == ?",valueName,tableName,keyName);
+	// Get the statement.
+	sqlite3_stmt *stmt = sqlite3_cached_statement(DB,query);
+	if (!stmt) return false;
+	sqlite3_bind_int64(stmt,1,keyData);
 	// Read the result.
 	int src = sqlite3_run_query(DB,stmt);
 	bool retVal = false;
@@ -126,7 +304,7 @@ bool sqlite3_single_lookup(sqlite3* DB, const char* tableName,
 		if (ptr) valueData = strdup(ptr);
 		retVal = true;
 	}
-	sqlite3_finalize(stmt);
+	sqlite3_release_statement(DB,stmt);
 	return retVal;
 }
 
@@ -135,11 +313,12 @@ bool sqlite3_single_lookup(sqlite3* DB, const char* tableName,
 
 bool sqlite3_command(sqlite3* DB, const char* query)
 {
-	// Prepare the statement.
+	// Commands are mostly one-shot text, so don't let them push the lookups out of the cache.
 	sqlite3_stmt *stmt;
 	if (sqlite3_prepare_statement(DB,&stmt,query)) return false;
 	// Run the query.
 	int src = sqlite3_run_query(DB,stmt);
+	sqlite3_finalize(stmt);
 	return src==SQLITE_DONE;
 }
 
@@ -2,9 +2,39 @@
 #define SQLITE3UTIL_H
 
 #include <sqlite3.h>
+#include <ostream>
+
+/** Default time to wait for a lock held by another connection, in ms. */
+static const unsigned sqlite3_default_busy_timeout = 2000;
+
+/**
+	Set up a new connection: a counting busy handler that waits up to busyTimeout ms,
+	and write-ahead logging if the library supports it.
+	Return true if WAL is on.
+*/
+bool sqlite3_setup(sqlite3* DB, unsigned busyTimeout=sqlite3_default_busy_timeout);
 
 int sqlite3_prepare_statement(sqlite3* DB, sqlite3_stmt **stmt, const char* query);
 
+/**
+	Take a prepared statement for a query from the connection's cache,
+	preparing it if the cache has none.  The statement belongs to the caller
+	until it is given back with sqlite3_release_statement().
+	Use bound parameters rather than formatting values into the query,
+	so that the text, which is the cache key, stays the same.
+	Return NULL on failure.
+*/
+sqlite3_stmt* sqlite3_cached_statement(sqlite3* DB, const char* query);
+
+/** Reset a statement from sqlite3_cached_statement() and put it back in the cache. */
+void sqlite3_release_statement(sqlite3* DB, sqlite3_stmt *stmt);
+
+/** Finalize the cached statements of a connection.  Call this before closing it. */
+void sqlite3_clear_cache(sqlite3* DB);
+
+/** Dump the cache and lock contention counters, for all connections. */
+void sqlite3_dump_stats(std::ostream& os);
+
 int sqlite3_run_query(sqlite3* DB, sqlite3_stmt *stmt);
 
 bool sqlite3_single_lookup(sqlite3* DB, const char *tableName,
@@ -23,7 +53,7 @@ bool sqlite3_single_lookup(sqlite3* DB, const char* tableName,
 bool sqlite3_exists(sqlite3* DB, const char* tableName,
 		const char* keyName, const char* keyData);
 
-/** Run a query, ignoring the result; return true on success. */
+/** Run a query, ignoring the result; return true on success.  The statement is not cached. */
 bool sqlite3_command(sqlite3* DB, const char* query);
 
 #endif